@@ -1,15 +1,52 @@
 //uniforms that are used several places are placed here.
 
+//Single-pass stereo: cnovr compiles a second copy of the shader with CNOVR_MULTIVIEW defined, so
+//include this before anything else that isn't a preprocessor line.
+#ifdef CNOVR_MULTIVIEW
+#extension GL_OVR_multiview2 : require
+#ifdef CNOVR_VERTEX_SHADER
+layout(num_views = 2) in;
+#endif
+#endif
+
 // (pound sign)MAPUNIFORM is a special flag that tells cnovr to load the named uniform into a slot
 // this is like the layout= thing that was provided in later versions of OpenGL.
 // but I want to support as broad of a platform as possible, so we have to reinvent the wheel.
 
 //Locations 0..3 TBA
 uniform mat4 umModel;           //#MAPUNIFORM umModel 4
-uniform mat4 umView;            //#MAPUNIFORM umView 5
-uniform mat4 umPerspective;     //#MAPUNIFORM umPerspective 6
-uniform vec4 ufRenderProps;     //#MAPUNIFORM ufRenderProps 7
 uniform sampler2D textures[8];  //#MAPUNIFORM textures 8
 
+//Per-frame / per-eye values live in one UBO (binding UBOBINDING_FRAME) that all shaders share, so
+//switching shaders doesn't resend them.  row_major because that's how cnovr keeps its matrices.
+layout(std140, row_major) uniform CNOVRFrame
+{
+	mat4 umView;
+	mat4 umPerspective;
+	vec4 ufRenderProps;
+	mat4 umStereoView[2];
+	mat4 umStereoPerspective[2];
+	vec4 ufEye;                 //x = cnovrstate->eyeTarget (0 = left, 1 = right, 2 = preview)
+};
+
+//Use CNOVREyeTarget instead of checking eyeTarget on the CPU, in single-pass stereo both eyes draw at once.
+#ifdef CNOVR_MULTIVIEW
+#define umView umStereoView[gl_ViewID_OVR]
+#define umPerspective umStereoPerspective[gl_ViewID_OVR]
+#define CNOVREyeTarget int(gl_ViewID_OVR)
+#else
+#define CNOVREyeTarget int(ufEye.x)
+#endif
+
 //Locations 16+ are fair game by users.
 
+//Instanced rendering (CNOVRModelRenderInstanced), #define CNOVR_INSTANCED in your .vert before including this.
+//Each instance gets its own model matrix, otherwise use CNOVRModelMatrix just like umModel.
+//They're transposed to column-major on upload, so unlike umModel (transpose=1) they're used as is.
+#ifdef CNOVR_INSTANCED
+in mat4 iamModel;               //#MAPATTRIB iamModel 8
+#define CNOVRModelMatrix iamModel
+#else
+#define CNOVRModelMatrix umModel
+#endif
+
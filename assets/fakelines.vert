@@ -1,4 +1,5 @@
 #version AUTOVER
+#inject
 #include "cnovr.glsl"
 
 //This is a weird system for making things that look like GL_LINES with a hard black
@@ -19,6 +20,6 @@ void main()
 {
 	barytc = bary;
 	normo = norm;
-	vec4 nppos  = umView * umModel * vec4(position.xyz,1.0);
+	vec4 nppos  = umView * CNOVRModelMatrix * vec4(position.xyz,1.0);
 	gl_Position = umPerspective * nppos;
 }
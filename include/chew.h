@@ -73,6 +73,8 @@ CHEWTYPEDEF( void, glVertexAttribPointer, , (index,size,type,normalized,stride,p
 CHEWTYPEDEF( void, glVertexAttribIPointer, , (index,size,type,stride,pointer), GLuint index, GLint size, GLenum type, GLsizei stride, const GLvoid * pointer )
 CHEWTYPEDEF( void, glVertexAttribLPointer, , (index,size,type,stride,pointer), GLuint index, GLint size, GLenum type, GLsizei stride, const GLvoid * pointer )
 CHEWTYPEDEF( void, glBindAttribLocation, , (program,index,name), GLuint program, GLuint index, const GLchar *name )
+CHEWTYPEDEF( void, glVertexAttribDivisor, , (index,divisor), GLuint index, GLuint divisor )
+CHEWTYPEDEF( void, glDrawElementsInstanced, , (mode,count,type,indices,instancecount), GLenum mode, GLsizei count, GLenum type, const void * indices, GLsizei instancecount )
 
 CHEWTYPEDEF( void, glDeleteVertexArrays, , (n,arrays), GLsizei n, const GLuint *arrays )
 CHEWTYPEDEF( void, glDeleteBuffers, , (n,buffers), GLsizei n, const GLuint * buffers )
@@ -105,6 +107,14 @@ CHEWTYPEDEF( void, glDeleteRenderbuffers, , (n,renderbuffers), GLsizei n, const
 CHEWTYPEDEF( GLenum, glCheckFramebufferStatus, return, (target) , GLenum target )
 CHEWTYPEDEF( GLenum, glCheckNamedFramebufferStatus, return, (framebuffer,target), GLuint framebuffer, GLenum target )
 CHEWTYPEDEF( void, glFramebufferTexture, , (target,attachment,texture,level), GLenum target, GLenum attachment, GLuint texture, GLint level )
+CHEWTYPEDEF( void, glFramebufferTextureLayer, , (target,attachment,texture,level,layer), GLenum target, GLenum attachment, GLuint texture, GLint level, GLint layer )
+CHEWTYPEDEF( void, glFramebufferTextureMultiviewOVR, , (target,attachment,texture,level,baseViewIndex,numViews), GLenum target, GLenum attachment, GLuint texture, GLint level, GLint baseViewIndex, GLsizei numViews )
+CHEWTYPEDEF2( void, glTexImage3D, glTexImage3DCHEW, , (target,level,internalformat,width,height,depth,border,format,type,data), GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void * data )
+CHEWTYPEDEF( void, glTexImage3DMultisample, , (target,samples,internalformat,width,height,depth,fixedsamplelocations), GLenum target, GLsizei samples, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth, GLboolean fixedsamplelocations )
+CHEWTYPEDEF( const GLubyte *, glGetStringi, return, (name,index), GLenum name, GLuint index )
+CHEWTYPEDEF( void, glTexStorage2D, , (target,levels,internalformat,width,height), GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height )
+CHEWTYPEDEF2( void, glCompressedTexImage2D, glCompressedTexImage2DCHEW, , (target,level,internalformat,width,height,border,imageSize,data), GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const void * data )
+CHEWTYPEDEF2( void, glCompressedTexSubImage2D, glCompressedTexSubImage2DCHEW, , (target,level,xoffset,yoffset,width,height,format,imageSize,data), GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLsizei imageSize, const void * data )
 
 
 
@@ -144,12 +154,25 @@ CHEWTYPEDEF( void, glUniformMatrix3fv, ,(location,count,transpose,value) , GLint
 CHEWTYPEDEF( void, glUniformMatrix4fv, ,(location,count,transpose,value) , GLint location, GLsizei count, GLboolean transpose, const GLfloat *value )
 CHEWTYPEDEF( void, glGetProgramInfoLog, , (program,maxLength, length, infoLog), GLuint program, GLsizei maxLength, GLsizei *length, GLchar *infoLog )
 CHEWTYPEDEF( GLint, glGetUniformLocation, return, (program,name), GLuint program, const GLchar *name )
+CHEWTYPEDEF( GLuint, glGetUniformBlockIndex, return, (program,uniformBlockName), GLuint program, const GLchar *uniformBlockName )
+CHEWTYPEDEF( void, glUniformBlockBinding, , (program,uniformBlockIndex,uniformBlockBinding), GLuint program, GLuint uniformBlockIndex, GLuint uniformBlockBinding )
+CHEWTYPEDEF( void, glBindBufferBase, , (target,index,buffer), GLenum target, GLuint index, GLuint buffer )
 
 CHEWTYPEDEF( void *, glMapBuffer, return, (target,access), GLenum target, GLenum access )
 CHEWTYPEDEF( void *, glMapNamedBuffer, return, (buffer,access), GLuint buffer, GLenum access )
 CHEWTYPEDEF( void *, glMapBufferRange, return, (buffer,offset,length,access), GLuint buffer, GLintptr offset, GLsizeiptr length, GLbitfield access )
 
 CHEWTYPEDEF( GLboolean, glUnmapBuffer, return, (target), GLenum target )
+CHEWTYPEDEF( void, glBufferStorage, , (target,size,data,flags), GLenum target, GLsizeiptr size, const void * data, GLbitfield flags )
+
+CHEWTYPEDEF( GLsync, glFenceSync, return, (condition,flags), GLenum condition, GLbitfield flags )
+CHEWTYPEDEF( GLenum, glClientWaitSync, return, (sync,flags,timeout), GLsync sync, GLbitfield flags, GLuint64 timeout )
+CHEWTYPEDEF( void, glDeleteSync, , (sync), GLsync sync )
+
+CHEWTYPEDEF( void, glProgramParameteri, , (program,pname,value), GLuint program, GLenum pname, GLint value )
+CHEWTYPEDEF( void, glGetProgramBinary, , (program,bufSize,length,binaryFormat,binary), GLuint program, GLsizei bufSize, GLsizei * length, GLenum * binaryFormat, void * binary )
+CHEWTYPEDEF( void, glProgramBinary, , (program,binaryFormat,binary,length), GLuint program, GLenum binaryFormat, const void * binary, GLsizei length )
+CHEWTYPEDEF( void, glMaxShaderCompilerThreadsKHR, , (count), GLuint count )
 
 #ifdef __cplusplus
 #ifndef TABLEONLY
@@ -83,9 +83,28 @@ typedef void (APIENTRY *GLDEBUGPROC)(
 #define GL_MAP_INVALIDATE_BUFFER_BIT      0x0008
 #define GL_MAP_FLUSH_EXPLICIT_BIT         0x0010
 #define GL_MAP_UNSYNCHRONIZED_BIT         0x0020
+#define GL_MAP_PERSISTENT_BIT             0x0040
+#define GL_MAP_COHERENT_BIT               0x0080
+#define GL_DYNAMIC_STORAGE_BIT            0x0100
+
+#define GL_SYNC_GPU_COMMANDS_COMPLETE     0x9117
+#define GL_SYNC_FLUSH_COMMANDS_BIT        0x00000001
+#define GL_ALREADY_SIGNALED               0x911A
+#define GL_TIMEOUT_EXPIRED                0x911B
+#define GL_CONDITION_SATISFIED            0x911C
+#define GL_WAIT_FAILED                    0x911D
 
 #define GL_VERTEX_PROGRAM_POINT_SIZE      0x8642
 #define GL_DEPTH_CLAMP                    0x864F
+#define GL_UNIFORM_BUFFER                 0x8A11
+#define GL_INVALID_INDEX                  0xFFFFFFFFu
+#define GL_TEXTURE_2D_ARRAY               0x8C1A
+#define GL_TEXTURE_2D_MULTISAMPLE_ARRAY   0x9102
+#define GL_DEPTH_COMPONENT24              0x81A6
+#define GL_NUM_EXTENSIONS                 0x821D
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH          0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS     0x87FE
 
 
 #define GL_POINT_SPRITE 0x8861
@@ -100,5 +119,10 @@ typedef void (APIENTRY *GLDEBUGPROC)(
 
 #endif
 
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR          0x91B1
+#endif
+
 
 #endif
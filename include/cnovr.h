@@ -21,11 +21,13 @@ int CNOVRAlertv( void * tag, int priority, const char * format, va_list ap );
 //////////////////////////////////////////////////////////////////////////////
 
 #define UNIFORMSLOT_MODEL       4
-#define UNIFORMSLOT_VIEW        5
-#define UNIFORMSLOT_PERSPECTIVE 6
-#define UNIFORMSLOT_RENDERPROPS 7
+//5..7 used to be view, perspective and renderprops, they're in the CNOVRFrame UBO now.
 #define UNIFORMSLOT_TEXTURES    8 //Provides 8 textures total.
 
+#define UBOBINDING_FRAME        0 //CNOVRFrame block in cnovr.glsl, see CNOVRFrameUniformsUpdate.
+
+#define ATTRIBSLOT_INSTANCEMODEL 8 //mat4, takes 8..11, see CNOVRModelRenderInstanced.
+
 //////////////////////////////////////////////////////////////////////////////
 // Globals (State)
 struct cnovrstate_t
@@ -39,8 +41,8 @@ struct cnovrstate_t
 	float fNear;
 	float fFar;
 	float mModel[16];	//Current model matrix, changes per object. (SLOT=4)
-	float mView[16];	//Current view matrix, changes per eye.     (SLOT=5)
-	float mPerspective[16];                                      // (SLOT=6)
+	float mView[16];	//Current view matrix, changes per eye.     (CNOVRFrame UBO)
+	float mPerspective[16];                                      // (CNOVRFrame UBO)
 
 	//cnovr_simple_node * pRootNode;
 
@@ -76,6 +78,23 @@ struct cnovrstate_t
 	uint8_t  has_ovr;
 	uint8_t  has_preview;
 	uint8_t  iMultisample; //If 0, use direct path, otherwise, use 2+.
+
+	//Set to ask for both eyes in one pass (GL_OVR_multiview2), cleared if the driver can't.
+	//While bStereoPass is set, eyeTarget is 0 for both eyes, shaders get umView/umPerspective and
+	//CNOVREyeTarget for whichever eye they're on.  Tricky: That means the CPU can't tell the eyes apart,
+	//anything that draws something different per eye has to do it in the shader with CNOVREyeTarget.
+	uint8_t  bSinglePassStereo;
+	uint8_t  bStereoPass;
+	cnovr_rf_buffer * stereolayered;
+	float mStereoView[2][16];
+	float mStereoPerspective[2][16];
+
+	//Allocate both eyes as one texture array instead of two separate targets (implied by bSinglePassStereo).
+	uint8_t  bEyeTextureArray;
+	//Resolve multisample targets with the resolve shader instead of glBlitFramebuffer.
+	uint8_t  bShaderResolve;
+	//Set at init if the driver has GL_KHR_parallel_shader_compile, shaders are then polled instead of waited on.
+	uint8_t  bParallelShaderCompile;
 } __attribute__((packed));
 
 #if defined( TCCINSTANCE ) && defined( WINDOWS )
@@ -88,9 +107,17 @@ extern struct cnovrstate_t * cnovrstate;
 int CNOVRInit( const char * appname, int screenx, int screeny, int allow_init_without_vr );
 void CNOVRShutdown();
 void CNOVRUpdate();
-int CNOVRCheck(); //Check for errors.
+int (CNOVRCheck)(); //Check for errors.
+//glGetError stalls the pipeline, so checks compile out unless you build with -DCNOVR_GLCHECK.
+#ifndef CNOVR_GLCHECK
+#define CNOVRCheck() 0
+#endif
 
 void CNOVRShaderLoadedSetUniformsInternal();
+void CNOVRShaderLoadedSetModelInternal(); //Only sends cnovrstate->mModel.
+//Pushes view, perspective and renderprops into the CNOVRFrame UBO if they changed.  Binding a shader
+//does this for you, only call it if you change them and keep drawing with the same shader.
+void CNOVRFrameUniformsUpdate();
 
 #endif
 
@@ -89,10 +89,18 @@ typedef struct cnovrfocus_properties_t
 	float NewPassiveProps[4];
 } cnovrfocus_properties;
 
+//Passed to cnovrLCollideBatch callbacks, so they can test every device in one go.
+typedef struct cnovrfocus_batch_t
+{
+	int count;
+	cnovrfocus_properties * props[CNOVRINPUTDEVS];
+} cnovrfocus_batch;
+
 //Ugh this is awkward.  Need to fix.
 
 //YOU own the 'ce' object. We just store it for you.
 void CNOVRFocusRespond( cnovrfocus_capture * ce, float realdistance, float * fdprops );
+void CNOVRFocusRespondDev( int devid, cnovrfocus_capture * ce, float realdistance, float * fdprops ); //For cnovrLCollideBatch callbacks.
 void CNOVRFocusAcquire( cnovrfocus_capture * ce, int wantfocus );
 void CNOVRFocusRemoveTag( void * tag );
 cnovr_pose * CNOVRFocusGetTipPose( int device );
@@ -116,6 +124,7 @@ typedef struct cnovr_model_focus_controller_t
 
 // Focus Stuff
 
+//Interactables go in a world space AABB tree, only the ones near a device's ray get collided.  Pass 0 to remove.
 void CNOVRModelSetInteractable( struct cnovr_model_t * m, cnovrfocus_capture * focusevent );
 void CNOVRGeneralHandleFocusEvent( cnovr_model_focus_controller * fc, cnovr_pose * pose, cnovrfocus_properties * prop, int event, int buttoninfo, int grabbutton /*default should be CTRLA_PINCHBTN*/ );
 
@@ -249,6 +249,13 @@ static inline cnovr_pose pose_invert_rtn(const cnovr_pose *pose_in)
 void pose_to_matrix44(FLT *mat44, const cnovr_pose *pose_in);
 void matrix44_to_pose(cnovr_pose *poseout, const FLT *m44); //HMD43-safe.
 
+// Batch versions of the above, for when you have a lot of them.  They match the scalar versions to within rounding.
+// Output can be the same array as an input.
+void apply_pose_to_point_n(cnovr_point3d *pout, const cnovr_pose *pose, const cnovr_point3d *pin, int n);
+void apply_pose_to_pose_n(cnovr_pose *pout, const cnovr_pose *lhs_poses, const cnovr_pose *rhs_poses, int n); // pout[i] = lhs[i] * rhs[i]
+void pose_to_matrix44_n(FLT *mat44s, const cnovr_pose *poses, int n); // 16 FLTs per pose.
+void quatslerp_n(cnovr_quat *q, const cnovr_quat *qa, const cnovr_quat *qb, const FLT *t, int n);
+
 void matrix44copy(FLT *mout, const FLT *minm);
 void matrix44transposeunsafe(FLT *mout, const FLT *minm); //Cannot operate on self.
 void matrix44transposeself(FLT *mout);
@@ -44,6 +44,24 @@ typedef struct cnovr_header_t
 #define CNOVRDelete( x )  CNOVRDeleteBase( &(x->base) )
 void CNOVRDeleteBase( cnovr_base * b );
 
+//Shared assets: textures from CNOVRTextureCreateFromFile, shaders, and OBJ geometry are kept by what they were
+//loaded from (resolved path + load parameters).  Asking for the same thing again hands back the same object with
+//one more reference, and CNOVRDelete on it only drops yours.  Don't change them in ways the other holders wouldn't expect.
+int CNOVRAssetCount();
+
+//Thin GL state cache, so redundant program, texture and VAO binds never reach the driver.  Everything in
+//the core binds through these, and the TCC exports of glBindTexture/glActiveTextureCHEW route here too.
+//If you bind any of these behind its back, call CNOVRStateInvalidate().  Invalidated every frame anyway.
+void CNOVRStateInvalidate();
+void CNOVRStateUseProgram( GLuint program );
+void CNOVRStateActiveTexture( int unit );
+void CNOVRStateBindTexture( GLuint texture ); //GL_TEXTURE_2D on the active unit.
+void CNOVRStateBindVertexArray( GLuint vao );
+//Call these before deleting the object, GL silently unbinds deleted objects.
+void CNOVRStateForgetProgram( GLuint program );
+void CNOVRStateForgetTexture( GLuint texture );
+void CNOVRStateForgetVertexArray( GLuint vao );
+
 #define TYPE_RFBUFFER 1
 #define TYPE_SHADER   2
 #define TYPE_TEXTURE  3
@@ -53,6 +71,8 @@ void CNOVRDeleteBase( cnovr_base * b );
 
 //////////////////////////////////////////////////////////////////////////////
 
+#define CNOVR_RF_MAX_LAYERS 2
+
 typedef struct cnovr_rf_buffer_t
 {
 	cnovr_base base;
@@ -63,15 +83,28 @@ typedef struct cnovr_rf_buffer_t
 	GLuint nColorBufferId;
 	GLuint nRenderTextureId;
 
-	struct cnovr_shader_t *resolveshader;
-	struct cnovr_model_t * resolvegeo;  
 	int width, height;
 	int origw, origh; //For holding while activating buffer.
 	int multisample;
+	int active;
+
+	//Only for layered buffers, render texture is an array, each layer resolves into its own 2D texture.
+	//If multiview, nRenderFramebufferId draws all layers at once, otherwise nLayerReadFramebufferId[] are drawn to one at a time.
+	int layers;
+	int multiview;
+	GLuint nLayerReadFramebufferId[CNOVR_RF_MAX_LAYERS];
+	GLuint nLayerResolveFramebufferId[CNOVR_RF_MAX_LAYERS];
+	GLuint nLayerResolveTextureId[CNOVR_RF_MAX_LAYERS];
 } cnovr_rf_buffer;
 
 cnovr_rf_buffer * CNOVRRFBufferCreate( int w, int h, int multisample );
+//Needs GL_OVR_multiview2.  Everything drawn while it's active goes to all layers at once, see bStereoPass.
+//CNOVRFBufferActivateLayer still draws just the one layer.
+cnovr_rf_buffer * CNOVRRFBufferCreateLayered( int w, int h, int multisample, int layers );
+//Same storage as the layered buffer, but no multiview, draw each layer with CNOVRFBufferActivateLayer.
+cnovr_rf_buffer * CNOVRRFBufferCreateArray( int w, int h, int multisample, int layers );
 void CNOVRFBufferActivate( cnovr_rf_buffer * b );
+void CNOVRFBufferActivateLayer( cnovr_rf_buffer * b, int layer );
 void CNOVRFBufferDeactivate( cnovr_rf_buffer * b );
 void CNOVRFBufferBlitResolve( cnovr_rf_buffer * b );
 
@@ -85,6 +118,20 @@ typedef struct cnovr_shader_t
 	char * shaderfilebase;
 	char * prefix;
 	uint8_t uniforms[SHADER_MAX_UNIFORM_MAP];
+
+	//Built on first use while bSinglePassStereo is set, same source compiled with CNOVR_MULTIVIEW.
+	struct cnovr_shader_t * multiview;
+	uint8_t bMultiview;
+	uint8_t bMultiviewPending; //This is a twin that hasn't finished its first build.
+
+	//A rebuild in flight, the current program stays in use until it's ready.  pLoaded is the sources from the
+	//loader thread, pBuild the GL objects while the driver compiles them.
+	struct cnovr_shader_build_t * pLoaded;
+	struct cnovr_shader_build_t * pBuild;
+
+	//What the mapped uniforms were last set to, so binding a shader only sends what changed.
+	uint32_t iUniformsSent; //Bit per UNIFORMSLOT_*, cleared on relink.
+	float mSentModel[16];
 } cnovr_shader;
 
 typedef struct cnovr_shader_uniform_t
@@ -106,6 +153,8 @@ extern cnovr_shader * cnovr_current_shader;
 GLint CNOVRUniform( cnovr_shader_uniform * u );
 
 //Call 'render' submethod to activate, and 'prerender' checks to see if anything is tainted.
+//Shared, by shaderfilebase + prefix.  Builds in the background, nShaderID is 0 (and render does nothing) until the first one's done.
+//Linked programs are cached next to the .vert as *.progcache.
 cnovr_shader * CNOVRShaderCreate( const char * shaderfilebase );
 
 //"prefix" can be things like "#define xxx" or whatever you want to be at the top of the shader files.
@@ -113,6 +162,9 @@ cnovr_shader * CNOVRShaderCreateWithPrefix( const char * shaderfilebase, const c
 
 int CNOVRShaderMapUniform( cnovr_shader * shader, const char * uniform_name, int targetmap );
 
+//Number of multiview twins (see bSinglePassStereo) that are still building.  While nonzero, eyes are drawn one at a time.
+int CNOVRShaderMultiviewPending();
+
 ///////////////////////////////////////////////////////////////////////////////
 
 typedef struct cnovr_texture_t
@@ -133,6 +185,24 @@ typedef struct cnovr_texture_t
 	uint8_t bFileChangeFlag;
 	uint8_t bCalculateMipMaps;
 	uint8_t bBypassTextureID;
+	uint8_t bCompress;        //Set before CNOVRTextureLoadFileAsync to block-compress (BC1/BC3) on load, cached as <file>.texcache.
+	uint8_t bLinear;          //File isn't sRGB color (normal maps, etc.), so CPU mips average it as-is.
+
+	//Async uploads: the loader fills a pooled PBO, prerender only does the glTexSubImage2D out of it.
+	int iPBOSlot;             //1-based into the pool, 0 if none held.
+	uint8_t * pPBOMapped;
+	uint32_t iUploadSerial;   //Bumped per async load so stale fill/upload jobs know to bail.
+
+	//Immutable (glTexStorage2D) storage, only reallocated when these change.  0 = none/mutable.
+	int iStorageWidth, iStorageHeight, iStorageLevels;
+	GLint nStorageInternalFormat;
+
+	//If set, data is block-compressed (see cnovrtexcompress.h) instead of pixels.
+	GLenum nCompressedFormat;
+	//How many mip levels data holds, largest first.  Files loaded with bCalculateMipMaps get their chain made on
+	//the loader thread, otherwise it's 1 and glGenerateMipmap makes them.
+	int iDataLevels;
+	int iUploadLevel;         //Chains go up coarse to fine, one level a frame.  Next one to go, -1 if done.
 
 	og_mutex_t mutProtect;
 } cnovr_texture;
@@ -140,24 +210,52 @@ typedef struct cnovr_texture_t
 
 //Defaults to a 1x1 px texture.
 cnovr_texture * CNOVRTextureCreate( int initw, int inith, int initchan ); //Set to all 0 to have the load control these details.
-int CNOVRTextureLoadFileAsync( cnovr_texture * tex, const char * texfile );
+int CNOVRTextureLoadFileAsync( cnovr_texture * tex, const char * texfile ); //Into tex, not shared.
+
+//Shared, by resolved path + flags.  Set up per flags before the load is queued.
+#define CNOVR_TEXFILE_MIPMAPS  1 //bCalculateMipMaps
+#define CNOVR_TEXFILE_COMPRESS 2 //bCompress
+#define CNOVR_TEXFILE_LINEAR   4 //bLinear
+cnovr_texture * CNOVRTextureCreateFromFile( const char * texfile, int flags );
 int CNOVRTextureLoadDataAsync( cnovr_texture * tex, int w, int h, int chan, int is_float, void * data ); //Data must be on heap.
 int CNOVRTextureLoadDataNow( cnovr_texture * tex, int w, int h, int chan, int is_float, void * data, int data_permanant ); //Must only call from the render/prerender thread.
+//For streaming (i.e. video): Begin maps a pooled PBO for one w x h frame, fill it from any thread, then
+//Commit uploads it.  Both must be called from the render/prerender thread.  Begin returns 0 if no PBO is free.
+uint8_t * CNOVRTextureStreamBegin( cnovr_texture * tex, int w, int h, int chan, int is_float );
+void CNOVRTextureStreamCommit( cnovr_texture * tex );
 
 ///////////////////////////////////////////////////////////////////////////////
 
+#define CNOVR_VBO_RING_SEGMENTS 3
+
 typedef struct cnovr_vbo_t
 {
 	GLfloat *   pVertices;
 	GLuint		nVBO;
 	uint32_t	iVertexCount;
+	uint32_t	iCapacity; //In floats, not vertices, so changing the stride doesn't invalidate it.
 	int  		iStride;
 
 	uint8_t 	bTainting;
-	uint8_t		bDynamic;
+	uint8_t		bDynamic;  //Rewritten every frame.  Streams through a persistently mapped ring if the driver supports it.
 
 	og_mutex_t  mutData;
 	uint8_t bIsUploaded;
+
+	//Vertices [iDirtyStart,iDirtyEnd) changed since the last upload.
+	uint32_t	iDirtyStart;
+	uint32_t	iDirtyEnd;
+	uint32_t	iUploadedBytes;
+	uint32_t	iGeneration; //Bumped on every taint, so anything derived from the vertices can tell it's stale.
+	uint32_t	iBufferGeneration; //Unique per GL buffer created, names get reused so VAOs key off of this.
+
+	//Only for dynamic VBOs.  Only touched from the render thread.
+	uint8_t		bRing;
+	int			iRingIndex;
+	uint32_t	iRingSegment; //Bytes per segment
+	uint32_t	iRingOffset;  //Where to draw from.
+	uint8_t *	pRingMap;
+	GLsync		pRingFences[CNOVR_VBO_RING_SEGMENTS];
 } cnovr_vbo;
 
 
@@ -165,7 +263,13 @@ typedef struct cnovr_vbo_t
 cnovr_vbo * CNOVRCreateVBO( int iStride, int bDynamic, int iInitialSize, int iAttribNo );
 void CNOVRVBOTackv( cnovr_vbo * g, int nverts, float * v );
 void CNOVRVBOTack( cnovr_vbo * g,  int nverts, ... ); //Warning: Performance: contents are auto-promoted to doubles and promptly demoted back to floats.
+//Bulk append: copies nverts vertices of iSrcStride floats each.  Extra source floats are dropped, missing ones are zeroed.
+//Returns the index of the first vertex appended.  Prefer this over Tack/Tackv when loading anything big.
+int CNOVRVBOTackN( cnovr_vbo * g, int nverts, const float * v, int iSrcStride );
+void CNOVRVBOReserve( cnovr_vbo * g, int nverts ); //Make room for nverts more vertices without reallocating.
 void CNOVRVBOTaint( cnovr_vbo * g );
+void CNOVRVBOTaintRange( cnovr_vbo * g, int first, int count ); //Only uploads the vertices you changed, if the size didn't change.
+void CNOVRVBOSetDynamic( cnovr_vbo * g, int dynamic ); //For data that's rewritten every frame.
 void CNOVRVBOSetStride( cnovr_vbo * g, int stride );
 void CNOVRVBODelete( cnovr_vbo * g );
 
@@ -210,6 +314,26 @@ typedef struct cnovr_model_t
 	int iCollideMesh; // -1 for all meshes.
 
 	char * sModifiers;
+
+	//OBJs loaded with CNOVRModelLoadFromFileAsync draw and collide out of this shared model, anything in our own
+	//geometry is ignored.  Pose, textures, iRenderMesh and iCollideMesh are still ours.
+	struct cnovr_model_t * pShared;
+
+	//Collision acceleration, see CNOVRModelCollide.
+	uint32_t iIndexGeneration;
+	struct cnovr_model_bvh_t * pBVH;
+	struct cnovr_model_bvh_t * pBVHPending;
+	uint8_t bBVHBuilding;
+
+	//Attribute setup lives in the VAO, pVAOAttribs tracks what each slot points at.
+	GLuint nVAO;
+	int iVAOAttribs;
+	struct cnovr_model_vao_attrib_t * pVAOAttribs;
+
+	//Per-instance model matrices, see CNOVRModelRenderInstanced.
+	GLuint nInstanceVBO;
+	float * pInstanceMatrices;
+	int iInstanceMax;
 } cnovr_model;
 
 //XXX TODO: Reorganize this.
@@ -223,9 +347,14 @@ void CNOVRModelSetNumVBOsWithStrides( cnovr_model * m, int vbos, ... );
 
 void CNOVRModelTaintIndices( cnovr_model * vm );
 
-void CNOVRModelLoadFromFileAsync( cnovr_model * m, const char * filename ); //Append ".rendermodel" to be an OpenVR rendermodel.
+void CNOVRModelLoadFromFileAsync( cnovr_model * m, const char * filename ); //Append ".rendermodel" to be an OpenVR rendermodel.  OBJs are shared, see pShared.
+//The model that actually holds m's geometry (pShared if set, otherwise m).  Read pGeos, pIndices, bIsLoading, etc. through this.
+cnovr_model * CNOVRModelGeometry( cnovr_model * m );
 void CNOVRModelTackIndex( cnovr_model * m, int nindices, ...);
 void CNOVRModelTackIndexv( cnovr_model * m, int nindices, uint32_t * indices );
+//Reorders triangles (within each mesh) so the GPU's post-transform cache gets more hits.  OBJ and rendermodel loads do this unless you add "nocacheopt".
+void CNOVRModelOptimizeVertexCache( cnovr_model * m );
+void CNOVROptimizeVertexCache( uint32_t * indices, int nindices );
 void CNOVRModelSetNumIndices( cnovr_model * m, uint32_t indices );
 void CNOVRModelResetMarks( cnovr_model * m );
 
@@ -236,12 +365,35 @@ void CNOVRModelAppendMesh( cnovr_model * m, int rows, int cols, int flipv, cnovr
 //If before first index, names first section.
 void CNOVRDelinateGeometry( cnovr_model * m, const char * newGeoName );
 
+//Uses a BVH once the model has enough triangles.  It's built on the async queue the first time you collide after a change,
+//brute force is used until it's ready.  Results are the same either way.
 int  CNOVRModelCollide( cnovr_model * m, const cnovr_point3d start, const cnovr_vec3d direction, cnovr_collide_results * r, float dradius, float minimumt );
+void CNOVRModelBuildBVH( cnovr_model * m ); //Build it now, on this thread, instead of waiting.
+
+typedef struct cnovr_collide_ray_t
+{
+	cnovr_point3d start;
+	cnovr_vec3d direction;
+	float dradius;
+	float minimumt;
+	cnovr_collide_results res; //Set res.t to the farthest you care about, same as CNOVRModelCollide.
+	int ret; //What CNOVRModelCollide would have returned.
+} cnovr_collide_ray;
+
+//Same as CNOVRModelCollide on each ray, but the model's only walked once for a whole batch.  Returns # of rays that hit.
+int  CNOVRModelCollideMany( cnovr_model * m, cnovr_collide_ray * rays, int nrays );
+//Replaces pTextures[0] with a shared one (see CNOVRTextureCreateFromFile), keeping its mipmap/compress/linear flags.
 void CNOVRModelApplyTextureFromFileAsync( cnovr_model * m, const char * sTextureFile );
 void CNOVRModelSetNumTextures( cnovr_model * m, int textures );
 
 void CNOVRModelRenderWithPose( cnovr_model * m, cnovr_pose * pose );
 
+//Draws count copies of the model in one glDrawElementsInstanced.  m->pose is ignored, each instance gets its own
+//model matrix in ATTRIBSLOT_INSTANCEMODEL.  The shader must #define CNOVR_INSTANCED and use CNOVRModelMatrix.
+void CNOVRModelRenderInstanced( cnovr_model * m, const cnovr_pose * poses, int count );
+//Same, but you provide the row-major 4x4's (16 floats per instance, same layout as pose_to_matrix44).
+void CNOVRModelRenderInstancedMatrices( cnovr_model * m, const float * mat44s, int count );
+
 //XXX TODO NOTE: We can set the models up to be "stamped" down with different uniform properties.  
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,50 @@
+#ifndef _CNOVR_PROFILE_H
+#define _CNOVR_PROFILE_H
+
+//Always-on frame profiler.  Every phase of CNOVRUpdate and every callback run by CNOVRListCall
+//goes into a ring buffer.  Dump it with CNOVRProfileDumpChromeTrace and open the result in
+//chrome://tracing (or ui.perfetto.dev).  A rolling per-phase and per-module summary is kept too.
+
+#define CNOVR_PROFILE_RING_SIZE 32768 //Must be a power of two.
+#define CNOVR_PROFILE_MAX_SUMMARY 128
+#define CNOVR_PROFILE_MODULE_NAME 32
+
+typedef struct cnovrprofile_event_t
+{
+	const char * name;   //Phase or run list name.  Must be a static string.
+	void * fn;           //Callback, if this was a callback.
+	void * tcctag;       //TCCInstance that owns the callback, 0 for core.
+	char module[CNOVR_PROFILE_MODULE_NAME]; //Copied at record time, the module may be gone when it's read.
+	double start;
+	double duration;
+	int eye;             //-1 if not eye-specific.
+	int thread;
+	int frame;
+	volatile unsigned seq; //Written last, so readers can tell if the slot is complete.
+} cnovrprofile_event;
+
+typedef struct cnovrprofile_summary_t
+{
+	const char * phase;  //Non-zero for a phase of CNOVRUpdate
+	char module[CNOVR_PROFILE_MODULE_NAME]; //Otherwise, the total of all callbacks in this module.
+	double fAveragems;   //Rolling per-frame average.
+	double fPeakms;      //Slowly decaying peak.
+	int iCalls;          //In the last frame.
+} cnovrprofile_summary;
+
+//Records [start, now] under name and returns now, so phases can be chained.
+double CNOVRProfilePhase( const char * name, int eye, double start );
+void CNOVRProfileRecord( const char * name, void * tcctag, void * fn, int eye, double start, double end );
+void CNOVRProfileEnable( int enable );
+int  CNOVRProfileIsEnabled();
+
+int  CNOVRProfileDumpChromeTrace( const char * filename ); //Returns number of events written, or -1.
+int  CNOVRProfileGetSummary( cnovrprofile_summary * out, int max );
+void CNOVRProfilePrintSummary();
+
+//Internal
+void CNOVRProfileInit();
+void CNOVRProfileFrameEnd(); //Called at the end of each frame.
+
+#endif
+
@@ -0,0 +1,36 @@
+#ifndef _CNOVR_TEXCOMPRESS_H
+#define _CNOVR_TEXCOMPRESS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+//CPU-side texture prep, for the loader threads so the render thread only has to upload.
+//Everything here works on RGBA8 and hands back every mip level, largest first, back to back.
+
+//How mips get filtered.  Both are a 2x2 box.
+#define CNOVR_TEXMIPS_NONE   0
+#define CNOVR_TEXMIPS_LINEAR 1 //Averages the bytes as-is.  For data that isn't color (normal maps, lookups).
+#define CNOVR_TEXMIPS_SRGB   2 //Averages color in linear light, alpha as-is.  What images off disk want.
+
+int CNOVRTexMipLevels( int w, int h ); //Full chain, down to 1x1.
+
+//rgba is a malloc'd w*h*4 image, it gets realloc'd to hold the whole chain (~4/3 the size) which is returned.
+uint8_t * CNOVRTexMipChainRGBA( uint8_t * rgba, int w, int h, int mips, int * levels, size_t * size );
+
+//Block compression, so big images (picture album, starfield) take 1/4 to 1/8 the VRAM and upload
+//bandwidth.  Opaque images go to BC1 (DXT1), anything with alpha to BC3 (DXT5).
+
+#define CNOVR_TEXCOMPRESS_BC1 0x83F0 //GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define CNOVR_TEXCOMPRESS_BC3 0x83F3 //GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+
+//rgba is w*h*4, mips is a CNOVR_TEXMIPS_*.  Returns a malloc'd blob.
+uint8_t * CNOVRTexCompressRGBA( const uint8_t * rgba, int w, int h, int mips, int * format, int * levels, size_t * size );
+size_t CNOVRTexCompressLevelSize( int format, int w, int h );
+
+//On-disk cache, next to the source as <file>.texcache.  Keyed by path, source mtime and mip filtering.
+//Load returns a malloc'd blob, or 0 if there's no usable cache.  Save failing isn't an error.
+uint8_t * CNOVRTexCompressCacheLoad( const char * filename, double srctime, int mips, int * w, int * h, int * format, int * levels, size_t * size );
+void CNOVRTexCompressCacheSave( const char * filename, double srctime, int mips, int w, int h, int format, int levels, const uint8_t * blob, size_t size );
+
+#endif
+
@@ -31,6 +31,12 @@ void * CNOVRNamedPtrData( const char * namedptr, const char * type, int size );
 
 char ** CNOVRFolderListing( const char * path, int * elements ); //You can free this up with a single free(...)
 char * CNOVRFileToString( const char * fname, int * length );
+//Read-only, zero-copy view of a whole file.  Tricky: Unlike CNOVRFileToString, it is NOT null terminated.
+//Files built into the executable are used first, like fopen.  Pass mapped back to CNOVRFileUnmap.
+//Only map files that are replaced by rename (like the caches).  If a mapped file is truncated in place, reading
+//it is a SIGBUS, so anything that gets edited and hot-reloaded should go through CNOVRFileToString.
+const char * CNOVRFileMap( const char * fname, int * length, int * mapped );
+void CNOVRFileUnmap( const char * data, int length, int mapped );
 char ** CNOVRSplitStrings( const char * line, char * split, char * white, int merge_fields, int * elementcount ); //You can just free(...) the return. it's safe.
 int CNOVRStringCompareEndingCase( const char * thing_to_search, const char * check_extension );
 char * CNOVRGetBaseFileName( const char * path ); //returned in trprintf, so you can't re-use the buffer.
@@ -46,7 +52,9 @@ void CNOVRFileSearchRemovePath( const char * path );
 
 
 //These must be threadsafe.  Also, need a way to wholesale clear out a class of these guys.
-void CNOVRFileTimeAddWatch( const char * fname, cnovr_cb_fn fn, void * tag, void * opaquev );  //XXX: This is also slow... We need to figure out a better way.
+//On Linux, changes are picked up with inotify on the file's directory.  Elsewhere, every watched file is polled.
+//Either way, callbacks fire once a file has been quiet for 200ms.
+void CNOVRFileTimeAddWatch( const char * fname, cnovr_cb_fn fn, void * tag, void * opaquev );
 void CNOVRFileTimeRemoveWatch( const char * fname, cnovr_cb_fn fn, void * tag, void * opaquev ); //XXX: this is slow. Avoid its use.
 void CNOVRFileTimeRemoveTagged( void * tag, int wait_on_pending );
 
@@ -58,20 +66,50 @@ double CNOVRFileTimeCached( const char * fname );
 typedef enum
 {
 	cnovrQLow,			//Things like making sure we're up to date - not sure?
-	cnovrQAsync,		//??? No access to GL thread.
+	cnovrQAsync,		//No access to GL thread.  Serviced by a pool of workers, so jobs may run concurrently with each other.
 	//cnovrQUpdate,		//???
 	cnovrQPrerender,	//Happens in the render thread
 	cnovrQMAX,
 } cnovrQueueType;
 
+//Higher priority jobs are always taken first.  Keep small, latency-sensitive work (dynamic buffer updates) high
+//and big work (texture uploads, shader compiles) low so the big things can't starve the small ones.
+//Order is only kept within a class, so a job that must run after another job for the same object can't be
+//in a higher class than it.  That's why deletes go low.
+typedef enum
+{
+	cnovrPriorityHigh,
+	cnovrPriorityNormal,
+	cnovrPriorityLow,
+	cnovrPriorityMAX,
+} cnovrJobPriority;
+
 //Async, but, has delays between each completion. Multiple identical items can queue.  Cancellation must match all parameters.
-void CNOVRJobTack( cnovrQueueType q, cnovr_cb_fn fn, void * tag, void * opaquev, bool insert_even_if_pending );
+void CNOVRJobTack( cnovrQueueType q, cnovr_cb_fn fn, void * tag, void * opaquev, bool insert_even_if_pending ); //Normal priority
+void CNOVRJobTackPriority( cnovrQueueType q, cnovr_cb_fn fn, void * tag, void * opaquev, bool insert_even_if_pending, cnovrJobPriority priority );
 void CNOVRJobCancel( cnovrQueueType q, cnovr_cb_fn fn, void * tag, void * opaquev, bool wait_on_pending );
 void CNOVRJobCancelAllTag( void * tag, int wait_on_pending );
 
+//cnovrQPrerender is run against a per-frame time budget.  Anything left over carries to the next frame.
+#define CNOVR_DEFAULT_PRERENDER_BUDGET_US 2000
+void CNOVRJobSetBudget( cnovrQueueType q, int budgetus ); //0 = drain the whole queue every pass.
+
+typedef struct cnovrJobStats_t
+{
+	int iDepth[cnovrPriorityMAX]; //Jobs waiting, by priority.
+	int iDepthTotal;
+	int iBudgetus;
+	int iJobsLastPass;            //From the last CNOVRJobProcessQueueBudgeted
+	double fTimeLastPassus;
+	double fTimeAverageus;        //Rolling average of fTimeLastPassus
+} cnovrJobStats;
+
+void CNOVRJobGetStats( cnovrQueueType q, cnovrJobStats * stats );
+
 //Usually internal
 void DEBUGDumpQueue( cnovrQueueType qt );
 int CNOVRJobProcessQueueElement( cnovrQueueType q ); //returns 1 if queue still processing.
+int CNOVRJobProcessQueueBudgeted( cnovrQueueType q ); //Runs jobs until the budget is spent, returns number run.
 
 //////////////////////////////////////////////////////////////////////////////
 //XXX TODO: Add some sort of "in the future" queue.
@@ -92,12 +130,15 @@ typedef enum
 	cnovrLRender4,
 	cnovrLPostRender,
 	cnovrLPreviewRender,
+	//Tricky: New lists go at the end, compiled modules have the numbers above baked in.
+	cnovrLCollideBatch, //Called once with a cnovrfocus_batch of every active device, see cnovrfocus.h
 	cnovrLMAX,
 } cnovrRunList;
 
 //Returns # of called events.
 int CNOVRListCall( cnovrRunList l, void * data, int delete_on_call ); 
-void CNOVRListAdd( cnovrRunList l, void * base_object, cnovr_cb_fn * fn );
+void CNOVRListAdd( cnovrRunList l, void * base_object, cnovr_cb_fn * fn ); //Priority 0
+void CNOVRListAddPriority( cnovrRunList l, void * base_object, cnovr_cb_fn * fn, int priority ); //Lower priorities are called first, ties in order added.
 void CNOVRListDeleteTag( void * base_object );
 void CNOVRListDeleteTCCTag( void * tcctag );
 
@@ -112,7 +112,6 @@ int previewH;
 int videoW = 1920;
 int videoH = 1080;
 
-int pboid;
 int pboid_download;
 void * mapptr_download = 0;
 int previewframehisthead_download = -1;
@@ -699,21 +698,10 @@ void PrerenderFunction( void * tag, void * opaquev )
 				did_set_aspect_ratio = 1;
 				CNOVRCanvasSetPhysicalSize( canvasvideo, videoW/(float)videoH, 1.0 );
 			}
-			if( !pboid )
-			{
-				glGenBuffers( 1, &pboid );
-				glBindBuffer( GL_PIXEL_UNPACK_BUFFER, pboid );
-				glBufferData(GL_PIXEL_UNPACK_BUFFER, videoW*videoH*2, NULL, GL_STREAM_DRAW);
-				mapptr = glMapBufferRange( GL_PIXEL_UNPACK_BUFFER, 0, videoW*videoH*4/2, GL_MAP_WRITE_BIT|GL_MAP_INVALIDATE_BUFFER_BIT);
-				glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
-			}
-			glBindBuffer( GL_PIXEL_UNPACK_BUFFER, pboid ); 
-			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER );
-			glBindTexture( GL_TEXTURE_2D, textureid );
-			glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, videoW/2, videoH, GL_RGBA, GL_UNSIGNED_BYTE, 0);
-			glBindTexture( GL_TEXTURE_2D, 0 );
-			mapptr = glMapBufferRange( GL_PIXEL_UNPACK_BUFFER, 0, videoW*videoH*4/2, GL_MAP_WRITE_BIT|GL_MAP_INVALIDATE_BUFFER_BIT);
-			glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 ); 
+			//YUYV goes up as half-width RGBA, previewyuyv unpacks it.
+			cnovr_texture * t = canvasvideo->model->pTextures[0];
+			if( mapptr ) CNOVRTextureStreamCommit( t );
+			mapptr = CNOVRTextureStreamBegin( t, videoW/2, videoH, 4, 0 );
 			framegrabbed = 0;
 			uploadednewframe = 1;
 		}
@@ -26,8 +26,9 @@ int widths[MAX_PICTURES];
 int heights[MAX_PICTURES];
 char picturestorename[160];
 
-//Bitfield of what outputs NOT to draw on.
+//Bitfield of what outputs NOT to draw on.  Checked in the shader against CNOVREyeTarget.
 int rendermask = 0;
+cnovr_shader_uniform picturealbum_uniform_rendermask = { "rendermask" };
 
 struct staticstore
 {
@@ -159,10 +160,9 @@ void UpdateFunction( void * tag, void * opaquev )
 
 void RenderFunction( void * tag, void * opaquev )
 {
-	if( (1<<cnovrstate->eyeTarget) & rendermask ) return;
-
 	int i;
 	CNOVRRender( shader );
+	glUniform1i( CNOVRUniform( &picturealbum_uniform_rendermask ), rendermask );
 	CNOVRRender( palette_m );
 	//glDisable(GL_CULL_FACE);
 	for( i = 0; i < MAX_PICTURES; i++ )
@@ -309,12 +309,12 @@ static void picturealbum_scene_setup( void * tag, void * opaquev )
 	{
 		char * fname = store->filename[i];
 		if( fname[0] == 0 ) continue;
+		//Flags have to be set before the load is queued, or the loader may beat us to them.
+		CNOVRModelSetNumTextures( picture_m[i], 1 );
+		cnovr_texture * t = picture_m[i]->pTextures[0];
+		t->bCalculateMipMaps = 1;
+		t->bCompress = 1;
 		CNOVRModelApplyTextureFromFileAsync( picture_m[i], fname );
-		cnovr_texture * t;
-		if( picture_m[i]->pTextures && (t=picture_m[i]->pTextures[0]) )
-		{
-			t->bCalculateMipMaps = 1;
-		}
 	}
 
 	UpdateFunction(0,0);
@@ -9,9 +9,13 @@ out vec2 texcoords;
 out vec3 normal;
 out vec3 position;
 
+uniform int rendermask;
+
 void main()
 {
 	gl_Position = umPerspective * umView * umModel * vec4(positionin.xyz,1.0);
+	//Masked off for this eye, put it behind the far plane.
+	if( ( ( 1 << CNOVREyeTarget ) & rendermask ) != 0 ) gl_Position = vec4( 0.0, 0.0, 2.0, 1.0 );
 	texcoords = texcoordsin.xy;
 	normal = normalin.xyz;
 	position = positionin.xyz;
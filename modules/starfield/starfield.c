@@ -240,6 +240,8 @@ static void starfield_setup( void * tag, void * opaquev )
 	galaxyshader = CNOVRShaderCreate( "starfield/galaxy" );
 	galaxyimage = make_genobj( 0, 1, 1 );
 	pose_make_identity( &galaxyimagepose );
+	CNOVRModelSetNumTextures( galaxyimage, 1 );
+	galaxyimage->pTextures[0]->bCompress = 1;
 	CNOVRModelApplyTextureFromFileAsync( galaxyimage, "starfield/Milky_Way_Galaxy.jpg" );
 
 	if( !disable_interaction ) SetupFocusHandler();
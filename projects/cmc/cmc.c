@@ -295,9 +295,9 @@ void RenderFunction( void * tag, void * opaquev )
 
 	glDisable(GL_CULL_FACE);
 	CNOVRRender( roombatest );
-	RenderRobots();
 	CNOVRRender( ourboi );
 	CNOVRRender( playarea );	
+	RenderRobots();
     glEnable(GL_CULL_FACE);
 
 	glEnable(GL_BLEND);
@@ -13,6 +13,8 @@ struct robot
 };
 
 cnovr_model * robotmodels[1];
+cnovr_shader * robotshader;
+cnovr_pose robotposes[MAX_ROBOTS];
 
 struct robot robots[MAX_ROBOTS];
 
@@ -69,13 +71,16 @@ void UpdateRobots( float dtime )
 void RenderRobots()
 {
 	int i;
+	int count = 0;
 	for( i = 0; i < MAX_ROBOTS; i++ )
 	{
 		struct robot * r = robots + i;
 		if( !r->enabled ) continue;
 	//	printf( "%f %f %f\n", PFTHREE( r->pose.Pos ) );
-		CNOVRModelRenderWithPose( robotmodels[0], &r->pose );
+		robotposes[count++] = r->pose;
 	}
+	CNOVRRender( robotshader );
+	CNOVRModelRenderInstanced( robotmodels[0], robotposes, count );
 }
 
 void InitRobots()
@@ -90,6 +95,7 @@ void InitRobots()
 		r->time_to_shoot = (rand()%10)*.2 + 1;
 	}
 
+	robotshader = CNOVRShaderCreateWithPrefix( "assets/fakelines", "#define CNOVR_INSTANCED" );
 	robotmodels[0] = CNOVRModelCreate( 0, GL_TRIANGLES );
 	robotmodels[0]->pose = 0;
 	CNOVRModelLoadFromFileAsync( robotmodels[0], "doomba.obj:barytc" );
@@ -723,6 +723,9 @@ void example_scene_setup( void * tag, void * opaquev )
 	explosion_shader = CNOVRShaderCreate( "explosion" );
 	explosion_model = CNOVRModelCreate( 0, GL_LINES );
 	CNOVRModelSetNumVBOsWithStrides( explosion_model, 4, 3, 4, 4, 4 );
+	//Rewritten every frame, stream it instead of reallocating the buffers.
+	for( i = 0; i < 4; i++ )
+		CNOVRVBOSetDynamic( explosion_model->pGeos[i], 1 );
 	for( i = 0; i < PARTICLEVERTS; i++ )
 	{
 		float nil[4] = { 0 };
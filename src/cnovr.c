@@ -10,6 +10,7 @@
 #include "cnovrparts.h"
 #include "cnovrtcc.h"
 #include "cnovrtccinterface.h"
+#include "cnovrprofile.h"
 
 struct cnovrstate_t  * cnovrstate;
 
@@ -38,6 +39,8 @@ void InternalCNOVRFocusUpdate();
 void InternalSetupNamedPtrs();
 
 #define DEFAULT_MULTISAMPLE 4
+#define DEFAULT_SINGLEPASS_STEREO 0
+#define DEFAULT_EYE_TEXTURE_ARRAY 0
 
 // Bit-mapping:
 // ---- ---- -Z[Shift][Space] DSAW
@@ -57,6 +60,7 @@ void HandleKey( int keycode, int bDown )
 		case 0x20: bDown ? (KeyboardState |= 0x0010) : (KeyboardState &= 0xFFEF); break; // Space
 		case 0x10: bDown ? (KeyboardState |= 0x0020) : (KeyboardState &= 0xFFDF); break; // Shift
 		case 0x7A: bDown ? (KeyboardState |= 0x0040) : (KeyboardState &= 0xFFBF); break; // Z
+		case 0x70: if( bDown ) { CNOVRProfilePrintSummary(); CNOVRProfileDumpChromeTrace( "cnovrtrace.json" ); } break; // P
 	}
 }
 
@@ -93,6 +97,18 @@ void APIENTRY DebugCallback(GLenum source, GLenum type, GLuint id, GLenum severi
 }
 
 
+static int CNOVRHasGLExtension( const char * name )
+{
+	GLint i, n = 0;
+	glGetIntegerv( GL_NUM_EXTENSIONS, &n );
+	for( i = 0; i < n; i++ )
+	{
+		const char * ext = (const char*)glGetStringi( GL_EXTENSIONS, i );
+		if( ext && strcmp( ext, name ) == 0 ) return 1;
+	}
+	return 0;
+}
+
 int CNOVRInit( const char * appname, int screenx, int screeny, int allow_init_without_vr_mode )
 {
 	int r;
@@ -171,6 +187,11 @@ int CNOVRInit( const char * appname, int screenx, int screeny, int allow_init_wi
 		cnovrstate->sterotargets[1] = 0;
 		cnovrstate->fPreviewFOV = 100;
 		cnovrstate->iMultisample = DEFAULT_MULTISAMPLE;
+		cnovrstate->bSinglePassStereo = DEFAULT_SINGLEPASS_STEREO;
+		cnovrstate->bEyeTextureArray = DEFAULT_EYE_TEXTURE_ARRAY;
+		cnovrstate->bShaderResolve = 0;
+		cnovrstate->bStereoPass = 0;
+		cnovrstate->stereolayered = 0;
 
 		//Initial camrea
 		pose_make_identity( &cnovrstate->pPreviewPose );
@@ -215,6 +236,14 @@ int CNOVRInit( const char * appname, int screenx, int screeny, int allow_init_wi
 
 	ovrprintf( "OpenGL %s\n", glGetString(GL_VERSION) );
 
+	//Let the driver compile shaders on its own threads, so nothing has to wait on them until they're checked.
+	if( glMaxShaderCompilerThreadsKHRfnptr && CNOVRHasGLExtension( "GL_KHR_parallel_shader_compile" ) )
+	{
+		glMaxShaderCompilerThreadsKHR( 0xffffffff );
+		cnovrstate->bParallelShaderCompile = 1;
+		ovrprintf( "Using parallel shader compile\n" );
+	}
+
 	//This is buggy on -rdynamic and older GL implementations.
 	if( glDebugMessageControlfnptr && glDebugMessageCallbackfnptr )
 	{
@@ -239,6 +268,7 @@ int CNOVRInit( const char * appname, int screenx, int screeny, int allow_init_wi
 	//printf( "Malloced State: %p;;; %p = %p\n", cnovrstate, &cnovrstate->pRootNode, cnovrstate->pRootNode );
 
 
+	CNOVRProfileInit();
 	CNOVRInternalStartCacheSystem();
 	CNOVRJobInit();
 
@@ -270,15 +300,18 @@ void CNOVRUpdate()
 
 	//Get poses
 	int i;
+	double tp = OGGetAbsoluteTime();
 
 //	memcpy( cnovrstate->openvr_renderposes, lastframeposes, sizeof( lastframeposes ) );
 	InternalCNOVRFocusUpdate();
+	tp = CNOVRProfilePhase( "Focus", -1, tp );
 
 	if( cnovrstate->has_ovr )
 	{
 		cnovrstate->oCompositor->WaitGetPoses( 
 			cnovrstate->openvr_renderposes, MAX_POSES_TO_PULL_FROM_OPENVR, 
 			cnovrstate->openvr_trackedposes, MAX_POSES_TO_PULL_FROM_OPENVR );
+		tp = CNOVRProfilePhase( "WaitGetPoses", -1, tp );
 
 		for( i = 0; i < MAX_POSES_TO_PULL_FROM_OPENVR; i++ )
 		{
@@ -312,17 +345,20 @@ void CNOVRUpdate()
 			}
 		}
 	}
-	FrameStart = OGGetAbsoluteTime();
+	FrameStart = tp = OGGetAbsoluteTime();
 
 	//Update + prerender
 	//cnovr_simple_node * root = cnovrstate->pRootNode;
 
 	//Scene Graph Pre-Render
 	CNOVRListCall( cnovrLUpdate, 0, 0 );
+	tp = CNOVRProfilePhase( "Update", -1, tp );
 
-	while( CNOVRJobProcessQueueElement( cnovrQPrerender ) );
+	CNOVRJobProcessQueueBudgeted( cnovrQPrerender );
+	tp = CNOVRProfilePhase( "PrerenderQueue", -1, tp );
 
 	CNOVRListCall( cnovrLPrerender, 0, 0 );
+	tp = CNOVRProfilePhase( "Prerender", -1, tp );
 
 	//Waste some time...
 	CNFGHandleInput();
@@ -336,15 +372,56 @@ void CNOVRUpdate()
 		cnovrstate->oSystem->GetRecommendedRenderTargetSize( &iEyeRenderWidth, &iEyeRenderHeight );
 		if( iEyeRenderWidth != cnovrstate->iEyeRenderWidth || iEyeRenderHeight != cnovrstate->iEyeRenderHeight )
 		{
+			//Resize the render targets.
 			CNOVRDelete( cnovrstate->sterotargets[0] );
 			CNOVRDelete( cnovrstate->sterotargets[1] );
-	 
-			//Resize the render targets.
-			cnovrstate->sterotargets[0] = CNOVRRFBufferCreate( iEyeRenderWidth, iEyeRenderHeight, cnovrstate->iMultisample );
-			cnovrstate->sterotargets[1] = CNOVRRFBufferCreate( iEyeRenderWidth, iEyeRenderHeight, cnovrstate->iMultisample );
+			CNOVRDelete( cnovrstate->stereolayered );
+			cnovrstate->sterotargets[0] = 0;
+			cnovrstate->sterotargets[1] = 0;
+			cnovrstate->stereolayered = 0;
 			cnovrstate->iEyeRenderWidth = iEyeRenderWidth;
 			cnovrstate->iEyeRenderHeight = iEyeRenderHeight;
 		}
+
+		//Both eyes in one texture array, either drawn in one multiview pass or one layer at a time.
+		int wantsinglepass = cnovrstate->bSinglePassStereo;
+		int wantlayered = cnovrstate->bSinglePassStereo || cnovrstate->bEyeTextureArray;
+		if( cnovrstate->stereolayered && ( !wantlayered || cnovrstate->stereolayered->multiview != wantsinglepass ) )
+		{
+			CNOVRDelete( cnovrstate->stereolayered );
+			cnovrstate->stereolayered = 0;
+		}
+		if( wantsinglepass && !cnovrstate->stereolayered && !CNOVRHasGLExtension( "GL_OVR_multiview2" ) )
+		{
+			ovrprintf( "GL_OVR_multiview2 not supported, single-pass stereo disabled.\n" );
+			cnovrstate->bSinglePassStereo = 0;
+			wantsinglepass = 0;
+		}
+		if( wantlayered && !cnovrstate->stereolayered )
+		{
+			if( wantsinglepass )
+				cnovrstate->stereolayered = CNOVRRFBufferCreateLayered( iEyeRenderWidth, iEyeRenderHeight, cnovrstate->iMultisample, 2 );
+			else
+				cnovrstate->stereolayered = CNOVRRFBufferCreateArray( iEyeRenderWidth, iEyeRenderHeight, cnovrstate->iMultisample, 2 );
+			if( cnovrstate->stereolayered )
+			{
+				CNOVRDelete( cnovrstate->sterotargets[0] );
+				CNOVRDelete( cnovrstate->sterotargets[1] );
+				cnovrstate->sterotargets[0] = 0;
+				cnovrstate->sterotargets[1] = 0;
+			}
+			else
+			{
+				//Don't keep retrying every frame.
+				cnovrstate->bSinglePassStereo = 0;
+				cnovrstate->bEyeTextureArray = 0;
+			}
+		}
+		if( !cnovrstate->stereolayered && !cnovrstate->sterotargets[0] )
+		{
+			cnovrstate->sterotargets[0] = CNOVRRFBufferCreate( iEyeRenderWidth, iEyeRenderHeight, cnovrstate->iMultisample );
+			cnovrstate->sterotargets[1] = CNOVRRFBufferCreate( iEyeRenderWidth, iEyeRenderHeight, cnovrstate->iMultisample );
+		}
 	}
 
 	if( cnovrstate->has_preview )
@@ -361,6 +438,9 @@ void CNOVRUpdate()
 
 	//Probably should do some other stuff while anything from the prerender step is still ticking.
 
+	//In case anything bound GL objects without going through the state cache.
+	CNOVRStateInvalidate();
+
 	glCullFace( GL_BACK );
 	glEnable( GL_CULL_FACE );
 	glClearColor( 0, 0, 0, 1 );
@@ -368,6 +448,7 @@ void CNOVRUpdate()
 	glEnable( GL_DEPTH_TEST );
 	glDepthMask(GL_TRUE);
 	glDepthFunc(GL_LESS);
+	tp = CNOVRProfilePhase( "FrameSetup", -1, tp );
 
 	//Scene Graph Render
 	if( cnovrstate->has_ovr )
@@ -375,48 +456,73 @@ void CNOVRUpdate()
 		int i;
 		for( i = 0; i < 2; i++ )
 		{
+			//In case eye-to-head changes, we need to get that
+			HmdMatrix34_t xform = cnovrstate->oSystem->GetEyeToHeadTransform( EVREye_Eye_Left + i );
+			CNOVRPoseFromHMDMatrix( &cnovrstate->pEyeToHead[i], &xform );
+
+			struct HmdMatrix44_t pm = cnovrstate->oSystem->GetProjectionMatrix( EVREye_Eye_Left + i, cnovrstate->fNear, cnovrstate->fFar );
+			memcpy( cnovrstate->mStereoPerspective[i], &pm.m[0][0], sizeof( HmdMatrix44_t ) );
+			cnovr_pose eye_in_worldspace;
+			apply_pose_to_pose( &eye_in_worldspace, &cnovrstate->pRenderPoses[0], &cnovrstate->pEyeToHead[i] );
+			pose_invert( &eye_in_worldspace, &eye_in_worldspace );
+			pose_to_matrix44( cnovrstate->mStereoView[i], &eye_in_worldspace );
+		}
+
+		//Single-pass stereo draws both eyes in one go into the layered target, shaders pick their
+		//eye's matrices by gl_ViewID_OVR.  mView/mPerspective are left as the left eye's.
+		//With a plain (non-multiview) eye array, each eye draws into its layer and both resolve at the end.
+		//Until every shader has its multiview build, the multiview target gets drawn a layer at a time too.
+		int layered = cnovrstate->stereolayered != 0;
+		int singlepass = layered && cnovrstate->stereolayered->multiview && !CNOVRShaderMultiviewPending();
+		int passes = singlepass ? 1 : 2;
+		for( i = 0; i < passes; i++ )
+		{
+			cnovr_rf_buffer * target = layered ? cnovrstate->stereolayered : cnovrstate->sterotargets[i];
 			cnovrstate->eyeTarget = i;
-			{
-				//In case eye-to-head changes, we need to get that
-				HmdMatrix34_t xform = cnovrstate->oSystem->GetEyeToHeadTransform( EVREye_Eye_Left + i );
-				CNOVRPoseFromHMDMatrix( &cnovrstate->pEyeToHead[i], &xform );
-
-				struct HmdMatrix44_t pm = cnovrstate->oSystem->GetProjectionMatrix( EVREye_Eye_Left + i, cnovrstate->fNear, cnovrstate->fFar );
-				memcpy( cnovrstate->mPerspective, &pm.m[0][0], sizeof( HmdMatrix44_t ) );
-				cnovr_pose eye_in_worldspace;
-				apply_pose_to_pose( &eye_in_worldspace, &cnovrstate->pRenderPoses[0], &cnovrstate->pEyeToHead[i] );
-				pose_invert( &eye_in_worldspace, &eye_in_worldspace );
-				pose_to_matrix44( cnovrstate->mView, &eye_in_worldspace );
-				matrix44identity( cnovrstate->mModel );
-			}
+			memcpy( cnovrstate->mView, cnovrstate->mStereoView[i], sizeof( cnovrstate->mView ) );
+			memcpy( cnovrstate->mPerspective, cnovrstate->mStereoPerspective[i], sizeof( cnovrstate->mPerspective ) );
+			matrix44identity( cnovrstate->mModel );
 
-			if( !cnovrstate->sterotargets[i] ) continue;
+			if( !target ) continue;
 
-			//This is a balance:  We could render both eyes simultaneously, or we could do this. 
-			CNOVRFBufferActivate( cnovrstate->sterotargets[i] );
+			if( singlepass )
+				CNOVRFBufferActivate( target );
+			else
+				CNOVRFBufferActivateLayer( target, i );
 			int width = cnovrstate->iRTWidth = cnovrstate->iEyeRenderWidth;
 			int height = cnovrstate->iRTHeight = cnovrstate->iEyeRenderHeight;
 			glViewport(0, 0, width, height );
 			glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+			CNOVRFrameUniformsUpdate();
+			tp = CNOVRProfilePhase( "EyeSetup", i, tp );
 			//root->base.header->Render( root );
 			CNOVRListCall( cnovrLRender0, 0, 0); 
+			tp = CNOVRProfilePhase( "Render0", i, tp );
 			CNOVRListCall( cnovrLRender1, 0, 0); 
+			tp = CNOVRProfilePhase( "Render1", i, tp );
 			CNOVRListCall( cnovrLRender2, 0, 0); 
+			tp = CNOVRProfilePhase( "Render2", i, tp );
 			CNOVRListCall( cnovrLRender3, 0, 0); 
+			tp = CNOVRProfilePhase( "Render3", i, tp );
 			CNOVRListCall( cnovrLRender4, 0, 0); 
-			//CNOVRFBufferDeactivate( cnovrstate->sterotargets[i] );
-			CNOVRFBufferBlitResolve( cnovrstate->sterotargets[i] );
+			tp = CNOVRProfilePhase( "Render4", i, tp );
+			if( !layered || i == passes - 1 )
+			{
+				CNOVRFBufferBlitResolve( target );
+				tp = CNOVRProfilePhase( "Resolve", i, tp );
+			}
 		}
 		for( i = 0; i < 2; i++ )
 		{
-
+			cnovr_rf_buffer * target = layered ? cnovrstate->stereolayered : cnovrstate->sterotargets[i];
+			if( !target ) continue;
 			Texture_t t;
-		//	t.handle = (void*)(uintptr_t)cnovrstate->sterotargets[i]->nRenderTextureId;
-			t.handle = (void*)(uintptr_t)cnovrstate->sterotargets[i]->nResolveTextureId;
+			t.handle = (void*)(uintptr_t)( layered ? target->nLayerResolveTextureId[i] : target->nResolveTextureId );
 			t.eType = ETextureType_TextureType_OpenGL;
 			t.eColorSpace = EColorSpace_ColorSpace_Auto;
 			cnovrstate->oCompositor->Submit( EVREye_Eye_Left + i, &t, 0, 0 ); 
 		}
+		tp = CNOVRProfilePhase( "Submit", -1, tp );
 	}
 
 	if( CNOVRCheck() ) ovrprintf( "Render Check\n" );
@@ -438,6 +544,7 @@ void CNOVRUpdate()
 			glViewport(0, 0, width, height );
 			//glClearColor( 1, 0, 1, 1 );
 			glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+			CNOVRFrameUniformsUpdate();
 			//root->base.header->Render( root );
 			CNOVRListCall( cnovrLRender0, 0, 0); 
 			CNOVRListCall( cnovrLRender1, 0, 0); 
@@ -478,13 +585,14 @@ void CNOVRUpdate()
 		CNOVRRender( cnovrstate->fullscreenshader );
 		glEnable( GL_TEXTURE_2D );
 		//printf( "%d\n", cnovrstate->previewtarget->nResolveTextureId );
-		glActiveTextureCHEW( GL_TEXTURE0 + 0 );
-		glBindTexture( GL_TEXTURE_2D, cnovrstate->previewtarget[0]->nResolveTextureId );
-		glActiveTextureCHEW( GL_TEXTURE0 + 1 );
-		glBindTexture( GL_TEXTURE_2D, cnovrstate->previewtarget[1]->nResolveTextureId );
+		CNOVRStateActiveTexture( 0 );
+		CNOVRStateBindTexture( cnovrstate->previewtarget[0]->nResolveTextureId );
+		CNOVRStateActiveTexture( 1 );
+		CNOVRStateBindTexture( cnovrstate->previewtarget[1]->nResolveTextureId );
 		CNOVRRender( cnovrstate->fullscreengeo );
 		//glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST );
 #endif
+		tp = CNOVRProfilePhase( "Preview", 2, tp );
 	}
 
 	if( CNOVRCheck() ) ovrprintf( "Cycle Check\n" );
@@ -499,10 +607,14 @@ void CNOVRUpdate()
 //	double diff = OGGetAbsoluteTime() - FrameStart;
 //	if( diff > 0.004 )	printf( "Diff: %f\n", diff );
 	if( !did_advanced_preview ) CNFGSwapBuffers(1);
+	tp = CNOVRProfilePhase( "Swap", -1, tp );
 //	FrameStart = OGGetAbsoluteTime();
 	CNOVRListCall( cnovrLPostRender, 0, 0 ); 
 	glFlush();
-	cnovrstate->fFrameTimems = (OGGetAbsoluteTime()-FrameStart)*1000;
+	tp = CNOVRProfilePhase( "PostRender", -1, tp );
+	CNOVRProfilePhase( "Frame", -1, FrameStart );
+	CNOVRProfileFrameEnd();
+	cnovrstate->fFrameTimems = (tp-FrameStart)*1000;
 
 }
 
@@ -550,7 +662,8 @@ void CNOVRShutdown()
 	exit( 0 );
 }
 
-int CNOVRCheck()
+//Tricky: Parenthesized so the CNOVRCheck() macro doesn't eat it, TCC modules still link against this.
+int (CNOVRCheck)()
 {
 	GLenum e = glGetError();
 	if( e != GL_NO_ERROR )
@@ -590,24 +703,86 @@ int CNOVRAlertv( void * tag, int priority, const char * format, va_list ap )
 	return len;
 }
 
+static void CNOVRShaderSendMatrix( int slot, float * sent, const float * mat )
+{
+	cnovr_shader * shd = cnovr_current_shader;
+	int uniform = CNOVRMAPPEDUNIFORMPOS( slot );
+	if( uniform == INVALIDUNIFORM ) return;
+	if( ( shd->iUniformsSent & ( 1<<slot ) ) && memcmp( sent, mat, sizeof( float ) * 16 ) == 0 ) return;
+	glUniformMatrix4fv( uniform, 1, 1, mat );
+	memcpy( sent, mat, sizeof( float ) * 16 );
+	shd->iUniformsSent |= 1<<slot;
+}
+
+void CNOVRShaderLoadedSetModelInternal()
+{
+	CNOVRShaderSendMatrix( UNIFORMSLOT_MODEL, cnovr_current_shader->mSentModel, cnovrstate->mModel );
+}
+
+//Same layout as the std140, row_major CNOVRFrame block, so our row-major matrices go in as-is.
+struct cnovr_frame_uniforms_t
+{
+	float mView[16];
+	float mPerspective[16];
+	float fRenderProps[4];
+	float mStereoView[2][16];
+	float mStereoPerspective[2][16];
+	float fEye[4];
+};
+
+static GLuint frame_ubo;
+static int frame_ubo_valid;
+static struct cnovr_frame_uniforms_t frame_ubo_sent;
+
+void CNOVRFrameUniformsUpdate()
+{
+	struct cnovr_frame_uniforms_t f;
+	memcpy( f.mView, cnovrstate->mView, sizeof( f.mView ) );
+	memcpy( f.mPerspective, cnovrstate->mPerspective, sizeof( f.mPerspective ) );
+	memcpy( f.fRenderProps, &cnovrstate->iRTWidth, sizeof( f.fRenderProps ) );
+	memcpy( f.mStereoView, cnovrstate->mStereoView, sizeof( f.mStereoView ) );
+	memcpy( f.mStereoPerspective, cnovrstate->mStereoPerspective, sizeof( f.mStereoPerspective ) );
+	f.fEye[0] = cnovrstate->eyeTarget;
+	f.fEye[1] = f.fEye[2] = f.fEye[3] = 0;
+	if( frame_ubo_valid && memcmp( &f, &frame_ubo_sent, sizeof( f ) ) == 0 ) return;
+
+	if( !frame_ubo )
+	{
+		glGenBuffers( 1, &frame_ubo );
+		glBindBuffer( GL_UNIFORM_BUFFER, frame_ubo );
+		glBufferData( GL_UNIFORM_BUFFER, sizeof( f ), &f, GL_DYNAMIC_DRAW );
+		//Stays bound here for good, every shader's CNOVRFrame block points at this binding.
+		glBindBufferBase( GL_UNIFORM_BUFFER, UBOBINDING_FRAME, frame_ubo );
+	}
+	else
+	{
+		glBindBuffer( GL_UNIFORM_BUFFER, frame_ubo );
+		glBufferSubData( GL_UNIFORM_BUFFER, 0, sizeof( f ), &f );
+	}
+	frame_ubo_sent = f;
+	frame_ubo_valid = 1;
+}
+
 void CNOVRShaderLoadedSetUniformsInternal()
 {
 	if( CNOVRCheck() ) ovrprintf( "Pre-Uniform Check with shader %s\n", cnovr_current_shader->shaderfilebase );
 	const static GLint TextureSlots[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+	cnovr_shader * shd = cnovr_current_shader;
 	int uniform;
-	if( ( uniform = CNOVRMAPPEDUNIFORMPOS( UNIFORMSLOT_MODEL ) ) != INVALIDUNIFORM )
-		glUniformMatrix4fv( uniform, 1, 1, cnovrstate->mModel );
-	if( ( uniform = CNOVRMAPPEDUNIFORMPOS( UNIFORMSLOT_VIEW ) )  != INVALIDUNIFORM )
-		glUniformMatrix4fv( uniform , 1, 1, cnovrstate->mView );
-	if( ( uniform = CNOVRMAPPEDUNIFORMPOS( UNIFORMSLOT_PERSPECTIVE ) ) != INVALIDUNIFORM )
-		glUniformMatrix4fv( uniform, 1, 1, cnovrstate->mPerspective );
-	if( ( uniform = CNOVRMAPPEDUNIFORMPOS( UNIFORMSLOT_RENDERPROPS ) ) != INVALIDUNIFORM )
-		glUniform4fv( uniform, 1, &cnovrstate->iRTWidth );
-	if( ( uniform = CNOVRMAPPEDUNIFORMPOS( UNIFORMSLOT_TEXTURES ) ) != INVALIDUNIFORM )
+	//Uniforms stick to the program, so only send what changed since this shader was last bound.
+	CNOVRShaderSendMatrix( UNIFORMSLOT_MODEL, shd->mSentModel, cnovrstate->mModel );
+	if( ( uniform = CNOVRMAPPEDUNIFORMPOS( UNIFORMSLOT_TEXTURES ) ) != INVALIDUNIFORM && !( shd->iUniformsSent & ( 1<<UNIFORMSLOT_TEXTURES ) ) )
+	{
 		glUniform1iv( uniform, 8, TextureSlots );
+		shd->iUniformsSent |= 1<<UNIFORMSLOT_TEXTURES;
+	}
+	//Normally a no-op, the eye setup already pushed these, but modules move the camera around too.
+	CNOVRFrameUniformsUpdate();
+#ifdef CNOVR_GLCHECK
 	//Ignore all uniform errors.
 	if( CNOVRCheck() ) ovrprintf( "Post-Uniform Check\n" );
 	glGetError();
+#endif
 }
 
 
@@ -27,10 +27,10 @@ static void CNOVRCanvasRender( cnovr_canvas * ths )
 
 	if( ths->set_filter_type == 0 && ths->model && ths->model->pTextures && ths->model->pTextures[0]->nTextureId )
 	{
-		glBindTexture( GL_TEXTURE_2D, ths->model->pTextures[0]->nTextureId );
+		CNOVRStateBindTexture( ths->model->pTextures[0]->nTextureId );
 		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
 		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
-		glBindTexture( GL_TEXTURE_2D, 0 );
+		CNOVRStateBindTexture( 0 );
 		ths->set_filter_type = 1;
 	}
 	CNOVRRender( ths->model );
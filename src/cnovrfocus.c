@@ -9,6 +9,30 @@
 #include <openvr_capi.h>
 #include <string.h>
 
+#define CNOVRFOCUS_TREE_MARGIN 0.1 //Meters.
+
+typedef struct focus_tree_node_t
+{
+	float bmin[3];
+	float bmax[3];
+	int parent;   //Next free node, if this one's free.
+	int child[2]; //-1 for leaves.
+	int item;     //Leaves only, index into interactables.
+} focus_tree_node;
+
+typedef struct focus_interactable_t
+{
+	cnovr_model * m;
+	int leaf;
+	int bInTree;
+	cnovr_pose lastpose;
+	cnovr_vbo * geo;
+	uint32_t iGeoGeneration;
+	uint32_t iGeoVertices;
+	float lmin[3]; //Model space bounds.
+	float lmax[3];
+} focus_interactable;
+
 typedef struct internal_focus_system_t
 {
 	VRActionSetHandle_t inputactionset;
@@ -28,10 +52,21 @@ typedef struct internal_focus_system_t
 	cnovrfocus_properties focusProps[CNOVRINPUTDEVS];	//Tricky: Device0 is the HMD, 1 and 2 are the controllers.
 	og_mutex_t    mutFocus;
 	
-	cnovrfocus_capture * capPassiveTemp; //Careful - if we delete in the operation, this must also be removed.
-	cnovrfocus_capture * capFocusTemp; //Careful - if we delete in the operation, this must also be removed.
+	cnovrfocus_capture * capPassiveTemp[CNOVRINPUTDEVS]; //Careful - if we delete in the operation, this must also be removed.
+	cnovrfocus_capture * capFocusTemp[CNOVRINPUTDEVS]; //Careful - if we delete in the operation, this must also be removed.
 
 	int current_devid; //If we're actively pursuing a callback. 
+
+	focus_interactable * interactables;
+	int nInteractables;
+	int mInteractables;
+	focus_tree_node * treenodes;
+	int * treestack;
+	uint32_t * treestackmask;
+	int nTreeNodes;
+	int mTreeNodes;
+	int iTreeRoot;
+	int iTreeFree;
 } internal_focus_system;
 
 internal_focus_system FOCUS;
@@ -108,22 +143,344 @@ cnovrfocus_properties * CNOVRFocusGetPropsForDev( int ctrl )
 	return &FOCUS.focusProps[ctrl];
 }
 
+//Broad phase for interactables.  A dynamic AABB tree of "fat" world space boxes, so things can move a little
+//before they have to be taken out and put back in.  Everything here is done with FOCUS.mutFocus held.
+
+static float FocusTreeArea( const float * bmin, const float * bmax )
+{
+	float dx = bmax[0] - bmin[0];
+	float dy = bmax[1] - bmin[1];
+	float dz = bmax[2] - bmin[2];
+	return dx*dy + dy*dz + dz*dx;
+}
+
+static void FocusTreeUnion( float * omin, float * omax, const focus_tree_node * a, const focus_tree_node * b )
+{
+	int k;
+	for( k = 0; k < 3; k++ )
+	{
+		omin[k] = ( a->bmin[k] < b->bmin[k] ) ? a->bmin[k] : b->bmin[k];
+		omax[k] = ( a->bmax[k] > b->bmax[k] ) ? a->bmax[k] : b->bmax[k];
+	}
+}
+
+static int FocusTreeAllocNode()
+{
+	int n = FOCUS.iTreeFree;
+	if( n >= 0 )
+	{
+		FOCUS.iTreeFree = FOCUS.treenodes[n].parent;
+	}
+	else
+	{
+		if( FOCUS.nTreeNodes == FOCUS.mTreeNodes )
+		{
+			FOCUS.mTreeNodes = FOCUS.mTreeNodes ? FOCUS.mTreeNodes * 2 : 32;
+			FOCUS.treenodes = realloc( FOCUS.treenodes, sizeof( focus_tree_node ) * FOCUS.mTreeNodes );
+			FOCUS.treestack = realloc( FOCUS.treestack, sizeof( int ) * FOCUS.mTreeNodes );
+			FOCUS.treestackmask = realloc( FOCUS.treestackmask, sizeof( uint32_t ) * FOCUS.mTreeNodes );
+		}
+		n = FOCUS.nTreeNodes++;
+	}
+	focus_tree_node * nd = &FOCUS.treenodes[n];
+	memset( nd, 0, sizeof( *nd ) );
+	nd->parent = -1;
+	nd->child[0] = nd->child[1] = -1;
+	nd->item = -1;
+	return n;
+}
+
+static void FocusTreeFreeNode( int n )
+{
+	FOCUS.treenodes[n].parent = FOCUS.iTreeFree;
+	FOCUS.iTreeFree = n;
+}
+
+static void FocusTreeRefit( int n )
+{
+	focus_tree_node * nodes = FOCUS.treenodes;
+	for( ; n >= 0; n = nodes[n].parent )
+		FocusTreeUnion( nodes[n].bmin, nodes[n].bmax, &nodes[nodes[n].child[0]], &nodes[nodes[n].child[1]] );
+}
+
+static void FocusTreeInsert( int leaf )
+{
+	if( FOCUS.iTreeRoot < 0 )
+	{
+		FOCUS.iTreeRoot = leaf;
+		FOCUS.treenodes[leaf].parent = -1;
+		return;
+	}
+
+	//Walk down toward whichever child grows the least.
+	int sib = FOCUS.iTreeRoot;
+	while( FOCUS.treenodes[sib].child[0] >= 0 )
+	{
+		focus_tree_node * nodes = FOCUS.treenodes;
+		float cost[2];
+		int c;
+		for( c = 0; c < 2; c++ )
+		{
+			focus_tree_node * ch = &nodes[nodes[sib].child[c]];
+			float umin[3], umax[3];
+			FocusTreeUnion( umin, umax, ch, &nodes[leaf] );
+			cost[c] = FocusTreeArea( umin, umax ) - FocusTreeArea( ch->bmin, ch->bmax );
+		}
+		sib = nodes[sib].child[ cost[1] < cost[0] ];
+	}
+
+	int np = FocusTreeAllocNode();
+	focus_tree_node * nodes = FOCUS.treenodes; //Tricky: Alloc may have moved them.
+	int oldparent = nodes[sib].parent;
+	nodes[np].parent = oldparent;
+	nodes[np].child[0] = sib;
+	nodes[np].child[1] = leaf;
+	nodes[sib].parent = np;
+	nodes[leaf].parent = np;
+	if( oldparent < 0 )
+		FOCUS.iTreeRoot = np;
+	else
+		nodes[oldparent].child[ nodes[oldparent].child[1] == sib ] = np;
+	FocusTreeRefit( np );
+}
+
+static void FocusTreeRemove( int leaf )
+{
+	focus_tree_node * nodes = FOCUS.treenodes;
+	if( leaf == FOCUS.iTreeRoot )
+	{
+		FOCUS.iTreeRoot = -1;
+		return;
+	}
+	int p = nodes[leaf].parent;
+	int gp = nodes[p].parent;
+	int sib = nodes[p].child[ nodes[p].child[0] == leaf ];
+	nodes[sib].parent = gp;
+	if( gp < 0 )
+	{
+		FOCUS.iTreeRoot = sib;
+	}
+	else
+	{
+		nodes[gp].child[ nodes[gp].child[1] == p ] = sib;
+		FocusTreeRefit( gp );
+	}
+	FocusTreeFreeNode( p );
+	nodes[leaf].parent = -1;
+}
+
+static void FocusInteractableAdd( cnovr_model * m )
+{
+	if( FOCUS.nInteractables == FOCUS.mInteractables )
+	{
+		FOCUS.mInteractables = FOCUS.mInteractables ? FOCUS.mInteractables * 2 : 16;
+		FOCUS.interactables = realloc( FOCUS.interactables, sizeof( focus_interactable ) * FOCUS.mInteractables );
+	}
+	int item = FOCUS.nInteractables++;
+	focus_interactable * fi = &FOCUS.interactables[item];
+	memset( fi, 0, sizeof( *fi ) );
+	fi->m = m;
+	fi->leaf = FocusTreeAllocNode();
+	FOCUS.treenodes[fi->leaf].item = item;
+}
+
+static void FocusInteractableRemove( cnovr_model * m )
+{
+	int i;
+	for( i = 0; i < FOCUS.nInteractables; i++ )
+	{
+		focus_interactable * fi = &FOCUS.interactables[i];
+		if( fi->m != m ) continue;
+		if( fi->bInTree ) FocusTreeRemove( fi->leaf );
+		FocusTreeFreeNode( fi->leaf );
+		//Move the last one into the hole.
+		*fi = FOCUS.interactables[--FOCUS.nInteractables];
+		if( i < FOCUS.nInteractables ) FOCUS.treenodes[fi->leaf].item = i;
+		return;
+	}
+}
+
+//Only looks at models whose pose or geometry changed, and only touches the tree if they left their fat box.
+static void FocusInteractablesUpdate()
+{
+	int i, k;
+	for( i = 0; i < FOCUS.nInteractables; i++ )
+	{
+		focus_interactable * fi = &FOCUS.interactables[i];
+		cnovr_model * m = fi->m;
+		cnovr_model * g = CNOVRModelGeometry( m );
+		cnovr_vbo * geo = ( g->iGeos && !g->bIsLoading ) ? g->pGeos[0] : 0;
+		if( !m->pose || !geo || !geo->iVertexCount )
+		{
+			if( fi->bInTree ) FocusTreeRemove( fi->leaf );
+			fi->bInTree = 0;
+			continue;
+		}
+
+		int geochanged = geo != fi->geo || geo->iGeneration != fi->iGeoGeneration || geo->iVertexCount != fi->iGeoVertices;
+		if( !geochanged && fi->bInTree && memcmp( &fi->lastpose, m->pose, sizeof( cnovr_pose ) ) == 0 ) continue;
+		memcpy( &fi->lastpose, m->pose, sizeof( cnovr_pose ) );
+
+		if( geochanged )
+		{
+			float * v = geo->pVertices;
+			int stride = geo->iStride;
+			uint32_t j;
+			copy3d( fi->lmin, v );
+			copy3d( fi->lmax, v );
+			for( j = 1; j < geo->iVertexCount; j++ )
+			for( k = 0; k < 3; k++ )
+			{
+				float f = v[j*stride+k];
+				if( f < fi->lmin[k] ) fi->lmin[k] = f;
+				if( f > fi->lmax[k] ) fi->lmax[k] = f;
+			}
+			fi->geo = geo;
+			fi->iGeoGeneration = geo->iGeneration;
+			fi->iGeoVertices = geo->iVertexCount;
+		}
+
+		float wmin[3], wmax[3];
+		int c;
+		for( c = 0; c < 8; c++ )
+		{
+			cnovr_point3d corner = { (c&1)?fi->lmax[0]:fi->lmin[0], (c&2)?fi->lmax[1]:fi->lmin[1], (c&4)?fi->lmax[2]:fi->lmin[2] };
+			apply_pose_to_point( corner, m->pose, corner );
+			for( k = 0; k < 3; k++ )
+			{
+				if( c == 0 || corner[k] < wmin[k] ) wmin[k] = corner[k];
+				if( c == 0 || corner[k] > wmax[k] ) wmax[k] = corner[k];
+			}
+		}
+
+		focus_tree_node * leaf = &FOCUS.treenodes[fi->leaf];
+		if( fi->bInTree )
+		{
+			for( k = 0; k < 3; k++ )
+				if( wmin[k] < leaf->bmin[k] || wmax[k] > leaf->bmax[k] ) break;
+			if( k == 3 ) continue;
+			FocusTreeRemove( fi->leaf );
+		}
+		for( k = 0; k < 3; k++ )
+		{
+			leaf->bmin[k] = wmin[k] - CNOVRFOCUS_TREE_MARGIN;
+			leaf->bmax[k] = wmax[k] + CNOVRFOCUS_TREE_MARGIN;
+		}
+		FocusTreeInsert( fi->leaf );
+		fi->bInTree = 1;
+	}
+}
+
+//Slab test of start + direction * [0,*t1] against n.  On a hit, *t0 is where it goes in.
+static int FocusTreeClip( const focus_tree_node * n, const float * start, const float * direction, float * t0, float t1 )
+{
+	int k;
+	*t0 = 0;
+	for( k = 0; k < 3; k++ )
+	{
+		if( direction[k] == 0 )
+		{
+			if( start[k] < n->bmin[k] || start[k] > n->bmax[k] ) return 0;
+			continue;
+		}
+		float ta = ( n->bmin[k] - start[k] ) / direction[k];
+		float tb = ( n->bmax[k] - start[k] ) / direction[k];
+		if( ta > tb ) { float tmp = ta; ta = tb; tb = tmp; }
+		if( ta > *t0 ) *t0 = ta;
+		if( tb < t1 ) t1 = tb;
+		if( *t0 > t1 ) return 0;
+	}
+	return 1;
+}
+
+static void ModelFocusCollide( cnovr_model * m, cnovrfocus_batch * batch );
+
+//Front to back for all devices at once.  A device drops out of a subtree once it has something closer
+//than the subtree's box, so only models near the rays get a narrow phase.
+static void FocusInteractablesCollide( cnovrfocus_batch * batch )
+{
+	float start[CNOVRINPUTDEVS][3];
+	float direction[CNOVRINPUTDEVS][3];
+	int * stack = FOCUS.treestack;
+	uint32_t * stackmask = FOCUS.treestackmask;
+	int sp = 0;
+	int i;
+	if( FOCUS.iTreeRoot < 0 || !batch->count ) return;
+
+	//Tricky: Affine, so t along these is the same t as along the model space rays in ModelFocusCollide.
+	for( i = 0; i < batch->count; i++ )
+	{
+		cnovr_pose * tip = &batch->props[i]->poseTip;
+		cnovr_point3d o = { 0, 0, 0 };
+		cnovr_point3d z = { 0, 0, 1 };
+		apply_pose_to_point( start[i], tip, o );
+		apply_pose_to_point( z, tip, z );
+		sub3d( direction[i], z, start[i] );
+	}
+
+	stack[sp] = FOCUS.iTreeRoot;
+	stackmask[sp++] = ( 1u << batch->count ) - 1;
+	while( sp )
+	{
+		sp--;
+		focus_tree_node * n = &FOCUS.treenodes[stack[sp]];
+		uint32_t mask = stackmask[sp];
+		uint32_t live = 0;
+		int first = -1;
+		float t0;
+		for( i = 0; i < batch->count; i++ )
+		{
+			if( !( mask & ( 1u<<i ) ) ) continue;
+			if( !FocusTreeClip( n, start[i], direction[i], &t0, batch->props[i]->NewPassiveRealDistance ) ) continue;
+			live |= 1u<<i;
+			if( first < 0 ) first = i;
+		}
+		if( !live ) continue;
+
+		if( n->child[0] < 0 )
+		{
+			cnovrfocus_batch sub;
+			sub.count = 0;
+			for( i = 0; i < batch->count; i++ )
+				if( live & ( 1u<<i ) ) sub.props[sub.count++] = batch->props[i];
+			ModelFocusCollide( FOCUS.interactables[n->item].m, &sub );
+			continue;
+		}
+
+		//Near child goes on top, as the first live device sees it.
+		float ta = 1e30, tb = 1e30;
+		float tmax = batch->props[first]->NewPassiveRealDistance;
+		if( !FocusTreeClip( &FOCUS.treenodes[n->child[0]], start[first], direction[first], &ta, tmax ) ) ta = 1e30;
+		if( !FocusTreeClip( &FOCUS.treenodes[n->child[1]], start[first], direction[first], &tb, tmax ) ) tb = 1e30;
+		int nearer = ( tb < ta );
+		stack[sp] = n->child[!nearer];
+		stackmask[sp++] = live;
+		stack[sp] = n->child[nearer];
+		stackmask[sp++] = live;
+	}
+}
+
 void InternalCNOVRFocusUpdate()
 {
 	int ctrl = 0;
 	int r;
+	cnovrfocus_capture * cap;
+	cnovrfocus_batch batch;
+	int bTipValid[CNOVRINPUTDEVS];
 
 	if( !cnovrstate->oInput ) return;
 	VRActiveActionSet_t actionSet = { 0 };
 	actionSet.ulActionSet = FOCUS.inputactionset;
 	cnovrstate->oInput->UpdateActionState( &actionSet, sizeof( actionSet ), 1 );
 
+	batch.count = 0;
+
+	//Buttons and tips for everyone first, so collision can be done for all devices at once.
 	for( ; ctrl < CNOVRINPUTDEVS; ctrl++ )
 	{
 		cnovrfocus_properties * props = &FOCUS.focusProps[ctrl];
-		cnovrfocus_capture * cap;
 
-		FOCUS.capFocusTemp = props->capturedFocus;
+		FOCUS.capFocusTemp[ctrl] = props->capturedFocus;
 		FOCUS.current_devid = ctrl;
 
 		int i;
@@ -179,26 +536,52 @@ void InternalCNOVRFocusUpdate()
 		//Tricky: we rotate 180 out so Z+ is is forward. TODO should this be around X or Y?  Are we switching coordinate systems?
 		quatrotate180X( FOCUS.poseTip[ctrl].Rot );
 
-		if( !ret && bActive && bPoseIsValid )
+		bTipValid[ctrl] = !ret && bActive && bPoseIsValid;
+		if( bTipValid[ctrl] )
 		{
 			memcpy( &props->poseTip, &FOCUS.poseTip[ctrl], sizeof( cnovr_pose ) );
+			FOCUS.capPassiveTemp[ctrl] = props->capturedPassive;
+			batch.props[batch.count++] = props;
+		}
+		FOCUS.current_devid = -1;
+	}
 
-			FOCUS.capPassiveTemp = props->capturedPassive;
-	
+	OGLockMutex( FOCUS.mutFocus );
+	for( r = 0; r < batch.count; r++ )
+	{
+		batch.props[r]->NewCapturedPassive = 0;
+		batch.props[r]->NewPassiveRealDistance = CNOVRFOCUS_FAR;
+	}
+	if( batch.count )
+	{
+		FocusInteractablesUpdate();
+		FocusInteractablesCollide( &batch );
+		CNOVRListCall( cnovrLCollideBatch, &batch, 0 );
+		//Older style, one device at a time.
+		for( r = 0; r < batch.count; r++ )
+		{
+			FOCUS.current_devid = batch.props[r]->devid;
+			CNOVRListCall( cnovrLCollide, batch.props[r], 0 );
+		}
+		FOCUS.current_devid = -1;
+	}
+	OGUnlockMutex( FOCUS.mutFocus );
+
+	for( ctrl = 0; ctrl < CNOVRINPUTDEVS; ctrl++ )
+	{
+		cnovrfocus_properties * props = &FOCUS.focusProps[ctrl];
+		FOCUS.current_devid = ctrl;
+
+		if( bTipValid[ctrl] )
+		{
 			OGLockMutex( FOCUS.mutFocus );
-			props->NewCapturedPassive = 0;
-			props->NewPassiveRealDistance = CNOVRFOCUS_FAR;
-			CNOVRListCall( cnovrLCollide, props, 0 );
 			props->capturedPassive = props->NewCapturedPassive;
 			props->capturedPassiveDistance = props->NewPassiveRealDistance;
-			OGUnlockMutex( FOCUS.mutFocus );
-
-			OGLockMutex( FOCUS.mutFocus );
-			if( FOCUS.capPassiveTemp != props->capturedPassive )
+			if( FOCUS.capPassiveTemp[ctrl] != props->capturedPassive )
 			{
-				if( FOCUS.capPassiveTemp )
+				if( FOCUS.capPassiveTemp[ctrl] )
 				{
-					TCCInvocation( FOCUS.capPassiveTemp->tcctag, FOCUS.capPassiveTemp->cb( CNOVRF_OUT, FOCUS.capPassiveTemp, props, 0 ) );
+					TCCInvocation( FOCUS.capPassiveTemp[ctrl]->tcctag, FOCUS.capPassiveTemp[ctrl]->cb( CNOVRF_OUT, FOCUS.capPassiveTemp[ctrl], props, 0 ) );
 				}
 				if( props->capturedPassive )
 				{
@@ -217,7 +600,8 @@ void InternalCNOVRFocusUpdate()
 		}
 
 		//Render model updates, etc. can be based off of "hand"
-		ret = cnovrstate->oInput->GetPoseActionDataForNextFrame( FOCUS.actionhandles[ctrl][CTRLA_MODEL], 
+		InputPoseActionData_t * p = &FOCUS.poseData[ctrl];
+		int ret = cnovrstate->oInput->GetPoseActionDataForNextFrame( FOCUS.actionhandles[ctrl][CTRLA_MODEL], 
 			ETrackingUniverseOrigin_TrackingUniverseStanding, p, sizeof( *p ), k_ulInvalidInputValueHandle ); 
 		if( ret || !p->bActive || !p->pose.bPoseIsValid )
 		{
@@ -228,11 +612,11 @@ void InternalCNOVRFocusUpdate()
 			FOCUS.bShowControllerPointer[ctrl] = 1;
 		}
 
-		if( FOCUS.capFocusTemp != props->capturedFocus )
+		if( FOCUS.capFocusTemp[ctrl] != props->capturedFocus )
 		{
 			OGLockMutex( FOCUS.mutFocus );
-			if( ( cap = FOCUS.capFocusTemp ) ) { TCCInvocation( cap->tcctag, cap->cb( CNOVRF_LOSTFOCUS, cap, props, i ) ); }
-			if( ( cap = props->capturedFocus ) ) { TCCInvocation( cap->tcctag, cap->cb( CNOVRF_ACQUIREDFOCUS, cap, props, i ) ); }
+			if( ( cap = FOCUS.capFocusTemp[ctrl] ) ) { TCCInvocation( cap->tcctag, cap->cb( CNOVRF_LOSTFOCUS, cap, props, CTRLA_GRASP+1 ) ); }
+			if( ( cap = props->capturedFocus ) ) { TCCInvocation( cap->tcctag, cap->cb( CNOVRF_ACQUIREDFOCUS, cap, props, CTRLA_GRASP+1 ) ); }
 			OGUnlockMutex( FOCUS.mutFocus );
 		}
 		FOCUS.current_devid = -1;
@@ -261,6 +645,8 @@ void InternalCNOVRFocusSetup()
 	int ctrl, i;
 
 	FOCUS.mutFocus = OGCreateMutex();
+	FOCUS.iTreeRoot = -1;
+	FOCUS.iTreeFree = -1;
 
 	for( i = 0; i < CNOVRINPUTDEVS; i++ )
 	{
@@ -351,9 +737,13 @@ void InternalCNOVRFocusSetup()
 //Also, considerin switching it up so parts of this function live as a #define for speed.
 void CNOVRFocusRespond( cnovrfocus_capture * ce, float realdistance, float * fdprops )
 {
-	int cdevid = FOCUS.current_devid;
-	if( cdevid < 0 ) return;
-	cnovrfocus_properties * fp = FOCUS.focusProps + cdevid;
+	CNOVRFocusRespondDev( FOCUS.current_devid, ce, realdistance, fdprops );
+}
+
+void CNOVRFocusRespondDev( int devid, cnovrfocus_capture * ce, float realdistance, float * fdprops )
+{
+	if( devid < 0 || devid >= CNOVRINPUTDEVS ) return;
+	cnovrfocus_properties * fp = FOCUS.focusProps + devid;
 	if( realdistance < fp->NewPassiveRealDistance )
 	{
 		fp->NewCapturedPassive = ce;
@@ -383,11 +773,11 @@ void CNOVRFocusRemoveTag( void * tag )
 {
 	printf( "Removing tag START: %p\n", tag );
 	OGLockMutex( FOCUS.mutFocus );
-	if( FOCUS.capPassiveTemp && FOCUS.capPassiveTemp->tag == tag ) FOCUS.capPassiveTemp = 0;
-	if( FOCUS.capFocusTemp && FOCUS.capFocusTemp->tag == tag ) FOCUS.capFocusTemp = 0;
 	int i = 0;
 	for( i = 0; i < CNOVRINPUTDEVS; i++ )
 	{
+		if( FOCUS.capPassiveTemp[i] && FOCUS.capPassiveTemp[i]->tag == tag ) FOCUS.capPassiveTemp[i] = 0;
+		if( FOCUS.capFocusTemp[i] && FOCUS.capFocusTemp[i]->tag == tag ) FOCUS.capFocusTemp[i] = 0;
 		cnovrfocus_properties * p = &FOCUS.focusProps[i];
 		cnovrfocus_capture ** ct[CNOVRINPUTDEVS] = { 
 			&p->capturedFocus,
@@ -405,32 +795,42 @@ void CNOVRFocusRemoveTag( void * tag )
 }
 
 
-static void ModelFocusCollideFunction(void * tag, void * opaquev )
+//All devices against one model, so it's only walked once.  Called from FocusInteractablesCollide.
+static void ModelFocusCollide( cnovr_model * m, cnovrfocus_batch * batch )
 {
-	//XXX TODO: This needs to be optimized! There's a lot we can do to improve its performance.
-	cnovrfocus_properties * p = (cnovrfocus_properties*)opaquev;
-	cnovr_model * m = tag;
-	if( !m ) return;
 	cnovr_model_focus_controller * fc = m->focuscontrol;
 	if( !fc ) return;
 	if( !fc->focusevent ) return;
-	if( fc->collide_mask & (1<<p->devid) ) return;
 	if( !m->pose ) return; //XXX TODO: Should this warn?
-	cnovr_point3d start = { 0, 0, 0 };
-	cnovr_vec3d direction = { 0, 0, 1 };
+	cnovr_collide_ray rays[CNOVRINPUTDEVS];
+	int devids[CNOVRINPUTDEVS];
+	int nrays = 0;
+	int i;
 	cnovr_pose invertedxform;
 	pose_invert( &invertedxform, m->pose );
-	apply_pose_to_point( start, &p->poseTip, start);
-	apply_pose_to_point( start, &invertedxform, start);
-	apply_pose_to_point( direction, &p->poseTip, direction);
-	apply_pose_to_point( direction, &invertedxform, direction);
-	sub3d( direction, direction, start );
-	cnovr_collide_results res;
-	res.t = p->NewPassiveRealDistance;
-	int r = CNOVRModelCollide( m, start, direction, &res, 0, 0 );
-	if( r >= 0 && res.t > 0 )
-	{
-		CNOVRFocusRespond( fc->focusevent, res.t, res.collidevs );
+	for( i = 0; i < batch->count; i++ )
+	{
+		cnovrfocus_properties * p = batch->props[i];
+		if( fc->collide_mask & (1<<p->devid) ) continue;
+		cnovr_collide_ray * ray = &rays[nrays];
+		cnovr_point3d start = { 0, 0, 0 };
+		cnovr_vec3d direction = { 0, 0, 1 };
+		apply_pose_to_point( start, &p->poseTip, start);
+		apply_pose_to_point( ray->start, &invertedxform, start);
+		apply_pose_to_point( direction, &p->poseTip, direction);
+		apply_pose_to_point( direction, &invertedxform, direction);
+		sub3d( ray->direction, direction, ray->start );
+		ray->dradius = 0;
+		ray->minimumt = 0;
+		ray->res.t = p->NewPassiveRealDistance;
+		devids[nrays++] = p->devid;
+	}
+	if( !nrays ) return;
+	CNOVRModelCollideMany( m, rays, nrays );
+	for( i = 0; i < nrays; i++ )
+	{
+		if( rays[i].ret >= 0 && rays[i].res.t > 0 )
+			CNOVRFocusRespondDev( devids[i], fc->focusevent, rays[i].res.t, rays[i].res.collidevs );
 	}
 }
 
@@ -447,17 +847,19 @@ void CNOVRModelSetInteractable( cnovr_model * m, cnovrfocus_capture * focusevent
 		ovrprintf( "Warning, CNOVRModelSetInteractable called on model without a pose.  This will fail in runtime.\n" );		
 	}
 	
+	OGLockMutex( FOCUS.mutFocus );
 	if( fc->focusevent )
 	{
-		CNOVRListDeleteTag( m ); 
+		FocusInteractableRemove( m );
 	}
 
 	fc->focusevent = focusevent;
 
 	if( focusevent )
 	{
-		CNOVRListAdd( cnovrLCollide, m, ModelFocusCollideFunction );
+		FocusInteractableAdd( m );
 	}
+	OGUnlockMutex( FOCUS.mutFocus );
 }
 
 
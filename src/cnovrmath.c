@@ -536,7 +536,7 @@ void quatslerp(cnovr_quat q, const cnovr_quat qa, const cnovr_quat qb, FLT t) {
 	// Switched implementation to match https://en.wikipedia.org/wiki/Slerp
 
     // Compute the cosine of the angle between the two vectors.
-    double dot = dot3d(qa, qb);
+    double dot = quatinnerproduct(qa, qb);
 
 	cnovr_quat nqb;
 
@@ -803,6 +803,242 @@ void matrix44_to_pose(cnovr_pose * pose_out, const FLT * mat44 )
 	pose_out->Scale = ( mag3d( mat44 + 0 ) + mag3d( mat44 + 4 ) + mag3d( mat44 + 8 ) ) / 3.0;
 }
 
+//Batch versions.  Same math as the scalar ones, four at a time.  GCC/clang vector extensions, so this is SSE
+//on x86 and NEON on ARM from the same code.  Everything else (TCC, double FLT) just loops the scalar ones.
+#if defined( USE_FLOAT ) && defined( __GNUC__ ) && !defined( __TINYC__ )
+#define CNOVRMATH_VECTOR
+
+typedef float cnovr_v4 __attribute__((vector_size(16)));
+typedef int cnovr_v4i __attribute__((vector_size(16)));
+
+#if defined( __clang__ )
+#define V4SHUF( a, b, i, j, k, l ) __builtin_shufflevector( a, b, i, j, k, l )
+#else
+#define V4SHUF( a, b, i, j, k, l ) __builtin_shuffle( a, b, (cnovr_v4i){ i, j, k, l } )
+#endif
+
+static inline cnovr_v4 v4load( const float * f ) { cnovr_v4 r; memcpy( &r, f, sizeof( r ) ); return r; }
+static inline void v4store( float * f, cnovr_v4 v ) { memcpy( f, &v, sizeof( v ) ); }
+static inline cnovr_v4 v4splat( float f ) { return (cnovr_v4){ f, f, f, f }; }
+
+//In place 4x4 transpose.  Turns four poses' worth of (w,x,y,z) into (w0..w3),(x0..x3), etc. and back.
+static inline void v4transpose( cnovr_v4 * r )
+{
+	cnovr_v4 t0 = V4SHUF( r[0], r[1], 0, 4, 1, 5 );
+	cnovr_v4 t1 = V4SHUF( r[2], r[3], 0, 4, 1, 5 );
+	cnovr_v4 t2 = V4SHUF( r[0], r[1], 2, 6, 3, 7 );
+	cnovr_v4 t3 = V4SHUF( r[2], r[3], 2, 6, 3, 7 );
+	r[0] = V4SHUF( t0, t1, 0, 1, 4, 5 );
+	r[1] = V4SHUF( t0, t1, 2, 3, 6, 7 );
+	r[2] = V4SHUF( t2, t3, 0, 1, 4, 5 );
+	r[3] = V4SHUF( t2, t3, 2, 3, 6, 7 );
+}
+
+//Four packed xyz points (12 floats) to x, y and z lanes, and back.
+static inline void v4loadpoints( cnovr_v4 * xyz, const float * f )
+{
+	cnovr_v4 a = v4load( f );
+	cnovr_v4 b = v4load( f + 4 );
+	cnovr_v4 c = v4load( f + 8 );
+	xyz[0] = V4SHUF( V4SHUF( a, b, 0, 3, 6, 7 ), c, 0, 1, 2, 5 );
+	xyz[1] = V4SHUF( V4SHUF( a, b, 1, 4, 7, 7 ), c, 0, 1, 2, 6 );
+	xyz[2] = V4SHUF( V4SHUF( a, b, 2, 5, 5, 5 ), c, 0, 1, 4, 7 );
+}
+
+static inline void v4storepoints( float * f, const cnovr_v4 * xyz )
+{
+	v4store( f,     V4SHUF( V4SHUF( xyz[0], xyz[1], 0, 4, 1, 5 ), xyz[2], 0, 1, 4, 2 ) );
+	v4store( f + 4, V4SHUF( V4SHUF( xyz[1], xyz[2], 1, 5, 2, 6 ), xyz[0], 0, 1, 6, 2 ) );
+	v4store( f + 8, V4SHUF( V4SHUF( xyz[2], xyz[0], 2, 7, 3, 7 ), xyz[1], 0, 1, 7, 2 ) );
+}
+
+//Same steps as quatrotatevector.  q is w,x,y,z lanes.
+static inline void v4quatrotatevector( cnovr_v4 * out, const cnovr_v4 * q, const cnovr_v4 * v )
+{
+	cnovr_v4 t0 = q[2] * v[2] - q[3] * v[1] + v[0] * q[0];
+	cnovr_v4 t1 = q[3] * v[0] - q[1] * v[2] + v[1] * q[0];
+	cnovr_v4 t2 = q[1] * v[1] - q[2] * v[0] + v[2] * q[0];
+	cnovr_v4 u0 = q[2] * t2 - q[3] * t1;
+	cnovr_v4 u1 = q[3] * t0 - q[1] * t2;
+	cnovr_v4 u2 = q[1] * t1 - q[2] * t0;
+	out[0] = v[0] + 2 * u0;
+	out[1] = v[1] + 2 * u1;
+	out[2] = v[2] + 2 * u2;
+}
+
+static inline void v4quatrotateabout( cnovr_v4 * p, const cnovr_v4 * q1, const cnovr_v4 * q2 )
+{
+	p[0] = (q1[0] * q2[0]) - (q1[1] * q2[1]) - (q1[2] * q2[2]) - (q1[3] * q2[3]);
+	p[1] = (q1[0] * q2[1]) + (q1[1] * q2[0]) + (q1[2] * q2[3]) - (q1[3] * q2[2]);
+	p[2] = (q1[0] * q2[2]) - (q1[1] * q2[3]) + (q1[2] * q2[0]) + (q1[3] * q2[1]);
+	p[3] = (q1[0] * q2[3]) + (q1[1] * q2[2]) - (q1[2] * q2[1]) + (q1[3] * q2[0]);
+}
+
+static inline cnovr_v4 v4sqrt( cnovr_v4 v )
+{
+	return (cnovr_v4){ FLT_SQRT( v[0] ), FLT_SQRT( v[1] ), FLT_SQRT( v[2] ), FLT_SQRT( v[3] ) };
+}
+
+static inline void v4quatnormalize( cnovr_v4 * q )
+{
+	cnovr_v4 norm = v4sqrt( q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3] );
+	q[0] /= norm; q[1] /= norm; q[2] /= norm; q[3] /= norm;
+}
+#endif
+
+void apply_pose_to_point_n(cnovr_point3d *pout, const cnovr_pose *pose, const cnovr_point3d *pin, int n) {
+	int i = 0;
+#ifdef CNOVRMATH_VECTOR
+	cnovr_v4 q[4] = { v4splat( pose->Rot[0] ), v4splat( pose->Rot[1] ), v4splat( pose->Rot[2] ), v4splat( pose->Rot[3] ) };
+	cnovr_v4 s = v4splat( pose->Scale );
+	for( ; i + 4 <= n; i += 4 )
+	{
+		cnovr_v4 v[3], o[3];
+		v4loadpoints( v, pin[i] );
+		v4quatrotatevector( o, q, v );
+		o[0] = o[0] * s + pose->Pos[0];
+		o[1] = o[1] * s + pose->Pos[1];
+		o[2] = o[2] * s + pose->Pos[2];
+		v4storepoints( pout[i], o );
+	}
+#endif
+	for( ; i < n; i++ )
+		apply_pose_to_point( pout[i], pose, pin[i] );
+}
+
+void apply_pose_to_pose_n(cnovr_pose *pout, const cnovr_pose *lhs_poses, const cnovr_pose *rhs_poses, int n) {
+	int i = 0;
+#ifdef CNOVRMATH_VECTOR
+	for( ; i + 4 <= n; i += 4 )
+	{
+		//Tricky: A pose is 8 floats, Rot then Pos and Scale, so four of them are two 4x4 transposes.
+		cnovr_v4 lr[4], lp[4], rr[4], rp[4], o[4], op[4];
+		int k;
+		for( k = 0; k < 4; k++ )
+		{
+			lr[k] = v4load( lhs_poses[i+k].Rot );
+			lp[k] = v4load( lhs_poses[i+k].Pos );
+			rr[k] = v4load( rhs_poses[i+k].Rot );
+			rp[k] = v4load( rhs_poses[i+k].Pos );
+		}
+		v4transpose( lr ); v4transpose( lp ); v4transpose( rr ); v4transpose( rp );
+
+		//Same as apply_pose_to_pose.
+		v4quatrotatevector( op, lr, rp );
+		op[0] = ( op[0] * lp[3] + lp[0] ) * rp[3];
+		op[1] = ( op[1] * lp[3] + lp[1] ) * rp[3];
+		op[2] = ( op[2] * lp[3] + lp[2] ) * rp[3];
+		op[3] = lp[3] * rp[3];
+		v4quatrotateabout( o, lr, rr );
+
+		v4transpose( o ); v4transpose( op );
+		for( k = 0; k < 4; k++ )
+		{
+			v4store( pout[i+k].Rot, o[k] );
+			v4store( pout[i+k].Pos, op[k] );
+		}
+	}
+#endif
+	for( ; i < n; i++ )
+		apply_pose_to_pose( &pout[i], &lhs_poses[i], &rhs_poses[i] );
+}
+
+void pose_to_matrix44_n(FLT *mat44s, const cnovr_pose *poses, int n) {
+	int i = 0;
+#ifdef CNOVRMATH_VECTOR
+	for( ; i + 4 <= n; i += 4 )
+	{
+		cnovr_v4 q[4], p[4], m[16];
+		int k;
+		for( k = 0; k < 4; k++ )
+		{
+			q[k] = v4load( poses[i+k].Rot );
+			p[k] = v4load( poses[i+k].Pos );
+		}
+		v4transpose( q ); v4transpose( p );
+
+		//Same as quattomatrix, then scaled.
+		v4quatnormalize( q );
+		cnovr_v4 xx = 2 * q[1] * q[1];
+		cnovr_v4 xy = 2 * q[1] * q[2];
+		cnovr_v4 xz = 2 * q[1] * q[3];
+		cnovr_v4 xw = 2 * q[1] * q[0];
+		cnovr_v4 yy = 2 * q[2] * q[2];
+		cnovr_v4 yz = 2 * q[2] * q[3];
+		cnovr_v4 yw = 2 * q[2] * q[0];
+		cnovr_v4 zz = 2 * q[3] * q[3];
+		cnovr_v4 zw = 2 * q[3] * q[0];
+		cnovr_v4 s = p[3];
+		m[0] = ( 1 - yy - zz ) * s; m[1] = ( xy - zw ) * s;     m[2] = ( xz + yw ) * s;      m[3] = p[0];
+		m[4] = ( xy + zw ) * s;     m[5] = ( 1 - xx - zz ) * s; m[6] = ( yz - xw ) * s;      m[7] = p[1];
+		m[8] = ( xz - yw ) * s;     m[9] = ( yz + xw ) * s;     m[10] = ( 1 - xx - yy ) * s; m[11] = p[2];
+		m[12] = v4splat( 0 );       m[13] = v4splat( 0 );       m[14] = v4splat( 0 );        m[15] = v4splat( 1 );
+
+		//m[] has each element for four poses, flip each row of four back to one pose each.
+		for( k = 0; k < 4; k++ )
+		{
+			cnovr_v4 r[4] = { m[k*4+0], m[k*4+1], m[k*4+2], m[k*4+3] };
+			int j;
+			v4transpose( r );
+			for( j = 0; j < 4; j++ )
+				v4store( mat44s + ( i + j ) * 16 + k * 4, r[j] );
+		}
+	}
+#endif
+	for( ; i < n; i++ )
+		pose_to_matrix44( mat44s + i * 16, &poses[i] );
+}
+
+void quatslerp_n(cnovr_quat *q, const cnovr_quat *qa, const cnovr_quat *qb, const FLT *t, int n) {
+	int i = 0;
+#ifdef CNOVRMATH_VECTOR
+	for( ; i + 4 <= n; i += 4 )
+	{
+		cnovr_v4 a[4], b[4], o[4];
+		int k;
+		for( k = 0; k < 4; k++ )
+		{
+			a[k] = v4load( qa[i+k] );
+			b[k] = v4load( qb[i+k] );
+		}
+		v4transpose( a ); v4transpose( b );
+		cnovr_v4 tt = v4load( t + i );
+
+		cnovr_v4 dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+		cnovr_v4 sign = (cnovr_v4){ dot[0] < 0 ? -1 : 1, dot[1] < 0 ? -1 : 1, dot[2] < 0 ? -1 : 1, dot[3] < 0 ? -1 : 1 };
+		dot *= sign;
+		for( k = 0; k < 4; k++ ) b[k] *= sign;
+
+		//Close ones just lerp, the rest need a few transcendentals each.
+		cnovr_v4 s0, s1;
+		for( k = 0; k < 4; k++ )
+		{
+			if( dot[k] > 0.9995 )
+			{
+				s0[k] = 1 - tt[k];
+				s1[k] = tt[k];
+			}
+			else
+			{
+				float theta_0 = FLT_ACOS( dot[k] );
+				float theta = theta_0 * tt[k];
+				float sin_theta = FLT_SIN( theta );
+				float sin_theta_0 = FLT_SIN( theta_0 );
+				s0[k] = FLT_COS( theta ) - dot[k] * sin_theta / sin_theta_0;
+				s1[k] = sin_theta / sin_theta_0;
+			}
+		}
+		for( k = 0; k < 4; k++ ) o[k] = a[k] * s0 + b[k] * s1;
+		v4quatnormalize( o );
+		v4transpose( o );
+		for( k = 0; k < 4; k++ )
+			v4store( q[i+k], o[k] );
+	}
+#endif
+	for( ; i < n; i++ )
+		quatslerp( q[i], qa[i], qb[i], t[i] );
+}
+
 
 
 #define m00 0
@@ -10,9 +10,11 @@
 #include <stdarg.h>
 #include <stb_image.h>
 #include <stb_include_custom.h>
+#include <cnovrtexcompress.h>
 #include <cnovrtccinterface.h>
 #include <stretchy_buffer.h>
 #include <cnrbtree.h>
+#include <sys/stat.h>
 
 //XXX Overall TODO: Replace more FreeLater's with frees
 
@@ -22,23 +24,229 @@ static void parts_delete_callback( void * tag, void * opaquev )
 	b->header->Delete( b );
 }
 
+static int CNOVRAssetRelease( cnovr_base * b );
+
 void CNOVRDeleteBase( cnovr_base * b )
 {
 	if( !b ) return;
+	//Shared assets only really go once the last holder lets go.
+	if( CNOVRAssetRelease( b ) ) return;
 	//XXX Tricky: Use -1 tag to prevent accidental task deletion.
-	CNOVRJobTack( cnovrQPrerender, parts_delete_callback, (void*)-1, b, 0 );
+	//Low, so it lands behind anything already queued for b in any class.  Jobs for one object keep their order.
+	CNOVRJobTackPriority( cnovrQPrerender, parts_delete_callback, (void*)-1, b, 0, cnovrPriorityLow );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//Shared assets, keyed by what they were loaded from.  Few enough of these that a list is fine.
+
+typedef struct cnovr_asset_t
+{
+	char * key;
+	cnovr_base * obj;
+	int refs;
+	struct cnovr_asset_t * next;
+} cnovr_asset;
+
+static cnovr_asset * cnovr_assets;
+static og_mutex_t cnovr_assets_mutex;
+static int cnovr_assets_count;
+
+static void CNOVRAssetLock()
+{
+	//XXX Tricky: First use is always from the main thread, during module or scene setup.
+	if( !cnovr_assets_mutex ) cnovr_assets_mutex = OGCreateMutex();
+	OGLockMutex( cnovr_assets_mutex );
+}
+
+//Must hold the lock.  Takes a reference if it's there.
+static cnovr_base * CNOVRAssetFind( const char * key )
+{
+	cnovr_asset * a;
+	for( a = cnovr_assets; a; a = a->next )
+	{
+		if( strcmp( a->key, key ) == 0 )
+		{
+			a->refs++;
+			return a->obj;
+		}
+	}
+	return 0;
+}
+
+//Returns nonzero if b is shared and somebody else still holds it.
+static int CNOVRAssetRelease( cnovr_base * b )
+{
+	if( !cnovr_assets ) return 0;
+	int ret = 0;
+	CNOVRAssetLock();
+	cnovr_asset ** pa;
+	for( pa = &cnovr_assets; *pa; pa = &(*pa)->next )
+	{
+		cnovr_asset * a = *pa;
+		if( a->obj != b ) continue;
+		if( --a->refs > 0 )
+		{
+			ret = 1;
+			break;
+		}
+		*pa = a->next;
+		free( a->key );
+		free( a );
+		cnovr_assets_count--;
+		break;
+	}
+	OGUnlockMutex( cnovr_assets_mutex );
+	return ret;
+}
+
+//Hands back the shared object for key, making it with create( opaque ) if nobody has it yet.
+static cnovr_base * CNOVRAssetAcquire( const char * tkey, cnovr_base * (*create)( void * opaque ), void * opaque )
+{
+	CNOVRAssetLock();
+	cnovr_base * ret = CNOVRAssetFind( tkey );
+	OGUnlockMutex( cnovr_assets_mutex );
+	if( ret ) return ret;
+	char * key = strdup( tkey ); //Likely a trprintf, loaders use those too.
+
+	//Tricky: Shared assets outlive whichever module asked first, so their jobs, watches and alerts can't be tied to it.
+	//Also made without the lock held, loaders take plenty of their own.
+	void * tcctag = OGGetTLS( tcctlstag );
+	OGSetTLS( tcctlstag, 0 );
+	cnovr_base * made = create( opaque );
+	OGSetTLS( tcctlstag, tcctag );
+	if( !made )
+	{
+		free( key );
+		return 0;
+	}
+
+	CNOVRAssetLock();
+	ret = CNOVRAssetFind( key );
+	if( !ret )
+	{
+		cnovr_asset * a = malloc( sizeof( cnovr_asset ) );
+		a->key = key;
+		key = 0;
+		a->obj = made;
+		a->refs = 1;
+		a->next = cnovr_assets;
+		cnovr_assets = a;
+		cnovr_assets_count++;
+		ret = made;
+		made = 0;
+	}
+	OGUnlockMutex( cnovr_assets_mutex );
+
+	//Lost a race with another thread loading the same thing.
+	if( made ) CNOVRDeleteBase( made );
+	free( key );
+	return ret;
+}
+
+int CNOVRAssetCount()
+{
+	return cnovr_assets_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define CNOVR_STATE_TEXTURE_UNITS 16
+#define CNOVR_STATE_UNKNOWN ((GLuint)~0)
+
+//Only touched from the render thread.
+static struct
+{
+	GLuint program;
+	GLuint vao;
+	int activeunit;
+	GLuint textures[CNOVR_STATE_TEXTURE_UNITS];
+} cnovr_glstate; //All zero is what a fresh context looks like.
+
+void CNOVRStateInvalidate()
+{
+	int i;
+	cnovr_glstate.program = CNOVR_STATE_UNKNOWN;
+	cnovr_glstate.vao = CNOVR_STATE_UNKNOWN;
+	cnovr_glstate.activeunit = -1;
+	for( i = 0; i < CNOVR_STATE_TEXTURE_UNITS; i++ )
+		cnovr_glstate.textures[i] = CNOVR_STATE_UNKNOWN;
+}
+
+void CNOVRStateUseProgram( GLuint program )
+{
+	if( cnovr_glstate.program == program ) return;
+	glUseProgram( program );
+	cnovr_glstate.program = program;
+}
+
+void CNOVRStateActiveTexture( int unit )
+{
+	if( cnovr_glstate.activeunit == unit ) return;
+	glActiveTextureCHEW( GL_TEXTURE0 + unit );
+	cnovr_glstate.activeunit = unit;
+}
+
+void CNOVRStateBindTexture( GLuint texture )
+{
+	int unit = cnovr_glstate.activeunit;
+	if( unit < 0 || unit >= CNOVR_STATE_TEXTURE_UNITS )
+	{
+		glBindTexture( GL_TEXTURE_2D, texture );
+		return;
+	}
+	if( cnovr_glstate.textures[unit] == texture ) return;
+	glBindTexture( GL_TEXTURE_2D, texture );
+	cnovr_glstate.textures[unit] = texture;
+}
+
+void CNOVRStateBindVertexArray( GLuint vao )
+{
+	if( cnovr_glstate.vao == vao ) return;
+	glBindVertexArray( vao );
+	cnovr_glstate.vao = vao;
+}
+
+void CNOVRStateForgetProgram( GLuint program )
+{
+	if( cnovr_glstate.program == program ) cnovr_glstate.program = CNOVR_STATE_UNKNOWN;
+}
+
+void CNOVRStateForgetTexture( GLuint texture )
+{
+	int i;
+	for( i = 0; i < CNOVR_STATE_TEXTURE_UNITS; i++ )
+		if( cnovr_glstate.textures[i] == texture ) cnovr_glstate.textures[i] = 0;
+}
+
+void CNOVRStateForgetVertexArray( GLuint vao )
+{
+	if( cnovr_glstate.vao == vao ) cnovr_glstate.vao = 0;
 }
 
 
+
 static void CNOVRRenderFrameBufferDelete( cnovr_rf_buffer * ths )
 {
+	if( ths->layers )
+	{
+		//Resolve ids alias layer 0, and depth is a texture array, multiview can't attach renderbuffers.
+		int i;
+		glDeleteFramebuffers( ths->layers, ths->nLayerReadFramebufferId );
+		glDeleteFramebuffers( ths->layers, ths->nLayerResolveFramebufferId );
+		for( i = 0; i < ths->layers; i++ ) CNOVRStateForgetTexture( ths->nLayerResolveTextureId[i] );
+		glDeleteTextures( ths->layers, ths->nLayerResolveTextureId );
+		if( ths->nDepthBufferId ) glDeleteTextures( 1, &ths->nDepthBufferId );
+		ths->nResolveFramebufferId = 0;
+		ths->nResolveTextureId = 0;
+		ths->nDepthBufferId = 0;
+	}
 	//Tricky - render and resolve may be the same if no multisampling is used.
 	if( ths->nResolveFramebufferId && ths->nResolveFramebufferId != ths->nRenderFramebufferId ) glDeleteFramebuffers( 1, &ths->nResolveFramebufferId );
 	if( ths->nRenderFramebufferId ) glDeleteFramebuffers( 1, &ths->nRenderFramebufferId );
-	if( ths->nResolveTextureId ) glDeleteTextures( 1, &ths->nResolveTextureId );
+	if( ths->nResolveTextureId ) { CNOVRStateForgetTexture( ths->nResolveTextureId ); glDeleteTextures( 1, &ths->nResolveTextureId ); }
 	if( ths->nDepthBufferId ) glDeleteRenderbuffers( 1, &ths->nDepthBufferId );
 	if( ths->nColorBufferId ) glDeleteRenderbuffers( 1, &ths->nColorBufferId );
-	if( ths->nRenderTextureId ) glDeleteTextures( 1, &ths->nRenderTextureId );
+	if( ths->nRenderTextureId ) { CNOVRStateForgetTexture( ths->nRenderTextureId ); glDeleteTextures( 1, &ths->nRenderTextureId ); }
 	CNOVRListDeleteTag( ths );
 
 	CNOVRFreeLater( ths );
@@ -58,6 +266,8 @@ cnovr_rf_buffer * CNOVRRFBufferCreate( int nWidth, int nHeight, int multisample
 	ret->base.tccctx = TCCGetTag();
 
 	ret->multisample = multisample;
+	ret->width = nWidth;
+	ret->height = nHeight;
 	//printf( "CNOVRRFBufferCreate %d (%d,%d)\n", multisample, nWidth, nHeight );
 
 	//XXX TODO: Figure out why we can't use depth buffers with multisamples.
@@ -128,7 +338,7 @@ cnovr_rf_buffer * CNOVRRFBufferCreate( int nWidth, int nHeight, int multisample
 		glGenFramebuffers(1, &ret->nResolveFramebufferId );
 		glBindFramebuffer(GL_FRAMEBUFFER, ret->nResolveFramebufferId);
 		glGenTextures(1, &ret->nResolveTextureId );
-		glBindTexture(GL_TEXTURE_2D, ret->nResolveTextureId );
+		CNOVRStateBindTexture( ret->nResolveTextureId );
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, nWidth, nHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
@@ -145,40 +355,152 @@ cnovr_rf_buffer * CNOVRRFBufferCreate( int nWidth, int nHeight, int multisample
 	}
 
 	glBindFramebuffer( GL_FRAMEBUFFER, 0 );
-	
-	if( !multisample )
+	return ret;
+}
+
+
+static cnovr_rf_buffer * CNOVRRFBufferCreateLayeredInternal( int nWidth, int nHeight, int multisample, int layers, int multiview );
+
+cnovr_rf_buffer * CNOVRRFBufferCreateLayered( int nWidth, int nHeight, int multisample, int layers )
+{
+	return CNOVRRFBufferCreateLayeredInternal( nWidth, nHeight, multisample, layers, 1 );
+}
+
+cnovr_rf_buffer * CNOVRRFBufferCreateArray( int nWidth, int nHeight, int multisample, int layers )
+{
+	return CNOVRRFBufferCreateLayeredInternal( nWidth, nHeight, multisample, layers, 0 );
+}
+
+static cnovr_rf_buffer * CNOVRRFBufferCreateLayeredInternal( int nWidth, int nHeight, int multisample, int layers, int multiview )
+{
+	int i;
+	if( multiview && !glFramebufferTextureMultiviewOVRfnptr )
 	{
-		ret->resolveshader = 0;
-		ret->resolvegeo = 0;
+		ovrprintf( "Warning: No GL_OVR_multiview, can't make a layered framebuffer\n" );
+		return 0;
 	}
+	if( layers > CNOVR_RF_MAX_LAYERS ) layers = CNOVR_RF_MAX_LAYERS;
+
+	cnovr_rf_buffer * ret = malloc( sizeof( cnovr_rf_buffer ) );
+	memset( ret, 0, sizeof( *ret ) );
+	ret->base.header = &cnovr_rf_buffer_header;
+	ret->base.tccctx = TCCGetTag();
+	ret->multisample = multisample;
+	ret->layers = layers;
+	ret->multiview = multiview;
+	ret->width = nWidth;
+	ret->height = nHeight;
+
+	int texmul = multisample?GL_TEXTURE_2D_MULTISAMPLE_ARRAY:GL_TEXTURE_2D_ARRAY;
+
+	glGenTextures( 1, &ret->nRenderTextureId );
+	glGenTextures( 1, &ret->nDepthBufferId );
+	glBindTexture( texmul, ret->nRenderTextureId );
+	if( multisample )
+		glTexImage3DMultisample( texmul, multisample, GL_RGBA8, nWidth, nHeight, layers, GL_TRUE );
+	else
+		glTexImage3DCHEW( texmul, 0, GL_RGBA8, nWidth, nHeight, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0 );
+	glBindTexture( texmul, ret->nDepthBufferId );
+	if( multisample )
+		glTexImage3DMultisample( texmul, multisample, GL_DEPTH_COMPONENT24, nWidth, nHeight, layers, GL_TRUE );
 	else
+		glTexImage3DCHEW( texmul, 0, GL_DEPTH_COMPONENT24, nWidth, nHeight, layers, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, 0 );
+	glBindTexture( texmul, 0 );
+
+	if( multiview )
 	{
-		char stbuf[128];
-		sprintf( stbuf, "#define MULTISAMPLES %d\n", multisample );
-		ret->resolveshader = CNOVRShaderCreateWithPrefix( "resolve", stbuf );
-		ret->resolvegeo = CNOVRModelCreate( 0, GL_TRIANGLES );
-		CNOVRModelAppendMesh( ret->resolvegeo, 1, 1, 0, (cnovr_point3d){ 1, 1, 0 }, 0, 0 );
+		glGenFramebuffers( 1, &ret->nRenderFramebufferId );
+		glBindFramebuffer( GL_FRAMEBUFFER, ret->nRenderFramebufferId );
+		glFramebufferTextureMultiviewOVR( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, ret->nRenderTextureId, 0, 0, layers );
+		glFramebufferTextureMultiviewOVR( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, ret->nDepthBufferId, 0, 0, layers );
+		if( glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE )
+		{
+			printf( "Warning bad framebuffer setup (Layered Render)\n" );
+			CNOVRRenderFrameBufferDelete( ret );
+			return 0;
+		}
+	}
+
+	//Each layer gets read out through its own framebuffer and blitted (resolved) into a plain 2D texture.
+	//That framebuffer gets the layer's depth too, so one layer can be drawn on its own through it.
+	//Arrays always draw that way, multiview buffers only while a multiview shader is still compiling.
+	glGenFramebuffers( layers, ret->nLayerReadFramebufferId );
+	glGenFramebuffers( layers, ret->nLayerResolveFramebufferId );
+	glGenTextures( layers, ret->nLayerResolveTextureId );
+	for( i = 0; i < layers; i++ )
+	{
+		glBindFramebuffer( GL_FRAMEBUFFER, ret->nLayerReadFramebufferId[i] );
+		glFramebufferTextureLayer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, ret->nRenderTextureId, 0, i );
+		glFramebufferTextureLayer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, ret->nDepthBufferId, 0, i );
+		if( glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE )
+		{
+			printf( "Warning bad framebuffer setup (Array Render)\n" );
+			CNOVRRenderFrameBufferDelete( ret );
+			return 0;
+		}
+
+		glBindFramebuffer( GL_FRAMEBUFFER, ret->nLayerResolveFramebufferId[i] );
+		CNOVRStateBindTexture( ret->nLayerResolveTextureId[i] );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0 );
+		glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA8, nWidth, nHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0 );
+		glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ret->nLayerResolveTextureId[i], 0 );
+		if( glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE )
+		{
+			printf( "Warning: Bad framebuffersetup (Layered Resolve)\n" );
+			CNOVRRenderFrameBufferDelete( ret );
+			return 0;
+		}
 	}
+	glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+
+	//Left eye is what anything expecting a single image gets.
+	ret->nResolveFramebufferId = ret->nLayerResolveFramebufferId[0];
+	ret->nResolveTextureId = ret->nLayerResolveTextureId[0];
 	return ret;
 }
 
+static void CNOVRFBufferActivateInternal( cnovr_rf_buffer * b, int layer );
 
 void CNOVRFBufferActivate( cnovr_rf_buffer * b )
+{
+	CNOVRFBufferActivateInternal( b, -1 );
+}
+
+void CNOVRFBufferActivateLayer( cnovr_rf_buffer * b, int layer )
+{
+	CNOVRFBufferActivateInternal( b, layer );
+}
+
+//layer < 0 is all layers at once if it's multiview, otherwise the first one.
+static void CNOVRFBufferActivateInternal( cnovr_rf_buffer * b, int layer )
 {
 	if( CNOVRCheck() ) ovrprintf( "PRE ACTIVAT\n" );
-	b->origw = cnovrstate->iRTWidth;
-	b->origh = cnovrstate->iRTHeight;
+	//Switching layers of an already-active array shouldn't lose what to go back to.
+	if( !b->active )
+	{
+		b->origw = cnovrstate->iRTWidth;
+		b->origh = cnovrstate->iRTHeight;
+	}
+	b->active = 1;
 	int w = cnovrstate->iRTWidth = b->width;
 	int h = cnovrstate->iRTHeight = b->height;
 	if( b->multisample )  glEnable( GL_MULTISAMPLE );
-	glBindFramebuffer( GL_FRAMEBUFFER, b->nRenderFramebufferId );
+	int allviews = b->multiview && layer < 0;
+	if( b->layers && !allviews )
+		glBindFramebuffer( GL_FRAMEBUFFER, b->nLayerReadFramebufferId[(layer<0)?0:layer] );
+	else
+		glBindFramebuffer( GL_FRAMEBUFFER, b->nRenderFramebufferId );
  	glViewport(0, 0, w, h );
+	cnovrstate->bStereoPass = allviews && b->layers > 1;
 	if( CNOVRCheck() ) ovrprintf( "POST ACTIVATE\n" );
 }
 
 void CNOVRFBufferDeactivate( cnovr_rf_buffer * b )
 {
 	if( CNOVRCheck() ) ovrprintf( "PRE DEACTIVATE\n" );
+	cnovrstate->bStereoPass = 0;
+	b->active = 0;
  	glBindFramebuffer( GL_FRAMEBUFFER, 0 );
 	int w = cnovrstate->iRTWidth = b->origw;
 	int h = cnovrstate->iRTHeight = b->origh;
@@ -186,35 +508,83 @@ void CNOVRFBufferDeactivate( cnovr_rf_buffer * b )
 	if( CNOVRCheck() ) ovrprintf( "POST DEACTIVATE\n" );
 }
 
+//Shader resolve is only the fallback now, so there's one program per sample count and one quad, shared by every buffer.
+#define CNOVR_RESOLVE_MAX_SAMPLES 32
+static cnovr_shader * cnovr_resolve_shaders[CNOVR_RESOLVE_MAX_SAMPLES+1];
+static cnovr_model * cnovr_resolve_geo;
+static int cnovr_resolve_blit_checked;
+static int cnovr_resolve_blit_failed;
+
+static void CNOVRFBufferShaderResolve( cnovr_rf_buffer * b )
+{
+	int samples = b->multisample;
+	if( samples > CNOVR_RESOLVE_MAX_SAMPLES ) samples = CNOVR_RESOLVE_MAX_SAMPLES;
+	if( !cnovr_resolve_shaders[samples] )
+	{
+		char stbuf[128];
+		sprintf( stbuf, "#define MULTISAMPLES %d\n", samples );
+		cnovr_resolve_shaders[samples] = CNOVRShaderCreateWithPrefix( "resolve", stbuf );
+		cnovr_resolve_shaders[samples]->base.tccctx = 0;
+	}
+	if( !cnovr_resolve_geo )
+	{
+		cnovr_resolve_geo = CNOVRModelCreate( 0, GL_TRIANGLES );
+		cnovr_resolve_geo->base.tccctx = 0;
+		CNOVRModelAppendMesh( cnovr_resolve_geo, 1, 1, 0, (cnovr_point3d){ 1, 1, 0 }, 0, 0 );
+	}
+
+	glBindFramebuffer( GL_FRAMEBUFFER, b->nResolveFramebufferId );
+	glViewport( 0, 0, b->width, b->height );
+	CNOVRStateActiveTexture( 0 );
+	glBindTexture( GL_TEXTURE_2D_MULTISAMPLE, b->nRenderTextureId );
+	glDisable( GL_BLEND ); // XXX TODO: Want to be in for a wild ride?  With multisample on in mixed reality, enable blending here! HAHAHAHAH
+	CNOVRRender( cnovr_resolve_shaders[samples] );
+	CNOVRRender( cnovr_resolve_geo );
+}
+
 void CNOVRFBufferBlitResolve( cnovr_rf_buffer * b )
 {
 	if( CNOVRCheck() ) ovrprintf( "PRE RESOLVE\n" );
+	cnovrstate->bStereoPass = 0;
+	b->active = 0;
 
-#if 0
-	//Broken???!?
-	glBindFramebuffer( GL_FRAMEBUFFER, 0);
-	if( b->multisample ) glDisable( GL_MULTISAMPLE );
-	glBindFramebuffer(GL_READ_FRAMEBUFFER, b->nRenderFramebufferId );
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, b->nResolveFramebufferId );
-	glBlitFramebuffer(0, 0, b->width, b->height, 0, 0, b->width, b->height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
- 	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0 );	
-#else
-
-	if( b->multisample )
+	if( b->layers )
+	{
+		//Can't texelFetch a layer out of the array with the plain resolve shader, so always blit.
+		int i;
+		for( i = 0; i < b->layers; i++ )
+		{
+			glBindFramebuffer( GL_READ_FRAMEBUFFER, b->nLayerReadFramebufferId[i] );
+			glBindFramebuffer( GL_DRAW_FRAMEBUFFER, b->nLayerResolveFramebufferId[i] );
+			glBlitFramebuffer( 0, 0, b->width, b->height, 0, 0, b->width, b->height, GL_COLOR_BUFFER_BIT, GL_NEAREST );
+		}
+	}
+	else if( b->multisample )
 	{
-		//glEnable( GL_MULTISAMPLE );
-		glBindFramebuffer( GL_FRAMEBUFFER, b->nResolveFramebufferId);
-		glActiveTextureCHEW( GL_TEXTURE0 );
-		glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, b->nRenderTextureId );
-		if( CNOVRCheck() ) ovrprintf( "MIDDLE RESOLVE\n" );
-		glDisable( GL_BLEND ); // XXX TODO: Want to be in for a wild ride?  With multisample on in mixed reality, enable blending here! HAHAHAHAH
-		CNOVRRender( b->resolveshader );
-		if( CNOVRCheck() ) ovrprintf( "MIDDLE1 RESOLVE\n" );
-		if( CNOVRCheck() ) ovrprintf( "MIDDLE2 RESOLVE\n" );
-		CNOVRRender( b->resolvegeo );
+		//Tricky: This used to be "Broken???", it was because width/height were never set, so it blitted nothing.
+		if( cnovrstate->bShaderResolve || cnovr_resolve_blit_failed )
+		{
+			CNOVRFBufferShaderResolve( b );
+		}
+		else
+		{
+			//Only check the first blit, glGetError stalls.
+			if( !cnovr_resolve_blit_checked ) while( glGetError() != GL_NO_ERROR );
+			glBindFramebuffer( GL_READ_FRAMEBUFFER, b->nRenderFramebufferId );
+			glBindFramebuffer( GL_DRAW_FRAMEBUFFER, b->nResolveFramebufferId );
+			glBlitFramebuffer( 0, 0, b->width, b->height, 0, 0, b->width, b->height, GL_COLOR_BUFFER_BIT, GL_NEAREST );
+			if( !cnovr_resolve_blit_checked )
+			{
+				cnovr_resolve_blit_checked = 1;
+				if( glGetError() != GL_NO_ERROR )
+				{
+					ovrprintf( "Warning: glBlitFramebuffer can't resolve, falling back to resolve shader.\n" );
+					cnovr_resolve_blit_failed = 1;
+					CNOVRFBufferShaderResolve( b );
+				}
+			}
+		}
 	}
-#endif
 
 	glBindFramebuffer( GL_FRAMEBUFFER, 0);
 
@@ -253,61 +623,126 @@ static void CNOVRShaderFileClearWatchlist( cnovr_shader * s )
 }
 #endif
 
+static void CNOVRShaderBuildFree( struct cnovr_shader_build_t * b );
+
+static int cnovr_multiview_pending; //Render thread only.
+
+int CNOVRShaderMultiviewPending()
+{
+	return cnovr_multiview_pending;
+}
+
+//The twin's first build is done (or gave up), the eyes can go back to one pass if it was the last one.
+static void CNOVRShaderMultiviewReady( cnovr_shader * ths )
+{
+	if( !ths->bMultiviewPending ) return;
+	ths->bMultiviewPending = 0;
+	cnovr_multiview_pending--;
+}
+
 static void CNOVRShaderDelete( cnovr_shader * ths )
 {
+	CNOVRShaderMultiviewReady( ths );
 	CNOVRFileTimeRemoveTagged( ths, 1 );
 	CNOVRListDeleteTag( ths );
 	CNOVRJobCancelAllTag( ths, 1 );
-	if( ths->nShaderID ) glDeleteProgram( ths->nShaderID );
+	if( ths->nShaderID ) { CNOVRStateForgetProgram( ths->nShaderID ); glDeleteProgram( ths->nShaderID ); }
+	if( ths->multiview ) CNOVRShaderDelete( ths->multiview );
+	if( ths->pBuild ) CNOVRShaderBuildFree( ths->pBuild );
+	if( ths->pLoaded ) CNOVRShaderBuildFree( ths->pLoaded );
 	if( ths->prefix ) free( ths->prefix );
 	//CNOVRShaderFileClearWatchlist( ths );
 	CNOVRFreeLater( ths->shaderfilebase );
 	CNOVRFreeLater( ths );
 }
 
-static GLuint CNOVRShaderCompilePart( cnovr_shader * ths, GLuint shader_type, const char * shadername, char * compstr )
+//A rebuild goes: sources preprocessed on a loader thread (pLoaded), then on the render thread either a cached
+//program binary, or compile + link handed to the driver (pBuild), polled each frame if it compiles in parallel.
+//The old program stays in use the whole time.
+
+#define CNOVR_SHADER_PARTS 3
+static const char * cnovr_shader_exts[CNOVR_SHADER_PARTS] = { "geo", "frag", "vert" };
+static const GLenum cnovr_shader_types[CNOVR_SHADER_PARTS] = { GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER, GL_VERTEX_SHADER };
+
+typedef struct cnovr_shader_build_t
 {
-	//Tricky - see if we want to autoversion this.
-#ifndef TARGET_SHADER_VERSION
-#define TARGET_SHADER_VERSION "330"
-#endif
+	char * names[CNOVR_SHADER_PARTS];   //Geo, frag, vert.  Geo is optional.
+	char * sources[CNOVR_SHADER_PARTS]; //Fully preprocessed.
+	char * cachepath;
+	uint64_t hash;                      //Of the sources, then the driver gets mixed in on the render thread.
+	GLuint parts[CNOVR_SHADER_PARTS];
+	GLuint program;
+	int fromcache;
+} cnovr_shader_build;
+
+static og_mutex_t cnovr_shader_mutex; //Protects pLoaded
+
+static uint64_t CNOVRShaderHash( uint64_t h, const char * s )
+{
+	while( s && *s ) h = ( h ^ (uint8_t)*s++ ) * 1099511628211ull;
+	return ( h ^ 0xff ) * 1099511628211ull; //So "ab","c" and "a","bc" differ.
+}
 
-	if( strncmp( compstr, "#version AUTOVER", 16 ) == 0 )
+//Only call from the render thread if it has GL objects.
+static void CNOVRShaderBuildFree( cnovr_shader_build * b )
+{
+	int i;
+	for( i = 0; i < CNOVR_SHADER_PARTS; i++ )
 	{
-		int i;
-		char c;
-		int eostr = 0;
-		for( i = 0; i < 7; i++ )
-		{
-			if( eostr ) c = 0;
-			else c = TARGET_SHADER_VERSION[i];
-			if( c == 0 ) { eostr = 1; c = ' '; }
-			compstr[9+i] = c;
-		}
+		if( b->parts[i] ) glDeleteShader( b->parts[i] );
+		free( b->names[i] );
+		free( b->sources[i] );
 	}
-	
+	if( b->program ) glDeleteProgram( b->program );
+	free( b->cachepath );
+	free( b );
+}
+
+static GLuint CNOVRShaderCompilePart( cnovr_shader * ths, GLuint shader_type, const char * compstr )
+{
 	GLuint nShader = glCreateShader( shader_type );
-	glShaderSource( nShader, 1, &compstr, NULL );
+	if( ths->bMultiview )
+	{
+		//cnovr.glsl needs to know before anything else is declared, so slide these in right after #version.
+		const GLchar * strs[3];
+		GLint lens[3];
+		int n = 0;
+		char * eol = ( strncmp( compstr, "#version", 8 ) == 0 ) ? strchr( compstr, '\n' ) : 0;
+		if( eol ) { strs[n] = compstr; lens[n++] = eol + 1 - compstr; }
+		strs[n] = ( shader_type == GL_VERTEX_SHADER ) ?
+			"#define CNOVR_MULTIVIEW\n#define CNOVR_VERTEX_SHADER\n#line 2\n" :
+			"#define CNOVR_MULTIVIEW\n#line 2\n";
+		lens[n++] = -1;
+		strs[n] = eol ? eol + 1 : compstr;
+		lens[n++] = -1;
+		glShaderSource( nShader, n, strs, lens );
+	}
+	else
+	{
+		glShaderSource( nShader, 1, &compstr, NULL );
+	}
+	//Don't ask how it went yet, that would wait for it.  CNOVRShaderBuildFinish checks.
 	glCompileShader( nShader );
-	GLint vShaderCompiled = GL_FALSE;
+	return nShader;
+}
 
+//Returns 1 if it compiled.
+static int CNOVRShaderReportPart( cnovr_shader * ths, GLuint nShader, const char * shadername )
+{
+	GLint vShaderCompiled = GL_FALSE;
 	glGetShaderiv( nShader, GL_COMPILE_STATUS, &vShaderCompiled );
-	if ( vShaderCompiled != GL_TRUE )
-	{
-		CNOVRAlert( ths->base.tccctx, 1, "Unable to compile shader: %s\n", shadername );
-		int retval;
-		glGetShaderiv( nShader, GL_INFO_LOG_LENGTH, &retval );
-		if ( retval > 1 ) {
-			char * log = (char*)malloc( retval );
-			glGetShaderInfoLog( nShader, retval, NULL, log );
-			CNOVRAlert( ths->base.tccctx, 1, "%s\n", log );
-			free( log );
-		}
-
-		glDeleteShader( nShader );
-		return 0;
+	if ( vShaderCompiled == GL_TRUE ) return 1;
+
+	CNOVRAlert( ths->base.tccctx, 1, "Unable to compile shader: %s\n", shadername );
+	int retval;
+	glGetShaderiv( nShader, GL_INFO_LOG_LENGTH, &retval );
+	if ( retval > 1 ) {
+		char * log = (char*)malloc( retval );
+		glGetShaderInfoLog( nShader, retval, NULL, log );
+		CNOVRAlert( ths->base.tccctx, 1, "%s\n", log );
+		free( log );
 	}
-	return nShader;
+	return 0;
 }
 
 static void CNOVRShaderFileChange( void * tag, void * opaquev );
@@ -372,169 +807,348 @@ static void CNOVRShaderProcessTextForMappingUniform( cnovr_shader * shader, GLui
 }
 
 
-static void CNOVRShaderFileChangePrerender( void * tag, void * opaquev )
+//Safe from any thread.  Returns 0 (after complaining) if the sources aren't usable.
+static cnovr_shader_build * CNOVRShaderPreprocess( cnovr_shader * ths )
 {
-	//Re-load shader
-	cnovr_shader * ths = (cnovr_shader*)tag;
-	//Careful: Need to re-try in case a program is still writing.
-
-	GLuint nGeoShader  = 0;
-	GLuint nFragShader = 0;
-	GLuint nVertShader = 0;
-
-	char stfbGeo[CNOVR_MAX_PATH];
-	char stfbFrag[CNOVR_MAX_PATH];
-	char stfbVert[CNOVR_MAX_PATH];
-	char * filedataGeo = 0;
-	char * filedataFrag = 0;
-	char * filedataVert = 0;
-
-	char includeerrors1[256];
-	char includeerrors2[256];
-	includeerrors1[0] = 0;
-	includeerrors2[0] = 0;
-	//printf( "THS: %p\n", ths );
-	sprintf( stfbGeo, "%s.geo", ths->shaderfilebase );
-	char * found = CNOVRFileSearch( stfbGeo ); if( found ) strcpy( stfbGeo, found );
-	if( found )
-		filedataGeo = stb_include_file( stfbGeo, ths->prefix, "assets", includeerrors1, CNOVRShaderFileTackInclude, tag );
-	//XXX TODO: Do we care about odd errors on geo?
-	sprintf( stfbFrag, "%s.frag", ths->shaderfilebase );
-	found = CNOVRFileSearch( stfbFrag ); if( found ) strcpy( stfbFrag, found );
-	if( found )
-		filedataFrag = stb_include_file( stfbFrag, ths->prefix, "assets", includeerrors2, CNOVRShaderFileTackInclude, tag );
-	sprintf( stfbVert, "%s.vert", ths->shaderfilebase );
-	found = CNOVRFileSearch( stfbVert ); if( found ) strcpy( stfbVert, found );
-	if( found )
-		filedataVert = stb_include_file( stfbVert, ths->prefix, "assets", includeerrors2, CNOVRShaderFileTackInclude, tag );
-	if( includeerrors2[0] )
-	{
-		CNOVRAlert( ths->base.tccctx, 1, "Shader preprocessor errors: %s\n", includeerrors2 );
-		goto jumpout;
-	}
-
-	if( !filedataFrag || !filedataVert )
-	{
-		CNOVRAlert( ths->base.tccctx, 1, "Unable to open vert/frag in shader: %s\n", ths->shaderfilebase );
-		goto jumpout;
-	}
-
-	if( filedataGeo )
-	{
-		nGeoShader = CNOVRShaderCompilePart( ths, GL_GEOMETRY_SHADER, stfbGeo, filedataGeo );
-	}
-	nFragShader = CNOVRShaderCompilePart( ths, GL_FRAGMENT_SHADER, stfbFrag, filedataFrag );
-	nVertShader = CNOVRShaderCompilePart( ths, GL_VERTEX_SHADER, stfbVert, filedataVert );
-
-	bool compfail = false;
-	if( filedataGeo )
-	{
-		if ( !nGeoShader )
-			compfail = true;
-	}
-	if ( !nVertShader || !nFragShader )
-	{
-		compfail = true;
-	}
-
-	GLuint unProgramID = 0;
+	//Tricky - see if we want to autoversion this.
+#ifndef TARGET_SHADER_VERSION
+#define TARGET_SHADER_VERSION "330"
+#endif
 
-	if ( !compfail )
+	cnovr_shader_build * b = calloc( 1, sizeof( cnovr_shader_build ) );
+	char stfb[CNOVR_MAX_PATH];
+	char includeerrors[256];
+	int i;
+	for( i = 0; i < CNOVR_SHADER_PARTS; i++ )
 	{
-		unProgramID = glCreateProgram();
-		if( filedataGeo )
+		sprintf( stfb, "%s.%s", ths->shaderfilebase, cnovr_shader_exts[i] );
+		char * found = CNOVRFileSearch( stfb );
+		if( !found ) continue;
+		b->names[i] = strdup( found );
+		includeerrors[0] = 0;
+		b->sources[i] = stb_include_file( b->names[i], ths->prefix, "assets", includeerrors, CNOVRShaderFileTackInclude, ths );
+		//XXX TODO: Do we care about odd errors on geo?
+		if( includeerrors[0] && cnovr_shader_types[i] != GL_GEOMETRY_SHADER )
 		{
-			glAttachShader( unProgramID, nGeoShader );
+			CNOVRAlert( ths->base.tccctx, 1, "Shader preprocessor errors: %s\n", includeerrors );
+			goto fail;
 		}
-		glAttachShader( unProgramID, nFragShader );
-		glAttachShader( unProgramID, nVertShader );
-
-		int i;
+		if( !b->sources[i] ) continue;
 
-		//XXX VERY TRICKY = we have to link twice, so we can rebind the attribs.
-		for( i = 0; i < 2; i++ )
+		char * compstr = b->sources[i];
+		if( strncmp( compstr, "#version AUTOVER", 16 ) == 0 )
 		{
-			glLinkProgram( unProgramID );
-
-			GLint programSuccess = GL_TRUE;
-			glGetProgramiv( unProgramID, GL_LINK_STATUS, &programSuccess );
-			if ( programSuccess != GL_TRUE )
-			{
-				CNOVRAlert( ths->base.tccctx, 1, "Shader linking failed: %s\n", ths->shaderfilebase );
-				int retval;
-				glGetShaderiv( unProgramID, GL_INFO_LOG_LENGTH, &retval );
-				if ( retval > 1 ) {
-					char * log = (char*)malloc( retval );
-					glGetProgramInfoLog( unProgramID, retval, NULL, log );
-					CNOVRAlert( ths->base.tccctx, 1, "%s\n", log );
-					free( log );
-				}
-				else
-				{
-					CNOVRAlert( ths->base.tccctx, 1, "No message\n" );
-				}
-				glDeleteProgram( unProgramID );
-				unProgramID = 0;
-				compfail = true;
-			}
-
-			if( !compfail && i == 0 )
+			int j;
+			char c;
+			int eostr = 0;
+			for( j = 0; j < 7; j++ )
 			{
-				//If we are going to proceed with compiling, we should make sure
-				//all of the attributes are lined up correctly.
-				if( filedataGeo )
-				{
-					CNOVRShaderProcessTextForMappingAttrib( ths, unProgramID, filedataGeo );
-				}
-				//Fragment shaders will not have attributes, but we do this just in case the impossible in unforeseen.
-				CNOVRShaderProcessTextForMappingAttrib( ths, unProgramID, filedataFrag );
-				CNOVRShaderProcessTextForMappingAttrib( ths, unProgramID, filedataVert );
+				if( eostr ) c = 0;
+				else c = TARGET_SHADER_VERSION[j];
+				if( c == 0 ) { eostr = 1; c = ' '; }
+				compstr[9+j] = c;
 			}
 		}
 	}
-	else
+
+	if( !b->sources[1] || !b->sources[2] )
 	{
-		CNOVRAlert( ths->base.tccctx, 1, "Shader compilation failed: %s\n", ths->shaderfilebase );
+		CNOVRAlert( ths->base.tccctx, 1, "Unable to open vert/frag in shader: %s\n", ths->shaderfilebase );
+		goto fail;
 	}
 
-	memset( ths->uniforms, INVALIDUNIFORM, sizeof( ths->uniforms ) );
+	b->hash = 14695981039346656037ull;
+	for( i = 0; i < CNOVR_SHADER_PARTS; i++ )
+		b->hash = CNOVRShaderHash( b->hash, b->sources[i] );
+	b->hash = CNOVRShaderHash( b->hash, ths->bMultiview ? "multiview" : "" );
+
+	//One cache file per variant, so editing the shader replaces its binary instead of piling up new ones.
+	uint32_t variant = (uint32_t)CNOVRShaderHash( CNOVRShaderHash( 14695981039346656037ull, ths->prefix ), ths->bMultiview ? "multiview" : "" );
+	b->cachepath = strdup( trprintf( "%s.%08x.progcache", b->names[2], variant ) );
+	return b;
+fail:
+	CNOVRShaderBuildFree( b );
+	return 0;
+}
 
-	if ( unProgramID )
-	{
-		if ( ths->nShaderID )
-		{
-			//CNOVRAlert( ths->base.tccctx, 3, "Compile OK: [%p] %s\n", ths, ths->shaderfilebase );
-			//Note: If we got here, we were successful. 
-			glDeleteProgram( ths->nShaderID );
-		}
-		ths->nShaderID = unProgramID;
+///////////////////////////////////////////////////////////////////////////////
+/// Program binary cache, next to the .vert as <vert>.<variant>.progcache.  Keyed by the hash of the
+/// preprocessed sources and the driver, so editing a shader, or updating the driver just misses.
+///
 
-		if( nGeoShader ) CNOVRShaderProcessTextForMappingUniform( ths, nGeoShader, filedataGeo );
-		CNOVRShaderProcessTextForMappingUniform( ths, nVertShader, filedataVert );
-		CNOVRShaderProcessTextForMappingUniform( ths, nFragShader, filedataFrag );
-	}
+#define CNOVR_PROGCACHE_VERSION 1
 
-jumpout:
-	if( filedataVert ) free( filedataVert );
-	if( filedataFrag ) free( filedataFrag );
-	if( filedataGeo ) free( filedataGeo );
+struct ProgCacheHeader
+{
+	char     magic[4];  //"CNPB"
+	uint32_t version;
+	uint64_t hash;
+	uint32_t format;    //From glGetProgramBinary
+	uint32_t size;
+};
 
-	if( nGeoShader )  glDeleteShader( nGeoShader );
-	if( nFragShader ) glDeleteShader( nFragShader );
-	if( nVertShader ) glDeleteShader( nVertShader );
+static int CNOVRShaderBinariesSupported()
+{
+	static int supported = -1;
+	if( supported < 0 )
+	{
+		GLint formats = 0;
+		if( glGetProgramBinaryfnptr && glProgramBinaryfnptr && glProgramParameterifnptr )
+			glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS, &formats );
+		supported = formats > 0;
+	}
+	return supported;
 }
 
-static void CNOVRShaderFileChange( void * tag, void * opaquev )
+static uint64_t CNOVRShaderDriverHash()
 {
-	//printf( "CNOVRShaderFileChange (%p %p)\n", tag, opaquev );
-	//0 = don't recompile if a recompile operation is already pending.
-	CNOVRJobTack( cnovrQPrerender, CNOVRShaderFileChangePrerender, tag, opaquev, 0 );
+	static uint64_t h;
+	if( !h )
+	{
+		h = CNOVRShaderHash( 14695981039346656037ull, (const char*)glGetString( GL_VENDOR ) );
+		h = CNOVRShaderHash( h, (const char*)glGetString( GL_RENDERER ) );
+		h = CNOVRShaderHash( h, (const char*)glGetString( GL_VERSION ) );
+	}
+	return h;
 }
 
-cnovr_shader default_shader = { { 0, 0 }, 0, "UNASSIGNED SHADER" };
-cnovr_shader * cnovr_current_shader = &default_shader;
-
-GLint CNOVRUniform( cnovr_shader_uniform * u )
+//Returns 1 and fills in b->program if there was a binary the driver would take.
+static int CNOVRShaderCacheLoad( cnovr_shader_build * b )
+{
+	if( !CNOVRShaderBinariesSupported() ) return 0;
+	int len, mapped;
+	const char * data = CNOVRFileMap( b->cachepath, &len, &mapped );
+	if( !data ) return 0;
+
+	const struct ProgCacheHeader * hd = (const struct ProgCacheHeader *)data;
+	if( len < sizeof( *hd ) || memcmp( hd->magic, "CNPB", 4 ) || hd->version != CNOVR_PROGCACHE_VERSION ||
+		hd->hash != b->hash || sizeof( *hd ) + hd->size > len )
+	{
+		CNOVRFileUnmap( data, len, mapped );
+		return 0;
+	}
+
+	GLuint program = glCreateProgram();
+	glProgramBinary( program, hd->format, data + sizeof( *hd ), hd->size );
+	CNOVRFileUnmap( data, len, mapped );
+
+	//Drivers can still turn it down, then it just gets compiled.
+	GLint programSuccess = GL_FALSE;
+	glGetProgramiv( program, GL_LINK_STATUS, &programSuccess );
+	if( programSuccess != GL_TRUE )
+	{
+		glDeleteProgram( program );
+		return 0;
+	}
+	b->program = program;
+	b->fromcache = 1;
+	return 1;
+}
+
+static void CNOVRShaderCacheSave( cnovr_shader_build * b )
+{
+	if( !CNOVRShaderBinariesSupported() ) return;
+	GLint size = 0;
+	glGetProgramiv( b->program, GL_PROGRAM_BINARY_LENGTH, &size );
+	if( size <= 0 ) return;
+
+	struct ProgCacheHeader * hd = malloc( sizeof( *hd ) + size );
+	memset( hd, 0, sizeof( *hd ) );
+	memcpy( hd->magic, "CNPB", 4 );
+	hd->version = CNOVR_PROGCACHE_VERSION;
+	hd->hash = b->hash;
+	GLenum format = 0;
+	GLsizei got = 0;
+	glGetProgramBinary( b->program, size, &got, &format, hd + 1 );
+	hd->format = format;
+	hd->size = got;
+
+	//Write then rename so a half-written cache is never picked up.
+	char * tmppath = strdup( trprintf( "%s.tmp", b->cachepath ) );
+	FILE * f = fopen( tmppath, "wb" );
+	if( f )
+	{
+		int ok = got > 0 && fwrite( hd, sizeof( *hd ) + got, 1, f ) == 1;
+		fclose( f );
+		if( ok )
+		{
+			remove( b->cachepath );
+			rename( tmppath, b->cachepath );
+		}
+		else
+		{
+			remove( tmppath );
+		}
+	}
+	free( tmppath );
+	free( hd );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void CNOVRShaderBuildFinish( cnovr_shader * ths )
+{
+	cnovr_shader_build * b = ths->pBuild;
+	ths->pBuild = 0;
+	int i;
+
+	//Even if it failed, the one-pass version of this shader isn't going to draw anything either.
+	CNOVRShaderMultiviewReady( ths );
+
+	GLint programSuccess = GL_FALSE;
+	glGetProgramiv( b->program, GL_LINK_STATUS, &programSuccess );
+	if ( programSuccess != GL_TRUE )
+	{
+		int compfail = 0;
+		for( i = 0; i < CNOVR_SHADER_PARTS; i++ )
+			if( b->parts[i] && !CNOVRShaderReportPart( ths, b->parts[i], b->names[i] ) )
+				compfail = 1;
+		if( compfail )
+		{
+			CNOVRAlert( ths->base.tccctx, 1, "Shader compilation failed: %s\n", ths->shaderfilebase );
+		}
+		else
+		{
+			CNOVRAlert( ths->base.tccctx, 1, "Shader linking failed: %s\n", ths->shaderfilebase );
+			int retval;
+			glGetProgramiv( b->program, GL_INFO_LOG_LENGTH, &retval );
+			if ( retval > 1 ) {
+				char * log = (char*)malloc( retval );
+				glGetProgramInfoLog( b->program, retval, NULL, log );
+				CNOVRAlert( ths->base.tccctx, 1, "%s\n", log );
+				free( log );
+			}
+			else
+			{
+				CNOVRAlert( ths->base.tccctx, 1, "No message\n" );
+			}
+		}
+		CNOVRShaderBuildFree( b );
+		return;
+	}
+
+	if( !b->fromcache ) CNOVRShaderCacheSave( b );
+
+	GLuint unProgramID = b->program;
+	b->program = 0;
+	if ( ths->nShaderID )
+	{
+		//CNOVRAlert( ths->base.tccctx, 3, "Compile OK: [%p] %s\n", ths, ths->shaderfilebase );
+		//Note: If we got here, we were successful. 
+		CNOVRStateForgetProgram( ths->nShaderID );
+		glDeleteProgram( ths->nShaderID );
+	}
+	ths->nShaderID = unProgramID;
+	ths->iUniformsSent = 0;
+	memset( ths->uniforms, INVALIDUNIFORM, sizeof( ths->uniforms ) );
+
+	GLuint frameblock = glGetUniformBlockIndex( unProgramID, "CNOVRFrame" );
+	if( frameblock != GL_INVALID_INDEX ) glUniformBlockBinding( unProgramID, frameblock, UBOBINDING_FRAME );
+
+	for( i = 0; i < CNOVR_SHADER_PARTS; i++ )
+		if( b->sources[i] ) CNOVRShaderProcessTextForMappingUniform( ths, unProgramID, b->sources[i] );
+
+	CNOVRShaderBuildFree( b );
+}
+
+static void CNOVRShaderBuildPoll( void * tag, void * dump )
+{
+	cnovr_shader * ths = (cnovr_shader*)tag;
+	GLint done = GL_FALSE;
+	glGetProgramiv( ths->pBuild->program, GL_COMPLETION_STATUS_KHR, &done );
+	if( !done ) return;
+	CNOVRListDeleteTag( ths );
+	CNOVRShaderBuildFinish( ths );
+}
+
+//Render thread.
+static void CNOVRShaderBuildStart( cnovr_shader * ths, cnovr_shader_build * b )
+{
+	//Anything still compiling is from older sources.
+	if( ths->pBuild )
+	{
+		CNOVRListDeleteTag( ths );
+		CNOVRShaderBuildFree( ths->pBuild );
+	}
+	ths->pBuild = b;
+
+	b->hash = ( b->hash ^ CNOVRShaderDriverHash() ) * 1099511628211ull;
+	if( CNOVRShaderCacheLoad( b ) )
+	{
+		CNOVRShaderBuildFinish( ths );
+		return;
+	}
+
+	int i;
+	b->program = glCreateProgram();
+	for( i = 0; i < CNOVR_SHADER_PARTS; i++ )
+	{
+		if( !b->sources[i] ) continue;
+		b->parts[i] = CNOVRShaderCompilePart( ths, cnovr_shader_types[i], b->sources[i] );
+		glAttachShader( b->program, b->parts[i] );
+	}
+
+	//Attribs can be bound before anything is compiled, so this only needs the one link.
+	for( i = 0; i < CNOVR_SHADER_PARTS; i++ )
+	{
+		//Fragment shaders will not have attributes, but we do this just in case the impossible in unforeseen.
+		if( b->sources[i] ) CNOVRShaderProcessTextForMappingAttrib( ths, b->program, b->sources[i] );
+	}
+	if( CNOVRShaderBinariesSupported() )
+		glProgramParameteri( b->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
+	glLinkProgram( b->program );
+
+	if( cnovrstate->bParallelShaderCompile )
+		CNOVRListAdd( cnovrLPrerender, ths, CNOVRShaderBuildPoll );
+	else
+		CNOVRShaderBuildFinish( ths );
+}
+
+static void CNOVRShaderBuildStartCallback( void * tag, void * opaquev )
+{
+	cnovr_shader * ths = (cnovr_shader*)tag;
+	OGLockMutex( cnovr_shader_mutex );
+	cnovr_shader_build * b = ths->pLoaded;
+	ths->pLoaded = 0;
+	OGUnlockMutex( cnovr_shader_mutex );
+	if( b ) CNOVRShaderBuildStart( ths, b );
+	else CNOVRShaderMultiviewReady( ths ); //Sources didn't load, nothing to wait for.
+}
+
+static void CNOVRShaderLoadTask( void * tag, void * opaquev )
+{
+	cnovr_shader * ths = (cnovr_shader*)tag;
+	cnovr_shader_build * b = CNOVRShaderPreprocess( ths );
+
+	//If the last one never got picked up, this one's newer.
+	if( b )
+	{
+		OGLockMutex( cnovr_shader_mutex );
+		cnovr_shader_build * old = ths->pLoaded;
+		ths->pLoaded = b;
+		OGUnlockMutex( cnovr_shader_mutex );
+		if( old ) CNOVRShaderBuildFree( old );
+	}
+	else if( !ths->bMultiviewPending )
+	{
+		return;
+	}
+
+	//0 = don't start another if one's already pending, it'll pick this up.
+	CNOVRJobTackPriority( cnovrQPrerender, CNOVRShaderBuildStartCallback, ths, 0, 0, cnovrPriorityLow );
+}
+
+static void CNOVRShaderFileChange( void * tag, void * opaquev )
+{
+	//printf( "CNOVRShaderFileChange (%p %p)\n", tag, opaquev );
+	CNOVRJobCancel( cnovrQAsync, CNOVRShaderLoadTask, tag, 0, 0 );
+	CNOVRJobTack( cnovrQAsync, CNOVRShaderLoadTask, tag, 0, 1 ); //If one's already going, let it finish.
+}
+
+cnovr_shader default_shader = { { 0, 0 }, 0, "UNASSIGNED SHADER" };
+cnovr_shader * cnovr_current_shader = &default_shader;
+
+GLint CNOVRUniform( cnovr_shader_uniform * u )
 {
 	if( u->connected_shader == cnovr_current_shader )
 		return u->mapped_uniform;
@@ -546,11 +1160,25 @@ GLint CNOVRUniform( cnovr_shader_uniform * u )
 }
 
 
+static cnovr_shader * CNOVRShaderCreateInternal( const char * shaderfilebase, const char * prefix, int multiview );
+
 static void CNOVRShaderRender( cnovr_shader * ths )
 {
+	//Drawing to both eyes at once needs the multiview build of this shader.  It builds like any other, and
+	//until it's ready the eyes are drawn one at a time (see CNOVRShaderMultiviewPending).
+	if( cnovrstate->bSinglePassStereo && !ths->bMultiview && !ths->multiview )
+	{
+		ths->multiview = CNOVRShaderCreateInternal( ths->shaderfilebase, ths->prefix, 1 );
+		ths->multiview->base.tccctx = ths->base.tccctx;
+	}
+	if( cnovrstate->bStereoPass && !ths->bMultiview )
+	{
+		if( !ths->multiview ) return;
+		ths = ths->multiview;
+	}
 	int shdid = ths->nShaderID;
 	if( !shdid ) { return; }
-	glUseProgram( shdid );
+	CNOVRStateUseProgram( shdid );
 	cnovr_current_shader = ths;
 	CNOVRShaderLoadedSetUniformsInternal();
 }
@@ -566,7 +1194,25 @@ cnovr_shader * CNOVRShaderCreate( const char * shaderfilebase )
 	return CNOVRShaderCreateWithPrefix( shaderfilebase, 0 );
 }
 
+struct cnovr_shader_asset_args
+{
+	const char * shaderfilebase;
+	const char * prefix;
+};
+
+static cnovr_base * CNOVRShaderAssetCreate( void * opaque )
+{
+	struct cnovr_shader_asset_args * a = (struct cnovr_shader_asset_args*)opaque;
+	return &CNOVRShaderCreateInternal( a->shaderfilebase, a->prefix, 0 )->base;
+}
+
 cnovr_shader * CNOVRShaderCreateWithPrefix( const char * shaderfilebase, const char * prefix )
+{
+	struct cnovr_shader_asset_args a = { shaderfilebase, prefix };
+	return (cnovr_shader*)CNOVRAssetAcquire( trprintf( "shader:%s:%s", shaderfilebase, prefix?prefix:"" ), CNOVRShaderAssetCreate, &a );
+}
+
+static cnovr_shader * CNOVRShaderCreateInternal( const char * shaderfilebase, const char * prefix, int multiview )
 {
 	cnovr_shader * ret = malloc( sizeof( cnovr_shader ) );
 	memset( ret, 0, sizeof( *ret ) );
@@ -574,7 +1220,10 @@ cnovr_shader * CNOVRShaderCreateWithPrefix( const char * shaderfilebase, const c
 	ret->base.tccctx = TCCGetTag();
 	ret->shaderfilebase = strdup( shaderfilebase );
 	ret->prefix = prefix?strdup(prefix):0;
+	ret->bMultiview = multiview;
 	memset( ret->uniforms, INVALIDUNIFORM, sizeof( ret->uniforms ) );
+	//XXX Tricky: First use is always from the main thread, during module or scene setup.
+	if( !cnovr_shader_mutex ) cnovr_shader_mutex = OGCreateMutex();
 
 	char stfb[CNOVR_MAX_PATH];
 	sprintf( stfb, "%s.geo", shaderfilebase );
@@ -586,6 +1235,12 @@ cnovr_shader * CNOVRShaderCreateWithPrefix( const char * shaderfilebase, const c
 	sprintf( stfb, "%s.vert", shaderfilebase );
 	found = CNOVRFileSearch( stfb );
 	if( found ) CNOVRFileTimeAddWatch( found, CNOVRShaderFileChange, ret, 0 );
+
+	if( multiview )
+	{
+		ret->bMultiviewPending = 1;
+		cnovr_multiview_pending++;
+	}
 	CNOVRShaderFileChange( ret, 0 );
 
 	return ret;
@@ -624,6 +1279,8 @@ int CNOVRShaderMapUniform( cnovr_shader * shader, const char * uniform_name, int
 
 //////////////////////////////////////////////////////////////////////////////
 
+static int CNOVRTextureLoadChainAsync( cnovr_texture * tex, int w, int h, int format, int levels, void * data );
+
 static void CNOVRTextureLoadFileTask( void * tag, void * opaquev )
 {
 	cnovr_texture * t = (cnovr_texture*)tag;
@@ -639,79 +1296,400 @@ static void CNOVRTextureLoadFileTask( void * tag, void * opaquev )
 		free( localfn );
 		return;
 	}
+	CNOVRFileTimeAddWatch( ffn, CNOVRTextureLoadFileTask, tag, 0 );
+
+	//Compressed textures are cached by the source's mtime, so a changed file just misses and re-encodes.
+	int compress = t->bCompress && glCompressedTexSubImage2DCHEWfnptr;
+	int mips = t->bCalculateMipMaps ? ( t->bLinear ? CNOVR_TEXMIPS_LINEAR : CNOVR_TEXMIPS_SRGB ) : CNOVR_TEXMIPS_NONE;
+	char * srcfn = strdup( ffn );
+	double srctime = compress ? OGGetFileTime( srcfn ) : 0;
+	if( compress )
+	{
+		int format, levels;
+		size_t size;
+		uint8_t * blob = CNOVRTexCompressCacheLoad( srcfn, srctime, mips, &x, &y, &format, &levels, &size );
+		if( blob )
+		{
+			CNOVRTextureLoadChainAsync( t, x, y, format, levels, blob );
+			t->bLoading = 0;
+			free( srcfn );
+			free( localfn );
+			return;
+		}
+	}
+
 	chan = 4;
 	x = 0;
 	y = 0;
-	stbi_uc * data = stbi_load( ffn, &x, &y, &chan, 4 );
+	stbi_uc * data = stbi_load( srcfn, &x, &y, &chan, 4 );
 	chan = 4;	//XXX UGH No idea why stbi_load does weird stuff if we don't specifically request 4.
-	CNOVRFileTimeAddWatch( ffn, CNOVRTextureLoadFileTask, tag, 0 );
 	free( localfn );
-	if( data )
+	if( data && compress )
+	{
+		int format, levels;
+		size_t size;
+		double start = OGGetAbsoluteTime();
+		uint8_t * blob = CNOVRTexCompressRGBA( data, x, y, mips, &format, &levels, &size );
+		ovrprintf( "Compressed %s (%dx%d) in %.1fms, %.2f MB -> %.2f MB VRAM\n", srcfn, x, y, ( OGGetAbsoluteTime() - start ) * 1000.0,
+			x * y * 4 * ( mips ? 4.0/3.0 : 1.0 ) / 1048576.0, size / 1048576.0 );
+		stbi_image_free( data );
+		CNOVRTexCompressCacheSave( srcfn, srctime, mips, x, y, format, levels, blob, size );
+		CNOVRTextureLoadChainAsync( t, x, y, format, levels, blob );
+		t->bLoading = 0;
+	}
+	else if( data && mips )
+	{
+		//Make the chain here instead of glGenerateMipmap'ing on the render thread.  stbi mallocs, so it can grow in place.
+		int levels;
+		size_t size;
+		data = CNOVRTexMipChainRGBA( data, x, y, mips, &levels, &size );
+		CNOVRTextureLoadChainAsync( t, x, y, 0, levels, data );
+		t->bLoading = 0;
+	}
+	else if( data )
 	{
 		CNOVRTextureLoadDataAsync( t, x, y, chan, 0, data );
 		t->bLoading = 0;
 	}
 	else
 	{
-		ovrprintf( "WARNING: stbi_load( %s (%s), ... ) failed. Is it saving? Trying again.\n", ffn, t->texfile );
+		ovrprintf( "WARNING: stbi_load( %s (%s), ... ) failed. Is it saving? Trying again.\n", srcfn, t->texfile );
 		CNOVRJobCancel( cnovrQAsync, CNOVRTextureLoadFileTask, t, 0, 0 );
 		CNOVRJobTack( cnovrQAsync, CNOVRTextureLoadFileTask, t, 0, 1 ); //If one's already going, let it finish.
 
 	}
+	free( srcfn );
+}
+
+//Textures loaded async get copied into one of these by the loader thread, so the render thread only
+//has to map/unmap and kick off a glTexSubImage2D out of it.  Pool state is render-thread only.
+#define CNOVR_PBO_POOL_SIZE 4
+
+struct cnovr_pbo_pool_t
+{
+	GLuint nPBO;
+	size_t iSize;
+	uint8_t bInUse;
+};
+static struct cnovr_pbo_pool_t cnovr_pbo_pool[CNOVR_PBO_POOL_SIZE];
+
+//Returns a 1-based slot with a mapped PBO of at least size bytes, or 0 if there isn't one free.
+static int CNOVRPBOAcquire( size_t size, uint8_t ** mapped )
+{
+	int i;
+	int pick = -1;
+	for( i = 0; i < CNOVR_PBO_POOL_SIZE; i++ )
+	{
+		if( cnovr_pbo_pool[i].bInUse ) continue;
+		if( pick < 0 ) pick = i;
+		if( cnovr_pbo_pool[i].iSize >= size ) { pick = i; break; }
+	}
+	if( pick < 0 ) return 0;
 
+	struct cnovr_pbo_pool_t * p = &cnovr_pbo_pool[pick];
+	if( !p->nPBO ) glGenBuffers( 1, &p->nPBO );
+	glBindBuffer( GL_PIXEL_UNPACK_BUFFER, p->nPBO );
+	if( p->iSize < size )
+	{
+		glBufferData( GL_PIXEL_UNPACK_BUFFER, size, 0, GL_STREAM_DRAW );
+		p->iSize = size;
+	}
+	//Invalidating orphans whatever a previous glTexSubImage2D may still be reading, so this doesn't stall.
+	*mapped = glMapBufferRange( GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT );
+	glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+	if( !*mapped ) return 0;
+	p->bInUse = 1;
+	return pick + 1;
 }
 
-static void CNOVRTextureUploadCallback( void * vths, void * dump )
+static void CNOVRPBORelease( int slot, int still_mapped )
+{
+	struct cnovr_pbo_pool_t * p = &cnovr_pbo_pool[slot-1];
+	if( still_mapped )
+	{
+		glBindBuffer( GL_PIXEL_UNPACK_BUFFER, p->nPBO );
+		glUnmapBuffer( GL_PIXEL_UNPACK_BUFFER );
+		glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+	}
+	p->bInUse = 0;
+}
+
+//Must hold mutProtect.  Gives up the PBO, and stops any chain that was partway up.
+static void CNOVRTextureDropPBO( cnovr_texture * t )
+{
+	if( t->iPBOSlot )
+	{
+		CNOVRPBORelease( t->iPBOSlot, t->pPBOMapped != 0 );
+		t->iPBOSlot = 0;
+		t->pPBOMapped = 0;
+	}
+	if( t->iUploadLevel >= 0 ) CNOVRListDeleteTag( t );
+	t->iUploadLevel = -1;
+}
+
+static size_t CNOVRTextureLevelSize( cnovr_texture * t, int w, int h )
+{
+	if( t->nCompressedFormat )
+		return CNOVRTexCompressLevelSize( t->nCompressedFormat, w, h );
+	return (size_t)w * h * t->channels * ( ( t->nType == GL_FLOAT ) ? 4 : 1 );
+}
+
+//Where a level starts in data, and its size.
+static size_t CNOVRTextureLevelOffset( cnovr_texture * t, int level, int * w, int * h )
+{
+	int i;
+	size_t offset = 0;
+	*w = t->width;
+	*h = t->height;
+	for( i = 0; i < level; i++ )
+	{
+		offset += CNOVRTextureLevelSize( t, *w, *h );
+		*w = ( *w > 1 ) ? *w / 2 : 1;
+		*h = ( *h > 1 ) ? *h / 2 : 1;
+	}
+	return offset;
+}
+
+static size_t CNOVRTextureDataSize( cnovr_texture * t )
+{
+	int w, h;
+	return CNOVRTextureLevelOffset( t, t->iDataLevels, &w, &h );
+}
+
+//One level, out of client memory (data) or the bound PBO (data = 0).  Returns how many bytes that was.
+static size_t CNOVRTextureUploadLevel( cnovr_texture * t, int level, const uint8_t * data, int immutable )
+{
+	int w, h;
+	size_t offset = CNOVRTextureLevelOffset( t, level, &w, &h );
+	size_t size = CNOVRTextureLevelSize( t, w, h );
+	if( t->nCompressedFormat )
+	{
+		if( immutable )
+			glCompressedTexSubImage2DCHEW( GL_TEXTURE_2D, level, 0, 0, w, h, t->nCompressedFormat, size, data + offset );
+		else
+			glCompressedTexImage2DCHEW( GL_TEXTURE_2D, level, t->nCompressedFormat, w, h, 0, size, data + offset );
+	}
+	else if( immutable )
+		glTexSubImage2D( GL_TEXTURE_2D, level, 0, 0, w, h, t->nFormat, t->nType, data + offset );
+	else
+		glTexImage2D( GL_TEXTURE_2D, level, t->nInternalFormat, w, h, 0, t->nFormat, t->nType, data + offset );
+	return size;
+}
+
+static void CNOVRTextureGenID( cnovr_texture * t )
+{
+	glGenTextures( 1, &t->nTextureId );
+	CNOVRStateBindTexture( t->nTextureId );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+}
+
+//Immutable storage can't be respecified, so to change size or format it needs a whole new texture.
+static void CNOVRTextureDropImmutable( cnovr_texture * t )
+{
+	if( t->nTextureId && t->iStorageWidth && glTexStorage2Dfnptr )
+	{
+		CNOVRStateForgetTexture( t->nTextureId );
+		glDeleteTextures( 1, &t->nTextureId );
+		t->nTextureId = 0;
+	}
+	t->iStorageWidth = t->iStorageHeight = t->iStorageLevels = 0;
+	t->nStorageInternalFormat = 0;
+}
+
+//Leaves the texture bound with storage for the current width/height/format.
+static void CNOVRTextureEnsureStorage( cnovr_texture * t )
+{
+	int levels = t->iDataLevels;
+	if( levels == 1 && t->bCalculateMipMaps && !t->nCompressedFormat )
+	{
+		int m = ( t->width > t->height ) ? t->width : t->height;
+		while( m >>= 1 ) levels++;
+	}
+
+	if( t->nTextureId && t->iStorageWidth == t->width && t->iStorageHeight == t->height &&
+		t->iStorageLevels == levels && t->nStorageInternalFormat == t->nInternalFormat )
+	{
+		CNOVRStateBindTexture( t->nTextureId );
+		return;
+	}
+
+	CNOVRTextureDropImmutable( t );
+	if( !t->nTextureId ) CNOVRTextureGenID( t );
+	CNOVRStateBindTexture( t->nTextureId );
+	if( glTexStorage2Dfnptr )
+		glTexStorage2D( GL_TEXTURE_2D, levels, t->nInternalFormat, t->width, t->height );
+	else if( !t->nCompressedFormat ) //Compressed ones get specified at upload.
+		glTexImage2D( GL_TEXTURE_2D, 0, t->nInternalFormat, t->width, t->height, 0, t->nFormat, t->nType, 0 );
+	t->iStorageWidth = t->width;
+	t->iStorageHeight = t->height;
+	t->iStorageLevels = levels;
+	t->nStorageInternalFormat = t->nInternalFormat;
+}
+
+//Straight from client memory, blocks the render thread for the whole copy.  This keeps the texture
+//mutable, since things like draggablewindows glTexImage2D into nTextureId themselves.
+static void CNOVRTextureUploadNow( cnovr_texture * t )
 {
-	cnovr_texture * t = (cnovr_texture*)vths;
-	OGLockMutex( t->mutProtect );
 	t->bTaintData = 0;
 
-	if( !t->nTextureId )
+	CNOVRTextureDropImmutable( t );
+	if( !t->nTextureId ) CNOVRTextureGenID( t );
+
+	CNOVRStateBindTexture( t->nTextureId );
+
+	int i;
+	for( i = 0; i < t->iDataLevels; i++ )
+		CNOVRTextureUploadLevel( t, i, t->data, 0 );
+
+	//A chain that was streaming in may have left these partway.
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0 );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, ( t->iDataLevels > 1 ) ? t->iDataLevels - 1 : 1000 );
+
+	if( t->iDataLevels == 1 && t->bCalculateMipMaps && !t->nCompressedFormat )
 	{
-		glGenTextures( 1, &t->nTextureId );
-		glBindTexture( GL_TEXTURE_2D, t->nTextureId );
-		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
-		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
-		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+		glGenerateMipmapCHEW(GL_TEXTURE_2D);
 	}
+	CNOVRStateBindTexture( 0 );
+}
 
+#define CNOVR_TEXTURE_STREAM_CHUNK (1<<20) //Bytes of a mip chain to put up per frame, always at least one level.
+
+//Must hold mutProtect.  Puts up the next level(s) of the chain out of the PBO, returns nonzero once they're all up.
+static int CNOVRTextureUploadLevelsFromPBO( cnovr_texture * t )
+{
+	struct cnovr_pbo_pool_t * p = &cnovr_pbo_pool[t->iPBOSlot-1];
+	int immutable = glTexStorage2Dfnptr != 0;
+	size_t sent = 0;
+	CNOVRStateBindTexture( t->nTextureId );
+	glBindBuffer( GL_PIXEL_UNPACK_BUFFER, p->nPBO );
+	do
+	{
+		sent += CNOVRTextureUploadLevel( t, t->iUploadLevel, 0, immutable );
+		t->iUploadLevel--;
+	} while( t->iUploadLevel >= 0 && sent < CNOVR_TEXTURE_STREAM_CHUNK );
+	glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+
+	//Only sample the levels that are there so far.
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, t->iUploadLevel + 1 );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, t->iDataLevels - 1 );
+	CNOVRStateBindTexture( 0 );
+
+	if( t->iUploadLevel >= 0 ) return 0;
+	CNOVRPBORelease( t->iPBOSlot, 0 );
+	t->iPBOSlot = 0;
+	return 1;
+}
 
-	glBindTexture( GL_TEXTURE_2D, t->nTextureId );
+//On cnovrLPrerender while a chain is going up.
+static void CNOVRTextureStreamLevels( void * vths, void * dump )
+{
+	cnovr_texture * t = (cnovr_texture*)vths;
+	OGLockMutex( t->mutProtect );
+	if( !t->iPBOSlot || t->iUploadLevel < 0 || CNOVRTextureUploadLevelsFromPBO( t ) )
+	{
+		t->iUploadLevel = -1;
+		CNOVRListDeleteTag( t );
+	}
+	OGUnlockMutex( t->mutProtect );
+}
 
-	glTexImage2D( GL_TEXTURE_2D,
-		0,
-		t->nInternalFormat,
-		t->width,
-		t->height,
-		0,
-		t->nFormat,
-		t->nType,
-		t->data );
+//Must hold mutProtect.
+static void CNOVRTextureCommitPBO( cnovr_texture * t )
+{
+	if( !t->iPBOSlot || !t->pPBOMapped ) return;
+	struct cnovr_pbo_pool_t * p = &cnovr_pbo_pool[t->iPBOSlot-1];
+	glBindBuffer( GL_PIXEL_UNPACK_BUFFER, p->nPBO );
+	glUnmapBuffer( GL_PIXEL_UNPACK_BUFFER );
+	glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+	t->pPBOMapped = 0;
+
+	CNOVRTextureEnsureStorage( t );
+	if( t->iDataLevels > 1 )
+	{
+		//Coarse levels go first, so it shows up (blurry) right away, then a finer level each frame.
+		t->iUploadLevel = t->iDataLevels - 1;
+		if( !CNOVRTextureUploadLevelsFromPBO( t ) )
+			CNOVRListAdd( cnovrLPrerender, t, CNOVRTextureStreamLevels );
+		return;
+	}
 
-	if( t->bCalculateMipMaps )
+	glBindBuffer( GL_PIXEL_UNPACK_BUFFER, p->nPBO );
+	CNOVRTextureUploadLevel( t, 0, 0, glTexStorage2Dfnptr != 0 );
+	glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0 );
+	if( t->bCalculateMipMaps && !t->nCompressedFormat )
 	{
 		glGenerateMipmapCHEW(GL_TEXTURE_2D);
 	}
+	CNOVRStateBindTexture( 0 );
+
+	CNOVRPBORelease( t->iPBOSlot, 0 );
+	t->iPBOSlot = 0;
+}
+
+static void CNOVRTextureUploadFromPBO( void * vths, void * vserial )
+{
+	cnovr_texture * t = (cnovr_texture*)vths;
+	OGLockMutex( t->mutProtect );
+	//If a newer load came in, its upload callback picks up the PBO we're holding.
+	if( t->iUploadSerial == (uint32_t)(uintptr_t)vserial )
+		CNOVRTextureCommitPBO( t );
+	OGUnlockMutex( t->mutProtect );
+}
+
+static void CNOVRTextureFillPBOTask( void * vths, void * vserial )
+{
+	cnovr_texture * t = (cnovr_texture*)vths;
+	OGLockMutex( t->mutProtect );
+	if( t->iUploadSerial == (uint32_t)(uintptr_t)vserial && t->pPBOMapped && t->data )
+	{
+		memcpy( t->pPBOMapped, t->data, CNOVRTextureDataSize( t ) );
+		CNOVRJobTackPriority( cnovrQPrerender, CNOVRTextureUploadFromPBO, t, vserial, 1, cnovrPriorityLow );
+	}
+	OGUnlockMutex( t->mutProtect );
+}
+
+static void CNOVRTextureUploadCallback( void * vths, void * dump )
+{
+	cnovr_texture * t = (cnovr_texture*)vths;
+	OGLockMutex( t->mutProtect );
+
+	//A load that got interrupted partway might still be holding a PBO, it may be the wrong size now.
+	CNOVRTextureDropPBO( t );
+
+	if( t->data && glMapBufferRangefnptr )
+		t->iPBOSlot = CNOVRPBOAcquire( CNOVRTextureDataSize( t ), &t->pPBOMapped );
+
+	if( t->iPBOSlot )
+	{
+		t->bTaintData = 0;
+		CNOVRJobTack( cnovrQAsync, CNOVRTextureFillPBOTask, t, (void*)(uintptr_t)t->iUploadSerial, 1 );
+	}
 	else
 	{
-		//
+		//Pool's all busy (or no PBOs), don't hold the texture back for it.
+		CNOVRTextureUploadNow( t );
 	}
-	glBindTexture( GL_TEXTURE_2D, 0 );
 
 	OGUnlockMutex( t->mutProtect );
 }
 
 static void CNOVRTextureDelete( cnovr_texture * ths )
 {
+	//Fill jobs take mutProtect, so let any that are already running finish before we hold it.
+	CNOVRJobCancelAllTag( ths, 1 );
 	OGLockMutex( ths->mutProtect );
 	CNOVRListDeleteTag( ths );
 	//In case any file changes are being watched.
 	CNOVRFileTimeRemoveTagged( ths, 1 );
 	CNOVRJobCancelAllTag( ths, 1 );
+	CNOVRTextureDropPBO( ths );
 	if( ths->nTextureId )
 	{
+		CNOVRStateForgetTexture( ths->nTextureId );
 		glDeleteTextures( 1, &ths->nTextureId );
 	}
 
@@ -723,7 +1701,7 @@ static void CNOVRTextureDelete( cnovr_texture * ths )
 
 static void CNOVRTextureRender( cnovr_texture * ths )
 {
-	glBindTexture( GL_TEXTURE_2D, ths->nTextureId );
+	CNOVRStateBindTexture( ths->nTextureId );
 }
 
 
@@ -753,6 +1731,8 @@ cnovr_texture * CNOVRTextureCreate( int initw, int inith, int initchan )
 	ret->bTaintData = 0;
 	ret->bLoading = 0;
 	ret->bFileChangeFlag = 0;
+	ret->iDataLevels = 1;
+	ret->iUploadLevel = -1;
 	memset( ret->data, 255, 4 );
 
 
@@ -771,6 +1751,33 @@ int CNOVRTextureLoadFileAsync( cnovr_texture * tex, const char * texfile )
 	return 0;
 }
 
+struct cnovr_texture_asset_args
+{
+	const char * texfile;
+	int flags;
+};
+
+static cnovr_base * CNOVRTextureAssetCreate( void * opaque )
+{
+	struct cnovr_texture_asset_args * a = (struct cnovr_texture_asset_args*)opaque;
+	cnovr_texture * ret = CNOVRTextureCreate( 1, 1, 4 );
+	ret->bCalculateMipMaps = !!( a->flags & CNOVR_TEXFILE_MIPMAPS );
+	ret->bCompress = !!( a->flags & CNOVR_TEXFILE_COMPRESS );
+	ret->bLinear = !!( a->flags & CNOVR_TEXFILE_LINEAR );
+	CNOVRTextureLoadFileAsync( ret, a->texfile );
+	return &ret->base;
+}
+
+cnovr_texture * CNOVRTextureCreateFromFile( const char * texfile, int flags )
+{
+	struct cnovr_texture_asset_args a = { texfile, flags };
+	const char * found = CNOVRFileSearch( texfile );
+	//Not found yet isn't shared, but it'll keep looking the same way a texture of your own would.
+	if( !found || !found[0] )
+		return (cnovr_texture*)CNOVRTextureAssetCreate( &a );
+	return (cnovr_texture*)CNOVRAssetAcquire( trprintf( "tex:%d:%s", flags, found ), CNOVRTextureAssetCreate, &a );
+}
+
 static void InternalCNOVRTextureLoadSetup(  cnovr_texture * tex, int w, int h, int chan, int is_float )
 {
 	tex->width = w;
@@ -786,6 +1793,8 @@ static void InternalCNOVRTextureLoadSetup(  cnovr_texture * tex, int w, int h, i
 		tex->nInternalFormat = channelmapI[chan];
 	tex->nFormat = channelmapB[chan];
 	tex->nType = is_float?GL_FLOAT:GL_UNSIGNED_BYTE;
+	tex->nCompressedFormat = 0;
+	tex->iDataLevels = 1;
 	tex->bTaintData = 1;
 }
 
@@ -797,7 +1806,10 @@ int CNOVRTextureLoadDataNow( cnovr_texture * tex, int w, int h, int chan, int is
 	if( tex->data ) free( tex->data );
 	tex->data = data;
 
-	CNOVRTextureUploadCallback( tex, 0 );
+	//Anything still in flight from an async load is now stale.
+	tex->iUploadSerial++;
+	CNOVRTextureDropPBO( tex );
+	CNOVRTextureUploadNow( tex );
 
 	//If data is permanant, we don't have to worry about deleting it.
 	if( data_permanant )
@@ -820,16 +1832,62 @@ int CNOVRTextureLoadDataAsync( cnovr_texture * tex, int w, int h, int chan, int
 	tex->data = data;
 
 	InternalCNOVRTextureLoadSetup( tex, w, h, chan, is_float );
+	tex->iUploadSerial++;
 
-	CNOVRJobTack( cnovrQPrerender, CNOVRTextureUploadCallback, tex, 0, 1 );
+	CNOVRJobTackPriority( cnovrQPrerender, CNOVRTextureUploadCallback, tex, 0, 1, cnovrPriorityLow );
 	OGUnlockMutex( tex->mutProtect );
 	return 0;
 }
 
+//Like CNOVRTextureLoadDataAsync, but data is a whole RGBA8 mip chain from cnovrtexcompress.  If format is set, it's
+//block-compressed in that format.
+static int CNOVRTextureLoadChainAsync( cnovr_texture * tex, int w, int h, int format, int levels, void * data )
+{
+	OGLockMutex( tex->mutProtect );
+	CNOVRJobCancel( cnovrQPrerender, CNOVRTextureUploadCallback, tex, 0, 1 );
 
+	if( tex->data && data != tex->data ) free( tex->data );
+	tex->data = data;
+
+	InternalCNOVRTextureLoadSetup( tex, w, h, 4, 0 );
+	if( format )
+	{
+		tex->nInternalFormat = format;
+		tex->nCompressedFormat = format;
+	}
+	tex->iDataLevels = levels;
+	tex->iUploadSerial++;
+
+	CNOVRJobTackPriority( cnovrQPrerender, CNOVRTextureUploadCallback, tex, 0, 1, cnovrPriorityLow );
+	OGUnlockMutex( tex->mutProtect );
+	return 0;
+}
+
+uint8_t * CNOVRTextureStreamBegin( cnovr_texture * tex, int w, int h, int chan, int is_float )
+{
+	OGLockMutex( tex->mutProtect );
+	tex->iUploadSerial++;
+	CNOVRTextureDropPBO( tex );
+	InternalCNOVRTextureLoadSetup( tex, w, h, chan, is_float );
+	tex->bTaintData = 0;
+	if( glMapBufferRangefnptr )
+		tex->iPBOSlot = CNOVRPBOAcquire( CNOVRTextureDataSize( tex ), &tex->pPBOMapped );
+	uint8_t * ret = tex->pPBOMapped;
+	OGUnlockMutex( tex->mutProtect );
+	return ret;
+}
+
+void CNOVRTextureStreamCommit( cnovr_texture * tex )
+{
+	OGLockMutex( tex->mutProtect );
+	CNOVRTextureCommitPBO( tex );
+	OGUnlockMutex( tex->mutProtect );
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
 
-///////////////////////////////////////////////////////////////////////////////
-
 cnovr_vbo * CNOVRCreateVBO( int iStride, int bDynamic, int iInitialSize, int iAttribNo )
 {
 	cnovr_vbo * ret = malloc( sizeof( cnovr_vbo ) );
@@ -838,6 +1896,7 @@ cnovr_vbo * CNOVRCreateVBO( int iStride, int bDynamic, int iInitialSize, int iAt
 
 	if( iInitialSize < 1 ) iInitialSize = 1;
 	ret->pVertices = malloc( iInitialSize * sizeof(float) * iStride );
+	ret->iCapacity = iInitialSize * iStride;
 	ret->iStride = iStride;
 	ret->bDynamic = bDynamic;
 	ret->mutData = OGCreateMutex();
@@ -846,13 +1905,75 @@ cnovr_vbo * CNOVRCreateVBO( int iStride, int bDynamic, int iInitialSize, int iAt
 	return ret;
 }
 
+//Must hold mutData.  Grows geometrically so appending one vertex at a time is amortized O(1).
+static float * CNOVRVBOGrow( cnovr_vbo * g, int nverts )
+{
+	uint32_t needed = ( g->iVertexCount + nverts ) * g->iStride;
+	if( needed > g->iCapacity )
+	{
+		uint32_t cap = g->iCapacity * 2;
+		if( cap < 64 ) cap = 64;
+		if( cap < needed ) cap = needed;
+		g->pVertices = realloc( g->pVertices, cap * sizeof(float) );
+		g->iCapacity = cap;
+	}
+	return g->pVertices + g->iVertexCount * g->iStride;
+}
+
+void CNOVRVBOReserve( cnovr_vbo * g, int nverts )
+{
+	OGLockMutex( g->mutData );
+	uint32_t needed = ( g->iVertexCount + nverts ) * g->iStride;
+	if( needed > g->iCapacity )
+	{
+		g->pVertices = realloc( g->pVertices, needed * sizeof(float) );
+		g->iCapacity = needed;
+	}
+	OGUnlockMutex( g->mutData );
+}
+
+//Keeps the storage around, for reloading into the same VBO.
+static void CNOVRVBOResetVertices( cnovr_vbo * g )
+{
+	OGLockMutex( g->mutData );
+	g->iVertexCount = 0;
+	OGUnlockMutex( g->mutData );
+}
+
+int CNOVRVBOTackN( cnovr_vbo * g, int nverts, const float * v, int iSrcStride )
+{
+	OGLockMutex( g->mutData );
+	int stride = g->iStride;
+	int first = g->iVertexCount;
+	float * verts = CNOVRVBOGrow( g, nverts );
+	if( iSrcStride == stride )
+	{
+		memcpy( verts, v, nverts * stride * sizeof(float) );
+	}
+	else
+	{
+		int tocopy = ( iSrcStride < stride ) ? iSrcStride : stride;
+		int i, j;
+		for( i = 0; i < nverts; i++ )
+		{
+			for( j = 0; j < tocopy; j++ )
+				verts[j] = v[j];
+			for( ; j < stride; j++ )
+				verts[j] = 0;
+			verts += stride;
+			v += iSrcStride;
+		}
+	}
+	g->iVertexCount += nverts;
+	OGUnlockMutex( g->mutData );
+	return first;
+}
 
 void CNOVRVBOTackv( cnovr_vbo * g, int nverts, float * v )
 {
 	OGLockMutex( g->mutData );
 	int stride = g->iStride;
-	g->pVertices = realloc( g->pVertices, (g->iVertexCount+1)*stride*sizeof(float) );
-	float * verts = g->pVertices + (g->iVertexCount*stride);
+	float * verts = CNOVRVBOGrow( g, 1 );
 	int tocopy = nverts;
 	if( nverts > stride ) tocopy = stride;
 	int i;
@@ -872,8 +1993,7 @@ void CNOVRVBOTack( cnovr_vbo * g,  int nverts, ... )
 {
 	OGLockMutex( g->mutData );
 	int stride = g->iStride;
-	g->pVertices = realloc( g->pVertices, (g->iVertexCount+1)*stride*sizeof(float) );
-	float * verts = g->pVertices + (g->iVertexCount*stride);
+	float * verts = CNOVRVBOGrow( g, 1 );
 	va_list argp;
 	va_start( argp, nverts );
 	int i;
@@ -891,22 +2011,117 @@ void CNOVRVBOTack( cnovr_vbo * g,  int nverts, ... )
 	OGUnlockMutex( g->mutData );
 }
 
+//Must hold mutData, and be on the render thread.
+static uint32_t cnovr_vbo_buffer_generation;
+
+static void CNOVRVBOReleaseGL( cnovr_vbo * g )
+{
+	int i;
+	for( i = 0; i < CNOVR_VBO_RING_SEGMENTS; i++ )
+	{
+		if( g->pRingFences[i] ) glDeleteSync( g->pRingFences[i] );
+		g->pRingFences[i] = 0;
+	}
+	//Deleting a buffer unmaps it.
+	if( g->nVBO ) glDeleteBuffers( 1, &g->nVBO );
+	g->nVBO = 0;
+	g->bRing = 0;
+	g->pRingMap = 0;
+	g->iUploadedBytes = 0;
+}
+
+//Returns 0 if the ring can't be used, i.e. no GL 4.4 / ARB_buffer_storage.
+static int CNOVRVBOUploadRing( cnovr_vbo * g, uint32_t bytes )
+{
+	if( !g->bRing || bytes > g->iRingSegment )
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		CNOVRVBOReleaseGL( g );
+		if( !glBufferStoragefnptr ) return 0;
+
+		//Leave some headroom, storage is immutable so growing means a new buffer.
+		uint32_t seg = ( bytes + bytes / 2 + 255 ) & ~255;
+		glGenBuffers( 1, &g->nVBO );
+		g->iBufferGeneration = ++cnovr_vbo_buffer_generation;
+		glBindBuffer( GL_ARRAY_BUFFER, g->nVBO );
+		glBufferStorage( GL_ARRAY_BUFFER, seg * CNOVR_VBO_RING_SEGMENTS, 0, flags );
+		g->pRingMap = glMapBufferRange( GL_ARRAY_BUFFER, 0, seg * CNOVR_VBO_RING_SEGMENTS, flags );
+		glBindBuffer( GL_ARRAY_BUFFER, 0 );
+		if( !g->pRingMap )
+		{
+			ovrprintf( "Warning: Could not map VBO ring, falling back to glBufferData\n" );
+			CNOVRVBOReleaseGL( g );
+			return 0;
+		}
+		g->bRing = 1;
+		g->iRingSegment = seg;
+		g->iRingIndex = 0;
+	}
+	else
+	{
+		//Everything drawn so far reads the current segment, fence it off and move to the next one.
+		g->pRingFences[g->iRingIndex] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+		g->iRingIndex = ( g->iRingIndex + 1 ) % CNOVR_VBO_RING_SEGMENTS;
+		GLsync f = g->pRingFences[g->iRingIndex];
+		if( f )
+		{
+			//Normally long signaled, we're CNOVR_VBO_RING_SEGMENTS uploads later.
+			if( glClientWaitSync( f, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000 ) == GL_TIMEOUT_EXPIRED )
+				ovrprintf( "Warning: Timed out waiting on VBO ring fence\n" );
+			glDeleteSync( f );
+			g->pRingFences[g->iRingIndex] = 0;
+		}
+	}
+
+	g->iRingOffset = g->iRingIndex * g->iRingSegment;
+	memcpy( g->pRingMap + g->iRingOffset, g->pVertices, bytes );
+	g->iUploadedBytes = bytes;
+	return 1;
+}
+
 static void CNOVRVBOPerformUpload( void * gv, void * dump )
 {
 	cnovr_vbo * g = (cnovr_vbo *)gv;
 
 	OGLockMutex( g->mutData );
 
-	if( !g->nVBO ) glGenBuffers( 1, &g->nVBO );
+	uint32_t bytes = g->iStride*sizeof(float)*g->iVertexCount;
+
+	if( g->bDynamic && bytes && CNOVRVBOUploadRing( g, bytes ) )
+	{
+		//Nothing else to do, the data's already visible to the GPU.
+	}
+	else
+	{
+		if( g->bRing ) CNOVRVBOReleaseGL( g );
+		if( !g->nVBO )
+		{
+			glGenBuffers( 1, &g->nVBO );
+			g->iBufferGeneration = ++cnovr_vbo_buffer_generation;
+		}
 
-	//This happens from within the render thread
-	glBindBuffer( GL_ARRAY_BUFFER, g->nVBO );
+		//This happens from within the render thread
+		glBindBuffer( GL_ARRAY_BUFFER, g->nVBO );
 
-	//XXX TODO: Consider streaming the data.
-	glBufferData( GL_ARRAY_BUFFER, g->iStride*sizeof(float)*g->iVertexCount, g->pVertices, g->bDynamic?GL_DYNAMIC_DRAW:GL_STATIC_DRAW);
-	glVertexPointer( g->iStride, GL_FLOAT, 0, 0);
-	//glVertexAttribPointer( 0, g->iStride, GL_FLOAT, 0, g->iStride, g->pVertices );
-	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+		if( bytes == g->iUploadedBytes && bytes )
+		{
+			//Same size, only send what changed, don't make the driver reallocate.
+			uint32_t vstride = g->iStride*sizeof(float);
+			if( g->iDirtyEnd > g->iVertexCount ) g->iDirtyEnd = g->iVertexCount;
+			if( g->iDirtyEnd > g->iDirtyStart )
+				glBufferSubData( GL_ARRAY_BUFFER, g->iDirtyStart * vstride, ( g->iDirtyEnd - g->iDirtyStart ) * vstride, g->pVertices + g->iDirtyStart * g->iStride );
+		}
+		else
+		{
+			glBufferData( GL_ARRAY_BUFFER, bytes, g->pVertices, g->bDynamic?GL_DYNAMIC_DRAW:GL_STATIC_DRAW);
+			g->iUploadedBytes = bytes;
+		}
+		glVertexPointer( g->iStride, GL_FLOAT, 0, 0);
+		//glVertexAttribPointer( 0, g->iStride, GL_FLOAT, 0, g->iStride, g->pVertices );
+		glBindBuffer( GL_ARRAY_BUFFER, 0 );
+		g->iRingOffset = 0;
+	}
+	g->iDirtyStart = g->iDirtyEnd = 0;
 	g->bIsUploaded = 1;
 
 #if 0
@@ -926,10 +2141,37 @@ static void CNOVRVBOPerformUpload( void * gv, void * dump )
 	OGUnlockMutex( g->mutData );
 }
 
-void CNOVRVBOTaint( cnovr_vbo * g )
+void CNOVRVBOTaintRange( cnovr_vbo * g, int first, int count )
 {
+	OGLockMutex( g->mutData );
+	uint32_t end = first + count;
+	if( g->iDirtyEnd <= g->iDirtyStart )
+	{
+		g->iDirtyStart = first;
+		g->iDirtyEnd = end;
+	}
+	else
+	{
+		if( first < g->iDirtyStart ) g->iDirtyStart = first;
+		if( end > g->iDirtyEnd ) g->iDirtyEnd = end;
+	}
+	g->iGeneration++;
+	OGUnlockMutex( g->mutData );
+
 	CNOVRJobCancel( cnovrQPrerender, CNOVRVBOPerformUpload, (void*)g, 0, 0 );
-	CNOVRJobTack( cnovrQPrerender, CNOVRVBOPerformUpload, (void*)g, 0, 1 );
+	//Dynamic buffers are usually small and change every frame, don't let them wait behind big uploads.
+	CNOVRJobTackPriority( cnovrQPrerender, CNOVRVBOPerformUpload, (void*)g, 0, 1, g->bDynamic?cnovrPriorityHigh:cnovrPriorityNormal );
+}
+
+void CNOVRVBOTaint( cnovr_vbo * g )
+{
+	CNOVRVBOTaintRange( g, 0, g->iVertexCount );
+}
+
+void CNOVRVBOSetDynamic( cnovr_vbo * g, int dynamic )
+{
+	//The ring (or lack of it) gets sorted out on the next upload.
+	g->bDynamic = dynamic;
 }
 
 void CNOVRVBODelete( cnovr_vbo * g )
@@ -937,7 +2179,7 @@ void CNOVRVBODelete( cnovr_vbo * g )
 	//Not a normal object.
 	CNOVRJobCancelAllTag( (void*)g, 1 );
 	OGLockMutex( g->mutData );
-	if( g->nVBO ) glDeleteBuffers( 1, &g->nVBO );
+	CNOVRVBOReleaseGL( g );
 	CNOVRFreeLater( g->pVertices );
 	OGDeleteMutex( g->mutData );
 	CNOVRFreeLater( g );
@@ -956,6 +2198,8 @@ static void CNOVRModelUpdateIBO( void * vm, void * dump )
 	cnovr_model * m = (cnovr_model *)vm;
 	OGLockMutex( m->model_mutex );
 	if( m->nIBO < 0 ) glGenBuffers( 1, (GLuint*)&m->nIBO );
+	//Tricky: The element buffer binding is VAO state, don't clobber whichever model's VAO was last bound.
+	CNOVRStateBindVertexArray( 0 );
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m->nIBO);
 //	printf( "Updating IBO: %d\n", m->iIndexCount );
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(m->pIndices[0])*m->iIndexCount, m->pIndices, GL_STATIC_DRAW);	//XXX TODO Make this tunable.
@@ -975,16 +2219,24 @@ static void CNOVRModelUpdateIBO( void * vm, void * dump )
 
 void CNOVRModelTaintIndices( cnovr_model * vm )
 {
+	vm = CNOVRModelGeometry( vm );
 	vm->iMeshMarks[vm->nMeshes] = vm->iIndexCount+1;
+	vm->iIndexGeneration++;
 	CNOVRJobTack( cnovrQPrerender, CNOVRModelUpdateIBO, (void*)vm, 0, 1 );	
 }
 
+static void CNOVRModelBVHFree( struct cnovr_model_bvh_t * b, int later );
+
 static void CNOVRModelDelete( cnovr_model * m )
 {
+	if( m->pShared ) CNOVRDelete( m->pShared );
 	CNOVRFileTimeRemoveTagged( m, 1 );
+	//Loads and BVH builds take model_mutex, so let any that are already running finish before we hold it.
+	CNOVRJobCancelAllTag( (void*)m, 1 );
 	OGLockMutex( m->model_mutex );
 	CNOVRListDeleteTag( m );
 	CNOVRJobCancelAllTag( (void*)m, 1 );
+	if( m->focuscontrol ) CNOVRModelSetInteractable( m, 0 );
 	int i;
 	for( i = 0; i < m->iGeos; i++ )
 	{
@@ -1015,67 +2267,124 @@ static void CNOVRModelDelete( cnovr_model * m )
 	m->iTextures = 0;
 
 	CNOVRFreeLater( m->pIndices );
+	CNOVRModelBVHFree( m->pBVH, 1 );
+	CNOVRModelBVHFree( m->pBVHPending, 1 );
 	if( m->geofile ) CNOVRFreeLater( m->geofile );
 	if( m->nIBO >= 0 ) glDeleteBuffers( 1, (GLuint*)&m->nIBO );
+	if( m->nInstanceVBO ) glDeleteBuffers( 1, &m->nInstanceVBO );
+	if( m->nVAO ) { CNOVRStateForgetVertexArray( m->nVAO ); glDeleteVertexArrays( 1, &m->nVAO ); }
+	if( m->pVAOAttribs ) free( m->pVAOAttribs );
+	if( m->pInstanceMatrices ) CNOVRFreeLater( m->pInstanceMatrices );
 	OGDeleteMutex( m->model_mutex );
 	CNOVRFreeLater( m );
 }
 
 
-static void CNOVRModelRender( cnovr_model * m )
+struct cnovr_model_vao_attrib_t
 {
-	static cnovr_model * last_rendered_model = 0;
-	cnovr_pose * pose;
+	uint32_t iBufferGeneration; //0 = attrib disabled.
+	uint32_t iOffset;
+	int iStride;
+};
 
-	if( m->pose )
-	{
-		pose_to_matrix44( cnovrstate->mModel, m->pose );
-		glUniformMatrix4fv( CNOVRMAPPEDUNIFORMPOS( UNIFORMSLOT_MODEL ), 1, 1, cnovrstate->mModel );
-	}
+//Models loaded from a file share the file's geometry (and its VAO and BVH), see CNOVRModelLoadFromFileAsync.
+//Pose, textures and which mesh to render/collide are still the model's own.
+cnovr_model * CNOVRModelGeometry( cnovr_model * m )
+{
+	return m->pShared ? m->pShared : m;
+}
 
-	if( !m->bIsUploaded || m->nIBO < 0 ) return;
+//Returns 0 if the model isn't ready to draw.  Leaves the model's VAO bound.
+static int CNOVRModelBindForRender( cnovr_model * m )
+{
+	cnovr_model * g = CNOVRModelGeometry( m );
+	if( !g->bIsUploaded || g->nIBO < 0 ) return 0;
 	//XXX Tricky: Don't lock model, so if we're loading while rendering, we don't hitch.
-//	if( m != last_rendered_model )
+	//Try binding any textures.
+	int i;
+	int count = m->iTextures;
+	cnovr_texture ** ts = m->pTextures;
+	if( ts )
 	{
-		//Try binding any textures.
-		int i;
-		int count = m->iTextures;
-		cnovr_texture ** ts = m->pTextures;
-		if( ts )
+		for( i = 0; i < count; i++ )
 		{
-			for( i = 0; i < count; i++ )
-			{
-				glActiveTextureCHEW( GL_TEXTURE0 + i );
-				cnovr_texture * t = ts[i];
-				CNOVRRender( t );
-			}
+			CNOVRStateActiveTexture( i );
+			cnovr_texture * t = ts[i];
+			CNOVRRender( t );
 		}
+	}
+	m = g;
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m->nIBO );
+	if( !m->nVAO )
+	{
+		glGenVertexArrays( 1, &m->nVAO );
+		CNOVRStateBindVertexArray( m->nVAO );
+		glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, m->nIBO );
+	}
+	else
+	{
+		CNOVRStateBindVertexArray( m->nVAO );
+	}
 
-		count = m->iGeos;
-		for( i = 0; i < count; i++ )
+	count = m->iGeos;
+	if( count > m->iVAOAttribs )
+	{
+		m->pVAOAttribs = realloc( m->pVAOAttribs, count * sizeof( struct cnovr_model_vao_attrib_t ) );
+		memset( m->pVAOAttribs + m->iVAOAttribs, 0, ( count - m->iVAOAttribs ) * sizeof( struct cnovr_model_vao_attrib_t ) );
+		m->iVAOAttribs = count;
+	}
+
+	//Only re-point attribs whose buffer actually moved.  Dynamic VBOs draw out of whichever ring segment was written last.
+	for( i = 0; i < m->iVAOAttribs; i++ )
+	{
+		struct cnovr_model_vao_attrib_t * a = m->pVAOAttribs + i;
+		cnovr_vbo * g = ( i < count ) ? m->pGeos[i] : 0;
+		uint32_t gen = ( g && g->bIsUploaded ) ? g->iBufferGeneration : 0;
+		if( a->iBufferGeneration == gen && ( !gen || ( a->iOffset == g->iRingOffset && a->iStride == g->iStride ) ) ) continue;
+		if( gen )
+		{
+			glBindBuffer( GL_ARRAY_BUFFER, g->nVBO );
+			glVertexAttribPointer( i, g->iStride, GL_FLOAT, GL_FALSE, g->iStride*4, (void*)(intptr_t)g->iRingOffset );
+			if( !a->iBufferGeneration ) glEnableVertexAttribArray( i );
+			a->iOffset = g->iRingOffset;
+			a->iStride = g->iStride;
+		}
+		else
 		{
-			if( !m->pGeos[i]->bIsUploaded ) continue;
-			glBindBuffer( GL_ARRAY_BUFFER, m->pGeos[i]->nVBO );
-			//glVertexPointer( m->pGeos[i]->iStride, GL_FLOAT, m->pGeos[i]->iStride, 0);    // last param is offset, not ptr
-			glVertexAttribPointer( i, m->pGeos[i]->iStride, GL_FLOAT, GL_FALSE, m->pGeos[i]->iStride*4, 0  );
+			glDisableVertexAttribArray( i );
 		}
+		a->iBufferGeneration = gen;
 	}
+	return 1;
+}
 
-//	glEnableClientState(GL_VERTEX_ARRAY);
+static void CNOVRModelDraw( cnovr_model * m, int instances )
+{
 	int mh = m->iRenderMesh;
-	if( mh == -1 )
+	m = CNOVRModelGeometry( m );
+	int m1 = 0;
+	int m2 = m->iIndexCount;
+	if( mh != -1 )
 	{
-		glDrawElements( m->nRenderType, m->iIndexCount, GL_UNSIGNED_INT, 0 );
+		m1 = m->iMeshMarks[mh];
+		m2 = m->iMeshMarks[mh+1];
 	}
+	if( instances )
+		glDrawElementsInstanced( m->nRenderType, m2-m1, GL_UNSIGNED_INT, ((int*)0) + m1, instances );
 	else
-	{
-		int m1 = m->iMeshMarks[mh];
-		int m2 = m->iMeshMarks[mh+1];
-		//printf( "%d %d\n", m1, m2 );
 		glDrawElements( m->nRenderType, m2-m1, GL_UNSIGNED_INT, ((int*)0) + m1 );
+}
+
+static void CNOVRModelRender( cnovr_model * m )
+{
+	if( m->pose )
+	{
+		pose_to_matrix44( cnovrstate->mModel, m->pose );
+		CNOVRShaderLoadedSetModelInternal();
 	}
+
+	if( !CNOVRModelBindForRender( m ) ) return;
+	CNOVRModelDraw( m, 0 );
 }
 
 
@@ -1228,6 +2537,167 @@ void CNOVRModelTackIndexv( cnovr_model * m, int nindices, uint32_t * indices )
 	m->iIndexCount = m->iIndexCount + nindices;
 }
 
+//Forsyth's "Linear-Speed Vertex Cache Optimisation", reorders triangles in place.
+#define CNOVR_VCACHE_SIZE 32
+
+static float VCacheScore( int cachepos, int remaining )
+{
+	if( remaining <= 0 ) return -1;
+	float score = 0;
+	if( cachepos >= 0 )
+	{
+		//The last triangle's verts are all used up, don't favor them too much or we'll get strips.
+		if( cachepos < 3 ) score = 0.75f;
+		else score = powf( 1.0f - ( cachepos - 3 ) / (float)( CNOVR_VCACHE_SIZE - 3 ), 1.5f );
+	}
+	//Prefer to finish off vertices with few triangles left.
+	return score + 2.0f / sqrtf( remaining );
+}
+
+void CNOVROptimizeVertexCache( uint32_t * indices, int nindices )
+{
+	int ntris = nindices / 3;
+	int i, k;
+	if( ntris < 2 ) return;
+
+	uint32_t vmin = indices[0], vmax = indices[0];
+	for( i = 1; i < ntris*3; i++ )
+	{
+		if( indices[i] < vmin ) vmin = indices[i];
+		if( indices[i] > vmax ) vmax = indices[i];
+	}
+	int nverts = vmax - vmin + 1;
+
+	uint32_t * tris = malloc( ntris * 3 * sizeof( uint32_t ) );
+	int * remaining = calloc( nverts, sizeof( int ) );
+	int * adjstart = malloc( ( nverts + 1 ) * sizeof( int ) );
+	int * adj = malloc( ntris * 3 * sizeof( int ) );
+	int * cachepos = malloc( nverts * sizeof( int ) );
+	float * vscore = malloc( nverts * sizeof( float ) );
+	float * tscore = malloc( ntris * sizeof( float ) );
+	uint8_t * added = calloc( ntris, 1 );
+	int cache[CNOVR_VCACHE_SIZE+3];
+	int newcache[CNOVR_VCACHE_SIZE+3];
+	int ncache = 0;
+
+	for( i = 0; i < ntris*3; i++ )
+	{
+		tris[i] = indices[i] - vmin;
+		remaining[tris[i]]++;
+	}
+	adjstart[0] = 0;
+	for( i = 0; i < nverts; i++ )
+	{
+		adjstart[i+1] = adjstart[i] + remaining[i];
+		cachepos[i] = -1;
+		vscore[i] = VCacheScore( -1, remaining[i] );
+		remaining[i] = 0;
+	}
+	for( i = 0; i < ntris*3; i++ )
+	{
+		int v = tris[i];
+		adj[adjstart[v] + remaining[v]++] = i / 3;
+	}
+
+	int best = 0;
+	for( i = 0; i < ntris; i++ )
+	{
+		tscore[i] = vscore[tris[i*3+0]] + vscore[tris[i*3+1]] + vscore[tris[i*3+2]];
+		if( tscore[i] > tscore[best] ) best = i;
+	}
+
+	int out = 0;
+	int cursor = 0;
+	while( best >= 0 )
+	{
+		uint32_t * t = tris + best*3;
+		added[best] = 1;
+		indices[out++] = t[0] + vmin;
+		indices[out++] = t[1] + vmin;
+		indices[out++] = t[2] + vmin;
+
+		//Take this triangle off of its vertices' lists, and put them at the front of the cache.
+		int nnew = 0;
+		for( k = 0; k < 3; k++ )
+		{
+			int v = t[k];
+			int * list = adj + adjstart[v];
+			int j;
+			for( j = 0; j < remaining[v]; j++ )
+			{
+				if( list[j] == best )
+				{
+					list[j] = list[--remaining[v]];
+					break;
+				}
+			}
+			for( j = 0; j < nnew; j++ ) if( newcache[j] == v ) break;
+			if( j == nnew ) newcache[nnew++] = v;
+		}
+		for( i = 0; i < ncache; i++ )
+		{
+			int v = cache[i];
+			if( v != t[0] && v != t[1] && v != t[2] ) newcache[nnew++] = v;
+		}
+
+		//Rescore everything that moved in, around or out of the cache.
+		best = -1;
+		float bestscore = -1;
+		for( i = 0; i < nnew; i++ )
+		{
+			int v = newcache[i];
+			cachepos[v] = ( i < CNOVR_VCACHE_SIZE ) ? i : -1;
+			vscore[v] = VCacheScore( cachepos[v], remaining[v] );
+		}
+		for( i = 0; i < nnew; i++ )
+		{
+			int v = newcache[i];
+			int * list = adj + adjstart[v];
+			int j;
+			for( j = 0; j < remaining[v]; j++ )
+			{
+				int tri = list[j];
+				uint32_t * tt = tris + tri*3;
+				float s = tscore[tri] = vscore[tt[0]] + vscore[tt[1]] + vscore[tt[2]];
+				if( s > bestscore ) { best = tri; bestscore = s; }
+			}
+		}
+		ncache = ( nnew < CNOVR_VCACHE_SIZE ) ? nnew : CNOVR_VCACHE_SIZE;
+		memcpy( cache, newcache, ncache * sizeof( int ) );
+
+		//Nothing in the cache is connected to anything left, start somewhere new.
+		if( best < 0 )
+		{
+			while( cursor < ntris && added[cursor] ) cursor++;
+			if( cursor < ntris ) best = cursor;
+		}
+	}
+
+	free( tris );
+	free( remaining );
+	free( adjstart );
+	free( adj );
+	free( cachepos );
+	free( vscore );
+	free( tscore );
+	free( added );
+}
+
+void CNOVRModelOptimizeVertexCache( cnovr_model * m )
+{
+	int i;
+	if( m->nRenderType != GL_TRIANGLES ) return;
+	//Triangles can't move between meshes, or the marks would be wrong.
+	for( i = 0; i < m->nMeshes; i++ )
+	{
+		int meshStart = m->iMeshMarks[i];
+		int meshEnd = (i == m->nMeshes-1 ) ? m->iIndexCount : m->iMeshMarks[i+1];
+		if( meshEnd > meshStart )
+			CNOVROptimizeVertexCache( m->pIndices + meshStart, meshEnd - meshStart );
+	}
+	CNOVRModelTaintIndices( m );
+}
+
 void CNOVRModelClearMeshes( cnovr_model * m )
 {
 	OGLockMutex( m->model_mutex );
@@ -1277,9 +2747,10 @@ void CNOVRModelAppendCube( cnovr_model * m, cnovr_point3d size, cnovr_pose * pos
 	}
 
 	{
-		//float * points = m->pGeos[0]->pVertices;
-		//float * texcoord = m->pGeos[1]->pVertices;
-		//float * normals = m->pGeos[2]->pVertices;
+		float points[36*3];
+		float texcoord[36*3];
+		float normals[36*3];
+		float extras[36*4];
 
 		for( i = 0; i < 12; i++ )
 		{
@@ -1295,34 +2766,35 @@ void CNOVRModelAppendCube( cnovr_model * m, cnovr_point3d size, cnovr_pose * pos
 			int j;
 			for( j = 0; j < 3; j++ )
 			{
-				float stage[4];
-				float staget[4];
+				int v = i*3+j;
+				float * stage = points + v*3;
+				float * staget = texcoord + v*3;
+				float * stagen = normals + v*3;
 				{
 					float xyzin[3] = { (vkeys[j]&4)?1:-1, (vkeys[j]&2)?1:-1, (vkeys[j]&1)?1:-1 };
 					mult3d( xyzin, xyzin, size );
 					apply_pose_to_point( stage, pose, xyzin );
 				}
-				stage[3] = 1;
-				CNOVRVBOTackv( m->pGeos[0], 3, stage );
 
 				staget[0] = stage[tcaxis1] * 0.5 + 0.5;
 				staget[1] = stage[tcaxis2] * 0.5 + 0.5;
 				staget[2] = m->nMeshes;
 
-				CNOVRVBOTackv( m->pGeos[1], 3, staget );
-
-				stage[0] = (normaxis==0)?normplus:0;
-				stage[1] = (normaxis==1)?normplus:0;
-				stage[2] = (normaxis==2)?normplus:0;
-				stage[3] = 0;
-				CNOVRVBOTackv( m->pGeos[2], 3, stage );
+				stagen[0] = (normaxis==0)?normplus:0;
+				stagen[1] = (normaxis==1)?normplus:0;
+				stagen[2] = (normaxis==2)?normplus:0;
 
 				if( extradata )
-					CNOVRVBOTackv( m->pGeos[3], 4, *extradata );
+					memcpy( extras + v*4, *extradata, sizeof( cnovr_point4d ) );
 				else
-					CNOVRVBOTackv( m->pGeos[3], 4, (float[4]){ 0, 0, 0, 0 } );
+					memset( extras + v*4, 0, sizeof( cnovr_point4d ) );
 			}
 		}
+
+		CNOVRVBOTackN( m->pGeos[0], 36, points, 3 );
+		CNOVRVBOTackN( m->pGeos[1], 36, texcoord, 3 );
+		CNOVRVBOTackN( m->pGeos[2], 36, normals, 3 );
+		CNOVRVBOTackN( m->pGeos[3], 36, extras, 4 );
 	}
 
 	m->iLastVertMark += 36;
@@ -1373,36 +2845,49 @@ void CNOVRModelAppendMesh( cnovr_model * m, int rows, int cols, int flipv, cnovr
 	}
 
 	{
-		float stage[4];
-		float stagen[4];
-
-		stagen[0] = 0;
-		stagen[1] = 0;
-		stagen[2] = -1;
-		stagen[3] = m->nMeshes;
+		int nverts = (rows+1)*(cols+1);
+		float * points = malloc( nverts * sizeof( float ) * 3 );
+		float * texcoord = malloc( nverts * sizeof( float ) * 3 );
+		float * normals = malloc( nverts * sizeof( float ) * 3 );
+		float * extras = malloc( nverts * sizeof( float ) * 4 );
+		int v = 0;
 
 		for( y = 0; y <= rows; y++ )
 		for( x = 0; x <= cols; x++ )
 		{
+			float * stage = texcoord + v*3;
 			stage[0] = x/(float)rows;
 			stage[1] = y/(float)cols;
 			if( flipv ) stage[1] = 1.0 - stage[1];
 			stage[2] = m->nMeshes;
-			CNOVRVBOTackv( m->pGeos[1], 3, stage );	//TC
-			stage[1] = y/(float)cols;
-			stage[0] = (stage[0] - 0.5)*2.0 * size[0];
-			stage[1] = (stage[1] - 0.5)*2.0 * size[1];
+
+			stage = points + v*3;
+			stage[0] = (x/(float)rows - 0.5)*2.0 * size[0];
+			stage[1] = (y/(float)cols - 0.5)*2.0 * size[1];
 			stage[2] = size[2];
 			if( poseofs_optional )
 				apply_pose_to_point( stage, poseofs_optional, stage );
-			CNOVRVBOTackv( m->pGeos[0], 3, stage );	//Pos
-			CNOVRVBOTackv( m->pGeos[2], 3, stagen );
+
+			stage = normals + v*3;
+			stage[0] = 0;
+			stage[1] = 0;
+			stage[2] = -1;
 
 			if( extradata )
-				CNOVRVBOTackv( m->pGeos[3], 4, *extradata );
+				memcpy( extras + v*4, *extradata, sizeof( cnovr_point4d ) );
 			else
-				CNOVRVBOTackv( m->pGeos[3], 4, (float[4]){ 0, 0, 0, 0 } );
+				memset( extras + v*4, 0, sizeof( cnovr_point4d ) );
+			v++;
 		}
+
+		CNOVRVBOTackN( m->pGeos[0], nverts, points, 3 );	//Pos
+		CNOVRVBOTackN( m->pGeos[1], nverts, texcoord, 3 );	//TC
+		CNOVRVBOTackN( m->pGeos[2], nverts, normals, 3 );
+		CNOVRVBOTackN( m->pGeos[3], nverts, extras, 4 );
+		free( points );
+		free( texcoord );
+		free( normals );
+		free( extras );
 	}
 
 	m->iLastVertMark += (rows+1)*(cols+1);
@@ -1418,13 +2903,21 @@ void CNOVRModelAppendMesh( cnovr_model * m, int rows, int cols, int flipv, cnovr
 
 void CNOVRModelApplyTextureFromFileAsync( cnovr_model * m, const char * sTextureFile )
 {
+	int flags = 0;
 	if( m->iTextures == 0 )
 	{
 		if( !m->pTextures ) m->pTextures = malloc( sizeof( cnovr_texture * ) );
-		m->pTextures[0] = CNOVRTextureCreate( 1, 1, 4 );
 		m->iTextures = 1;
 	}
-	CNOVRTextureLoadFileAsync( m->pTextures[0], sTextureFile );
+	else
+	{
+		//Whatever was asked of the texture that's there carries over to the shared one.
+		cnovr_texture * old = m->pTextures[0];
+		flags = ( old->bCalculateMipMaps ? CNOVR_TEXFILE_MIPMAPS : 0 ) | ( old->bCompress ? CNOVR_TEXFILE_COMPRESS : 0 ) |
+			( old->bLinear ? CNOVR_TEXFILE_LINEAR : 0 );
+		CNOVRDelete( old );
+	}
+	m->pTextures[0] = CNOVRTextureCreateFromFile( sTextureFile, flags );
 }
 
 void CNOVRModelSetNumTextures( cnovr_model * m, int textures )
@@ -1444,298 +2937,1311 @@ void CNOVRModelSetNumTextures( cnovr_model * m, int textures )
 void CNOVRModelRenderWithPose( cnovr_model * m, cnovr_pose * pose )
 {
 	pose_to_matrix44( cnovrstate->mModel, pose );
-	glUniformMatrix4fv( CNOVRMAPPEDUNIFORMPOS( UNIFORMSLOT_MODEL ), 1, 1, cnovrstate->mModel );
+	CNOVRShaderLoadedSetModelInternal();
 	m->base.header->Render( (cnovr_base*)m );
 }
 
-int  CNOVRModelCollide( cnovr_model * m, const cnovr_point3d start, const cnovr_vec3d direction, cnovr_collide_results * r, float dradius, float minimumt )
+//Scratch for the column-major copies, so the shader can use iamModel as is instead of transposing per vertex.
+static float * CNOVRModelInstanceScratch( cnovr_model * m, int count )
+{
+	if( count > m->iInstanceMax )
+	{
+		m->pInstanceMatrices = realloc( m->pInstanceMatrices, count * 16 * sizeof( float ) );
+		m->iInstanceMax = count;
+	}
+	return m->pInstanceMatrices;
+}
+
+static void CNOVRModelInstanceTranspose( float * mats, int count )
+{
+	int i, r, c;
+	for( i = 0; i < count; i++, mats += 16 )
+	for( r = 0; r < 4; r++ )
+	for( c = r + 1; c < 4; c++ )
+	{
+		float tmp = mats[r*4+c];
+		mats[r*4+c] = mats[c*4+r];
+		mats[c*4+r] = tmp;
+	}
+}
+
+static void CNOVRModelRenderInstancedColumns( cnovr_model * m, const float * mat44s, int count )
 {
-	int ret = -1;
-	if( m->iGeos == 0 ) return -1;
-	if( m->bIsLoading ) return -1;
-	int iMeshNo = 0;
-	//Iterate through all this.
-	if( !m->pGeos[0] ) return -1;
-	float * vpos = m->pGeos[0]->pVertices;
-	int stride = m->pGeos[0]->iStride;
 	int i;
-	GLuint * indices = m->pIndices;
-//	printf( "DIRECTION: %f %f %f\n", PFTHREE( direction ) );
-	int startmesh = (m->iCollideMesh>=0)?m->iCollideMesh:0;
-	int endmesh = (m->iCollideMesh>=0)?(m->iCollideMesh+1):m->nMeshes;
-	for( i = startmesh; i < endmesh; i++ )
+	if( !CNOVRModelBindForRender( m ) ) return;
+	cnovr_model * g = CNOVRModelGeometry( m ); //Pointers live in its VAO, so the instance buffer has to be its too.
+
+	if( !g->nInstanceVBO )
 	{
-		int meshStart = m->iMeshMarks[i];
-		int meshEnd = (i == m->nMeshes-1 ) ? m->iIndexCount : m->iMeshMarks[i+1];
-	//	printf( "%d   %d  %d\n", i, meshStart, meshEnd );
-	//	printf( "%d %d\n", meshStart, meshEnd );
-		int j;
-		for( j = meshStart; j < meshEnd; j+=3 )
+		//Pointers and divisors live in the model's VAO, only the enables get flipped per draw.
+		glGenBuffers( 1, &g->nInstanceVBO );
+		glBindBuffer( GL_ARRAY_BUFFER, g->nInstanceVBO );
+		for( i = 0; i < 4; i++ )
 		{
-			int i0 = indices[j+0];
-			int i1 = indices[j+1];
-			int i2 = indices[j+2];
-			//i0..2 are the indices we will be verting.
-			float * v0 = &vpos[i0*stride];
-			float * v1 = &vpos[i1*stride];
-			float * v2 = &vpos[i2*stride];
-
-		//	if( i == 1 ) { printf( "%f %f %f  %f %f %f  %f %f %f\n", PFTHREE( v0 ), PFTHREE( v1 ), PFTHREE( v2) ); }
-
-			float v10[3];
-			float v21[3];
-			float v02[3];
-			float N[3];
-			sub3d( v10, v1, v0 );
-			sub3d( v21, v2, v1 );
-			sub3d( v02, v0, v2 );
-
-			//Current algorithm based on https://www.scratchapixel.com/lessons/3d-basic-rendering/ray-tracing-rendering-a-triangle/ray-triangle-intersection-geometric-solution
-			//XXX TODO: https://en.wikipedia.org/wiki/M%C3%B6ller%E2%80%93Trumbore_intersection_algorithm looks faster than this.
-			//XXX ALSO -> This is really cool: http://www.peroxide.dk/papers/collision/collision.pdf
-			{
-				float v01[3];
-				sub3d( v01, v0, v1 ); //!?!?!
-				cross3d( N, v21, v01 );
-			}
-			float Ax2 = magnitude3d( N );
-			scale3d( N, N, 1./Ax2 );
+			int slot = ATTRIBSLOT_INSTANCEMODEL + i;
+			glVertexAttribPointer( slot, 4, GL_FLOAT, GL_FALSE, 16 * sizeof( float ), (void*)(intptr_t)( i * 4 * sizeof( float ) ) );
+			glVertexAttribDivisor( slot, 1 );
+		}
+	}
+	else
+	{
+		glBindBuffer( GL_ARRAY_BUFFER, g->nInstanceVBO );
+	}
 
-			float D = -dot3d(N, v0);
+	//Respecify the storage every draw so we don't stall on the last draw's use of it.
+	glBufferData( GL_ARRAY_BUFFER, count * 16 * sizeof( float ), mat44s, GL_STREAM_DRAW );
 
-			//Distance from contact location to underlying geometry
-			float thissndist = (dot3d( N, start ) + D - dradius);
+	for( i = 0; i < 4; i++ )
+		glEnableVertexAttribArray( ATTRIBSLOT_INSTANCEMODEL + i );
 
-			float t = -thissndist / dot3d( N, direction ); 
+	CNOVRModelDraw( m, count );
 
-			float Phit[3];
-			scale3d( Phit, direction, t );
-			add3d( Phit, Phit, start );
-			float C0[3];
-			float C1[3];
-			float C2[3];
+	//So non-instanced shaders using these slots see the default attribs.
+	for( i = 0; i < 4; i++ )
+		glDisableVertexAttribArray( ATTRIBSLOT_INSTANCEMODEL + i );
+}
 
-			{
-				float C0tmp[3];
-				float C1tmp[3];
-				float C2tmp[3];
-				sub3d( C0tmp, Phit, v0 );
-				sub3d( C1tmp, Phit, v1 );
-				sub3d( C2tmp, Phit, v2 );
-				cross3d( C0, v10, C0tmp );
-				cross3d( C1, v21, C1tmp );
-				cross3d( C2, v02, C2tmp );
-			}
+void CNOVRModelRenderInstancedMatrices( cnovr_model * m, const float * mat44s, int count )
+{
+	if( count <= 0 ) return;
+	float * cols = CNOVRModelInstanceScratch( m, count );
+	if( cols != mat44s ) memcpy( cols, mat44s, count * 16 * sizeof( float ) );
+	CNOVRModelInstanceTranspose( cols, count );
+	CNOVRModelRenderInstancedColumns( m, cols, count );
+}
 
-			//C1-2 are busted (?) here. Their magnitude is weird.  Almost like it's squared or something?
-			float t0 = dot3d( N, C0 );
-			float t1 = dot3d( N, C1 );
-			float t2 = dot3d( N, C2 );
-	//		printf( "TRIS: %f %f %f   %f %f %f > %f/%f > %f/%f\n", t0, t1, t2, PFTHREE( N ), t, thissndist, r->t, r->sndist );
+void CNOVRModelRenderInstanced( cnovr_model * m, const cnovr_pose * poses, int count )
+{
+	if( count <= 0 ) return;
+	float * cols = CNOVRModelInstanceScratch( m, count );
+	pose_to_matrix44_n( cols, poses, count );
+	CNOVRModelInstanceTranspose( cols, count );
+	CNOVRModelRenderInstancedColumns( m, cols, count );
+}
 
-			if( t0 < -0.0001 || t1 < -.0001 || t2 < -.0001 ||
-				t0 != t0 || t1 != t1 || t2 != t2  || /* Make sure we don't have a NaN */
-				t < minimumt )
-			//if( 1 )
-			{
-				if( dradius <= 0 )
-					continue;
-
-				cnovr_point3d geonormbase;
-
-				//We did not hit the triangle, itself.
-				float pv0[3];
-				float pv1[3];
-				float pv2[3];
-				float drsq = dradius*dradius;
-				sub3d( pv0, start, v0 );
-				sub3d( pv1, start, v1 );
-				sub3d( pv2, start, v2 );
-
-				int didhit = 0;
-				t = r->t;
-
-				//Check vetices.
-				cnovr_point3d ptsolutions;
-				if( 1 ){
-					cnovr_point3d pC_C = { dot3d( pv0, pv0 )-drsq, dot3d( pv1, pv1 )-drsq, dot3d( pv2, pv2 )-drsq };
-					cnovr_point3d pC_B = { 2*dot3d( direction, pv0 ), 2*dot3d( direction, pv1 ), 2*dot3d( direction, pv2 ) };
-					float pCxA = dot3d( direction, direction );
-
-					cnovr_point3d discriminants;
-					cnovr_point3d tmp, tmp2;
-					mult3d( tmp, pC_B, pC_B ); //B^2
-					scale3d( tmp2, pC_C, -4*pCxA ); //-4AC
-					add3d( discriminants, tmp, tmp2 );
-					pCxA *= 2;
-					ptsolutions[0] = (-pC_B[0] - sqrt( discriminants[0] ))/pCxA;
-					ptsolutions[1] = (-pC_B[1] - sqrt( discriminants[1] ))/pCxA;
-					ptsolutions[2] = (-pC_B[2] - sqrt( discriminants[2] ))/pCxA;
-
-					//printf( "%f    %f %f %f    %f %f %f   %f %f %f  %f %f %f\n", pCxA, PFTHREE( pC_B ), PFTHREE( pC_C ), PFTHREE( discriminants ), PFTHREE( ptsolutions ) );
-					if( !( ptsolutions[0] != ptsolutions[0] || ptsolutions[0] > t || ptsolutions[0] < minimumt ) ) { didhit = 1; t = ptsolutions[0]; copy3d( geonormbase, v0 ); }
-					if( !( ptsolutions[1] != ptsolutions[1] || ptsolutions[1] > t || ptsolutions[1] < minimumt ) ) { didhit = 1; t = ptsolutions[1]; copy3d( geonormbase, v1 ); }
-					if( !( ptsolutions[2] != ptsolutions[2] || ptsolutions[2] > t || ptsolutions[2] < minimumt ) ) { didhit = 1; t = ptsolutions[2]; copy3d( geonormbase, v2 ); }
-				}
+///////////////////////////////////////////////////////////////////////////////
+//Collision BVH.  Binned SAH over the same triangles CNOVRModelCollide walks.  It's only a broad phase,
+//candidates still go through CNOVRModelCollideTriangle in brute-force order, so results are identical.
 
-				//Check edges.
-				cnovr_point3d edgesolutions = { 0./0., 0./0., 0./0. };
+#define CNOVR_BVH_BINS 12
+#define CNOVR_BVH_LEAF 8 //One AVX batch.
+#define CNOVR_BVH_MIN_TRIS 32 //Below this, brute force is fast enough.
+#define CNOVR_BVH_STACK 256
+#define CNOVR_BVH_LOCAL_CANDS 64 //Candidates per ray that fit on the stack before spilling to the heap.
+#define CNOVR_BVH_PACKET 16 //Rays CNOVRModelCollideMany walks together, at most 32.
+
+typedef struct cnovr_model_bvh_node_t
+{
+	float bmin[3];
+	float bmax[3];
+	uint32_t first; //First tri if a leaf, otherwise the left child.  The right child is always first+1.
+	uint32_t count; //0 for interior nodes.
+} cnovr_model_bvh_node;
+
+typedef struct cnovr_model_bvh_tri_t
+{
+	uint32_t j; //Into pIndices
+	uint32_t mesh;
+} cnovr_model_bvh_tri;
+
+typedef struct cnovr_model_bvh_t
+{
+	cnovr_model_bvh_node * nodes;
+	cnovr_model_bvh_tri * tris;
+	int nNodes;
+	int nTris;
+	int nTree;      //tris[nTree...nTris) are slivers that can't be boxed, they're tested on every query.
+	float fEpsilon; //Scaled to the model, soaks up rounding in the narrow phase.
+	float fExtent;
+	float * soa;    //See CNOVRModelBVHBuildSoA
+	int iSoAStride;
+
+	//What it was built from.
+	cnovr_vbo * geo;
+	uint32_t iGeneration;
+	uint32_t iIndexGeneration;
+	uint32_t iIndexCount;
+} cnovr_model_bvh;
+
+typedef struct cnovr_model_bvh_build_t
+{
+	cnovr_model_bvh * b;
+	float * boxes; //6 per tri, min then max.
+	float * cents; //3 per tri
+} cnovr_model_bvh_build;
+
+static void CNOVRModelBVHFree( cnovr_model_bvh * b, int later )
+{
+	if( !b ) return;
+	if( later )
+	{
+		CNOVRFreeLater( b->nodes );
+		CNOVRFreeLater( b->tris );
+		CNOVRFreeLater( b->soa );
+		CNOVRFreeLater( b );
+	}
+	else
+	{
+		free( b->nodes );
+		free( b->tris );
+		free( b->soa );
+		free( b );
+	}
+}
+
+static void CNOVRModelBVHSwap( cnovr_model_bvh_build * c, int a, int b )
+{
+	cnovr_model_bvh_tri t = c->b->tris[a]; c->b->tris[a] = c->b->tris[b]; c->b->tris[b] = t;
+	float tmp[6];
+	memcpy( tmp, c->boxes + a*6, sizeof( tmp ) );
+	memcpy( c->boxes + a*6, c->boxes + b*6, sizeof( tmp ) );
+	memcpy( c->boxes + b*6, tmp, sizeof( tmp ) );
+	memcpy( tmp, c->cents + a*3, sizeof( float ) * 3 );
+	memcpy( c->cents + a*3, c->cents + b*3, sizeof( float ) * 3 );
+	memcpy( c->cents + b*3, tmp, sizeof( float ) * 3 );
+}
+
+static float CNOVRModelBVHArea( const float * bmin, const float * bmax )
+{
+	float dx = bmax[0] - bmin[0];
+	float dy = bmax[1] - bmin[1];
+	float dz = bmax[2] - bmin[2];
+	if( dx < 0 ) return 0; //Empty
+	return dx*dy + dy*dz + dz*dx;
+}
+
+static void CNOVRModelBVHBoxEmpty( float * bmin, float * bmax )
+{
+	bmin[0] = bmin[1] = bmin[2] = 1e30;
+	bmax[0] = bmax[1] = bmax[2] = -1e30;
+}
+
+static void CNOVRModelBVHBoxGrow( float * bmin, float * bmax, const float * box )
+{
+	int k;
+	for( k = 0; k < 3; k++ )
+	{
+		if( box[k] < bmin[k] ) bmin[k] = box[k];
+		if( box[k+3] > bmax[k] ) bmax[k] = box[k+3];
+	}
+}
+
+static void CNOVRModelBVHBuildNode( cnovr_model_bvh_build * c, int nodeno, int first, int count )
+{
+	cnovr_model_bvh * b = c->b;
+	cnovr_model_bvh_node * n = &b->nodes[nodeno];
+	int i, k;
+
+	float cmin[3] = { 1e30, 1e30, 1e30 };
+	float cmax[3] = { -1e30, -1e30, -1e30 };
+	CNOVRModelBVHBoxEmpty( n->bmin, n->bmax );
+	for( i = first; i < first + count; i++ )
+	{
+		CNOVRModelBVHBoxGrow( n->bmin, n->bmax, c->boxes + i*6 );
+		for( k = 0; k < 3; k++ )
+		{
+			float cv = c->cents[i*3+k];
+			if( cv < cmin[k] ) cmin[k] = cv;
+			if( cv > cmax[k] ) cmax[k] = cv;
+		}
+	}
+
+	n->first = first;
+	n->count = count;
+	if( count <= CNOVR_BVH_LEAF ) return;
+
+	//Binned SAH, try every axis.
+	int bestaxis = -1;
+	int bestsplit = 0;
+	float bestcost = CNOVRModelBVHArea( n->bmin, n->bmax ) * count;
+	for( k = 0; k < 3; k++ )
+	{
+		float extent = cmax[k] - cmin[k];
+		if( !( extent > 0 ) ) continue;
+		float binmin[CNOVR_BVH_BINS][3];
+		float binmax[CNOVR_BVH_BINS][3];
+		int bincount[CNOVR_BVH_BINS] = { 0 };
+		float scale = CNOVR_BVH_BINS / extent;
+		for( i = 0; i < CNOVR_BVH_BINS; i++ ) CNOVRModelBVHBoxEmpty( binmin[i], binmax[i] );
+		for( i = first; i < first + count; i++ )
+		{
+			int bin = ( c->cents[i*3+k] - cmin[k] ) * scale;
+			if( bin >= CNOVR_BVH_BINS ) bin = CNOVR_BVH_BINS - 1;
+			bincount[bin]++;
+			CNOVRModelBVHBoxGrow( binmin[bin], binmax[bin], c->boxes + i*6 );
+		}
+
+		//Sweep from the right, then from the left.
+		float rightcost[CNOVR_BVH_BINS];
+		float smin[3], smax[3];
+		int scount = 0;
+		CNOVRModelBVHBoxEmpty( smin, smax );
+		for( i = CNOVR_BVH_BINS - 1; i > 0; i-- )
+		{
+			float box[6] = { binmin[i][0], binmin[i][1], binmin[i][2], binmax[i][0], binmax[i][1], binmax[i][2] };
+			if( bincount[i] ) CNOVRModelBVHBoxGrow( smin, smax, box );
+			scount += bincount[i];
+			rightcost[i] = CNOVRModelBVHArea( smin, smax ) * scount;
+		}
+		scount = 0;
+		CNOVRModelBVHBoxEmpty( smin, smax );
+		for( i = 0; i < CNOVR_BVH_BINS - 1; i++ )
+		{
+			float box[6] = { binmin[i][0], binmin[i][1], binmin[i][2], binmax[i][0], binmax[i][1], binmax[i][2] };
+			if( bincount[i] ) CNOVRModelBVHBoxGrow( smin, smax, box );
+			scount += bincount[i];
+			if( scount == 0 || scount == count ) continue;
+			float cost = CNOVRModelBVHArea( smin, smax ) * scount + rightcost[i+1];
+			if( cost < bestcost )
+			{
+				bestcost = cost;
+				bestaxis = k;
+				bestsplit = i;
+			}
+		}
+	}
+
+	int mid;
+	if( bestaxis >= 0 )
+	{
+		float scale = CNOVR_BVH_BINS / ( cmax[bestaxis] - cmin[bestaxis] );
+		int lo = first;
+		int hi = first + count - 1;
+		while( lo <= hi )
+		{
+			int bin = ( c->cents[lo*3+bestaxis] - cmin[bestaxis] ) * scale;
+			if( bin >= CNOVR_BVH_BINS ) bin = CNOVR_BVH_BINS - 1;
+			if( bin <= bestsplit )
+				lo++;
+			else
+				CNOVRModelBVHSwap( c, lo, hi-- );
+		}
+		mid = lo;
+	}
+	else if( count <= CNOVR_BVH_LEAF * 2 )
+	{
+		return; //Splitting isn't worth it.
+	}
+	else
+	{
+		//Everything's piled in one spot.  Just halve it so the depth stays bounded.
+		mid = first + count / 2;
+	}
+
+	int left = b->nNodes;
+	b->nNodes += 2;
+	n->first = left;
+	n->count = 0;
+	CNOVRModelBVHBuildNode( c, left, first, mid - first );
+	CNOVRModelBVHBuildNode( c, left + 1, mid, first + count - mid );
+}
+
+//Ray prefilter.  A SoA copy of every triangle (in leaf order) gets a Moller-Trumbore test, 4 or 8 at a time.
+//It's only used to throw triangles out: it's a different computation than CNOVRModelCollideTriangle, so
+//it rejects with a margin big enough to cover both of their rounding, and survivors go through the real test.
+//That keeps t, collidepos, collidevs, etc. bit for bit what they always were.  Rays only, not swept spheres.
+
+#define CNOVR_BVH_SOA_PLANES 11 //v0 xyz, e1 xyz, e2 xyz, eps, emax
+#define CNOVR_BVH_SOA_PAD 8     //So any leaf can be loaded 8 wide.
+#define CNOVR_BVH_FILTER_K 1e-4 //Rounding margin, relative.  Thousands of ulps.
+#define CNOVR_BVH_FILTER_ALWAYS 1e30 //eps for "can't tell, always test".  -1 for "never hits".
+
+#if !defined( __TINYC__ ) && ( defined( __x86_64__ ) || defined( _M_X64 ) || ( defined( __i386__ ) && defined( __SSE2__ ) ) )
+#define CNOVR_BVH_SIMD
+#endif
+
+typedef struct cnovr_model_bvh_ray_t
+{
+	float start[3];
+	float dir[3];
+	float dirl1;
+	float tmin;
+	float tmax;
+} cnovr_model_bvh_ray;
+
+static void CNOVRModelBVHBuildSoA( cnovr_model * m, cnovr_model_bvh * b, const float * vpos, int stride )
+{
+	int n = b->nTris + CNOVR_BVH_SOA_PAD;
+	int i, k;
+	b->iSoAStride = n;
+	b->soa = calloc( n * CNOVR_BVH_SOA_PLANES, sizeof( float ) );
+	for( i = 0; i < b->nTris; i++ )
+	{
+		GLuint * ind = m->pIndices + b->tris[i].j;
+		const float * v0 = &vpos[ind[0]*stride];
+		const float * v1 = &vpos[ind[1]*stride];
+		const float * v2 = &vpos[ind[2]*stride];
+		float emax = 0;
+		for( k = 0; k < 3; k++ )
+		{
+			b->soa[(0+k)*n+i] = v0[k];
+			b->soa[(3+k)*n+i] = v1[k] - v0[k];
+			b->soa[(6+k)*n+i] = v2[k] - v0[k];
+		}
+		float l1 = fabsf( v1[0] - v0[0] ) + fabsf( v1[1] - v0[1] ) + fabsf( v1[2] - v0[2] );
+		float l2 = fabsf( v2[0] - v0[0] ) + fabsf( v2[1] - v0[1] ) + fabsf( v2[2] - v0[2] );
+		float l3 = fabsf( v2[0] - v1[0] ) + fabsf( v2[1] - v1[1] ) + fabsf( v2[2] - v1[2] );
+		emax = ( l1 > l2 ) ? l1 : l2;
+		if( l3 > emax ) emax = l3;
+
+		//Same Ax2 the narrow phase computes.  If it's degenerate there, it never hits, so flag it with eps < 0.
+		float v21[3], v01[3], N[3];
+		sub3d( v21, v2, v1 );
+		sub3d( v01, v0, v1 );
+		cross3d( N, v21, v01 );
+		float Ax2 = magnitude3d( N );
+		float eps = 0.0001 / Ax2 * 1.001;
+		if( !( Ax2 > 0 ) || !( eps < 1e30 ) || !( emax < 1e30 ) ) eps = -1;
+		if( i >= b->nTree ) eps = CNOVR_BVH_FILTER_ALWAYS; //Only for completeness, these never see the filter.
+		b->soa[9*n+i] = eps;
+		b->soa[10*n+i] = emax;
+	}
+}
+
+//count must be <= 32.  In det-scaled units: hit iff U, V and det-U-V are all >= -eps*|det|, and minimumt <= T/det < r->t.
+static uint32_t CNOVRModelBVHFilterScalar( const cnovr_model_bvh * b, int first, int count, const cnovr_model_bvh_ray * ray )
+{
+	int n = b->iSoAStride;
+	const float * s = b->soa;
+	const float * d = ray->dir;
+	uint32_t mask = 0;
+	int i;
+	for( i = 0; i < count; i++ )
+	{
+		int o = first + i;
+		float eps = s[9*n+o];
+		if( eps < 0 ) continue;
+		if( eps >= CNOVR_BVH_FILTER_ALWAYS ) { mask |= 1u<<i; continue; }
+		float v0x = s[0*n+o], v0y = s[1*n+o], v0z = s[2*n+o];
+		float e1x = s[3*n+o], e1y = s[4*n+o], e1z = s[5*n+o];
+		float e2x = s[6*n+o], e2y = s[7*n+o], e2z = s[8*n+o];
+		float emax = s[10*n+o];
+		float px = d[1]*e2z - d[2]*e2y;
+		float py = d[2]*e2x - d[0]*e2z;
+		float pz = d[0]*e2y - d[1]*e2x;
+		float det = e1x*px + e1y*py + e1z*pz;
+		float tx = ray->start[0] - v0x, ty = ray->start[1] - v0y, tz = ray->start[2] - v0z;
+		float U = tx*px + ty*py + tz*pz;
+		float qx = ty*e1z - tz*e1y;
+		float qy = tz*e1x - tx*e1z;
+		float qz = tx*e1y - ty*e1x;
+		float V = d[0]*qx + d[1]*qy + d[2]*qz;
+		float T = e2x*qx + e2y*qy + e2z*qz;
+		if( det < 0 ) { U = -U; V = -V; T = -T; det = -det; }
+		float D = fabsf( tx ) + fabsf( ty ) + fabsf( tz ) + fabsf( v0x ) + fabsf( v0y ) + fabsf( v0z );
+		float M = eps * det + CNOVR_BVH_FILTER_K * ( D * emax * ray->dirl1 + det );
+		float W = det - U - V;
+		float Mt = CNOVR_BVH_FILTER_K * ( D * emax * emax + fabsf( T ) );
+		//Tricky: Written so NaNs fall through and get the real test.
+		if( U < -M || V < -M || W < -M ) continue;
+		if( T < ray->tmin * det - Mt || T > ray->tmax * det + Mt ) continue;
+		mask |= 1u<<i;
+	}
+	return mask;
+}
+
+#ifdef CNOVR_BVH_SIMD
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static uint32_t CNOVRModelBVHFilterSSE( const cnovr_model_bvh * b, int first, int count, const cnovr_model_bvh_ray * ray )
+{
+	int n = b->iSoAStride;
+	const float * s = b->soa;
+	__m128 dx = _mm_set1_ps( ray->dir[0] ), dy = _mm_set1_ps( ray->dir[1] ), dz = _mm_set1_ps( ray->dir[2] );
+	__m128 sx = _mm_set1_ps( ray->start[0] ), sy = _mm_set1_ps( ray->start[1] ), sz = _mm_set1_ps( ray->start[2] );
+	__m128 k = _mm_set1_ps( CNOVR_BVH_FILTER_K );
+	__m128 kdirl1 = _mm_set1_ps( CNOVR_BVH_FILTER_K * ray->dirl1 );
+	__m128 tmin = _mm_set1_ps( ray->tmin ), tmax = _mm_set1_ps( ray->tmax );
+	__m128 zero = _mm_setzero_ps();
+	__m128 absmask = _mm_castsi128_ps( _mm_set1_epi32( 0x7fffffff ) );
+	__m128 signmask = _mm_castsi128_ps( _mm_set1_epi32( 0x80000000 ) );
+	uint32_t mask = 0;
+	int i;
+	for( i = 0; i < count; i += 4 )
+	{
+		int o = first + i;
+		__m128 v0x = _mm_loadu_ps( s+0*n+o ), v0y = _mm_loadu_ps( s+1*n+o ), v0z = _mm_loadu_ps( s+2*n+o );
+		__m128 e1x = _mm_loadu_ps( s+3*n+o ), e1y = _mm_loadu_ps( s+4*n+o ), e1z = _mm_loadu_ps( s+5*n+o );
+		__m128 e2x = _mm_loadu_ps( s+6*n+o ), e2y = _mm_loadu_ps( s+7*n+o ), e2z = _mm_loadu_ps( s+8*n+o );
+		__m128 eps = _mm_loadu_ps( s+9*n+o ), emax = _mm_loadu_ps( s+10*n+o );
+		__m128 px = _mm_sub_ps( _mm_mul_ps( dy, e2z ), _mm_mul_ps( dz, e2y ) );
+		__m128 py = _mm_sub_ps( _mm_mul_ps( dz, e2x ), _mm_mul_ps( dx, e2z ) );
+		__m128 pz = _mm_sub_ps( _mm_mul_ps( dx, e2y ), _mm_mul_ps( dy, e2x ) );
+		__m128 det = _mm_add_ps( _mm_add_ps( _mm_mul_ps( e1x, px ), _mm_mul_ps( e1y, py ) ), _mm_mul_ps( e1z, pz ) );
+		__m128 tx = _mm_sub_ps( sx, v0x ), ty = _mm_sub_ps( sy, v0y ), tz = _mm_sub_ps( sz, v0z );
+		__m128 U = _mm_add_ps( _mm_add_ps( _mm_mul_ps( tx, px ), _mm_mul_ps( ty, py ) ), _mm_mul_ps( tz, pz ) );
+		__m128 qx = _mm_sub_ps( _mm_mul_ps( ty, e1z ), _mm_mul_ps( tz, e1y ) );
+		__m128 qy = _mm_sub_ps( _mm_mul_ps( tz, e1x ), _mm_mul_ps( tx, e1z ) );
+		__m128 qz = _mm_sub_ps( _mm_mul_ps( tx, e1y ), _mm_mul_ps( ty, e1x ) );
+		__m128 V = _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, qx ), _mm_mul_ps( dy, qy ) ), _mm_mul_ps( dz, qz ) );
+		__m128 T = _mm_add_ps( _mm_add_ps( _mm_mul_ps( e2x, qx ), _mm_mul_ps( e2y, qy ) ), _mm_mul_ps( e2z, qz ) );
+		__m128 sgn = _mm_and_ps( det, signmask );
+		U = _mm_xor_ps( U, sgn ); V = _mm_xor_ps( V, sgn ); T = _mm_xor_ps( T, sgn ); det = _mm_and_ps( det, absmask );
+		__m128 D = _mm_add_ps( _mm_add_ps( _mm_and_ps( tx, absmask ), _mm_and_ps( ty, absmask ) ), _mm_and_ps( tz, absmask ) );
+		D = _mm_add_ps( D, _mm_add_ps( _mm_add_ps( _mm_and_ps( v0x, absmask ), _mm_and_ps( v0y, absmask ) ), _mm_and_ps( v0z, absmask ) ) );
+		__m128 M = _mm_add_ps( _mm_mul_ps( eps, det ), _mm_add_ps( _mm_mul_ps( kdirl1, _mm_mul_ps( D, emax ) ), _mm_mul_ps( k, det ) ) );
+		__m128 nM = _mm_sub_ps( zero, M );
+		__m128 W = _mm_sub_ps( _mm_sub_ps( det, U ), V );
+		__m128 Mt = _mm_mul_ps( k, _mm_add_ps( _mm_mul_ps( D, _mm_mul_ps( emax, emax ) ), _mm_and_ps( T, absmask ) ) );
+		__m128 reject = _mm_cmplt_ps( eps, zero );
+		__m128 always = _mm_cmpge_ps( eps, _mm_set1_ps( CNOVR_BVH_FILTER_ALWAYS ) );
+		reject = _mm_or_ps( reject, _mm_cmplt_ps( U, nM ) );
+		reject = _mm_or_ps( reject, _mm_cmplt_ps( V, nM ) );
+		reject = _mm_or_ps( reject, _mm_cmplt_ps( W, nM ) );
+		reject = _mm_or_ps( reject, _mm_cmplt_ps( T, _mm_sub_ps( _mm_mul_ps( tmin, det ), Mt ) ) );
+		reject = _mm_or_ps( reject, _mm_cmpgt_ps( T, _mm_add_ps( _mm_mul_ps( tmax, det ), Mt ) ) );
+		reject = _mm_andnot_ps( always, reject );
+		mask |= (uint32_t)( ~_mm_movemask_ps( reject ) & 0xf ) << i;
+	}
+	return mask & ( ( 1ull << count ) - 1 );
+}
+
+#if defined( __GNUC__ ) || defined( __clang__ )
+__attribute__((target("avx")))
+#endif
+static uint32_t CNOVRModelBVHFilterAVX( const cnovr_model_bvh * b, int first, int count, const cnovr_model_bvh_ray * ray )
+{
+	int n = b->iSoAStride;
+	const float * s = b->soa;
+	__m256 dx = _mm256_set1_ps( ray->dir[0] ), dy = _mm256_set1_ps( ray->dir[1] ), dz = _mm256_set1_ps( ray->dir[2] );
+	__m256 sx = _mm256_set1_ps( ray->start[0] ), sy = _mm256_set1_ps( ray->start[1] ), sz = _mm256_set1_ps( ray->start[2] );
+	__m256 k = _mm256_set1_ps( CNOVR_BVH_FILTER_K );
+	__m256 kdirl1 = _mm256_set1_ps( CNOVR_BVH_FILTER_K * ray->dirl1 );
+	__m256 tmin = _mm256_set1_ps( ray->tmin ), tmax = _mm256_set1_ps( ray->tmax );
+	__m256 zero = _mm256_setzero_ps();
+	__m256 absmask = _mm256_castsi256_ps( _mm256_set1_epi32( 0x7fffffff ) );
+	__m256 signmask = _mm256_castsi256_ps( _mm256_set1_epi32( 0x80000000 ) );
+	uint32_t mask = 0;
+	int i;
+	for( i = 0; i < count; i += 8 )
+	{
+		int o = first + i;
+		__m256 v0x = _mm256_loadu_ps( s+0*n+o ), v0y = _mm256_loadu_ps( s+1*n+o ), v0z = _mm256_loadu_ps( s+2*n+o );
+		__m256 e1x = _mm256_loadu_ps( s+3*n+o ), e1y = _mm256_loadu_ps( s+4*n+o ), e1z = _mm256_loadu_ps( s+5*n+o );
+		__m256 e2x = _mm256_loadu_ps( s+6*n+o ), e2y = _mm256_loadu_ps( s+7*n+o ), e2z = _mm256_loadu_ps( s+8*n+o );
+		__m256 eps = _mm256_loadu_ps( s+9*n+o ), emax = _mm256_loadu_ps( s+10*n+o );
+		__m256 px = _mm256_sub_ps( _mm256_mul_ps( dy, e2z ), _mm256_mul_ps( dz, e2y ) );
+		__m256 py = _mm256_sub_ps( _mm256_mul_ps( dz, e2x ), _mm256_mul_ps( dx, e2z ) );
+		__m256 pz = _mm256_sub_ps( _mm256_mul_ps( dx, e2y ), _mm256_mul_ps( dy, e2x ) );
+		__m256 det = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( e1x, px ), _mm256_mul_ps( e1y, py ) ), _mm256_mul_ps( e1z, pz ) );
+		__m256 tx = _mm256_sub_ps( sx, v0x ), ty = _mm256_sub_ps( sy, v0y ), tz = _mm256_sub_ps( sz, v0z );
+		__m256 U = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( tx, px ), _mm256_mul_ps( ty, py ) ), _mm256_mul_ps( tz, pz ) );
+		__m256 qx = _mm256_sub_ps( _mm256_mul_ps( ty, e1z ), _mm256_mul_ps( tz, e1y ) );
+		__m256 qy = _mm256_sub_ps( _mm256_mul_ps( tz, e1x ), _mm256_mul_ps( tx, e1z ) );
+		__m256 qz = _mm256_sub_ps( _mm256_mul_ps( tx, e1y ), _mm256_mul_ps( ty, e1x ) );
+		__m256 V = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( dx, qx ), _mm256_mul_ps( dy, qy ) ), _mm256_mul_ps( dz, qz ) );
+		__m256 T = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( e2x, qx ), _mm256_mul_ps( e2y, qy ) ), _mm256_mul_ps( e2z, qz ) );
+		__m256 sgn = _mm256_and_ps( det, signmask );
+		U = _mm256_xor_ps( U, sgn ); V = _mm256_xor_ps( V, sgn ); T = _mm256_xor_ps( T, sgn ); det = _mm256_and_ps( det, absmask );
+		__m256 D = _mm256_add_ps( _mm256_add_ps( _mm256_and_ps( tx, absmask ), _mm256_and_ps( ty, absmask ) ), _mm256_and_ps( tz, absmask ) );
+		D = _mm256_add_ps( D, _mm256_add_ps( _mm256_add_ps( _mm256_and_ps( v0x, absmask ), _mm256_and_ps( v0y, absmask ) ), _mm256_and_ps( v0z, absmask ) ) );
+		__m256 M = _mm256_add_ps( _mm256_mul_ps( eps, det ), _mm256_add_ps( _mm256_mul_ps( kdirl1, _mm256_mul_ps( D, emax ) ), _mm256_mul_ps( k, det ) ) );
+		__m256 nM = _mm256_sub_ps( zero, M );
+		__m256 W = _mm256_sub_ps( _mm256_sub_ps( det, U ), V );
+		__m256 Mt = _mm256_mul_ps( k, _mm256_add_ps( _mm256_mul_ps( D, _mm256_mul_ps( emax, emax ) ), _mm256_and_ps( T, absmask ) ) );
+		__m256 reject = _mm256_cmp_ps( eps, zero, _CMP_LT_OQ );
+		__m256 always = _mm256_cmp_ps( eps, _mm256_set1_ps( CNOVR_BVH_FILTER_ALWAYS ), _CMP_GE_OQ );
+		reject = _mm256_or_ps( reject, _mm256_cmp_ps( U, nM, _CMP_LT_OQ ) );
+		reject = _mm256_or_ps( reject, _mm256_cmp_ps( V, nM, _CMP_LT_OQ ) );
+		reject = _mm256_or_ps( reject, _mm256_cmp_ps( W, nM, _CMP_LT_OQ ) );
+		reject = _mm256_or_ps( reject, _mm256_cmp_ps( T, _mm256_sub_ps( _mm256_mul_ps( tmin, det ), Mt ), _CMP_LT_OQ ) );
+		reject = _mm256_or_ps( reject, _mm256_cmp_ps( T, _mm256_add_ps( _mm256_mul_ps( tmax, det ), Mt ), _CMP_GT_OQ ) );
+		reject = _mm256_andnot_ps( always, reject );
+		mask |= (uint32_t)( ~_mm256_movemask_ps( reject ) & 0xff ) << i;
+	}
+	return mask & ( ( 1ull << count ) - 1 );
+}
+
+static int CNOVRCPUHasAVX()
+{
+#if defined( __GNUC__ ) || defined( __clang__ )
+	__builtin_cpu_init();
+	return __builtin_cpu_supports( "avx" );
+#elif defined( _MSC_VER )
+	int info[4];
+	__cpuid( info, 1 );
+	//AVX, and the OS saves the YMM registers.
+	if( ( info[2] & ( 1<<28 ) ) == 0 || ( info[2] & ( 1<<27 ) ) == 0 ) return 0;
+	return ( _xgetbv( 0 ) & 6 ) == 6;
+#else
+	return 0;
+#endif
+}
+#endif
+
+typedef uint32_t (*cnovr_model_bvh_filter_fn)( const cnovr_model_bvh * b, int first, int count, const cnovr_model_bvh_ray * ray );
+static cnovr_model_bvh_filter_fn CNOVRModelBVHFilter;
+
+static void CNOVRModelBVHSelectFilter()
+{
+#ifdef CNOVR_BVH_SIMD
+	CNOVRModelBVHFilter = CNOVRCPUHasAVX() ? CNOVRModelBVHFilterAVX : CNOVRModelBVHFilterSSE;
+#else
+	CNOVRModelBVHFilter = CNOVRModelBVHFilterScalar;
+#endif
+}
+
+//Tricky: On a sliver, the normal CNOVRModelCollideTriangle computes is mostly rounding error, and with the edge
+//slop it will accept hits along a strip that follows the edge line forever.  There's no box for that.
+static int CNOVRModelBVHIsSliver( const float * v0, const float * v1, const float * v2, float Ax2 )
+{
+	float e[3], emax2 = 0;
+	int k;
+	sub3d( e, v1, v0 ); if( dot3d( e, e ) > emax2 ) emax2 = dot3d( e, e );
+	sub3d( e, v2, v1 ); if( dot3d( e, e ) > emax2 ) emax2 = dot3d( e, e );
+	sub3d( e, v0, v2 ); if( dot3d( e, e ) > emax2 ) emax2 = dot3d( e, e );
+	return Ax2 > 0 && Ax2 < emax2 * 0.01;
+}
+
+//Must hold model_mutex.  Returns 0 if there's nothing worth building.
+static cnovr_model_bvh * CNOVRModelBVHBuild( cnovr_model * m )
+{
+	if( m->iGeos == 0 || !m->pGeos[0] || m->nRenderType != GL_TRIANGLES ) return 0;
+	cnovr_vbo * geo = m->pGeos[0];
+	GLuint * indices = m->pIndices;
+	int i, j, k;
+	int ntris = 0;
+
+	//Same walk as CNOVRModelCollide.
+	for( i = 0; i < m->nMeshes; i++ )
+	{
+		int meshStart = m->iMeshMarks[i];
+		int meshEnd = (i == m->nMeshes-1 ) ? m->iIndexCount : m->iMeshMarks[i+1];
+		for( j = meshStart; j < meshEnd && j + 2 < m->iIndexCount; j+=3 ) ntris++;
+	}
+	if( ntris == 0 ) return 0;
+
+	//Tricky: model_mutex doesn't cover the vertices, Tack/Reserve can realloc them under mutData at any time.
+	//So build from a copy.  The generation goes with the copy, so an edit after this just means a rebuild.
+	OGLockMutex( geo->mutData );
+	int stride = geo->iStride;
+	uint32_t nverts = geo->iVertexCount;
+	uint32_t generation = geo->iGeneration;
+	float * vpos = malloc( sizeof( float ) * stride * nverts + 1 );
+	memcpy( vpos, geo->pVertices, sizeof( float ) * stride * nverts );
+	OGUnlockMutex( geo->mutData );
+
+	//Indices can run ahead of the vertices while something is mid-edit.  Try again once it settles.
+	for( i = 0; i < m->iIndexCount; i++ )
+	{
+		if( indices[i] >= nverts )
+		{
+			free( vpos );
+			return 0;
+		}
+	}
+
+	cnovr_model_bvh * b = calloc( 1, sizeof( cnovr_model_bvh ) );
+	b->tris = malloc( sizeof( cnovr_model_bvh_tri ) * ntris );
+	b->nodes = malloc( sizeof( cnovr_model_bvh_node ) * ( ntris * 2 ) );
+	b->nTris = ntris;
+	b->geo = geo;
+	b->iGeneration = generation;
+	b->iIndexGeneration = m->iIndexGeneration;
+	b->iIndexCount = m->iIndexCount;
+
+	cnovr_model_bvh_build c;
+	c.b = b;
+	c.boxes = malloc( sizeof( float ) * 6 * ntris );
+	c.cents = malloc( sizeof( float ) * 3 * ntris );
+	uint8_t * loose = malloc( ntris );
+
+	float extent = 0;
+	int t = 0;
+	for( i = 0; i < m->nMeshes; i++ )
+	{
+		int meshStart = m->iMeshMarks[i];
+		int meshEnd = (i == m->nMeshes-1 ) ? m->iIndexCount : m->iMeshMarks[i+1];
+		for( j = meshStart; j < meshEnd && j + 2 < m->iIndexCount; j+=3 )
+		{
+			const float * v[3] = { &vpos[indices[j+0]*stride], &vpos[indices[j+1]*stride], &vpos[indices[j+2]*stride] };
+			float * box = c.boxes + t*6;
+			b->tris[t].j = j;
+			b->tris[t].mesh = i;
+
+			//Tricky: The narrow phase lets hits land up to 0.0001 outside each edge, in units of twice the
+			//triangle's area.  That puts the worst case corners at V_a + e*(2V_a - V_b - V_c), e = 0.0001/Ax2.
+			float v21[3], v01[3], N[3];
+			sub3d( v21, v[2], v[1] );
+			sub3d( v01, v[0], v[1] );
+			cross3d( N, v21, v01 );
+			float Ax2 = magnitude3d( N );
+			float e = ( Ax2 > 0 ) ? ( 0.0001 / Ax2 ) * 1.01 : 0;
+			if( !( e < 1e6 ) ) e = 1e6;
+			loose[t] = CNOVRModelBVHIsSliver( v[0], v[1], v[2], Ax2 );
+
+			box[0] = box[1] = box[2] = 1e30;
+			box[3] = box[4] = box[5] = -1e30;
+			int a;
+			for( a = 0; a < 3; a++ )
+			{
+				const float * va = v[a];
+				const float * vb = v[(a+1)%3];
+				const float * vc = v[(a+2)%3];
+				for( k = 0; k < 3; k++ )
 				{
-					//In http://www.peroxide.dk/papers/collision/collision.pdf
-					//"edge" refers to v10, v21, v02
-					//"baseToVertex" refers to -pv_<<<<<
-					//"velocity" refers to direction
-					cnovr_point3d tmp1, tmp2;
-					float tmp;
-					cnovr_point3d edgesquared;
-					cnovr_point3d A,B,C;
-					edgesquared[0] = dot3d( v10, v10 );
-					edgesquared[1] = dot3d( v21, v21 );
-					edgesquared[2] = dot3d( v02, v02 );
-					tmp = -dot3d( direction, direction );
-					scale3d( tmp1, edgesquared, tmp );
-					tmp2[0] = dot3d( v10, direction );
-					tmp2[1] = dot3d( v21, direction );
-					tmp2[2] = dot3d( v02, direction );
-					mult3d( tmp2, tmp2, tmp2 ); //Dot squared  ?!?!?!?!
-					add3d( A, tmp1, tmp2 );
-
-					tmp1[0] = -2*dot3d( direction, pv0 )*edgesquared[0];
-					tmp1[1] = -2*dot3d( direction, pv1 )*edgesquared[1];
-					tmp1[2] = -2*dot3d( direction, pv2 )*edgesquared[2];
-					tmp2[0] =  2*dot3d(v10,direction)*dot3d(v10,pv0);
-					tmp2[1] =  2*dot3d(v21,direction)*dot3d(v21,pv1);
-					tmp2[2] =  2*dot3d(v02,direction)*dot3d(v02,pv2);
-					add3d( B, tmp1, tmp2 );
-
-					tmp1[0] = edgesquared[0]*(drsq-dot3d(pv0, pv0));
-					tmp1[1] = edgesquared[1]*(drsq-dot3d(pv1, pv1));
-					tmp1[2] = edgesquared[2]*(drsq-dot3d(pv2, pv2));
-					tmp2[0] = -dot3d(v10,pv0);
-					tmp2[1] = -dot3d(v21,pv1);
-					tmp2[2] = -dot3d(v02,pv2);
-					mult3d( tmp2, tmp2, tmp2 );
-					add3d( C, tmp1, tmp2 );
-
-					//b^2-4ac
-					cnovr_point3d x1;
-					x1[0] = (-B[0] + sqrt( B[0]*B[0] - 4 * A[0] * C[0] )) / ( 2 * A[0] );
-					x1[1] = (-B[1] + sqrt( B[1]*B[1] - 4 * A[1] * C[1] )) / ( 2 * A[1] );
-					x1[2] = (-B[2] + sqrt( B[2]*B[2] - 4 * A[2] * C[2] )) / ( 2 * A[2] );
-
-					cnovr_point3d f0;
-					f0[0] = ( dot3d( v10, direction ) * x1[0] + dot3d( v10, pv0 ) ) / edgesquared[0];
-					f0[1] = ( dot3d( v21, direction ) * x1[1] + dot3d( v21, pv1 ) ) / edgesquared[1];
-					f0[2] = ( dot3d( v02, direction ) * x1[2] + dot3d( v02, pv2 ) ) / edgesquared[2];
-
-					if( f0[0] >= 0 && f0[0] <= 1 ) edgesolutions[0] = x1[0];
-					if( f0[1] >= 0 && f0[1] <= 1 ) edgesolutions[1] = x1[1];
-					if( f0[2] >= 0 && f0[2] <= 1 ) edgesolutions[2] = x1[2];
-					//printf( "%f %f %f   %f %f %f   %f %f %f     %f %f %f   %f %f %f   %f %f %f  %d %d %f\n", PFTHREE( A ), PFTHREE( B ), PFTHREE( C ), PFTHREE( x1 ), PFTHREE( f0 ), PFTHREE( edgesolutions ), edgesolutions[1] != edgesolutions[1], edgesolutions[1] > t, t  );
-					if( !( edgesolutions[0] != edgesolutions[0] || edgesolutions[0] > t || edgesolutions[0] < minimumt ) ) { didhit = 1; t = edgesolutions[0]; scale3d( geonormbase, v10, f0[0] ); add3d (geonormbase, geonormbase, v0 ); }
-					if( !( edgesolutions[1] != edgesolutions[1] || edgesolutions[1] > t || edgesolutions[1] < minimumt ) ) { didhit = 1; t = edgesolutions[1]; scale3d( geonormbase, v21, f0[1] ); add3d (geonormbase, geonormbase, v1 ); }
-					if( !( edgesolutions[2] != edgesolutions[2] || edgesolutions[2] > t || edgesolutions[2] < minimumt ) ) { didhit = 1; t = edgesolutions[2]; scale3d( geonormbase, v02, f0[2] ); add3d (geonormbase, geonormbase, v2 ); }
+					float corner = va[k] + e * ( 2*va[k] - vb[k] - vc[k] );
+					float lo = ( va[k] < corner ) ? va[k] : corner;
+					float hi = ( va[k] > corner ) ? va[k] : corner;
+					if( lo < box[k] ) box[k] = lo;
+					if( hi > box[k+3] ) box[k+3] = hi;
+					float mag = fabsf( va[k] );
+					if( mag > extent ) extent = mag;
 				}
-				if( !didhit ) continue;
-				//cnovr_point3d hitpos;
-				scale3d( Phit, direction, t );
-				add3d( Phit, Phit, start );
-				sub3d( r->geonorm, Phit, geonormbase );
-				r->sndist = magnitude3d( r->geonorm ) - dradius; //checks out OK
-				normalize3d( r->geonorm, r->geonorm );
-				//Now that we've calculated the norm, we can compute what the nominal penetration would be.
-
-				if( t < 0 )
+			}
+			for( k = 0; k < 3; k++ )
+				c.cents[t*3+k] = ( box[k] + box[k+3] ) * 0.5;
+			t++;
+		}
+	}
+	b->fEpsilon = ( extent + 1 ) * 1e-5;
+	b->fExtent = extent;
+
+	//Slivers go to the end, outside of the tree.
+	b->nTree = ntris;
+	for( t = 0; t < b->nTree; )
+	{
+		if( loose[t] )
+		{
+			b->nTree--;
+			CNOVRModelBVHSwap( &c, t, b->nTree );
+			loose[t] = loose[b->nTree];
+		}
+		else
+			t++;
+	}
+	free( loose );
+
+	b->nNodes = 1;
+	CNOVRModelBVHBuildNode( &c, 0, 0, b->nTree );
+	CNOVRModelBVHBuildSoA( m, b, vpos, stride );
+	if( !CNOVRModelBVHFilter ) CNOVRModelBVHSelectFilter();
+
+	free( c.boxes );
+	free( c.cents );
+	free( vpos );
+	return b;
+}
+
+static int CNOVRModelBVHCurrent( cnovr_model * m, cnovr_model_bvh * b )
+{
+	return b && m->iGeos && b->geo == m->pGeos[0] && b->iGeneration == b->geo->iGeneration &&
+		b->iIndexGeneration == m->iIndexGeneration && b->iIndexCount == m->iIndexCount;
+}
+
+static void CNOVRModelBVHPublish( void * vm, void * dump )
+{
+	cnovr_model * m = (cnovr_model*)vm;
+	OGLockMutex( m->model_mutex );
+	CNOVRModelBVHFree( m->pBVH, 1 );
+	m->pBVH = m->pBVHPending;
+	m->pBVHPending = 0;
+	m->bBVHBuilding = 0;
+	OGUnlockMutex( m->model_mutex );
+}
+
+static void CNOVRModelBVHBuildJob( void * vm, void * dump )
+{
+	cnovr_model * m = (cnovr_model*)vm;
+	OGLockMutex( m->model_mutex );
+	CNOVRModelBVHFree( m->pBVHPending, 0 );
+	m->pBVHPending = CNOVRModelBVHBuild( m );
+	OGUnlockMutex( m->model_mutex );
+	//Swapped in on the main thread, so nobody's in the middle of a query with the old one.
+	CNOVRJobTack( cnovrQPrerender, CNOVRModelBVHPublish, m, 0, 0 );
+}
+
+void CNOVRModelBuildBVH( cnovr_model * m )
+{
+	m = CNOVRModelGeometry( m );
+	OGLockMutex( m->model_mutex );
+	cnovr_model_bvh * b = CNOVRModelBVHBuild( m );
+	CNOVRModelBVHFree( m->pBVH, 1 );
+	m->pBVH = b;
+	OGUnlockMutex( m->model_mutex );
+}
+
+//Clips [*t0,*t1] to where start + direction*t is inside n's box, inflated by expand.  Returns 0 if that's empty.
+static int CNOVRModelBVHClip( const cnovr_model_bvh_node * n, const float * start, const float * direction, float expand, float * t0, float * t1 )
+{
+	int k;
+	for( k = 0; k < 3; k++ )
+	{
+		float lo = n->bmin[k] - expand;
+		float hi = n->bmax[k] + expand;
+		if( direction[k] == 0 )
+		{
+			if( start[k] < lo || start[k] > hi ) return 0;
+			continue;
+		}
+		float ta = ( lo - start[k] ) / direction[k];
+		float tb = ( hi - start[k] ) / direction[k];
+		if( ta > tb ) { float tmp = ta; ta = tb; tb = tmp; }
+		if( ta > *t0 ) *t0 = ta;
+		if( tb < *t1 ) *t1 = tb;
+		if( *t0 > *t1 ) return 0;
+	}
+	return 1;
+}
+
+static int CNOVRModelCollideTriangle( cnovr_model * m, int i, int j, const float * start, const float * direction, cnovr_collide_results * r, float dradius, float minimumt );
+
+//One ray's state while a packet of them walks the tree.  Every triangle the walk exact-tests is tested into
+//scratch and recorded in cands, which is then replayed on the real results in brute-force order.
+typedef struct cnovr_model_bvh_walker_t
+{
+	cnovr_collide_ray * ray;
+	cnovr_collide_results scratch;
+	cnovr_model_bvh_ray filter;
+	cnovr_model_bvh_ray * pfilter; //Only for plain rays, the prefilter doesn't know about dradius.
+	float expand;
+	cnovr_model_bvh_tri * cands;
+	int ncands;
+	int candmax;
+	cnovr_model_bvh_tri localcands[CNOVR_BVH_LOCAL_CANDS];
+} cnovr_model_bvh_walker;
+
+static void CNOVRModelBVHWalkerInit( cnovr_model_bvh * b, cnovr_model_bvh_walker * w, cnovr_collide_ray * ray )
+{
+	const float * start = ray->start;
+	float startmag = fabsf( start[0] ) + fabsf( start[1] ) + fabsf( start[2] );
+	w->ray = ray;
+	w->scratch = ray->res;
+	w->cands = w->localcands;
+	w->ncands = 0;
+	w->candmax = CNOVR_BVH_LOCAL_CANDS;
+	w->expand = fabsf( ray->dradius ) * 1.001 + b->fEpsilon + startmag * 1e-5;
+	//Tricky: The sweep's quadratics lose half their precision to cancellation, so its hits can land
+	//about sqrt(ulp) * distance away from where they should.
+	if( ray->dradius != 0 ) w->expand += ( startmag + b->fExtent ) * 1e-3;
+	w->pfilter = 0;
+	if( ray->dradius == 0 )
+	{
+		copy3d( w->filter.start, start );
+		copy3d( w->filter.dir, ray->direction );
+		w->filter.dirl1 = fabsf( ray->direction[0] ) + fabsf( ray->direction[1] ) + fabsf( ray->direction[2] );
+		w->filter.tmin = ray->minimumt;
+		w->pfilter = &w->filter;
+	}
+}
+
+static void CNOVRModelBVHWalkerTest( cnovr_model * m, cnovr_model_bvh_walker * w, const cnovr_model_bvh_tri * tri )
+{
+	if( w->ncands == w->candmax )
+	{
+		int newmax = w->candmax * 2;
+		cnovr_model_bvh_tri * nc = malloc( sizeof( cnovr_model_bvh_tri ) * newmax );
+		memcpy( nc, w->cands, sizeof( cnovr_model_bvh_tri ) * w->ncands );
+		if( w->cands != w->localcands ) free( w->cands );
+		w->cands = nc;
+		w->candmax = newmax;
+	}
+	w->cands[w->ncands++] = *tri;
+	cnovr_collide_ray * ray = w->ray;
+	CNOVRModelCollideTriangle( m, tri->mesh, tri->j, ray->start, ray->direction, &w->scratch, ray->dradius, ray->minimumt );
+}
+
+//Walks the tree once for all n (<= CNOVR_BVH_PACKET) rays.  Each node is clipped against every ray still
+//live at it, out to that ray's closest hit so far, and children go front to back for the first live ray.
+//Returns 0 if the tree is too deep for the stack.
+static int CNOVRModelBVHWalk( cnovr_model * m, cnovr_model_bvh * b, cnovr_model_bvh_walker * w, int n, int startmesh, int endmesh )
+{
+	uint32_t stack[CNOVR_BVH_STACK];
+	uint32_t stackmask[CNOVR_BVH_STACK];
+	int sp = 0;
+	int i, k;
+
+	//Slivers aren't in the tree, everyone tests them.
+	for( k = 0; k < n; k++ )
+	for( i = b->nTree; i < b->nTris; i++ )
+	{
+		cnovr_model_bvh_tri * tri = &b->tris[i];
+		if( tri->mesh < startmesh || tri->mesh >= endmesh ) continue;
+		CNOVRModelBVHWalkerTest( m, &w[k], tri );
+	}
+
+	stack[sp] = 0;
+	stackmask[sp++] = ( n == 32 ) ? 0xffffffff : ( ( 1u<<n ) - 1 );
+	while( sp )
+	{
+		sp--;
+		cnovr_model_bvh_node * nd = &b->nodes[stack[sp]];
+		uint32_t mask = stackmask[sp];
+		uint32_t live = 0;
+		int first = -1;
+
+		//Tricky: Clipped on pop, not push, so rays that found something closer in the meantime drop out.
+		for( k = 0; mask; k++, mask >>= 1 )
+		{
+			if( !( mask & 1 ) ) continue;
+			cnovr_model_bvh_walker * wk = &w[k];
+			float t0 = wk->ray->minimumt;
+			float t1 = wk->scratch.t;
+			if( !CNOVRModelBVHClip( nd, wk->ray->start, wk->ray->direction, wk->expand, &t0, &t1 ) ) continue;
+			live |= 1u<<k;
+			if( first < 0 ) first = k;
+		}
+		if( !live ) continue;
+
+		if( nd->count )
+		{
+			for( k = 0; live; k++, live >>= 1 )
+			{
+				if( !( live & 1 ) ) continue;
+				cnovr_model_bvh_walker * wk = &w[k];
+				uint32_t keep = 0xffffffff;
+				if( wk->pfilter )
 				{
-					//XXX This is rough.  I'm not sure how to solve it, but it is possible to
-					//overshoot the edge of a cylinder/sphere and get a value higher than the maximum penetration.
-					//This can happen at extreme glancing angles.  Right now, we do not use triangle information to fix this.
-					//Perhaps we should.  
-					cnovr_point3d zerohit;
-					sub3d( zerohit, start, geonormbase );
-					r->sndist = magnitude3d( zerohit ) - dradius;
-					//float outsndist = (dot3d( N, Phit ) + D - dradius); //Use triangle information to fix.
-					//if( r->sndist > outsndist ) r->sndist = outsndist; 
-					if( r->sndist > 0 ) r->sndist = 0;
-					//printf( "K %f %f (%f)\n", r->sndist, t, magnitude3d( zerohit ) );
+					wk->filter.tmax = wk->scratch.t;
+					keep = CNOVRModelBVHFilter( b, nd->first, nd->count, wk->pfilter );
 				}
-				else
+				for( i = 0; i < nd->count; i++ )
 				{
-				//	printf( "L %f\n", r->sndist );
+					if( !( keep & ( 1u<<i ) ) ) continue;
+					cnovr_model_bvh_tri * tri = &b->tris[nd->first+i];
+					if( tri->mesh < startmesh || tri->mesh >= endmesh ) continue;
+					CNOVRModelBVHWalkerTest( m, wk, tri );
 				}
-				//printf( "B %f %f\n", t, r->sndist );
 			}
-			else
-			{
-				//continue;
-				//We got a proper triangle hit.
-				if( t < r->t && t >= minimumt)
-				{
-					float outsndist = (t<0)?thissndist:(dot3d( N, Phit ) + D - dradius);
+			continue;
+		}
 
-					//printf( "A %f", outsndist );
-					r->sndist = outsndist;
-					copy3d( r->geonorm, N );
-					//if( r->sndist < 0 ) printf( "T: %f\n", r->sndist );
-				}
+		if( sp + 2 > CNOVR_BVH_STACK ) return 0;
+		//Near child goes on top, as the first live ray sees it.
+		cnovr_model_bvh_walker * wf = &w[first];
+		float ta0 = wf->ray->minimumt, ta1 = wf->scratch.t;
+		float tc0 = wf->ray->minimumt, tc1 = wf->scratch.t;
+		if( !CNOVRModelBVHClip( &b->nodes[nd->first], wf->ray->start, wf->ray->direction, wf->expand, &ta0, &ta1 ) ) ta0 = 1e30;
+		if( !CNOVRModelBVHClip( &b->nodes[nd->first+1], wf->ray->start, wf->ray->direction, wf->expand, &tc0, &tc1 ) ) tc0 = 1e30;
+		stack[sp] = ( ta0 < tc0 ) ? nd->first + 1 : nd->first;
+		stackmask[sp++] = live;
+		stack[sp] = ( ta0 < tc0 ) ? nd->first : nd->first + 1;
+		stackmask[sp++] = live;
+	}
+	return 1;
+}
+
+static int CNOVRModelBVHTriCompare( const void * va, const void * vb )
+{
+	const cnovr_model_bvh_tri * a = (const cnovr_model_bvh_tri *)va;
+	const cnovr_model_bvh_tri * b = (const cnovr_model_bvh_tri *)vb;
+	if( a->mesh != b->mesh ) return ( a->mesh < b->mesh ) ? -1 : 1;
+	if( a->j != b->j ) return ( a->j < b->j ) ? -1 : 1;
+	return 0;
+}
+
+//Tricky: A triangle's effect on the results only depends on the t they have going in.  The walk tested every
+//triangle that could hit at or before the final t, so replaying just those in brute-force order (ties and all)
+//comes out the same as brute force.  If none of them changed anything, brute force wouldn't have either.
+static void CNOVRModelBVHWalkerFinish( cnovr_model * m, cnovr_model_bvh_walker * w )
+{
+	cnovr_collide_ray * ray = w->ray;
+	int i;
+	ray->ret = -1;
+	if( memcmp( &w->scratch, &ray->res, sizeof( w->scratch ) ) != 0 )
+	{
+		if( w->ncands > 1 ) qsort( w->cands, w->ncands, sizeof( cnovr_model_bvh_tri ), CNOVRModelBVHTriCompare );
+		for( i = 0; i < w->ncands; i++ )
+		{
+			cnovr_model_bvh_tri * c = &w->cands[i];
+			if( CNOVRModelCollideTriangle( m, c->mesh, c->j, ray->start, ray->direction, &ray->res, ray->dradius, ray->minimumt ) )
+				ray->ret = c->mesh;
+		}
+	}
+	if( w->cands != w->localcands ) free( w->cands );
+}
+
+//The narrow phase, for one triangle, starting at index j of mesh i.  Returns 1 if r was updated with a closer hit.
+static int CNOVRModelCollideTriangle( cnovr_model * m, int i, int j, const float * start, const float * direction, cnovr_collide_results * r, float dradius, float minimumt )
+{
+	float * vpos = m->pGeos[0]->pVertices;
+	int stride = m->pGeos[0]->iStride;
+	GLuint * indices = m->pIndices;
+
+	int i0 = indices[j+0];
+	int i1 = indices[j+1];
+	int i2 = indices[j+2];
+	//i0..2 are the indices we will be verting.
+	float * v0 = &vpos[i0*stride];
+	float * v1 = &vpos[i1*stride];
+	float * v2 = &vpos[i2*stride];
+
+//	if( i == 1 ) { printf( "%f %f %f  %f %f %f  %f %f %f\n", PFTHREE( v0 ), PFTHREE( v1 ), PFTHREE( v2) ); }
+
+	float v10[3];
+	float v21[3];
+	float v02[3];
+	float N[3];
+	sub3d( v10, v1, v0 );
+	sub3d( v21, v2, v1 );
+	sub3d( v02, v0, v2 );
+
+	//Current algorithm based on https://www.scratchapixel.com/lessons/3d-basic-rendering/ray-tracing-rendering-a-triangle/ray-triangle-intersection-geometric-solution
+	//Moller-Trumbore only runs as the BVH prefilter (see CNOVRModelBVHFilter), this stays the exact test since
+	//dradius, sndist and the edge slop are all defined in terms of it.
+	//XXX ALSO -> This is really cool: http://www.peroxide.dk/papers/collision/collision.pdf
+	{
+		float v01[3];
+		sub3d( v01, v0, v1 ); //!?!?!
+		cross3d( N, v21, v01 );
+	}
+	float Ax2 = magnitude3d( N );
+	scale3d( N, N, 1./Ax2 );
+
+	float D = -dot3d(N, v0);
+
+	//Distance from contact location to underlying geometry
+	float thissndist = (dot3d( N, start ) + D - dradius);
+
+	float t = -thissndist / dot3d( N, direction ); 
+
+	float Phit[3];
+	scale3d( Phit, direction, t );
+	add3d( Phit, Phit, start );
+	float C0[3];
+	float C1[3];
+	float C2[3];
+
+	{
+		float C0tmp[3];
+		float C1tmp[3];
+		float C2tmp[3];
+		sub3d( C0tmp, Phit, v0 );
+		sub3d( C1tmp, Phit, v1 );
+		sub3d( C2tmp, Phit, v2 );
+		cross3d( C0, v10, C0tmp );
+		cross3d( C1, v21, C1tmp );
+		cross3d( C2, v02, C2tmp );
+	}
+
+	//C1-2 are busted (?) here. Their magnitude is weird.  Almost like it's squared or something?
+	float t0 = dot3d( N, C0 );
+	float t1 = dot3d( N, C1 );
+	float t2 = dot3d( N, C2 );
+	//		printf( "TRIS: %f %f %f   %f %f %f > %f/%f > %f/%f\n", t0, t1, t2, PFTHREE( N ), t, thissndist, r->t, r->sndist );
+
+	if( t0 < -0.0001 || t1 < -.0001 || t2 < -.0001 ||
+		t0 != t0 || t1 != t1 || t2 != t2  || /* Make sure we don't have a NaN */
+		t < minimumt )
+	//if( 1 )
+	{
+		if( dradius <= 0 )
+			return 0;
+
+		cnovr_point3d geonormbase;
+
+		//We did not hit the triangle, itself.
+		float pv0[3];
+		float pv1[3];
+		float pv2[3];
+		float drsq = dradius*dradius;
+		sub3d( pv0, start, v0 );
+		sub3d( pv1, start, v1 );
+		sub3d( pv2, start, v2 );
+
+		int didhit = 0;
+		t = r->t;
+
+		//Check vetices.
+		cnovr_point3d ptsolutions;
+		if( 1 ){
+			cnovr_point3d pC_C = { dot3d( pv0, pv0 )-drsq, dot3d( pv1, pv1 )-drsq, dot3d( pv2, pv2 )-drsq };
+			cnovr_point3d pC_B = { 2*dot3d( direction, pv0 ), 2*dot3d( direction, pv1 ), 2*dot3d( direction, pv2 ) };
+			float pCxA = dot3d( direction, direction );
+
+			cnovr_point3d discriminants;
+			cnovr_point3d tmp, tmp2;
+			mult3d( tmp, pC_B, pC_B ); //B^2
+			scale3d( tmp2, pC_C, -4*pCxA ); //-4AC
+			add3d( discriminants, tmp, tmp2 );
+			pCxA *= 2;
+			ptsolutions[0] = (-pC_B[0] - sqrt( discriminants[0] ))/pCxA;
+			ptsolutions[1] = (-pC_B[1] - sqrt( discriminants[1] ))/pCxA;
+			ptsolutions[2] = (-pC_B[2] - sqrt( discriminants[2] ))/pCxA;
+
+			//printf( "%f    %f %f %f    %f %f %f   %f %f %f  %f %f %f\n", pCxA, PFTHREE( pC_B ), PFTHREE( pC_C ), PFTHREE( discriminants ), PFTHREE( ptsolutions ) );
+			if( !( ptsolutions[0] != ptsolutions[0] || ptsolutions[0] > t || ptsolutions[0] < minimumt ) ) { didhit = 1; t = ptsolutions[0]; copy3d( geonormbase, v0 ); }
+			if( !( ptsolutions[1] != ptsolutions[1] || ptsolutions[1] > t || ptsolutions[1] < minimumt ) ) { didhit = 1; t = ptsolutions[1]; copy3d( geonormbase, v1 ); }
+			if( !( ptsolutions[2] != ptsolutions[2] || ptsolutions[2] > t || ptsolutions[2] < minimumt ) ) { didhit = 1; t = ptsolutions[2]; copy3d( geonormbase, v2 ); }
+		}
+
+		//Check edges.
+		cnovr_point3d edgesolutions = { 0./0., 0./0., 0./0. };
+		{
+			//In http://www.peroxide.dk/papers/collision/collision.pdf
+			//"edge" refers to v10, v21, v02
+			//"baseToVertex" refers to -pv_<<<<<
+			//"velocity" refers to direction
+			cnovr_point3d tmp1, tmp2;
+			float tmp;
+			cnovr_point3d edgesquared;
+			cnovr_point3d A,B,C;
+			edgesquared[0] = dot3d( v10, v10 );
+			edgesquared[1] = dot3d( v21, v21 );
+			edgesquared[2] = dot3d( v02, v02 );
+			tmp = -dot3d( direction, direction );
+			scale3d( tmp1, edgesquared, tmp );
+			tmp2[0] = dot3d( v10, direction );
+			tmp2[1] = dot3d( v21, direction );
+			tmp2[2] = dot3d( v02, direction );
+			mult3d( tmp2, tmp2, tmp2 ); //Dot squared  ?!?!?!?!
+			add3d( A, tmp1, tmp2 );
+
+			tmp1[0] = -2*dot3d( direction, pv0 )*edgesquared[0];
+			tmp1[1] = -2*dot3d( direction, pv1 )*edgesquared[1];
+			tmp1[2] = -2*dot3d( direction, pv2 )*edgesquared[2];
+			tmp2[0] =  2*dot3d(v10,direction)*dot3d(v10,pv0);
+			tmp2[1] =  2*dot3d(v21,direction)*dot3d(v21,pv1);
+			tmp2[2] =  2*dot3d(v02,direction)*dot3d(v02,pv2);
+			add3d( B, tmp1, tmp2 );
+
+			tmp1[0] = edgesquared[0]*(drsq-dot3d(pv0, pv0));
+			tmp1[1] = edgesquared[1]*(drsq-dot3d(pv1, pv1));
+			tmp1[2] = edgesquared[2]*(drsq-dot3d(pv2, pv2));
+			tmp2[0] = -dot3d(v10,pv0);
+			tmp2[1] = -dot3d(v21,pv1);
+			tmp2[2] = -dot3d(v02,pv2);
+			mult3d( tmp2, tmp2, tmp2 );
+			add3d( C, tmp1, tmp2 );
+
+			//b^2-4ac
+			cnovr_point3d x1;
+			x1[0] = (-B[0] + sqrt( B[0]*B[0] - 4 * A[0] * C[0] )) / ( 2 * A[0] );
+			x1[1] = (-B[1] + sqrt( B[1]*B[1] - 4 * A[1] * C[1] )) / ( 2 * A[1] );
+			x1[2] = (-B[2] + sqrt( B[2]*B[2] - 4 * A[2] * C[2] )) / ( 2 * A[2] );
+
+			cnovr_point3d f0;
+			f0[0] = ( dot3d( v10, direction ) * x1[0] + dot3d( v10, pv0 ) ) / edgesquared[0];
+			f0[1] = ( dot3d( v21, direction ) * x1[1] + dot3d( v21, pv1 ) ) / edgesquared[1];
+			f0[2] = ( dot3d( v02, direction ) * x1[2] + dot3d( v02, pv2 ) ) / edgesquared[2];
+
+			if( f0[0] >= 0 && f0[0] <= 1 ) edgesolutions[0] = x1[0];
+			if( f0[1] >= 0 && f0[1] <= 1 ) edgesolutions[1] = x1[1];
+			if( f0[2] >= 0 && f0[2] <= 1 ) edgesolutions[2] = x1[2];
+			//printf( "%f %f %f   %f %f %f   %f %f %f     %f %f %f   %f %f %f   %f %f %f  %d %d %f\n", PFTHREE( A ), PFTHREE( B ), PFTHREE( C ), PFTHREE( x1 ), PFTHREE( f0 ), PFTHREE( edgesolutions ), edgesolutions[1] != edgesolutions[1], edgesolutions[1] > t, t  );
+			if( !( edgesolutions[0] != edgesolutions[0] || edgesolutions[0] > t || edgesolutions[0] < minimumt ) ) { didhit = 1; t = edgesolutions[0]; scale3d( geonormbase, v10, f0[0] ); add3d (geonormbase, geonormbase, v0 ); }
+			if( !( edgesolutions[1] != edgesolutions[1] || edgesolutions[1] > t || edgesolutions[1] < minimumt ) ) { didhit = 1; t = edgesolutions[1]; scale3d( geonormbase, v21, f0[1] ); add3d (geonormbase, geonormbase, v1 ); }
+			if( !( edgesolutions[2] != edgesolutions[2] || edgesolutions[2] > t || edgesolutions[2] < minimumt ) ) { didhit = 1; t = edgesolutions[2]; scale3d( geonormbase, v02, f0[2] ); add3d (geonormbase, geonormbase, v2 ); }
+		}
+		if( !didhit ) return 0;
+		//cnovr_point3d hitpos;
+		scale3d( Phit, direction, t );
+		add3d( Phit, Phit, start );
+		sub3d( r->geonorm, Phit, geonormbase );
+		r->sndist = magnitude3d( r->geonorm ) - dradius; //checks out OK
+		normalize3d( r->geonorm, r->geonorm );
+		//Now that we've calculated the norm, we can compute what the nominal penetration would be.
+
+		if( t < 0 )
+		{
+			//XXX This is rough.  I'm not sure how to solve it, but it is possible to
+			//overshoot the edge of a cylinder/sphere and get a value higher than the maximum penetration.
+			//This can happen at extreme glancing angles.  Right now, we do not use triangle information to fix this.
+			//Perhaps we should.  
+			cnovr_point3d zerohit;
+			sub3d( zerohit, start, geonormbase );
+			r->sndist = magnitude3d( zerohit ) - dradius;
+			//float outsndist = (dot3d( N, Phit ) + D - dradius); //Use triangle information to fix.
+			//if( r->sndist > outsndist ) r->sndist = outsndist; 
+			if( r->sndist > 0 ) r->sndist = 0;
+			//printf( "K %f %f (%f)\n", r->sndist, t, magnitude3d( zerohit ) );
+		}
+		else
+		{
+		//	printf( "L %f\n", r->sndist );
+		}
+		//printf( "B %f %f\n", t, r->sndist );
+	}
+	else
+	{
+		//return 0;
+		//We got a proper triangle hit.
+		if( t < r->t && t >= minimumt)
+		{
+			float outsndist = (t<0)?thissndist:(dot3d( N, Phit ) + D - dradius);
+
+			//printf( "A %f", outsndist );
+			r->sndist = outsndist;
+			copy3d( r->geonorm, N );
+			//if( r->sndist < 0 ) printf( "T: %f\n", r->sndist );
+		}
+	}
+
+	//Else: We have a hit.  This doesn't happen for all that many polys, so time isn't as critical here.
+	//The following code is triggered for triangles or points,
+	if( t < r->t && t >= minimumt )
+	{
+		r->t = t;
+		r->whichmesh = i;
+		r->whichvert = j;
+		copy3d( r->collidepos, Phit );
+
+		if( m->iGeos > 1 )
+		{
+			t0/=Ax2;
+			t1/=Ax2;
+			t2/=Ax2;
+
+			//{ t0, t1, t2 } are the barycentric coordinates. 
+			int stride1 = m->pGeos[1]->iStride;
+			float * vd1 = m->pGeos[1]->pVertices;
+			float * tx0 = vd1 + i0 * stride1;
+			float * tx1 = vd1 + i1 * stride1;
+			float * tx2 = vd1 + i2 * stride1;
+			float * txo = r->collidevs;
+			int j;
+			for( j = 0; j < stride1; j++ )
+			{
+				txo[j] = tx0[j] * t1 + tx1[j] * t2 + tx2[j] * t0;
+			}
+			for( ; j < sizeof(r->collidevs) / sizeof(r->collidevs[0]); j++ )
+			{
+				txo[j] = 0;
 			}
 
-			//Else: We have a hit.  This doesn't happen for all that many polys, so time isn't as critical here.
-			//The following code is triggered for triangles or points,
-			if( t < r->t && t >= minimumt )
+			//Also get normal?
+			stride1 = m->pGeos[2]->iStride;
+			vd1 = m->pGeos[2]->pVertices;
+			tx0 = vd1 + i0 * stride1;
+			tx1 = vd1 + i1 * stride1;
+			tx2 = vd1 + i2 * stride1;
+			txo = r->collidens;
+			for( j = 0; j < stride1; j++ )
+			{
+				txo[j] = tx0[j] * t1 + tx1[j] * t2 + tx2[j] * t0;
+			}
+			//printf( "%f %f %f %d  %f %f %f\n", PFTHREE( tx0 ), stride1, PFTHREE( txo ) );
+			for( ; j < sizeof(r->collidens) / sizeof(r->collidens[0]); j++ )
 			{
-				r->t = t;
-				r->whichmesh = i;
-				r->whichvert = j;
-				copy3d( r->collidepos, Phit );
+				txo[j] = 0;
+			}
+//					printf( "CONTACT : %f\n", t );
+			//printf( "%f * (%f %f %f)  %f * (%f %f %f)  %f * (%f %f %f)\n", t1, PFTHREE( tx0 ), t2, PFTHREE( tx1 ), t0, PFTHREE( tx2 ) );
+		}
+		return 1;
+	}
+	return 0;
+}
 
-				if( m->iGeos > 1 )
-				{
-					t0/=Ax2;
-					t1/=Ax2;
-					t2/=Ax2;
-
-					//{ t0, t1, t2 } are the barycentric coordinates. 
-					int stride1 = m->pGeos[1]->iStride;
-					float * vd1 = m->pGeos[1]->pVertices;
-					float * tx0 = vd1 + i0 * stride1;
-					float * tx1 = vd1 + i1 * stride1;
-					float * tx2 = vd1 + i2 * stride1;
-					float * txo = r->collidevs;
-					int j;
-					for( j = 0; j < stride1; j++ )
-					{
-						txo[j] = tx0[j] * t1 + tx1[j] * t2 + tx2[j] * t0;
-					}
-					for( ; j < sizeof(r->collidevs) / sizeof(r->collidevs[0]); j++ )
-					{
-						txo[j] = 0;
-					}
+static int CNOVRModelCollideBrute( cnovr_model * m, const float * start, const float * direction, cnovr_collide_results * r, float dradius, float minimumt, int startmesh, int endmesh )
+{
+	int ret = -1;
+	int i;
+	for( i = startmesh; i < endmesh; i++ )
+	{
+		int meshStart = m->iMeshMarks[i];
+		int meshEnd = (i == m->nMeshes-1 ) ? m->iIndexCount : m->iMeshMarks[i+1];
+	//	printf( "%d   %d  %d\n", i, meshStart, meshEnd );
+		int j;
+		for( j = meshStart; j < meshEnd; j+=3 )
+		{
+			if( CNOVRModelCollideTriangle( m, i, j, start, direction, r, dradius, minimumt ) )
+				ret = i;
+		}
+	}
+	return ret;
+}
+
+//Returns the BVH if it's good for the model as it is now, otherwise kicks off a (re)build and returns 0.
+static cnovr_model_bvh * CNOVRModelBVHGet( cnovr_model * m )
+{
+	cnovr_model_bvh * bvh = m->pBVH;
+	if( CNOVRModelBVHCurrent( m, bvh ) ) return bvh;
+	//Brute force until the (re)build lands.  Dynamic geometry changes every frame, a BVH would never catch up,
+	//so those stay brute force unless someone asks with CNOVRModelBuildBVH.
+	if( !m->bBVHBuilding && m->nRenderType == GL_TRIANGLES && m->iIndexCount >= CNOVR_BVH_MIN_TRIS * 3 &&
+		!m->pGeos[0]->bDynamic )
+	{
+		m->bBVHBuilding = 1;
+		CNOVRJobTack( cnovrQAsync, CNOVRModelBVHBuildJob, m, 0, 0 );
+	}
+	return 0;
+}
+
+static void CNOVRModelBVHCollidePacket( cnovr_model * m, cnovr_model_bvh * bvh, cnovr_model_bvh_walker * w, int n, int startmesh, int endmesh )
+{
+	int k;
+	if( CNOVRModelBVHWalk( m, bvh, w, n, startmesh, endmesh ) )
+	{
+		for( k = 0; k < n; k++ )
+			CNOVRModelBVHWalkerFinish( m, &w[k] );
+		return;
+	}
+	//Too deep, do it the slow way.
+	for( k = 0; k < n; k++ )
+	{
+		cnovr_collide_ray * ray = w[k].ray;
+		if( w[k].cands != w[k].localcands ) free( w[k].cands );
+		ray->ret = CNOVRModelCollideBrute( m, ray->start, ray->direction, &ray->res, ray->dradius, ray->minimumt, startmesh, endmesh );
+	}
+}
+
+int  CNOVRModelCollide( cnovr_model * m, const cnovr_point3d start, const cnovr_vec3d direction, cnovr_collide_results * r, float dradius, float minimumt )
+{
+	int collidemesh = m->iCollideMesh;
+	m = CNOVRModelGeometry( m );
+	if( m->iGeos == 0 ) return -1;
+	if( m->bIsLoading ) return -1;
+	//Iterate through all this.
+	if( !m->pGeos[0] ) return -1;
+//	printf( "DIRECTION: %f %f %f\n", PFTHREE( direction ) );
+	int startmesh = (collidemesh>=0)?collidemesh:0;
+	int endmesh = (collidemesh>=0)?(collidemesh+1):m->nMeshes;
+
+	cnovr_model_bvh * bvh = CNOVRModelBVHGet( m );
+
+	//Tricky: !( r->t >= minimumt ) also sends NaNs down the brute force path, so they behave exactly as before.
+	if( bvh && r->t >= minimumt )
+	{
+		cnovr_collide_ray ray;
+		cnovr_model_bvh_walker w;
+		copy3d( ray.start, start );
+		copy3d( ray.direction, direction );
+		ray.dradius = dradius;
+		ray.minimumt = minimumt;
+		ray.res = *r;
+		CNOVRModelBVHWalkerInit( bvh, &w, &ray );
+		CNOVRModelBVHCollidePacket( m, bvh, &w, 1, startmesh, endmesh );
+		*r = ray.res;
+		return ray.ret;
+	}
 
-					//Also get normal?
-					stride1 = m->pGeos[2]->iStride;
-					vd1 = m->pGeos[2]->pVertices;
-					tx0 = vd1 + i0 * stride1;
-					tx1 = vd1 + i1 * stride1;
-					tx2 = vd1 + i2 * stride1;
-					txo = r->collidens;
-					for( j = 0; j < stride1; j++ )
-					{
-						txo[j] = tx0[j] * t1 + tx1[j] * t2 + tx2[j] * t0;
-					}
-					//printf( "%f %f %f %d  %f %f %f\n", PFTHREE( tx0 ), stride1, PFTHREE( txo ) );
-					for( ; j < sizeof(r->collidens) / sizeof(r->collidens[0]); j++ )
-					{
-						txo[j] = 0;
-					}
-//					printf( "CONTACT : %f\n", t );
-					//printf( "%f * (%f %f %f)  %f * (%f %f %f)  %f * (%f %f %f)\n", t1, PFTHREE( tx0 ), t2, PFTHREE( tx1 ), t0, PFTHREE( tx2 ) );
-				}
-				ret = i;
-			}
+	return CNOVRModelCollideBrute( m, start, direction, r, dradius, minimumt, startmesh, endmesh );
+}
+
+int CNOVRModelCollideMany( cnovr_model * m, cnovr_collide_ray * rays, int nrays )
+{
+	cnovr_model_bvh_walker w[CNOVR_BVH_PACKET];
+	int n = 0;
+	int hits = 0;
+	int i;
+	for( i = 0; i < nrays; i++ ) rays[i].ret = -1;
+	int collidemesh = m->iCollideMesh;
+	m = CNOVRModelGeometry( m );
+	if( m->iGeos == 0 || m->bIsLoading || !m->pGeos[0] ) return 0;
+	int startmesh = (collidemesh>=0)?collidemesh:0;
+	int endmesh = (collidemesh>=0)?(collidemesh+1):m->nMeshes;
+
+	cnovr_model_bvh * bvh = CNOVRModelBVHGet( m );
+	for( i = 0; i < nrays; i++ )
+	{
+		cnovr_collide_ray * ray = &rays[i];
+		if( bvh && ray->res.t >= ray->minimumt )
+			CNOVRModelBVHWalkerInit( bvh, &w[n++], ray );
+		else
+			ray->ret = CNOVRModelCollideBrute( m, ray->start, ray->direction, &ray->res, ray->dradius, ray->minimumt, startmesh, endmesh );
+		if( n == CNOVR_BVH_PACKET || ( n && i == nrays - 1 ) )
+		{
+			CNOVRModelBVHCollidePacket( m, bvh, w, n, startmesh, endmesh );
+			n = 0;
 		}
 	}
-	return ret;
+	for( i = 0; i < nrays; i++ )
+		if( rays[i].ret >= 0 ) hits++;
+	return hits;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1747,17 +4253,32 @@ int  CNOVRModelCollide( cnovr_model * m, const cnovr_point3d start, const cnovr_
 /// OBJ File Loader (From Spreadgine)
 ///
 
-#define TBUFFERSIZE 256
-#define VBUFFERSIZE 524288
-
 struct TempObject
 {
-	int     CVertCount;
+	//All stretchy buffers, 3, 4 and 3 floats per element.
 	float * CVerts;
-	int     CNormalCount;
+	float * CTexs;
 	float * CNormals;
+	int     CVertCount;
 	int     CTexCount;
-	float * CTexs;
+	int     CNormalCount;
+};
+
+//Output of the loader, staged so it can go into the VBOs in one shot.
+struct TempOutput
+{
+	float * pos;
+	float * tc;
+	float * norm;
+	uint32_t * indices;
+	int nverts;
+	int nObjNo;
+	int barytc;
+
+	//Open addressing, v/vt/vn/extra -> output vertex, so corners that are the same vertex share it.
+	int * dedupekeys;
+	int * dedupevals;
+	int dedupesize;
 };
 
 void CNOVRModelLoadFromFileAsyncCallback( void * vm, void * dump );
@@ -1776,11 +4297,428 @@ CNRBTREETEMPLATE( int64_t, rbset_null_t, RBptrcmp, RBptrcpy, RBnullop );
 typedef cnrbtree_cnovr_point3dint linevertexpair;
 typedef cnrbtree_int64_trbset_null_t indexpairset;
 
+static const char * ObjSkipSpace( const char * p, const char * e )
+{
+	while( p < e && ( *p == ' ' || *p == '\t' || *p == '\r' ) ) p++;
+	return p;
+}
+
+//Hand rolled so we don't need a null terminator, don't care about locale and don't go through sscanf.
+//Returns 0 if there wasn't a number there.
+static int ObjParseFloat( const char ** pp, const char * e, float * out )
+{
+	static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	const char * p = ObjSkipSpace( *pp, e );
+	int neg = 0;
+	uint64_t mant = 0;
+	int exp = 0;
+	int digits = 0;
+
+	if( p < e && ( *p == '-' || *p == '+' ) ) neg = ( *p++ == '-' );
+	for( ; p < e && *p >= '0' && *p <= '9'; p++, digits++ )
+	{
+		if( mant < 100000000000000000ULL ) mant = mant * 10 + ( *p - '0' );
+		else exp++;
+	}
+	if( p < e && *p == '.' )
+	{
+		for( p++; p < e && *p >= '0' && *p <= '9'; p++, digits++ )
+		{
+			if( mant < 100000000000000000ULL ) { mant = mant * 10 + ( *p - '0' ); exp--; }
+		}
+	}
+	if( !digits ) return 0;
+
+	if( p < e && ( *p == 'e' || *p == 'E' ) )
+	{
+		const char * q = p + 1;
+		int eneg = 0, ev = 0;
+		if( q < e && ( *q == '-' || *q == '+' ) ) eneg = ( *q++ == '-' );
+		if( q < e && *q >= '0' && *q <= '9' )
+		{
+			for( ; q < e && *q >= '0' && *q <= '9'; q++ )
+				if( ev < 10000 ) ev = ev * 10 + ( *q - '0' );
+			exp += eneg ? -ev : ev;
+			p = q;
+		}
+	}
+
+	double v = (double)mant;
+	while( exp > 22 ) { v *= 1e22; exp -= 22; }
+	while( exp < -22 ) { v /= 1e22; exp += 22; }
+	if( exp > 0 ) v *= pow10[exp];
+	else if( exp < 0 ) v /= pow10[-exp];
+
+	*out = neg ? -v : v;
+	*pp = p;
+	return 1;
+}
+
+//OBJ indices are 1-based, or negative to count back from the most recent element.
+//Leaves *out at -1 if missing or 0.
+static void ObjParseIndex( const char ** pp, const char * e, int count, int * out )
+{
+	const char * p = *pp;
+	int neg = 0;
+	int v = 0;
+	*out = -1;
+	if( p < e && *p == '-' ) { neg = 1; p++; }
+	if( p >= e || *p < '0' || *p > '9' ) return;
+	for( ; p < e && *p >= '0' && *p <= '9'; p++ )
+		v = v * 10 + ( *p - '0' );
+	*pp = p;
+	if( v == 0 ) return;
+	*out = neg ? ( count - v ) : ( v - 1 );
+}
+
+static int ObjEmitVertex( struct TempOutput * o, struct TempObject * t, int vi, int ti, int ni, int corner )
+{
+	float * pos = sb_add( o->pos, 3 );
+	float * tc = sb_add( o->tc, 4 );
+	float * norm = sb_add( o->norm, 3 );
+
+	if( vi >= 0 && vi < t->CVertCount ) copy3d( pos, t->CVerts + vi*3 );
+	else zero3d( pos );
+
+	if( o->barytc )
+	{
+		tc[0] = (corner==0)?1.f:0.f;
+		tc[1] = (corner==1)?1.f:0.f;
+		tc[2] = (corner==2)?1.f:0.f;
+		tc[3] = o->nObjNo;
+	}
+	else if( ti >= 0 && ti < t->CTexCount )
+	{
+		memcpy( tc, t->CTexs + ti*4, sizeof( float ) * 4 );
+	}
+	else
+	{
+		tc[0] = tc[1] = tc[2] = 0;
+		tc[3] = o->nObjNo;
+	}
+
+	if( ni >= 0 && ni < t->CNormalCount ) copy3d( norm, t->CNormals + ni*3 );
+	else zero3d( norm );
+
+	return o->nverts++;
+}
+
+static uint32_t ObjDedupeHash( const int * key )
+{
+	uint32_t h = key[0] * 73856093u ^ key[1] * 19349663u ^ key[2] * 83492791u ^ key[3] * 2654435761u;
+	h ^= h >> 16;
+	h *= 0x7feb352d;
+	h ^= h >> 15;
+	return h;
+}
+
+static int * ObjDedupeSlot( struct TempOutput * o, const int * key )
+{
+	uint32_t mask = o->dedupesize - 1;
+	uint32_t h = ObjDedupeHash( key ) & mask;
+	while( o->dedupevals[h] >= 0 && memcmp( o->dedupekeys + h*4, key, sizeof( int ) * 4 ) )
+		h = ( h + 1 ) & mask;
+	return o->dedupekeys + h*4;
+}
+
+static void ObjDedupeGrow( struct TempOutput * o )
+{
+	int * oldkeys = o->dedupekeys;
+	int * oldvals = o->dedupevals;
+	int oldsize = o->dedupesize;
+	int i;
+	o->dedupesize = oldsize ? oldsize * 2 : 4096;
+	o->dedupekeys = malloc( sizeof( int ) * 4 * o->dedupesize );
+	o->dedupevals = malloc( sizeof( int ) * o->dedupesize );
+	memset( o->dedupevals, 0xff, sizeof( int ) * o->dedupesize );
+	for( i = 0; i < oldsize; i++ )
+	{
+		if( oldvals[i] < 0 ) continue;
+		int * slot = ObjDedupeSlot( o, oldkeys + i*4 );
+		memcpy( slot, oldkeys + i*4, sizeof( int ) * 4 );
+		o->dedupevals[( slot - o->dedupekeys ) / 4] = oldvals[i];
+	}
+	free( oldkeys );
+	free( oldvals );
+}
+
+//Like ObjEmitVertex, but reuses the vertex if it's been seen before.
+static int ObjGetVertex( struct TempOutput * o, struct TempObject * t, int vi, int ti, int ni, int corner )
+{
+	//The object number goes into the texture coordinate when there isn't one, and barycentric coordinates depend on the corner.
+	int key[4] = { vi, ti, ni, o->nObjNo * 4 + ( o->barytc ? corner + 1 : 0 ) };
+	if( o->nverts * 2 >= o->dedupesize ) ObjDedupeGrow( o );
+	int * slot = ObjDedupeSlot( o, key );
+	int * val = o->dedupevals + ( slot - o->dedupekeys ) / 4;
+	if( *val >= 0 ) return *val;
+	memcpy( slot, key, sizeof( key ) );
+	return *val = ObjEmitVertex( o, t, vi, ti, ni, corner );
+}
+
+static int ObjEmitLineVertex( struct TempOutput * o, struct TempObject * t, linevertexpair * lvps, int vi, int ti, int ni )
+{
+	cnovr_point3d va;
+	if( vi >= 0 && vi < t->CVertCount ) copy3d( va, t->CVerts + vi*3 );
+	else zero3d( va );
+	if( RBHAS( lvps, va ) ) return RBA( lvps, va );
+	int ret = ObjEmitVertex( o, t, vi, ti, ni, -1 );
+	RBA( lvps, va ) = ret;
+	return ret;
+}
+
+static void ObjFlushIndices( cnovr_model * m, struct TempOutput * o )
+{
+	if( sb_count( o->indices ) )
+	{
+		CNOVRModelTackIndexv( m, sb_count( o->indices ), o->indices );
+		stb__sbn( o->indices ) = 0;
+	}
+}
+
+///
+/// Binary mesh cache.  Lives next to the source as <file>.<modifier hash>.meshcache.
+/// Header, then strides[geos], vertex counts[geos], mesh marks[meshes], mesh names
+/// (length prefixed, ~0 for none), then raw vertex blobs and the index blob.
+/// Stale (different version, source path, source mtime and size, or modifiers) caches get rebuilt.
+///
+
+#define CNOVR_MESHCACHE_VERSION 2
+#define CNOVR_MESHCACHE_NONAME 0xffffffff
+
+struct MeshCacheHeader
+{
+	char     magic[4];  //"CNMC"
+	uint32_t version;
+	double   srctime;
+	uint64_t srcsize;   //mtime is only to the second, a re-export in the same second usually changes the size.
+	uint32_t pathlen;   //Source path and modifiers follow the header
+	uint32_t modlen;
+	uint32_t geos;
+	uint32_t meshes;
+	uint32_t indices;
+	uint32_t reserved;
+};
+
+//Returns 0 if the source isn't a real file on disk (builtin or missing).  Then there's nothing to check a
+//cache against, so it must not be used or written.
+static int MeshCacheSourceStat( const char * filename, double * srctime, uint64_t * srcsize )
+{
+	struct stat st;
+	if( stat( filename, &st ) ) return 0;
+	*srctime = OGGetFileTime( filename );
+	*srcsize = st.st_size;
+	return 1;
+}
+
+static uint32_t MeshCacheHashString( const char * s )
+{
+	uint32_t h = 2166136261u;
+	while( s && *s ) h = ( h ^ (uint8_t)*s++ ) * 16777619u;
+	return h;
+}
+
+static char * MeshCachePath( const char * filename, const char * modifiers )
+{
+	return strdup( trprintf( "%s.%08x.meshcache", filename, MeshCacheHashString( modifiers ) ) );
+}
+
+//Must hold model_mutex, and the model must already have the VBOs the cache is going into.
+//Returns 1 if the model was loaded from the cache.
+static int CNOVRMeshCacheLoad( cnovr_model * m, const char * filename, const char * modifiers, double srctime, uint64_t srcsize )
+{
+	char * path = MeshCachePath( filename, modifiers );
+	int len, mapped;
+	const char * data = CNOVRFileMap( path, &len, &mapped );
+	free( path );
+	if( !data ) return 0;
+
+	const char * end = data + len;
+	const struct MeshCacheHeader * h = (const struct MeshCacheHeader *)data;
+	const char * p = data + sizeof( *h );
+	if( len < sizeof( *h ) || memcmp( h->magic, "CNMC", 4 ) || h->version != CNOVR_MESHCACHE_VERSION ||
+		h->srctime != srctime || h->srcsize != srcsize || p + h->pathlen + h->modlen > end ||
+		h->pathlen != strlen( filename ) || memcmp( p, filename, h->pathlen ) ||
+		h->modlen != ( modifiers ? strlen( modifiers ) : 0 ) || memcmp( p + h->pathlen, modifiers ? modifiers : "", h->modlen ) )
+	{
+		CNOVRFileUnmap( data, len, mapped );
+		return 0;
+	}
+	p += ( h->pathlen + h->modlen + 3 ) & ~3;
+
+	int i;
+	int geos = h->geos;
+	int meshes = h->meshes;
+	if( geos != m->iGeos || (size_t)h->geos * 2 + h->meshes > ( end - p ) / 4 ) goto corrupt;
+	const uint32_t * strides = (const uint32_t *)p;
+	const uint32_t * counts = strides + geos;
+	const uint32_t * marks = counts + geos;
+	p = (const char *)( marks + meshes );
+	if( p > end || meshes < 1 ) goto corrupt;
+
+	//Names, then make sure the blobs are all there before touching the model.
+	const char * names = p;
+	for( i = 0; i < meshes; i++ )
+	{
+		if( p + 4 > end ) goto corrupt;
+		uint32_t nl = *(const uint32_t *)p;
+		p += 4;
+		if( nl != CNOVR_MESHCACHE_NONAME ) p += ( nl + 3 ) & ~3;
+	}
+	if( p > end ) goto corrupt;
+
+	//Each blob has to be exactly what the VBO it goes into holds, one entry per vertex in every VBO.
+	const char * blobs = p;
+	uint32_t verts = geos ? counts[0] : 0;
+	for( i = 0; i < geos; i++ )
+	{
+		if( strides[i] != m->pGeos[i]->iStride || counts[i] != verts ) goto corrupt;
+		size_t blob = (size_t)strides[i] * counts[i] * sizeof( float );
+		if( blob > (size_t)( end - p ) ) goto corrupt;
+		p += blob;
+	}
+	const uint32_t * indices = (const uint32_t *)p;
+	if( (size_t)h->indices * sizeof( uint32_t ) > (size_t)( end - p ) ) goto corrupt;
+
+	//Every index has to land inside every VBO, or GL reads past the end.
+	for( i = 0; i < h->indices; i++ )
+		if( indices[i] >= verts ) goto corrupt;
+	for( i = 0; i < meshes; i++ )
+		if( marks[i] > h->indices ) goto corrupt;
+
+	p = blobs;
+	for( i = 0; i < geos; i++ )
+	{
+		CNOVRVBOResetVertices( m->pGeos[i] );
+		CNOVRVBOTackN( m->pGeos[i], counts[i], (const float *)p, strides[i] );
+		p += (size_t)strides[i] * counts[i] * sizeof( float );
+	}
+	CNOVRModelSetNumIndices( m, 0 );
+	CNOVRModelResetMarks( m );
+	CNOVRModelTackIndexv( m, h->indices, (uint32_t *)indices );
+
+	m->iMeshMarks = realloc( m->iMeshMarks, sizeof( int ) * ( meshes + 1 ) );
+	m->sMeshMarks = realloc( m->sMeshMarks, sizeof( char * ) * meshes );
+	m->nMeshes = meshes;
+	p = names;
+	for( i = 0; i < meshes; i++ )
+	{
+		uint32_t nl = *(const uint32_t *)p;
+		p += 4;
+		m->iMeshMarks[i] = marks[i];
+		m->sMeshMarks[i] = 0;
+		if( nl != CNOVR_MESHCACHE_NONAME )
+		{
+			m->sMeshMarks[i] = malloc( nl + 1 );
+			memcpy( m->sMeshMarks[i], p, nl );
+			m->sMeshMarks[i][nl] = 0;
+			p += ( nl + 3 ) & ~3;
+		}
+	}
+	m->iMeshMarks[meshes] = m->iIndexCount;
+
+	CNOVRFileUnmap( data, len, mapped );
+
+	for( i = 0; i < geos; i++ ) CNOVRVBOTaint( m->pGeos[i] );
+	CNOVRModelTaintIndices( m );
+	return 1;
+corrupt:
+	CNOVRAlert( m->base.tccctx, 2, "Warning: Mesh cache for %s is corrupt, reparsing\n", filename );
+	CNOVRFileUnmap( data, len, mapped );
+	return 0;
+}
+
+static void MeshCachePad( FILE * f, uint32_t len )
+{
+	static const char zeroes[4];
+	if( len & 3 ) fwrite( zeroes, 4 - ( len & 3 ), 1, f );
+}
+
+//Must hold model_mutex.  Failure isn't an error, the asset directory may not be writable.
+static void CNOVRMeshCacheSave( cnovr_model * m, const char * filename, const char * modifiers, double srctime, uint64_t srcsize )
+{
+	char * path = MeshCachePath( filename, modifiers );
+	char * tmppath = strdup( trprintf( "%s.tmp", path ) );
+	FILE * f = fopen( tmppath, "wb" );
+	int i;
+	if( !f ) goto done;
+
+	struct MeshCacheHeader h;
+	memset( &h, 0, sizeof( h ) );
+	memcpy( h.magic, "CNMC", 4 );
+	h.version = CNOVR_MESHCACHE_VERSION;
+	h.srctime = srctime;
+	h.srcsize = srcsize;
+	h.pathlen = strlen( filename );
+	h.modlen = modifiers ? strlen( modifiers ) : 0;
+	h.geos = m->iGeos;
+	h.meshes = m->nMeshes;
+	h.indices = m->iIndexCount;
+	fwrite( &h, sizeof( h ), 1, f );
+	//Path and modifiers are padded together.
+	fwrite( filename, h.pathlen, 1, f );
+	fwrite( modifiers ? modifiers : "", h.modlen, 1, f );
+	MeshCachePad( f, h.pathlen + h.modlen );
+	for( i = 0; i < m->iGeos; i++ ) fwrite( &m->pGeos[i]->iStride, 4, 1, f );
+	for( i = 0; i < m->iGeos; i++ ) fwrite( &m->pGeos[i]->iVertexCount, 4, 1, f );
+	for( i = 0; i < m->nMeshes; i++ ) fwrite( &m->iMeshMarks[i], 4, 1, f );
+	for( i = 0; i < m->nMeshes; i++ )
+	{
+		const char * name = m->sMeshMarks[i];
+		uint32_t nl = name ? strlen( name ) : CNOVR_MESHCACHE_NONAME;
+		fwrite( &nl, 4, 1, f );
+		if( name )
+		{
+			fwrite( name, nl, 1, f );
+			MeshCachePad( f, nl );
+		}
+	}
+	for( i = 0; i < m->iGeos; i++ )
+		fwrite( m->pGeos[i]->pVertices, sizeof( float ) * m->pGeos[i]->iStride, m->pGeos[i]->iVertexCount, f );
+	fwrite( m->pIndices, sizeof( uint32_t ), m->iIndexCount, f );
+
+	if( ferror( f ) )
+	{
+		fclose( f );
+		remove( tmppath );
+		goto done;
+	}
+	fclose( f );
+	//Write then rename so a half-written cache is never picked up.
+	remove( path );
+	rename( tmppath, path );
+done:
+	free( path );
+	free( tmppath );
+}
+
 static void CNOVRModelLoadOBJ( cnovr_model * m, const char * filename, const char * modifiers )
 {
+	//A fresh cache means no parsing, and no need to wait for the size to settle.
+	double srctime = 0;
+	uint64_t srcsize = 0;
+	int cacheable = MeshCacheSourceStat( filename, &srctime, &srcsize );
+	if( m->iGeos != 3 )
+	{
+		CNOVRModelSetNumVBOsWithStrides( m, 3, 3, 4, 3 );
+	}
+	if( cacheable && CNOVRMeshCacheLoad( m, filename, modifiers, srctime, srcsize ) )
+	{
+		m->iLoadOpaque2 = 0;
+		return;
+	}
+
+	//Not CNOVRFileMap, the OBJ can be rewritten in place while it's being reloaded.
 	int filelen;
 	char * file = CNOVRFileToString( filename, &filelen );
 
+	if( !file )
+	{
+		CNOVRAlert( m->base.tccctx, 1, "Error: Could not open OBJ \"%s\"\n", filename );
+		return;
+	}
+
+	//Tricky: The file may still be being written, wait till its size settles before reading it.
 	if( m->iLoadOpaque1 != filelen )
 	{
 		m->iLoadOpaque2 = 0;
@@ -1795,34 +4733,32 @@ static void CNOVRModelLoadOBJ( cnovr_model * m, const char * filename, const cha
 	}
 
 	m->iLoadOpaque2 = 0;
-	char ** splits = CNOVRSplitStrings( file, "\n", "\r", 1, 0 );
-	free( file );
 
 	int lineify = 0; //Finds all unique edges and generates them
 	int flipv = 1;
 	int barytc = 0; //Replaces the texture coord section with the barycentric coordinates 
+	int nocacheopt = 0; //Keep the triangles in file order.
 	if( modifiers )
 	{
 		if( strstr( modifiers, "lineify" ) ) lineify = 1;
 		if( strstr( modifiers, "barytc" ) ) barytc = 1;
 		if( strstr( modifiers, "noflipv" ) ) flipv = 0;
+		if( strstr( modifiers, "nocacheopt" ) ) nocacheopt = 1;
 	}
 
 	struct TempObject t;
+	struct TempOutput o;
 	memset( &t, 0, sizeof( t ) );
-	if( m->iGeos != 3 )
-	{
-		CNOVRModelSetNumVBOsWithStrides( m, 3, 3, 4, 3 );
-		CNOVRModelSetNumIndices( m, 0 );
-		CNOVRModelResetMarks( m );
-	}
+	memset( &o, 0, sizeof( o ) );
+	o.barytc = barytc && !lineify;
+
+	//Could be a reload, otherwise we'd append to (and index into) the old data.
+	CNOVRVBOResetVertices( m->pGeos[0] );
+	CNOVRVBOResetVertices( m->pGeos[1] );
+	CNOVRVBOResetVertices( m->pGeos[2] );
 	CNOVRModelSetNumIndices( m, 0 );
+	CNOVRModelResetMarks( m );
 
-	int indices = 0;
-	char * line;
-	int lineno;
-	int nObjNo = 0;
-	
 	linevertexpair * lvps = 0;
 	indexpairset   * lvpsi = 0;
 	if( lineify )
@@ -1830,253 +4766,178 @@ static void CNOVRModelLoadOBJ( cnovr_model * m, const char * filename, const cha
 		lvps = cnrbtree_cnovr_point3dint_create();
 		lvpsi = cnrbtree_int64_trbset_null_t_create();
 	}
-	
-	for( lineno = 0; (line = splits[lineno]) ; lineno++ )
+
+	const char * fe = file + filelen;
+	const char * line = file;
+	while( line < fe )
 	{
-		int linelen = strlen( line );
-		if( linelen < 2 ) continue;
-		if( tolower( line[0] ) == 'v' )
+		const char * le = memchr( line, '\n', fe - line );
+		if( !le ) le = fe;
+		const char * p = ObjSkipSpace( line, le );
+		line = le + 1;
+
+		if( le - p < 2 ) continue;
+		char c0 = tolower( p[0] );
+		char c1 = tolower( p[1] );
+
+		if( c0 == 'v' && ( c1 == ' ' || c1 == '\t' ) )
 		{
-			if( tolower( line[1] ) == 'n' )
-			{
-				t.CNormals = realloc( t.CNormals, ( t.CNormalCount + 1 ) * 3 * sizeof( float ) );
-				int r = sscanf( line + 3, "%f %f %f", 
-					&t.CNormals[0 + t.CNormalCount * 3], 
-					&t.CNormals[1 + t.CNormalCount * 3], 
-					&t.CNormals[2 + t.CNormalCount * 3] );
-				//t.CNormals[3 + t.CNormalCount * 3] = 0;
-				if( r == 3 )
-					t.CNormalCount++;
-			}
-			else if( tolower( line[1] ) == 't' )
+			float * v = sb_add( t.CVerts, 3 );
+			p++;
+			v[2] = 0;
+			if( ObjParseFloat( &p, le, &v[0] ) && ObjParseFloat( &p, le, &v[1] ) )
 			{
-				if( !barytc )
-				{
-					t.CTexs = realloc( t.CTexs, ( t.CTexCount + 1 ) * 4 * sizeof( float ) );
-					t.CTexs[1 + t.CTexCount * 4] = 0;
-					t.CTexs[2 + t.CTexCount * 4] = 0;
-					t.CTexs[3 + t.CTexCount * 4] = nObjNo;
-					int r = sscanf( line + 3, "%f %f %f", 
-						&t.CTexs[0 + t.CTexCount * 4], 
-						&t.CTexs[1 + t.CTexCount * 4], 
-						&t.CTexs[2 + t.CTexCount * 4] );
-
-					if( flipv )
-						t.CTexs[1 + t.CTexCount * 4] = 1. - t.CTexs[1 + t.CTexCount * 4];
-					if( r == 3 || r == 2 )
-						t.CTexCount++;
-					else
-					{
-						CNOVRAlert( m->base.tccctx, 1, "Error: Invalid Tex Coords (%d) (%s)\n", r, line + 3 );
-					}
-				}
+				ObjParseFloat( &p, le, &v[2] );
+				t.CVertCount++;
 			}
 			else
 			{
-				t.CVerts = realloc( t.CVerts, ( t.CVertCount + 1 ) * 3 * sizeof( float ) );
-				t.CVerts[2 + t.CVertCount * 3] = 0;
-				int r = sscanf( line + 2, "%f %f %f", 
-					&t.CVerts[0 + t.CVertCount * 3], 
-					&t.CVerts[1 + t.CVertCount * 3], 
-					&t.CVerts[2 + t.CVertCount * 3] );
-				if( r == 3 || r == 2 )
-					t.CVertCount++;
-				else
-				{
-					fprintf( stderr, "Error: Invalid Vertex\n" );
-				}
+				stb__sbn( t.CVerts ) -= 3;
+				CNOVRAlert( m->base.tccctx, 1, "Error: Invalid Vertex in %s\n", filename );
 			}
 		}
-		else if( tolower( line[0] ) == 'f' )
+		else if( c0 == 'v' && c1 == 'n' )
 		{
-			char buffer[4][TBUFFERSIZE];
-			int p = 0;
-			int r = sscanf( line + 1, "%30s %30s %30s %30s", 
-				buffer[0], buffer[1], buffer[2], buffer[3] );
-
-			if( r != 3 && r != 4 )
+			float * n = sb_add( t.CNormals, 3 );
+			p += 2;
+			if( ObjParseFloat( &p, le, &n[0] ) && ObjParseFloat( &p, le, &n[1] ) && ObjParseFloat( &p, le, &n[2] ) )
+				t.CNormalCount++;
+			else
+				stb__sbn( t.CNormals ) -= 3;
+		}
+		else if( c0 == 'v' && c1 == 't' )
+		{
+			if( barytc ) continue;
+			float * tc = sb_add( t.CTexs, 4 );
+			p += 2;
+			tc[1] = 0;
+			tc[2] = 0;
+			tc[3] = o.nObjNo;
+			if( ObjParseFloat( &p, le, &tc[0] ) && ObjParseFloat( &p, le, &tc[1] ) )
 			{
-				//Invalid line - continue.
-				continue;
+				ObjParseFloat( &p, le, &tc[2] );
+				if( flipv ) tc[1] = 1. - tc[1];
+				t.CTexCount++;
 			}
-
-			//Whatever... they're all populated with something now.
-
-			char buffer2[4 /*max # of elements*/][4][TBUFFERSIZE];
-			for( p = 0; p < r; p++ )
+			else
+			{
+				stb__sbn( t.CTexs ) -= 4;
+				CNOVRAlert( m->base.tccctx, 1, "Error: Invalid Tex Coords in %s\n", filename );
+			}
+		}
+		else if( c0 == 'f' && ( c1 == ' ' || c1 == '\t' ) )
+		{
+			//Any number of corners.  Triangles are fanned out from the first one.
+			int first[3], prev[3], cur[3];
+			int corner = 0;
+			int firstidx = 0, previdx = 0;
+			p++;
+			for( ;; )
 			{
-				int mark = 0, markb = 0;
-				int i;
-				int sl = strlen( buffer[p] );
-				for( i = 0; i < sl; i++ )
+				p = ObjSkipSpace( p, le );
+				ObjParseIndex( &p, le, t.CVertCount, &cur[0] );
+				if( cur[0] < 0 ) break;
+				cur[1] = cur[2] = -1;
+				if( p < le && *p == '/' )
 				{
-					if( buffer[p][i] == '/' )
+					p++;
+					ObjParseIndex( &p, le, t.CTexCount, &cur[1] );
+					if( p < le && *p == '/' )
 					{
-						buffer2[p][mark][markb] = 0;
-						mark++;
-						if( mark >= r ) break;
-						markb = 0;
+						p++;
+						ObjParseIndex( &p, le, t.CNormalCount, &cur[2] );
 					}
-					else
-						buffer2[p][mark][markb++] = buffer[p][i];
-				}
-				buffer2[p][mark][markb] = 0;
-				for( i = mark+1; i < r; i++ )
-				{
-					buffer2[p][i][0] = '0';
-					buffer2[p][i][1] = 0;
 				}
-			}
-			
+				//Skip anything we don't understand up to the next corner.
+				while( p < le && *p != ' ' && *p != '\t' ) p++;
 
-			if( lineify )
-			{
-				for( p = 0; p < r; p++ )
+				if( lineify )
 				{
-					int iao1o = p;
-					int iao2o = ( p < r-1 )?(p+1):(p-(r-1));
-					int VNumber1 = atoi( buffer2[iao1o][0] ) - 1;
-					int VNumber2 = atoi( buffer2[iao2o][0] ) - 1;
-					int TNumber1 = atoi( buffer2[iao1o][1] ) - 1;
-					int TNumber2 = atoi( buffer2[iao2o][1] ) - 1;
-					int NNumber1 = atoi( buffer2[iao1o][2] ) - 1;
-					int NNumber2 = atoi( buffer2[iao2o][2] ) - 1;
-
-					cnovr_point3d va;
-					cnovr_point3d vb;
-					copy3d( va, &t.CVerts[VNumber1*3] );
-					copy3d( vb, &t.CVerts[VNumber2*3] );
-					int i1;
-					int i2;
-					if( !RBHAS( lvps, va ) )
-					{
-						i1 = RBA( lvps, va ) = m->pGeos[0]->iVertexCount;
-						if( VNumber1 < t.CVertCount && VNumber1 >= 0 )
-							CNOVRVBOTackv( m->pGeos[0], 3, &t.CVerts[VNumber1*3] );
-						else
-							CNOVRVBOTack( m->pGeos[0], 3, 0, 0, 0 );
-
-						if( TNumber1 < t.CTexCount && TNumber1 >= 0 )
-							CNOVRVBOTackv( m->pGeos[1], 4, &t.CTexs[TNumber1*4] );
-						else
-							CNOVRVBOTack( m->pGeos[1], 4, 0, 0, 0, nObjNo );
-
-						if( NNumber1 < t.CNormalCount && NNumber1 >= 0 )
-							CNOVRVBOTackv( m->pGeos[2], 3, &t.CNormals[NNumber1*3] );
-						else
-							CNOVRVBOTack( m->pGeos[2], 3, 0, 0, 0 );
-					}
-					else
-					{
-						i1 = RBA( lvps, va );
-					}
-					if( !RBHAS( lvps, vb ) )
-					{
-						i2 = RBA( lvps, vb ) = m->pGeos[0]->iVertexCount;
-						if( VNumber2 < t.CVertCount && VNumber2 >= 0 )
-							CNOVRVBOTackv( m->pGeos[0], 3, &t.CVerts[VNumber2*3] );
-						else
-							CNOVRVBOTack( m->pGeos[0], 3, 0, 0, 0 );
-
-						if( TNumber2 < t.CTexCount && TNumber2 >= 0 )
-							CNOVRVBOTackv( m->pGeos[1], 4, &t.CTexs[TNumber2*4] );
-						else
-							CNOVRVBOTack( m->pGeos[1], 4, 0, 0, 0, nObjNo );
-						if( NNumber2 < t.CNormalCount && NNumber2 >= 0 )
-							CNOVRVBOTackv( m->pGeos[2], 3, &t.CNormals[NNumber2*3] );
-						else
-							CNOVRVBOTack( m->pGeos[2], 3, 0, 0, 0 );
-					}
+					int idx = ObjEmitLineVertex( &o, &t, lvps, cur[0], cur[1], cur[2] );
+					if( corner == 0 ) firstidx = idx;
 					else
 					{
-						i2 = RBA( lvps, vb );
-					}
-
-					//printf( "I: %d (%f %f %f) %d (%f %f %f)\n", i1, PFTHREE( va ), i2, PFTHREE( vb ) );
-					
-					int64_t paria = i1 | (((int64_t)i2)<<32);
-					int64_t parib = i2 | (((int64_t)i1)<<32);
-					//printf( "%llx %llx  %p %p\n", (uint64_t)paria, (uint64_t)parib, RBHAS( lvpsi, paria ), RBHAS( lvpsi, parib ) );
-					if( !RBHAS( lvpsi, paria ) && !RBHAS( lvpsi, parib ) )
-					{
-						//printf( "ACCESS: %p {%d %d}\n", 
-							lvpsi->access( lvpsi, paria )
-						//, i1, i2 )
-						;
-						
-						//Now, examine if i1, i2 is already in the set.
-						CNOVRModelTackIndex( m, 2, i1, i2 );
-						indices+=2;
+						int64_t paria = previdx | (((int64_t)idx)<<32);
+						int64_t parib = idx | (((int64_t)previdx)<<32);
+						if( !RBHAS( lvpsi, paria ) && !RBHAS( lvpsi, parib ) )
+						{
+							lvpsi->access( lvpsi, paria );
+							sb_push( o.indices, previdx );
+							sb_push( o.indices, idx );
+						}
 					}
+					previdx = idx;
+				}
+				else if( corner == 0 )
+				{
+					memcpy( first, cur, sizeof( cur ) );
+				}
+				else if( corner >= 2 )
+				{
+					sb_push( o.indices, ObjGetVertex( &o, &t, first[0], first[1], first[2], 0 ) );
+					sb_push( o.indices, ObjGetVertex( &o, &t, prev[0], prev[1], prev[2], 1 ) );
+					sb_push( o.indices, ObjGetVertex( &o, &t, cur[0], cur[1], cur[2], 2 ) );
 				}
+				memcpy( prev, cur, sizeof( cur ) );
+				corner++;
 			}
-			else
+
+			if( lineify && corner > 2 )
 			{
-				//Triangles out.
-				for( p = 0; p < r; p++ )
+				//Close the loop.
+				int64_t paria = previdx | (((int64_t)firstidx)<<32);
+				int64_t parib = firstidx | (((int64_t)previdx)<<32);
+				if( !RBHAS( lvpsi, paria ) && !RBHAS( lvpsi, parib ) )
 				{
-					int VNumber = atoi( buffer2[p][0] ) - 1;
-					int TNumber = atoi( buffer2[p][1] ) - 1;
-					int NNumber = atoi( buffer2[p][2] ) - 1;
-
-					CNOVRModelTackIndex( m, 1, indices++ );
-					if( VNumber < t.CVertCount && VNumber >= 0 )
-						CNOVRVBOTackv( m->pGeos[0], 3, &t.CVerts[VNumber*3] );
-					else
-						CNOVRVBOTack( m->pGeos[0], 3, 0, 0, 0 );
-
-					if( barytc )
-					{
-						CNOVRVBOTack( m->pGeos[1], 4, (p==0)?1.f:0.f,
-							(p==1)?1.f:0.f, (p==2)?1.f:0.f, nObjNo );
-					}
-					else
-					{
-						if( TNumber < t.CTexCount && TNumber >= 0 )
-							CNOVRVBOTackv( m->pGeos[1], 4, &t.CTexs[TNumber*4] );
-						else
-							CNOVRVBOTack( m->pGeos[1], 4, 0, 0, 0, nObjNo );
-					}
-
-					if( NNumber < t.CNormalCount && NNumber >= 0 )
-						CNOVRVBOTackv( m->pGeos[2], 3, &t.CNormals[NNumber*3] );
-					else
-						CNOVRVBOTack( m->pGeos[2], 3, 0, 0, 0 );
+					lvpsi->access( lvpsi, paria );
+					sb_push( o.indices, previdx );
+					sb_push( o.indices, firstidx );
 				}
-
 			}
 		}
-		else if( tolower( line[0] ) == 'o' )
+		else if( c0 == 'o' && ( c1 == ' ' || c1 == '\t' ) )
 		{
-			const char * marker = ( strlen( line ) > 2 )?( line + 2 ):0;
-			nObjNo++;
+			char marker[OBJBUFFERSIZE];
+			const char * ms = ObjSkipSpace( p + 1, le );
+			const char * me = le;
+			while( me > ms && ( me[-1] == '\r' || me[-1] == ' ' || me[-1] == '\t' ) ) me--;
+			int mlen = me - ms;
+			if( mlen > OBJBUFFERSIZE - 1 ) mlen = OBJBUFFERSIZE - 1;
+			memcpy( marker, ms, mlen );
+			marker[mlen] = 0;
+			o.nObjNo++;
+			//Marks are by index, so anything pending has to go in first.
+			ObjFlushIndices( m, &o );
 			CNOVRDelinateGeometry( m, marker );
 		}
-		else if( strncmp( line, "usemtl", 6 ) == 0 )
-		{
-			//Not implemented.
-		}
-		else if( strncmp( line, "mtllib", 6 ) == 0 )
-		{
-			//Not implemented.
-		}
-		else if( tolower( line[0] ) == 's' )
-		{
-			//Not implemented.
-		}
+		//usemtl, mtllib, s, g: Not implemented.
 	}
 
-	printf( "LOADED MODEL {%s} %d INDICES\n", filename, indices );
+	ObjFlushIndices( m, &o );
+	if( !lineify && !nocacheopt ) CNOVRModelOptimizeVertexCache( m );
+	CNOVRVBOTackN( m->pGeos[0], o.nverts, o.pos, 3 );
+	CNOVRVBOTackN( m->pGeos[1], o.nverts, o.tc, 4 );
+	CNOVRVBOTackN( m->pGeos[2], o.nverts, o.norm, 3 );
+
+	printf( "LOADED MODEL {%s} %d INDICES %d VERTICES\n", filename, m->iIndexCount, o.nverts );
 
 	if( lvps )
 	{
 		cnrbtree_cnovr_point3dint_destroy( lvps );
 		cnrbtree_int64_trbset_null_t_destroy( lvpsi );
 	}
-	if( t.CVerts ) free( t.CVerts ); 
-	if( t.CTexs ) free( t.CTexs ); 
-	if( t.CNormals ) free( t.CNormals ); 
-	free( splits );
+	sb_free( t.CVerts );
+	sb_free( t.CTexs );
+	sb_free( t.CNormals );
+	sb_free( o.pos );
+	sb_free( o.tc );
+	sb_free( o.norm );
+	sb_free( o.indices );
+	free( o.dedupekeys );
+	free( o.dedupevals );
+	free( file );
+
+	if( cacheable ) CNOVRMeshCacheSave( m, filename, modifiers, srctime, srcsize );
 
 	CNOVRVBOTaint( m->pGeos[0] );
 	CNOVRVBOTaint( m->pGeos[1] );
@@ -2094,11 +4955,13 @@ static void CNOVRModelLoadRenderModel( cnovr_model * m, char * pchRenderModelNam
 	int lineify = 0;
 	int flipv = 1;
 	int barytc = 0;
+	int nocacheopt = 0;
 	if( modifiers )
 	{
 		if( strstr( modifiers, "barytc" ) ) barytc = 1;
 		if( strstr( modifiers, "lineify" ) ) lineify = 1;
 		if( strstr( modifiers, "noflipv" ) ) flipv = 0;
+		if( strstr( modifiers, "nocacheopt" ) ) nocacheopt = 1;
 	}
 
 	if( !cnovrstate->oRenderModels )
@@ -2152,9 +5015,21 @@ static void CNOVRModelLoadRenderModel( cnovr_model * m, char * pchRenderModelNam
 		CNOVRModelSetNumVBOsWithStrides( m, 3, 3, 4, 3 );
 		CNOVRModelResetMarks( m );
 	}
+	else
+	{
+		CNOVRVBOResetVertices( m->pGeos[0] );
+		CNOVRVBOResetVertices( m->pGeos[1] );
+		CNOVRVBOResetVertices( m->pGeos[2] );
+	}
 	CNOVRModelSetNumIndices( m, 0 );
 	CNOVRDelinateGeometry( m, pchRenderModelName );
 	int i;
+	{
+		int nverts = ( lineify || barytc ) ? pModel->unTriangleCount * 3 : pModel->unVertexCount;
+		CNOVRVBOReserve( m->pGeos[0], nverts );
+		CNOVRVBOReserve( m->pGeos[1], nverts );
+		CNOVRVBOReserve( m->pGeos[2], nverts );
+	}
 	if( lineify )
 	{
 		linevertexpair * lvps = 0;
@@ -2245,37 +5120,70 @@ static void CNOVRModelLoadRenderModel( cnovr_model * m, char * pchRenderModelNam
 	}
 	else if( barytc )
 	{
-		for( i = 0; i < pModel->unTriangleCount*3; i++ )
+		//Each vertex can be used as up to three different corners, share it within each.
+		int nidx = pModel->unTriangleCount*3;
+		int * cornermap = malloc( sizeof( int ) * 3 * pModel->unVertexCount );
+		float * pos = malloc( sizeof( float ) * 3 * nidx );
+		float * tcs = malloc( sizeof( float ) * 4 * nidx );
+		float * norms = malloc( sizeof( float ) * 3 * nidx );
+		uint32_t * indices = malloc( sizeof( uint32_t ) * nidx );
+		int nverts = 0;
+		memset( cornermap, 0xff, sizeof( int ) * 3 * pModel->unVertexCount );
+		for( i = 0; i < nidx; i++ )
 		{
-			//pModel->rIndexData[i*3+0], pModel->rIndexData[i*3+1], pModel->rIndexData[i*3+2] );
 			int ridx = pModel->rIndexData[i];
-
-			RenderModel_Vertex_t * v = pModel->rVertexData + ridx;
-			CNOVRVBOTackv( m->pGeos[0], 3, v->vPosition.v );
-			if( !flipv ) v->rfTextureCoord[1] = 1-v->rfTextureCoord[1];
-			//CNOVRVBOTackv( m->pGeos[1], 2, v->rfTextureCoord );
 			int p = i%3;
-			CNOVRVBOTack( m->pGeos[1], 4, (p==0)?1.f:0.f,
-				(p==1)?1.f:0.f, (p==2)?1.f:0.f, 0 );
-			CNOVRVBOTackv( m->pGeos[2], 3, v->vNormal.v );
-			CNOVRModelTackIndex( m, 1, i );
+			int * map = cornermap + ridx*3 + p;
+			if( *map < 0 )
+			{
+				RenderModel_Vertex_t * v = pModel->rVertexData + ridx;
+				copy3d( pos + nverts*3, v->vPosition.v );
+				copy3d( norms + nverts*3, v->vNormal.v );
+				float * tc = tcs + nverts*4;
+				tc[0] = (p==0)?1.f:0.f;
+				tc[1] = (p==1)?1.f:0.f;
+				tc[2] = (p==2)?1.f:0.f;
+				tc[3] = 0;
+				*map = nverts++;
+			}
+			indices[i] = *map;
 		}
+		CNOVRVBOTackN( m->pGeos[0], nverts, pos, 3 );
+		CNOVRVBOTackN( m->pGeos[1], nverts, tcs, 4 );
+		CNOVRVBOTackN( m->pGeos[2], nverts, norms, 3 );
+		CNOVRModelTackIndexv( m, nidx, indices );
+		if( !nocacheopt ) CNOVRModelOptimizeVertexCache( m );
+		free( cornermap );
+		free( pos );
+		free( tcs );
+		free( norms );
+		free( indices );
 	}
 	else
 	{
 		//Regular triangles
-		for( i = 0; i < pModel->unVertexCount; i++ )
+		int nverts = pModel->unVertexCount;
+		int vstride = sizeof( RenderModel_Vertex_t ) / sizeof( float );
+		float * tcs = malloc( nverts * 2 * sizeof( float ) );
+		for( i = 0; i < nverts; i++ )
 		{
 			RenderModel_Vertex_t * v = pModel->rVertexData + i;
-			CNOVRVBOTackv( m->pGeos[0], 3, v->vPosition.v );
-			if( !flipv ) v->rfTextureCoord[1] = 1-v->rfTextureCoord[1];
-			CNOVRVBOTackv( m->pGeos[1], 2, v->rfTextureCoord );
-			CNOVRVBOTackv( m->pGeos[2], 3, v->vNormal.v );
+			tcs[i*2+0] = v->rfTextureCoord[0];
+			tcs[i*2+1] = flipv?v->rfTextureCoord[1]:(1-v->rfTextureCoord[1]);
 		}
-		for( i = 0; i < pModel->unTriangleCount; i++ )
+		//Tricky: Position and normal are the first three floats of their part of the vertex, so they can be read straight out of the interleaved data.
+		CNOVRVBOTackN( m->pGeos[0], nverts, pModel->rVertexData[0].vPosition.v, vstride );
+		CNOVRVBOTackN( m->pGeos[1], nverts, tcs, 2 );
+		CNOVRVBOTackN( m->pGeos[2], nverts, pModel->rVertexData[0].vNormal.v, vstride );
+		free( tcs );
+		uint32_t * indices = malloc( sizeof( uint32_t ) * pModel->unTriangleCount * 3 );
+		for( i = 0; i < pModel->unTriangleCount*3; i++ )
 		{
-			CNOVRModelTackIndex( m, 3, pModel->rIndexData[i*3+0], pModel->rIndexData[i*3+1], pModel->rIndexData[i*3+2] );
+			indices[i] = pModel->rIndexData[i];
 		}
+		CNOVRModelTackIndexv( m, pModel->unTriangleCount*3, indices );
+		free( indices );
+		if( !nocacheopt ) CNOVRModelOptimizeVertexCache( m );
 	}
 
 	if( m->iTextures == 0 )
@@ -2320,10 +5228,25 @@ void CNOVRModelLoadFromFileAsyncCallback( void * vm, void * dump )
 	OGUnlockMutex( m->model_mutex );
 }
 
+static cnovr_base * CNOVRModelAssetCreate( void * opaque )
+{
+	cnovr_model * from = (cnovr_model*)opaque;
+	cnovr_model * ret = CNOVRModelCreate( 0, GL_TRIANGLES );
+	ret->geofile = strdup( from->geofile );
+	ret->sModifiers = from->sModifiers ? strdup( from->sModifiers ) : 0;
+	CNOVRJobTack( cnovrQAsync, CNOVRModelLoadFromFileAsyncCallback, ret, 0, 1 );
+	CNOVRFileTimeAddWatch( ret->geofile, CNOVRModelLoadFromFileAsyncCallback, ret, 0 );
+	return &ret->base;
+}
+
 void CNOVRModelLoadFromFileAsync( cnovr_model * m, const char * filename )
 {
 	OGLockMutex( m->model_mutex );
+	cnovr_model * oldshared = m->pShared;
+	m->pShared = 0;
 	if( m->geofile ) free( m->geofile );
+	if( m->sModifiers ) free( m->sModifiers );
+	m->sModifiers = 0;
 	char * colon = strchr( filename, ':' );
 	if( colon )
 	{
@@ -2339,9 +5262,19 @@ void CNOVRModelLoadFromFileAsync( cnovr_model * m, const char * filename )
 		const char * gfile = CNOVRFileSearch( filename );
 		m->geofile = strdup( (gfile&&gfile[0])?gfile:filename ); //In case it's a render model.
 	}
-	CNOVRJobTack( cnovrQAsync, CNOVRModelLoadFromFileAsyncCallback, m, 0, 1 );
-	CNOVRFileTimeAddWatch( m->geofile, CNOVRModelLoadFromFileAsyncCallback, m, 0 );
+	if( CNOVRStringCompareEndingCase( m->geofile, ".obj" ) == 0 )
+	{
+		//Everyone loading this OBJ with the same modifiers draws out of one copy.
+		m->pShared = (cnovr_model*)CNOVRAssetAcquire( trprintf( "model:%s:%s", m->geofile, m->sModifiers?m->sModifiers:"" ),
+			CNOVRModelAssetCreate, m );
+	}
+	else
+	{
+		CNOVRJobTack( cnovrQAsync, CNOVRModelLoadFromFileAsyncCallback, m, 0, 1 );
+		CNOVRFileTimeAddWatch( m->geofile, CNOVRModelLoadFromFileAsyncCallback, m, 0 );
+	}
 	OGUnlockMutex( m->model_mutex );
+	if( oldshared ) CNOVRDelete( oldshared );
 }
 
 /////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,230 @@
+#include "cnovrprofile.h"
+#include "cnovrtcc.h"
+#include "cnovr.h"
+#include <os_generic.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(WINDOWS) || defined( WIN32 ) || defined( WIN64 )
+#include <windows.h>
+#define PROFILE_ATOMIC_INC( x ) ( InterlockedIncrement( (LONG*)&(x) ) - 1 )
+#define PROFILE_STORE_RELEASE( x, v ) InterlockedExchange( (LONG*)&(x), (v) )
+#define PROFILE_LOAD_ACQUIRE( x ) ( (unsigned)InterlockedCompareExchange( (LONG*)&(x), 0, 0 ) )
+#define PROFILE_FENCE() { LONG fence = 0; InterlockedExchange( &fence, 1 ); }
+#elif defined( __GNUC__ ) || defined( __clang__ )
+#define PROFILE_ATOMIC_INC( x ) __sync_fetch_and_add( &(x), 1 )
+#define PROFILE_STORE_RELEASE( x, v ) __atomic_store_n( &(x), (v), __ATOMIC_RELEASE )
+#define PROFILE_LOAD_ACQUIRE( x ) __atomic_load_n( &(x), __ATOMIC_ACQUIRE )
+#define PROFILE_FENCE() __atomic_thread_fence( __ATOMIC_SEQ_CST )
+#else
+#error cnovrprofile needs atomics.  Add them for this compiler.
+#endif
+
+static cnovrprofile_event profilering[CNOVR_PROFILE_RING_SIZE];
+static volatile unsigned profilehead;
+static unsigned profiletail;  //Only touched by CNOVRProfileFrameEnd.
+static volatile int profileframe;
+static int profiledisabled;
+static volatile unsigned profilethreads;
+static og_tls_t profilethreadtls;
+
+static cnovrprofile_summary profilesummary[CNOVR_PROFILE_MAX_SUMMARY];
+static double profilesummaryaccum[CNOVR_PROFILE_MAX_SUMMARY];
+static int profilesummarycalls[CNOVR_PROFILE_MAX_SUMMARY];
+static int profilesummarycount;
+
+static int ProfileThreadID()
+{
+	//Tricky: 0 means unassigned, so thread ids are 1-based in the TLS.
+	if( !profilethreadtls ) return 0;
+	intptr_t id = (intptr_t)OGGetTLS( profilethreadtls );
+	if( !id )
+	{
+		id = PROFILE_ATOMIC_INC( profilethreads ) + 1;
+		OGSetTLS( profilethreadtls, (void*)id );
+	}
+	return id - 1;
+}
+
+void CNOVRProfileRecord( const char * name, void * tcctag, void * fn, int eye, double start, double end )
+{
+	if( profiledisabled ) return;
+	unsigned seq = PROFILE_ATOMIC_INC( profilehead );
+	cnovrprofile_event * e = &profilering[seq & (CNOVR_PROFILE_RING_SIZE-1)];
+	//Tricky: Mark the slot as in-progress before touching the payload, then publish it after.
+	//Readers check seq on both sides of their copy (see ProfileReadEvent)
+	PROFILE_STORE_RELEASE( e->seq, 0 );
+	PROFILE_FENCE();
+	e->name = name;
+	e->fn = fn;
+	e->tcctag = tcctag;
+	if( tcctag )
+	{
+		TCCInstance * tce = (TCCInstance*)tcctag;
+		strncpy( e->module, tce->basefilename?tce->basefilename:"?", CNOVR_PROFILE_MODULE_NAME-1 );
+		e->module[CNOVR_PROFILE_MODULE_NAME-1] = 0;
+	}
+	else
+	{
+		strcpy( e->module, "core" );
+	}
+	e->start = start;
+	e->duration = end - start;
+	e->eye = eye;
+	e->thread = ProfileThreadID();
+	e->frame = profileframe;
+	PROFILE_STORE_RELEASE( e->seq, seq + 1 );
+}
+
+//Copies out event number i.  Returns 0 if it was overwritten or is still being written.
+static int ProfileReadEvent( unsigned i, cnovrprofile_event * out )
+{
+	cnovrprofile_event * e = &profilering[i & (CNOVR_PROFILE_RING_SIZE-1)];
+	if( PROFILE_LOAD_ACQUIRE( e->seq ) != i + 1 ) return 0;
+	*out = *e;
+	PROFILE_FENCE();
+	return PROFILE_LOAD_ACQUIRE( e->seq ) == i + 1;
+}
+
+void CNOVRProfileInit()
+{
+	profilethreadtls = OGCreateTLS();
+}
+
+double CNOVRProfilePhase( const char * name, int eye, double start )
+{
+	double now = OGGetAbsoluteTime();
+	CNOVRProfileRecord( name, 0, 0, eye, start, now );
+	return now;
+}
+
+void CNOVRProfileEnable( int enable )
+{
+	profiledisabled = !enable;
+}
+
+int CNOVRProfileIsEnabled()
+{
+	return !profiledisabled;
+}
+
+static int ProfileSummarySlot( const char * phase, const char * module )
+{
+	int i;
+	for( i = 0; i < profilesummarycount; i++ )
+	{
+		cnovrprofile_summary * s = &profilesummary[i];
+		if( phase ? ( s->phase == phase ) : ( !s->phase && strcmp( s->module, module ) == 0 ) )
+			return i;
+	}
+	if( profilesummarycount >= CNOVR_PROFILE_MAX_SUMMARY ) return -1;
+	cnovrprofile_summary * s = &profilesummary[profilesummarycount];
+	memset( s, 0, sizeof( *s ) );
+	s->phase = phase;
+	if( !phase ) strcpy( s->module, module );
+	return profilesummarycount++;
+}
+
+void CNOVRProfileFrameEnd()
+{
+	unsigned head = PROFILE_LOAD_ACQUIRE( profilehead );
+	int i;
+
+	if( head - profiletail > CNOVR_PROFILE_RING_SIZE ) profiletail = head - CNOVR_PROFILE_RING_SIZE;
+
+	for( ; profiletail != head; profiletail++ )
+	{
+		cnovrprofile_event e;
+		if( !ProfileReadEvent( profiletail, &e ) ) continue;
+		//Callbacks are rolled up by module, everything else is a phase.
+		int slot = ProfileSummarySlot( e.fn ? 0 : e.name, e.module );
+		if( slot < 0 ) continue;
+		profilesummaryaccum[slot] += e.duration * 1000.0;
+		profilesummarycalls[slot]++;
+	}
+
+	for( i = 0; i < profilesummarycount; i++ )
+	{
+		cnovrprofile_summary * s = &profilesummary[i];
+		double ms = profilesummaryaccum[i];
+		s->fAveragems = s->fAveragems * .95 + ms * .05;
+		s->fPeakms *= .99;
+		if( ms > s->fPeakms ) s->fPeakms = ms;
+		s->iCalls = profilesummarycalls[i];
+		profilesummaryaccum[i] = 0;
+		profilesummarycalls[i] = 0;
+	}
+
+	profileframe++;
+}
+
+int CNOVRProfileGetSummary( cnovrprofile_summary * out, int max )
+{
+	int n = ( profilesummarycount < max ) ? profilesummarycount : max;
+	memcpy( out, profilesummary, sizeof( cnovrprofile_summary ) * n );
+	return n;
+}
+
+void CNOVRProfilePrintSummary()
+{
+	int i;
+	ovrprintf( "%-32s %9s %9s %6s\n", "Phase/Module", "Avg ms", "Peak ms", "Calls" );
+	for( i = 0; i < profilesummarycount; i++ )
+	{
+		cnovrprofile_summary * s = &profilesummary[i];
+		ovrprintf( "%-32s %9.3f %9.3f %6d\n", s->phase?s->phase:s->module, s->fAveragems, s->fPeakms, s->iCalls );
+	}
+}
+
+//Names come from run lists and modules, so they can have quotes or (on Windows) backslashes in them.
+static void ProfileJSONString( FILE * f, const char * s )
+{
+	if( !s ) s = "?";
+	for( ; *s; s++ )
+	{
+		unsigned char c = *s;
+		if( c == '"' || c == '\\' )
+			fprintf( f, "\\%c", c );
+		else if( c < 0x20 )
+			fprintf( f, "\\u%04x", c );
+		else
+			fputc( c, f );
+	}
+}
+
+int CNOVRProfileDumpChromeTrace( const char * filename )
+{
+	FILE * f = fopen( filename, "w" );
+	if( !f )
+	{
+		ovrprintf( "Error: Could not open %s to write profile trace\n", filename );
+		return -1;
+	}
+
+	unsigned head = PROFILE_LOAD_ACQUIRE( profilehead );
+	unsigned start = ( head > CNOVR_PROFILE_RING_SIZE ) ? head - CNOVR_PROFILE_RING_SIZE : 0;
+	unsigned i;
+	int written = 0;
+
+	fprintf( f, "{\"traceEvents\":[\n" );
+	for( i = start; i != head; i++ )
+	{
+		cnovrprofile_event e;
+		if( !ProfileReadEvent( i, &e ) ) continue;
+		fprintf( f, "%s{\"name\":\"", written?",\n":"" );
+		ProfileJSONString( f, e.fn ? e.module : e.name );
+		if( e.fn )
+			fprintf( f, ":%p", e.fn );
+		fprintf( f, "\",\"cat\":\"" );
+		ProfileJSONString( f, e.fn ? e.name : "phase" );
+		fprintf( f, "\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%d,\"eye\":%d,\"module\":\"",
+			e.thread, e.start*1000000.0, e.duration*1000000.0, e.frame, e.eye );
+		ProfileJSONString( f, e.module );
+		fprintf( f, "\"}}" );
+		written++;
+	}
+	fprintf( f, "\n],\"displayTimeUnit\":\"ms\"}\n" );
+	fclose( f );
+	return written;
+}
+
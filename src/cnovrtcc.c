@@ -14,14 +14,13 @@
 void CNOVRStopTCCSystem();
 
 //TCC Makes use of a lot of global variables which are not TLS.
-//We have to lock around any use of the compiler, itself.
+//We have to lock around any use of the compiler, itself.  Made in CNOVRStartTCCSystem.
 static og_mutex_t tccmutex;
 
 static void StopTCCInstance( TCCInstance * tcc );
 
 static void ReloadTCCInstance( void * tag, void * opaquev )
 {
-	if( !tccmutex ) tccmutex = OGCreateMutex();
 	int r;
 	TCCInstance * tce = (TCCInstance *)opaquev;
 //	printf( "Reloading: %p %p\n", tag, tce );
@@ -229,7 +228,6 @@ TCCInstance * CreateOrRefreshTCCInstance( TCCInstance * tccold, char * tccfilena
 
 void DestroyTCCInstance( TCCInstance * tcc )
 {
-	if( !tccmutex ) tccmutex = OGCreateMutex();
 	CNOVRFileTimeRemoveTagged( tcc, 1 );
 	StopTCCInstance( tcc );
 
@@ -443,6 +441,8 @@ failout:
 
 void CNOVRStartTCCSystem( const char * tccsuitefile )
 {
+	//Reloads run on the async workers, several at once, so this has to exist before any of them can.
+	if( !tccmutex ) tccmutex = OGCreateMutex();
 	CNOVRStopTCCSystem();
 	if( cnovrtccsystem.suitefile ) free( cnovrtccsystem.suitefile );
 	
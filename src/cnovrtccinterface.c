@@ -2,6 +2,7 @@
 #include <cnovrutil.h>
 #include <cnovrcanvas.h>
 #include <cnovrfocus.h>
+#include <cnovrprofile.h>
 #include <tinycc/libtcc.h>
 #include <stdarg.h>
 #include <cnovr.h>
@@ -355,10 +356,9 @@ static cnovr_rf_buffer * TCCCNOVRRFBufferCreate( int w, int h, int multisample )
 	return ret;
 }
 
-
-static cnovr_shader * TCCCNOVRShaderCreateWithPrefix( const char * shaderfilebase, const char * prefix )
+static cnovr_rf_buffer * TCCCNOVRRFBufferCreateArray( int w, int h, int multisample, int layers )
 {
-	cnovr_shader * ret = CNOVRShaderCreateWithPrefix( shaderfilebase, prefix );
+	cnovr_rf_buffer * ret = CNOVRRFBufferCreateArray( w, h, multisample, layers );
 	MARKOGLockMutex( tccinterfacemutex );
 	object_cleanup * c = CNHashGetValue( objects_to_delete, TCCGetTag()  );
 	if( c ) cnptrset_insert( c->tccobjects, ret );
@@ -366,13 +366,42 @@ static cnovr_shader * TCCCNOVRShaderCreateWithPrefix( const char * shaderfilebas
 	return ret;
 }
 
-static cnovr_shader * TCCCNOVRShaderCreate( const char * shaderfilebase )
+
+//Shared assets come back as the same pointer every time, but the module's set only releases each one once.
+//So a module only ever holds one reference, asking again just gives the extra one back.
+static void TCCTrackSharedObject( cnovr_base * b )
 {
-	cnovr_shader * ret = CNOVRShaderCreate( shaderfilebase );
+	if( !b ) return;
+	int dup = 0;
 	MARKOGLockMutex( tccinterfacemutex );
 	object_cleanup * c = CNHashGetValue( objects_to_delete, TCCGetTag()  );
-	if( c ) cnptrset_insert( c->tccobjects, ret );
+	if( c )
+	{
+		if( RBHAS( c->tccobjects, b ) ) dup = 1;
+		else cnptrset_insert( c->tccobjects, b );
+	}
 	MARKOGUnlockMutex( tccinterfacemutex );
+	if( dup ) CNOVRDeleteBase( b );
+}
+
+static cnovr_shader * TCCCNOVRShaderCreateWithPrefix( const char * shaderfilebase, const char * prefix )
+{
+	cnovr_shader * ret = CNOVRShaderCreateWithPrefix( shaderfilebase, prefix );
+	TCCTrackSharedObject( &ret->base );
+	return ret;
+}
+
+static cnovr_shader * TCCCNOVRShaderCreate( const char * shaderfilebase )
+{
+	cnovr_shader * ret = CNOVRShaderCreate( shaderfilebase );
+	TCCTrackSharedObject( &ret->base );
+	return ret;
+}
+
+static cnovr_texture * TCCCNOVRTextureCreateFromFile( const char * texfile, int flags )
+{
+	cnovr_texture * ret = CNOVRTextureCreateFromFile( texfile, flags );
+	TCCTrackSharedObject( &ret->base );
 	return ret;
 }
 
@@ -441,11 +470,21 @@ static void TCCCNOVRJobTack( cnovrQueueType q, cnovr_cb_fn fn, void * tag, void
 	CNOVRJobTack( q, fn, TCCGetTag(), opaquev, insert_even_if_pending );
 }
 
+static void TCCCNOVRJobTackPriority( cnovrQueueType q, cnovr_cb_fn fn, void * tag, void * opaquev, bool insert_even_if_pending, cnovrJobPriority priority )
+{
+	CNOVRJobTackPriority( q, fn, TCCGetTag(), opaquev, insert_even_if_pending, priority );
+}
+
 static void TCCCNOVRListAdd( cnovrRunList l, void * base_object, cnovr_cb_fn * fn )
 {
 	CNOVRListAdd( l, TCCGetTag(), fn );
 }
 
+static void TCCCNOVRListAddPriority( cnovrRunList l, void * base_object, cnovr_cb_fn * fn, int priority )
+{
+	CNOVRListAddPriority( l, TCCGetTag(), fn, priority );
+}
+
 void TCCCNOVRListDeleteTCCTag( void * tcctag )
 {
 	CNOVRListDeleteTCCTag( TCCGetTag() );
@@ -529,6 +568,12 @@ void TCCCNOVRFocusRespond( cnovrfocus_capture * ce, float realdistance, float *
 	CNOVRFocusRespond( ce, realdistance, fdprops );
 }
 
+void TCCCNOVRFocusRespondDev( int devid, cnovrfocus_capture * ce, float realdistance, float * fdprops )
+{
+	ce->tag = TCCGetTag();
+	CNOVRFocusRespondDev( devid, ce, realdistance, fdprops );
+}
+
 void TCCCNOVRFocusAcquire( cnovrfocus_capture * ce, int wantfocus )
 {
 	ce->tag = TCCGetTag();
@@ -569,6 +614,18 @@ void * TCCGetTCCTag()
 	return TCCGetTag();
 }
 
+//Modules bind through the state cache too, or it'd skip binds it thinks are still current.
+static void TCCglBindTexture( GLenum target, GLuint texture )
+{
+	if( target == GL_TEXTURE_2D ) CNOVRStateBindTexture( texture );
+	else glBindTexture( target, texture );
+}
+
+static void TCCglActiveTextureCHEW( GLenum texture )
+{
+	CNOVRStateActiveTexture( texture - GL_TEXTURE0 );
+}
+
 #if defined( WINDOWS  ) || defined ( WIN32 ) || defined( WIN64 )
 //XXX TODO: I think we'll need these maybe?
 static void TCC_InterlockedExchangeAdd( ) { ovrprintf( "Unsupported function\n" );  }
@@ -648,24 +705,37 @@ const struct ImportList ILSYMS[] = {
 	TCCExportS( cnovr_current_shader )
 	TCCExport( CNOVRNodeCreateSimple )
 	TCCExportS( CNOVRVBOTaint )
+	TCCExportS( CNOVRVBOTaintRange )
+	TCCExportS( CNOVRVBOSetDynamic )
 	TCCExport( CNOVRModelCreate )
 	TCCExportS( CNOVRModelSetNumVBOs )
 	TCCExportS( CNOVRCreateVBO )
 	TCCExportS( CNOVRModelTaintIndices )
+	TCCExportS( CNOVRModelOptimizeVertexCache )
 	TCCExportS( CNOVRModelTackIndex )
 	TCCExportS( CNOVRModelRenderWithPose )
+	TCCExportS( CNOVRModelRenderInstanced )
+	TCCExportS( CNOVRModelRenderInstancedMatrices )
 	TCCExportS( CNOVRModelApplyTextureFromFileAsync )
+	TCCExportS( CNOVRModelSetNumTextures )
 	TCCExportS( CNOVRModelAppendMesh )
 	TCCExportS( CNOVRModelLoadFromFileAsync )
+	TCCExportS( CNOVRModelGeometry )
 	TCCExport( CNOVRTextureCreate )
+	TCCExport( CNOVRTextureCreateFromFile )
+	TCCExportS( CNOVRAssetCount )
 	TCCExport( CNOVRShaderCreate )
 	TCCExportS( CNOVRUniform )
 	TCCExport( CNOVRShaderCreateWithPrefix )
 	TCCExport( CNOVRDeleteBase )
 	TCCExportS( CNOVRTextureLoadDataNow )
+	TCCExportS( CNOVRTextureStreamBegin )
+	TCCExportS( CNOVRTextureStreamCommit )
 	TCCExportS( CNOVRTextureLoadFileAsync )
 	TCCExportS( CNOVRModelAppendCube )
 	TCCExportS( CNOVRModelCollide )
+	TCCExportS( CNOVRModelBuildBVH )
+	TCCExportS( CNOVRModelCollideMany )
 	TCCExportS( CNOVRGeneralHandleFocusEvent )
 	TCCExportS( CNOVRFocusDefaultFocusEvent )
 	TCCExportS( CNOVRFocusGetPropsForDev )
@@ -690,24 +760,37 @@ const struct ImportList ILSYMS[] = {
 	TCCExport( CNOVRSplitStrings )
 	TCCExport( CNOVRFileToString )
 	TCCExport( CNOVRJobTack )
+	TCCExport( CNOVRJobTackPriority )
+	TCCExportS( CNOVRJobSetBudget )
+	TCCExportS( CNOVRJobGetStats )
+	TCCExportS( CNOVRProfileRecord )
+	TCCExportS( CNOVRProfilePhase )
+	TCCExportS( CNOVRProfileDumpChromeTrace )
+	TCCExportS( CNOVRProfileGetSummary )
+	TCCExportS( CNOVRProfilePrintSummary )
 	TCCExport( CNOVRListAdd )
+	TCCExport( CNOVRListAddPriority )
 	TCCExport( CNOVRListDeleteTCCTag )
 	TCCExportS( CNOVRListDeleteTag )
 	TCCExport( CNOVRFocusRespond )
+	TCCExport( CNOVRFocusRespondDev )
 	TCCExport( CNOVRFocusAcquire )
 	TCCExport( CNOVRFocusRemoveTag )
 	TCCExportS( CNOVRFocusGetTipPose )
 	TCCExport( CNOVRRFBufferCreate )
+	TCCExport( CNOVRRFBufferCreateArray )
 	TCCExportS( CNOVRFocusGetVRActionHandleFromConrollerAndCtrlA )
 	TCCExportS( CNOVRGetTrackedDeviceString )
 	TCCExportS( CNOVRListCall )
 	TCCExportS( CNOVRFBufferActivate )
+	TCCExportS( CNOVRFBufferActivateLayer )
 	TCCExportS( CNOVRFBufferBlitResolve )
 	TCCExportS( CNOVRCanvasSetPhysicalSize )
 	TCCExportS( CNOVRCanvasYFlip )
 	TCCExportS( CNOVRCanvasApplyCannedGUI )
 	TCCExportS( CNOVRCheck )
-	TCCExportS( glActiveTextureCHEW )
+	TCCExportS( CNOVRFrameUniformsUpdate )
+	TCCExport( glActiveTextureCHEW )
 	TCCExportS( cnovr_interpolate )
 	TCCExportS( cross3d )
 	TCCExportS( sub3d )
@@ -791,6 +874,8 @@ const struct ImportList ILSYMS[] = {
 
 	TCCExportS( CNOVRPoseFromHMDMatrix )
 	TCCExportS( CNOVRVBOTackv )
+	TCCExportS( CNOVRVBOTackN )
+	TCCExportS( CNOVRVBOReserve )
 	TCCExportS( CNOVRModelSetNumVBOsWithStrides )
 
 	TCCExportS( glGenBuffers )
@@ -802,7 +887,7 @@ const struct ImportList ILSYMS[] = {
 	TCCExportS( glUniform4fv )
 	TCCExportS( glUniform4f )
 	TCCExportS( glUniform4fvCHEW )
-	TCCExportS( glBindTexture )
+	TCCExport( glBindTexture )
 	TCCExportS( glTexImage2D )
 	TCCExportS( glGenerateMipmapCHEW )
 	TCCExportS( glEnable )
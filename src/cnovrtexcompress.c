@@ -0,0 +1,479 @@
+#include "cnovrtexcompress.h"
+#include "cnovrutil.h"
+#include "cnovr.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static int Pack565( const float * c )
+{
+	int r = (int)( c[0] * 31.0f / 255.0f + 0.5f );
+	int g = (int)( c[1] * 63.0f / 255.0f + 0.5f );
+	int b = (int)( c[2] * 31.0f / 255.0f + 0.5f );
+	if( r < 0 ) r = 0;
+	if( r > 31 ) r = 31;
+	if( g < 0 ) g = 0;
+	if( g > 63 ) g = 63;
+	if( b < 0 ) b = 0;
+	if( b > 31 ) b = 31;
+	return ( r << 11 ) | ( g << 5 ) | b;
+}
+
+static void Unpack565( int c, int * out )
+{
+	int r = ( c >> 11 ) & 31, g = ( c >> 5 ) & 63, b = c & 31;
+	out[0] = ( r << 3 ) | ( r >> 2 );
+	out[1] = ( g << 2 ) | ( g >> 4 );
+	out[2] = ( b << 3 ) | ( b >> 2 );
+}
+
+//Endpoints are the extremes along the block's principal axis, pulled in by 1/16 so the
+//interpolated colors land where most of the texels are.
+static void EmitColorBlock( const uint8_t block[16][4], uint8_t * out )
+{
+	int i, k;
+	float mean[3] = { 0, 0, 0 };
+	for( i = 0; i < 16; i++ ) for( k = 0; k < 3; k++ ) mean[k] += block[i][k];
+	for( k = 0; k < 3; k++ ) mean[k] /= 16.0f;
+
+	float cov[6] = { 0, 0, 0, 0, 0, 0 };
+	for( i = 0; i < 16; i++ )
+	{
+		float r = block[i][0] - mean[0], g = block[i][1] - mean[1], b = block[i][2] - mean[2];
+		cov[0] += r*r; cov[1] += r*g; cov[2] += r*b;
+		cov[3] += g*g; cov[4] += g*b; cov[5] += b*b;
+	}
+
+	//A few rounds of power iteration is plenty for a 3x3.
+	float axis[3] = { 1, 1, 1 };
+	for( i = 0; i < 4; i++ )
+	{
+		float x = cov[0]*axis[0] + cov[1]*axis[1] + cov[2]*axis[2];
+		float y = cov[1]*axis[0] + cov[3]*axis[1] + cov[4]*axis[2];
+		float z = cov[2]*axis[0] + cov[4]*axis[1] + cov[5]*axis[2];
+		float m = x*x + y*y + z*z;
+		if( m < 1e-6f ) break;
+		m = 1.0f / sqrtf( m );
+		axis[0] = x * m; axis[1] = y * m; axis[2] = z * m;
+	}
+
+	float minp = 1e30f, maxp = -1e30f;
+	for( i = 0; i < 16; i++ )
+	{
+		float p = ( block[i][0] - mean[0] ) * axis[0] + ( block[i][1] - mean[1] ) * axis[1] + ( block[i][2] - mean[2] ) * axis[2];
+		if( p < minp ) minp = p;
+		if( p > maxp ) maxp = p;
+	}
+	float inset = ( maxp - minp ) / 16.0f;
+	minp += inset;
+	maxp -= inset;
+
+	float e0[3], e1[3];
+	for( k = 0; k < 3; k++ )
+	{
+		e0[k] = mean[k] + axis[k] * maxp;
+		e1[k] = mean[k] + axis[k] * minp;
+	}
+	int c0 = Pack565( e0 );
+	int c1 = Pack565( e1 );
+	//c0 > c1 picks 4-color mode.
+	if( c0 < c1 ) { int t = c0; c0 = c1; c1 = t; }
+
+	uint32_t indices = 0;
+	if( c0 != c1 )
+	{
+		int pal[4][3];
+		Unpack565( c0, pal[0] );
+		Unpack565( c1, pal[1] );
+		for( k = 0; k < 3; k++ )
+		{
+			pal[2][k] = ( 2 * pal[0][k] + pal[1][k] ) / 3;
+			pal[3][k] = ( pal[0][k] + 2 * pal[1][k] ) / 3;
+		}
+		for( i = 0; i < 16; i++ )
+		{
+			int best = 0, bestd = 0x7fffffff, j;
+			for( j = 0; j < 4; j++ )
+			{
+				int dr = block[i][0] - pal[j][0], dg = block[i][1] - pal[j][1], db = block[i][2] - pal[j][2];
+				int d = dr*dr + dg*dg + db*db;
+				if( d < bestd ) { bestd = d; best = j; }
+			}
+			indices |= best << ( i * 2 );
+		}
+	}
+
+	out[0] = c0 & 0xff; out[1] = c0 >> 8;
+	out[2] = c1 & 0xff; out[3] = c1 >> 8;
+	out[4] = indices; out[5] = indices >> 8; out[6] = indices >> 16; out[7] = indices >> 24;
+}
+
+static void EmitAlphaBlock( const uint8_t block[16][4], uint8_t * out )
+{
+	int i, j;
+	int a0 = 0, a1 = 255;
+	for( i = 0; i < 16; i++ )
+	{
+		if( block[i][3] > a0 ) a0 = block[i][3];
+		if( block[i][3] < a1 ) a1 = block[i][3];
+	}
+	out[0] = a0;
+	out[1] = a1;
+
+	//a0 > a1 is the 8-value mode: a0, a1, then 6 steps between.
+	int pal[8];
+	pal[0] = a0; pal[1] = a1;
+	for( i = 1; i < 7; i++ ) pal[i+1] = ( ( 7 - i ) * a0 + i * a1 ) / 7;
+
+	uint64_t indices = 0;
+	if( a0 != a1 )
+	{
+		for( i = 0; i < 16; i++ )
+		{
+			int best = 0, bestd = 256;
+			for( j = 0; j < 8; j++ )
+			{
+				int d = abs( block[i][3] - pal[j] );
+				if( d < bestd ) { bestd = d; best = j; }
+			}
+			indices |= (uint64_t)best << ( i * 3 );
+		}
+	}
+	for( i = 0; i < 6; i++ ) out[2+i] = indices >> ( i * 8 );
+}
+
+size_t CNOVRTexCompressLevelSize( int format, int w, int h )
+{
+	return (size_t)( ( w + 3 ) / 4 ) * ( ( h + 3 ) / 4 ) * ( ( format == CNOVR_TEXCOMPRESS_BC1 ) ? 8 : 16 );
+}
+
+
+///
+/// Mip chains.  2x2 box filter, an odd last row/column gets dropped like glGenerateMipmap does.
+///
+
+#if !defined( __TINYC__ ) && ( defined( __x86_64__ ) || defined( _M_X64 ) || ( defined( __i386__ ) && defined( __SSE2__ ) ) )
+#define CNOVR_TEXMIPS_SIMD
+#include <emmintrin.h>
+#endif
+
+int CNOVRTexMipLevels( int w, int h )
+{
+	int levels = 1;
+	while( w > 1 || h > 1 )
+	{
+		w = ( w > 1 ) ? w / 2 : 1;
+		h = ( h > 1 ) ? h / 2 : 1;
+		levels++;
+	}
+	return levels;
+}
+
+//sRGB <-> 16-bit linear.  The way back is a full 64k table, so dark colors don't band.
+static uint16_t tex_srgb_to_linear[256];
+static uint8_t tex_linear_to_srgb[65536];
+static volatile int tex_srgb_ready;
+
+static void TexBuildSRGBTables()
+{
+	//Tricky: Two loader threads can both end up building these.  They write the same values, so let them.
+	if( tex_srgb_ready ) return;
+	int i;
+	for( i = 0; i < 256; i++ )
+	{
+		double c = i / 255.0;
+		c = ( c <= 0.04045 ) ? c / 12.92 : pow( ( c + 0.055 ) / 1.055, 2.4 );
+		tex_srgb_to_linear[i] = (uint16_t)( c * 65535.0 + 0.5 );
+	}
+	for( i = 0; i < 65536; i++ )
+	{
+		double l = i / 65535.0;
+		l = ( l <= 0.0031308 ) ? l * 12.92 : 1.055 * pow( l, 1.0 / 2.4 ) - 0.055;
+		tex_linear_to_srgb[i] = (uint8_t)( l * 255.0 + 0.5 );
+	}
+	tex_srgb_ready = 1;
+}
+
+static void TexMipDownsample( const uint8_t * src, int w, int h, uint8_t * dst, int mode )
+{
+	int nw = ( w > 1 ) ? w / 2 : 1;
+	int nh = ( h > 1 ) ? h / 2 : 1;
+	int x, y, k;
+	for( y = 0; y < nh; y++ )
+	{
+		int y0 = y * 2;
+		const uint8_t * r0 = src + y0 * w * 4;
+		const uint8_t * r1 = src + ( ( y0 + 1 < h ) ? y0 + 1 : y0 ) * w * 4;
+		uint8_t * o = dst + y * nw * 4;
+		x = 0;
+		if( mode == CNOVR_TEXMIPS_SRGB )
+		{
+			//Average in linear light, otherwise everything darkens as it goes down the chain.  Alpha is already linear.
+			for( ; x < nw; x++ )
+			{
+				int a = x * 8;
+				int b = ( x * 2 + 1 < w ) ? a + 4 : a;
+				for( k = 0; k < 3; k++ )
+					o[x*4+k] = tex_linear_to_srgb[( tex_srgb_to_linear[r0[a+k]] + tex_srgb_to_linear[r0[b+k]] +
+						tex_srgb_to_linear[r1[a+k]] + tex_srgb_to_linear[r1[b+k]] + 2 ) >> 2];
+				o[x*4+3] = ( r0[a+3] + r0[b+3] + r1[a+3] + r1[b+3] + 2 ) >> 2;
+			}
+			continue;
+		}
+#ifdef CNOVR_TEXMIPS_SIMD
+		//Four output pixels at a time while all eight source pixels are in the row.  Same rounding as below.
+		const __m128i z = _mm_setzero_si128();
+		const __m128i two = _mm_set1_epi16( 2 );
+		for( ; x + 4 <= nw && x * 2 + 8 <= w; x += 4 )
+		{
+			__m128i a0 = _mm_loadu_si128( (const __m128i*)( r0 + x * 8 ) );
+			__m128i a1 = _mm_loadu_si128( (const __m128i*)( r0 + x * 8 + 16 ) );
+			__m128i b0 = _mm_loadu_si128( (const __m128i*)( r1 + x * 8 ) );
+			__m128i b1 = _mm_loadu_si128( (const __m128i*)( r1 + x * 8 + 16 ) );
+			//Vertical sums, two source pixels per register.
+			__m128i s0 = _mm_add_epi16( _mm_unpacklo_epi8( a0, z ), _mm_unpacklo_epi8( b0, z ) );
+			__m128i s1 = _mm_add_epi16( _mm_unpackhi_epi8( a0, z ), _mm_unpackhi_epi8( b0, z ) );
+			__m128i s2 = _mm_add_epi16( _mm_unpacklo_epi8( a1, z ), _mm_unpacklo_epi8( b1, z ) );
+			__m128i s3 = _mm_add_epi16( _mm_unpackhi_epi8( a1, z ), _mm_unpackhi_epi8( b1, z ) );
+			//Then even + odd source pixels.
+			__m128i t0 = _mm_add_epi16( _mm_unpacklo_epi64( s0, s1 ), _mm_unpackhi_epi64( s0, s1 ) );
+			__m128i t1 = _mm_add_epi16( _mm_unpacklo_epi64( s2, s3 ), _mm_unpackhi_epi64( s2, s3 ) );
+			t0 = _mm_srli_epi16( _mm_add_epi16( t0, two ), 2 );
+			t1 = _mm_srli_epi16( _mm_add_epi16( t1, two ), 2 );
+			_mm_storeu_si128( (__m128i*)( o + x * 4 ), _mm_packus_epi16( t0, t1 ) );
+		}
+#endif
+		for( ; x < nw; x++ )
+		{
+			int a = x * 8;
+			int b = ( x * 2 + 1 < w ) ? a + 4 : a;
+			for( k = 0; k < 4; k++ )
+				o[x*4+k] = ( r0[a+k] + r0[b+k] + r1[a+k] + r1[b+k] + 2 ) >> 2;
+		}
+	}
+}
+
+static size_t TexMipChainSize( int w, int h, int levels )
+{
+	size_t total = 0;
+	int i;
+	for( i = 0; i < levels; i++ )
+	{
+		total += (size_t)w * h * 4;
+		w = ( w > 1 ) ? w / 2 : 1;
+		h = ( h > 1 ) ? h / 2 : 1;
+	}
+	return total;
+}
+
+uint8_t * CNOVRTexMipChainRGBA( uint8_t * rgba, int w, int h, int mips, int * levels, size_t * size )
+{
+	int nlevels = mips ? CNOVRTexMipLevels( w, h ) : 1;
+	size_t total = TexMipChainSize( w, h, nlevels );
+	uint8_t * ret = realloc( rgba, total );
+	if( !ret )
+	{
+		ret = rgba;
+		nlevels = 1;
+		total = (size_t)w * h * 4;
+	}
+	if( mips == CNOVR_TEXMIPS_SRGB ) TexBuildSRGBTables();
+
+	uint8_t * level = ret;
+	int i;
+	for( i = 1; i < nlevels; i++ )
+	{
+		uint8_t * next = level + (size_t)w * h * 4;
+		TexMipDownsample( level, w, h, next, mips );
+		level = next;
+		w = ( w > 1 ) ? w / 2 : 1;
+		h = ( h > 1 ) ? h / 2 : 1;
+	}
+	*levels = nlevels;
+	*size = total;
+	return ret;
+}
+
+///
+/// Block compression.
+///
+
+static void CompressLevel( const uint8_t * rgba, int w, int h, int format, uint8_t * out )
+{
+	int bx, by, x, y;
+	uint8_t block[16][4];
+	for( by = 0; by < h; by += 4 )
+	for( bx = 0; bx < w; bx += 4 )
+	{
+		//Partial blocks on the edges just repeat the last row/column.
+		for( y = 0; y < 4; y++ )
+		for( x = 0; x < 4; x++ )
+		{
+			int sx = ( bx + x < w ) ? bx + x : w - 1;
+			int sy = ( by + y < h ) ? by + y : h - 1;
+			memcpy( block[x+y*4], rgba + ( sx + sy * w ) * 4, 4 );
+		}
+		if( format == CNOVR_TEXCOMPRESS_BC3 )
+		{
+			EmitAlphaBlock( block, out );
+			out += 8;
+		}
+		EmitColorBlock( block, out );
+		out += 8;
+	}
+}
+
+static size_t TexCompressChainSize( int format, int w, int h, int levels )
+{
+	size_t total = 0;
+	int i;
+	for( i = 0; i < levels; i++ )
+	{
+		total += CNOVRTexCompressLevelSize( format, w, h );
+		w = ( w > 1 ) ? w / 2 : 1;
+		h = ( h > 1 ) ? h / 2 : 1;
+	}
+	return total;
+}
+
+uint8_t * CNOVRTexCompressRGBA( const uint8_t * rgba, int w, int h, int mips, int * format, int * levels, size_t * size )
+{
+	int i;
+	int fmt = CNOVR_TEXCOMPRESS_BC1;
+	for( i = 0; i < w * h; i++ )
+		if( rgba[i*4+3] != 255 ) { fmt = CNOVR_TEXCOMPRESS_BC3; break; }
+
+	int nlevels = mips ? CNOVRTexMipLevels( w, h ) : 1;
+	size_t total = TexCompressChainSize( fmt, w, h, nlevels );
+
+	uint8_t * ret = malloc( total );
+	uint8_t * out = ret;
+	const uint8_t * level = rgba;
+	uint8_t * scratch = 0;
+	if( mips == CNOVR_TEXMIPS_SRGB ) TexBuildSRGBTables();
+	int lw = w, lh = h;
+	for( i = 0; i < nlevels; i++ )
+	{
+		CompressLevel( level, lw, lh, fmt, out );
+		out += CNOVRTexCompressLevelSize( fmt, lw, lh );
+		if( i == nlevels - 1 ) break;
+
+		int nw = ( lw > 1 ) ? lw / 2 : 1;
+		int nh = ( lh > 1 ) ? lh / 2 : 1;
+		uint8_t * next = malloc( (size_t)nw * nh * 4 );
+		TexMipDownsample( level, lw, lh, next, mips );
+		free( scratch );
+		scratch = next;
+		level = next;
+		lw = nw;
+		lh = nh;
+	}
+	free( scratch );
+
+	*format = fmt;
+	*levels = nlevels;
+	*size = total;
+	return ret;
+}
+
+///
+/// Texture cache.  Same idea as the mesh cache: header, source path (padded to 4), then the blob.
+///
+
+#define CNOVR_TEXCACHE_VERSION 2
+
+struct TexCacheHeader
+{
+	char     magic[4];  //"CNTC"
+	uint32_t version;
+	double   srctime;
+	uint32_t pathlen;
+	uint32_t format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t levels;
+	uint32_t mips;      //CNOVR_TEXMIPS_*
+	uint32_t size;
+};
+
+uint8_t * CNOVRTexCompressCacheLoad( const char * filename, double srctime, int mips, int * w, int * h, int * format, int * levels, size_t * size )
+{
+	int len, mapped;
+	const char * data = CNOVRFileMap( trprintf( "%s.texcache", filename ), &len, &mapped );
+	if( !data ) return 0;
+
+	const struct TexCacheHeader * hd = (const struct TexCacheHeader *)data;
+	const char * p = data + sizeof( *hd );
+	uint8_t * ret = 0;
+	if( len < sizeof( *hd ) || memcmp( hd->magic, "CNTC", 4 ) || hd->version != CNOVR_TEXCACHE_VERSION ||
+		hd->srctime != srctime || hd->mips != mips ||
+		hd->pathlen != strlen( filename ) || sizeof( *hd ) + ( ( hd->pathlen + 3 ) & ~3 ) > len ||
+		memcmp( p, filename, hd->pathlen ) )
+		goto reject;
+
+	//Don't trust anything else in the header either, the blob has to be exactly the chain it says it is.
+	if( ( hd->format != CNOVR_TEXCOMPRESS_BC1 && hd->format != CNOVR_TEXCOMPRESS_BC3 ) ||
+		hd->width < 1 || hd->height < 1 || hd->width > 65536 || hd->height > 65536 ||
+		hd->levels != ( mips ? CNOVRTexMipLevels( hd->width, hd->height ) : 1 ) ||
+		hd->size != TexCompressChainSize( hd->format, hd->width, hd->height, hd->levels ) ||
+		sizeof( *hd ) + ( ( hd->pathlen + 3 ) & ~3 ) + (size_t)hd->size != len )
+	{
+		CNOVRAlert( 0, 2, "Warning: Texture cache for %s is corrupt, recompressing\n", filename );
+		goto reject;
+	}
+	p += ( hd->pathlen + 3 ) & ~3;
+
+	ret = malloc( hd->size );
+	memcpy( ret, p, hd->size );
+	*w = hd->width;
+	*h = hd->height;
+	*format = hd->format;
+	*levels = hd->levels;
+	*size = hd->size;
+	CNOVRFileUnmap( data, len, mapped );
+	return ret;
+reject:
+	CNOVRFileUnmap( data, len, mapped );
+	return 0;
+}
+
+void CNOVRTexCompressCacheSave( const char * filename, double srctime, int mips, int w, int h, int format, int levels, const uint8_t * blob, size_t size )
+{
+	static const char zeroes[4];
+	char * path = strdup( trprintf( "%s.texcache", filename ) );
+	char * tmppath = strdup( trprintf( "%s.tmp", path ) );
+	FILE * f = fopen( tmppath, "wb" );
+	if( !f ) goto done;
+
+	struct TexCacheHeader hd;
+	memset( &hd, 0, sizeof( hd ) );
+	memcpy( hd.magic, "CNTC", 4 );
+	hd.version = CNOVR_TEXCACHE_VERSION;
+	hd.srctime = srctime;
+	hd.pathlen = strlen( filename );
+	hd.format = format;
+	hd.width = w;
+	hd.height = h;
+	hd.levels = levels;
+	hd.mips = mips;
+	hd.size = size;
+	fwrite( &hd, sizeof( hd ), 1, f );
+	fwrite( filename, hd.pathlen, 1, f );
+	if( hd.pathlen & 3 ) fwrite( zeroes, 4 - ( hd.pathlen & 3 ), 1, f );
+	fwrite( blob, size, 1, f );
+
+	if( ferror( f ) )
+	{
+		fclose( f );
+		remove( tmppath );
+		goto done;
+	}
+	fclose( f );
+	//Write then rename so a half-written cache is never picked up.
+	remove( path );
+	rename( tmppath, path );
+done:
+	free( path );
+	free( tmppath );
+}
@@ -11,12 +11,16 @@
 #include <stretchy_buffer.h>
 #include "cnovrtccinterface.h"
 #include "cnovr.h"
+#include "cnovrprofile.h"
 
 #if defined(WINDOWS) || defined( WIN32 ) || defined( WIN64 )
 #include <windows.h>
 #else
 #include <dirent.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -356,6 +360,68 @@ char * CNOVRFileToString( const char * fname, int * length )
 	return ret;
 }
 
+static const uint8_t * InternalBuiltinFile( const char * fname, int * size );
+
+const char * CNOVRFileMap( const char * fname, int * length, int * mapped )
+{
+	*length = 0;
+	*mapped = 0;
+
+	//Same order as __wrap_fopen, files built into the executable win.  They're already in memory.
+	const char * builtin = (const char*)InternalBuiltinFile( fname, length );
+	if( builtin ) return builtin;
+
+#if defined(WINDOWS) || defined( WIN32 ) || defined( WIN64 )
+	HANDLE f = CreateFileA( fname, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0 );
+	if( f == INVALID_HANDLE_VALUE ) return 0;
+	DWORD len = GetFileSize( f, 0 );
+	if( len == 0 || len == INVALID_FILE_SIZE )
+	{
+		CloseHandle( f );
+		return ( len == 0 ) ? "" : 0;
+	}
+	HANDLE mh = CreateFileMappingA( f, 0, PAGE_READONLY, 0, 0, 0 );
+	CloseHandle( f );
+	if( !mh ) return 0;
+	//The view keeps the mapping alive.
+	const char * ret = MapViewOfFile( mh, FILE_MAP_READ, 0, 0, 0 );
+	CloseHandle( mh );
+	if( ret ) { *length = len; *mapped = 1; }
+	return ret;
+#else
+	int fd = open( fname, O_RDONLY );
+	if( fd < 0 ) return 0;
+	struct stat st;
+	if( fstat( fd, &st ) )
+	{
+		close( fd );
+		return 0;
+	}
+	if( st.st_size == 0 )
+	{
+		close( fd );
+		return "";
+	}
+	void * ret = mmap( 0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if( ret == MAP_FAILED ) return 0;
+	madvise( ret, st.st_size, MADV_SEQUENTIAL );
+	*length = st.st_size;
+	*mapped = 1;
+	return ret;
+#endif
+}
+
+void CNOVRFileUnmap( const char * data, int length, int mapped )
+{
+	if( !data || !mapped ) return;
+#if defined(WINDOWS) || defined( WIN32 ) || defined( WIN64 )
+	UnmapViewOfFile( data );
+#else
+	munmap( (void*)data, length );
+#endif
+}
+
 char ** CNOVRSplitStrings( const char * line, char * split, char * white, int merge_fields, int * elementcount )
 {
 	if( elementcount ) *elementcount = 0;
@@ -497,6 +563,7 @@ static int CheckFileExists(const char * szPath)
 		!(dwAttrib & FILE_ATTRIBUTE_DIRECTORY));
 }
 int InternalCheckFileExists( const char * path ) { return 0; }
+static const uint8_t * InternalBuiltinFile( const char * fname, int * size ) { return 0; }
 #endif
 
 char * CNOVRFileSearch( const char * fname )
@@ -654,7 +721,8 @@ void InternalFileSearchShutdown()
 //An example in-memory file.
 __attribute__((used)) const char IOF_testmemfile_txt[] = { 0x07, 0x00, 0x00, 0x00, 'm', 'e', 'm', 'f', 'i', 'l', 'e' };
 
-static int InternalCheckFileExists( const char * fname )
+//Returns the contents if this file is built into the executable, 0 if not.
+static const uint8_t * InternalBuiltinFile( const char * fname, int * size )
 {
 	//See if this symbol already exists in the executable.
 	char stbuff[PATH_MAX+5];
@@ -674,10 +742,15 @@ static int InternalCheckFileExists( const char * fname )
 		if( c == 0 ) break;
 	}
 	uint8_t * v = dlsym( 0/*RTLD_DEFAULT?*/, stbuff );
-	if( v )
-		return 1;
-	else
-		return 0;
+	if( !v ) return 0;
+	*size = v[0] | (v[1]<<8) | (v[2]<<16) | (v[3]<<24);
+	return v + 4;
+}
+
+static int InternalCheckFileExists( const char * fname )
+{
+	int size;
+	return InternalBuiltinFile( fname, &size ) != 0;
 }
 #include <signal.h>
 
@@ -686,30 +759,10 @@ FILE * __wrap_fopen( const char * fname, const char * mode )
 {
 	if( mode && mode[0] == 'r' && fname && fname[0] )
 	{
-		//See if this symbol already exists in the executable.
-		char stbuff[PATH_MAX+5];
-
-		//The symbol is IOF_(filename) where filename has .'s and /'s replaced with _'s
-		stbuff[0] = 'I';
-		stbuff[1] = 'O';
-		stbuff[2] = 'F';
-		stbuff[3] = '_';
-		int i;
-		for( i = 0; i < PATH_MAX; i++ )
-		{
-			char c = fname[i];
-			if( c == '/' ) c = '_';
-			if( c == '.' ) c = '_';
-			stbuff[i+4] = c;
-			if( c == 0 ) break;
-		}
-		uint8_t * v = dlsym( 0/*RTLD_DEFAULT?*/, stbuff );
+		int size;
+		const uint8_t * v = InternalBuiltinFile( fname, &size );
 		if( v )
-		{
-			int size = v[0] | (v[1]<<8) | (v[2]<<16) | (v[3]<<24);
-			v += 4;
-			return fmemopen( v, size, mode );
-		}
+			return fmemopen( (void*)v, size, mode );
 		//File was not found.
 	}
 #if 0
@@ -751,6 +804,8 @@ typedef struct filetimedata_t
 	filetimetagged * front;
 	int list_changed;
 	double time_noticed;
+	const char * fname; //Same as the key in htFileTimeCacher
+	int dirty;          //In ftdirty, waiting to settle.
 } filetimedata;
 
 static filetimedata * ftopscurrent; //Mechanism to make new adds from in-process adds not get run.
@@ -759,87 +814,251 @@ static filetimedata * ftopscurrent; //Mechanism to make new adds from in-process
 static CNOVRIndexedList * ftindexlist;
 static filetimetagged ftstaged; //Current callback, used to make sure we don't delete something ongoing.
 
-void * thdfiletimechecker( void * v )
+#define TIME_TO_WAIT_AFTER_FILE_CHANGE_BEFORE_DOING_SOMETHING .2
+
+//On Linux, we watch the directories of every file with inotify and only look at files something
+//happened to.  Otherwise (or if inotify is unavailable) we fall back to polling every file.
+#if defined( __linux__ )
+#define CNOVR_INOTIFY
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+static int ftinotify = -1;
+static cnhashtable * ftwatcheddirs;  //prefix (i.e. "assets/") -> wd
+static cnhashtable * ftwdprefixes;   //wd -> stretchy buffer of prefixes, one dir can be reached many ways.
+#endif
+static filetimedata ** ftdirty;      //stretchy buffer
+
+static filetimedata * FileTimeNewData( const char * fname );
+
+static void FileTimeMarkDirty( filetimedata * k, double Now )
+{
+	//Each event pushes the deadline back, so a file being written in pieces only fires once.
+	k->time_noticed = Now;
+	if( !k->dirty )
+	{
+		k->dirty = 1;
+		sb_push( ftdirty, k );
+	}
+}
+
+//Must hold mutFileTimeCacher.  Returns nonzero if the file has changed but hasn't settled yet.
+static int FileTimeCheck( filetimedata * k, double Now )
+{
+	double ft = OGGetFileTime( k->fname );
+	if( k->time == ft )
+	{
+		k->time_noticed = 0;
+		return 0;
+	}
+	if( k->time_noticed == 0 ) k->time_noticed = Now;
+	if( Now - k->time_noticed <= TIME_TO_WAIT_AFTER_FILE_CHANGE_BEFORE_DOING_SOMETHING && k->time >= 1 )
+		return 1;
+
+	k->time_noticed = 0;
+	double origtime = k->time;
+	k->time = ft;
+	ftopscurrent = k;
+	if( origtime > 1 ) //Make sure this isn't a first-time catch.
+	{
+		filetimetagged * l;
+		filetimetagged * staged;
+
+		l = k->front;
+		while( l )
+		{
+			l->called_this_set = 0;
+			l = l->next;
+		}
+refresh_set:
+		staged = &ftstaged;
+		l = k->front;
+		while( l )
+		{
+			staged->tag = l->tag;
+			staged->opaquev = l->opaquev;
+			staged->fn = l->fn;
+			staged->tcctag = l->tcctag;
+			if( l->called_this_set ) { l = l->next; continue; }
+			l->called_this_set = 1;
+			k->list_changed = 0; //Would not be possible to trigger in callback.
+			OGTSUnlockMutex( mutFileTimeCacher );
+			//printf( "calling %p with *%p* %p in %p\n", l->fn, k->fname, l->opaquev, l->tag );
+			if( l->fn ) TCCInvocation( l->tcctag, l->fn( l->tag, l->opaquev ) );
+			OGTSLockMutex( mutFileTimeCacher );
+			if( k->list_changed )
+			{
+				k->list_changed = 0;
+				goto refresh_set;
+			}
+			staged->tag = 0;
+			staged->opaquev = 0;
+			staged->fn = 0;
+			staged->tcctag = 0;
+			l = l->next;
+		}
+	}
+	ftopscurrent = 0;
+	return 0;
+}
+
+static void FileTimePollAll()
 {
 	int i;
-	while( !intStopFileTimeCacher )
+	//Tricky: This is safe because array_size only increases.
+	OGTSLockMutex( mutFileTimeCacher );
+	for( i = 0; i < htFileTimeCacher->array_size; i++ )
 	{
-		//Tricky: This is safe because array_size only increases.
-		OGTSLockMutex( mutFileTimeCacher );
-		for( i = 0; i < htFileTimeCacher->array_size; i++ )
+		cnhashelement * e = htFileTimeCacher->elements + i;
+		if( e->data )
 		{
-			cnhashelement * e = htFileTimeCacher->elements + i;
-			if( e->data )
+			FileTimeCheck( (filetimedata*)e->data, OGGetAbsoluteTime() );
+			while( OGGetSema( semPendinger ) == 0 ) OGUnlockSema( semPendinger ); 
+			OGTSUnlockMutex( mutFileTimeCacher );
+			OGUSleep( 1000 );
+			//CNOVRListCall( cnovrLFTCheck, 0, 0 );
+			OGTSLockMutex( mutFileTimeCacher );
+		}
+	}
+	OGTSUnlockMutex( mutFileTimeCacher );
+	OGUSleep( 1000 );
+}
+
+#ifdef CNOVR_INOTIFY
+//Must hold mutFileTimeCacher.
+static void FileTimeWatchDirectory( const char * fname )
+{
+	const char * slash = strrchr( fname, '/' );
+	int prefixlen = slash ? ( slash - fname + 1 ) : 0;
+	char * prefix = malloc( prefixlen + 1 );
+	memcpy( prefix, fname, prefixlen );
+	prefix[prefixlen] = 0;
+
+	if( CNHashGetValue( ftwatcheddirs, prefix ) )
+	{
+		free( prefix );
+		return;
+	}
+
+	char * dir = strdup( prefixlen ? prefix : "." );
+	if( prefixlen > 1 ) dir[prefixlen-1] = 0;
+	int wd = inotify_add_watch( ftinotify, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_MODIFY | IN_ATTRIB | IN_DELETE );
+	free( dir );
+	if( wd < 0 )
+	{
+		//Directory may not exist yet.  Polling the file would not find it either.
+		free( prefix );
+		return;
+	}
+
+	CNHashInsert( ftwatcheddirs, prefix, (void*)(intptr_t)wd );
+	cnhashelement * e = CNHashIndex( ftwdprefixes, (void*)(intptr_t)wd );
+	char ** prefixes = (char**)e->data;
+	sb_push( prefixes, prefix );
+	e->data = prefixes;
+}
+
+static void FileTimeHandleINotify()
+{
+	char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	char full[CNOVR_MAX_PATH+1];
+	int len;
+	double Now = OGGetAbsoluteTime();
+
+	OGTSLockMutex( mutFileTimeCacher );
+	while( ( len = read( ftinotify, buf, sizeof( buf ) ) ) > 0 )
+	{
+		char * ptr;
+		for( ptr = buf; ptr < buf + len; ptr += sizeof( struct inotify_event ) + ((struct inotify_event*)ptr)->len )
+		{
+			const struct inotify_event * ev = (const struct inotify_event *)ptr;
+			if( ev->mask & IN_Q_OVERFLOW )
 			{
-				double Now = OGGetAbsoluteTime();
-				double ft = OGGetFileTime( e->key );
-				filetimedata * front = ((filetimedata*)e->data);
-				filetimedata * k = front;
-				//Ugh.  Yucky logic.
-				#define TIME_TO_WAIT_AFTER_FILE_CHANGE_BEFORE_DOING_SOMETHING .2
-				if( k->time != ft && k->time_noticed == 0 ) k->time_noticed = Now;
-				if( k->time != ft && ( Now - k->time_noticed > TIME_TO_WAIT_AFTER_FILE_CHANGE_BEFORE_DOING_SOMETHING || k->time < 1 ) )
+				//Lost events, so we have to look at everything.
+				int i;
+				for( i = 0; i < htFileTimeCacher->array_size; i++ )
 				{
-					k->time_noticed = 0;
-					double origtime = k->time;
-					k->time = ft;
-					ftopscurrent = k;
-					if( origtime > 1 ) //Make sure this isn't a first-time catch.
-					{
-						filetimetagged * l;
-						filetimetagged * staged;
-
-						l = k->front;
-						while( l )
-						{
-							l->called_this_set = 0;
-							l = l->next;
-						}
-refresh_set:
-						e = htFileTimeCacher->elements + i; //Tricky: If the loop is hit, and we have a table alteration within the loop, the array could become corrupt.
-						front = ((filetimedata*)e->data);
-						staged = &ftstaged;
-						l = k->front;
-						while( l )
-						{
-							staged->tag = l->tag;
-							staged->opaquev = l->opaquev;
-							staged->fn = l->fn;
-							staged->tcctag = l->tcctag;
-							if( l->called_this_set ) { l = l->next; continue; }
-							l->called_this_set = 1;
-							front->list_changed = 0; //Would not be possible to trigger in callback.
-							OGTSUnlockMutex( mutFileTimeCacher );
-							//printf( "calling %p with *%p* %p in %p\n", l->fn, e->key, l->opaquev, l->tag );
-							if( l->fn ) TCCInvocation( l->tcctag, l->fn( l->tag, l->opaquev ) );
-							OGTSLockMutex( mutFileTimeCacher );
-							if( front->list_changed )
-							{
-								front->list_changed = 0;
-								goto refresh_set;
-							}
-							staged->tag = 0;
-							staged->opaquev = 0;
-							staged->fn = 0;
-							staged->tcctag = 0;
-							l = l->next;
-						}
-					}
-					ftopscurrent = 0;
+					cnhashelement * e = htFileTimeCacher->elements + i;
+					if( e->data ) FileTimeMarkDirty( (filetimedata*)e->data, Now );
 				}
-				while( OGGetSema( semPendinger ) == 0 ) OGUnlockSema( semPendinger ); 
-				OGTSUnlockMutex( mutFileTimeCacher );
-				OGUSleep( 1000 );
-				//CNOVRListCall( cnovrLFTCheck, 0, 0 );
-				OGTSLockMutex( mutFileTimeCacher );
+				continue;
+			}
+			if( !ev->len ) continue;
+			char ** prefixes = (char**)CNHashGetValue( ftwdprefixes, (void*)(intptr_t)ev->wd );
+			int p;
+			for( p = 0; p < sb_count( prefixes ); p++ )
+			{
+				snprintf( full, sizeof( full ), "%s%s", prefixes[p], ev->name );
+				filetimedata * k = (filetimedata*)CNHashGetValue( htFileTimeCacher, full );
+				if( k ) FileTimeMarkDirty( k, Now );
+			}
+		}
+	}
+	OGTSUnlockMutex( mutFileTimeCacher );
+}
+#endif
+
+static void FileTimeSettleDirty()
+{
+	int i;
+	OGTSLockMutex( mutFileTimeCacher );
+	filetimedata ** check = ftdirty;
+	ftdirty = 0;
+	for( i = 0; i < sb_count( check ); i++ )
+	{
+		filetimedata * k = check[i];
+		k->dirty = 0;
+		if( FileTimeCheck( k, OGGetAbsoluteTime() ) && !k->dirty )
+		{
+			k->dirty = 1;
+			sb_push( ftdirty, k );
+		}
+	}
+	sb_free( check );
+	while( OGGetSema( semPendinger ) == 0 ) OGUnlockSema( semPendinger ); 
+	OGTSUnlockMutex( mutFileTimeCacher );
+}
+
+void * thdfiletimechecker( void * v )
+{
+	while( !intStopFileTimeCacher )
+	{
+#ifdef CNOVR_INOTIFY
+		if( ftinotify >= 0 )
+		{
+			//Wake up often enough to notice we're quitting, or to let dirty files settle.
+			struct pollfd pfd = { ftinotify, POLLIN, 0 };
+			if( poll( &pfd, 1, sb_count( ftdirty ) ? 20 : 100 ) > 0 )
+			{
+				FileTimeHandleINotify();
 			}
+			if( sb_count( ftdirty ) ) FileTimeSettleDirty();
+			continue;
 		}
-		OGTSUnlockMutex( mutFileTimeCacher );
-		OGUSleep( 1000 );
+#endif
+		FileTimePollAll();
 	}
 	return 0;
 }
 
+//Must hold mutFileTimeCacher.
+static filetimedata * FileTimeNewData( const char * fname )
+{
+	filetimedata * in = malloc( sizeof( filetimedata ) );
+	char * key = strdup( fname );
+	in->front = 0;
+	in->time = OGGetFileTime( fname );
+	in->time_noticed = 0;
+	in->list_changed = 0;
+	in->fname = key;
+	in->dirty = 0;
+	CNHashInsert( htFileTimeCacher, key, in );
+#ifdef CNOVR_INOTIFY
+	if( ftinotify >= 0 ) FileTimeWatchDirectory( fname );
+#endif
+	return in;
+}
+
 double FileTimeCached( const char * fname )
 {
 	OGTSLockMutex( mutFileTimeCacher );
@@ -850,11 +1069,7 @@ double FileTimeCached( const char * fname )
 		OGUnlockMutex( mutFileTimeCacher );
 		return r;
 	}
-	filetimedata * in = malloc( sizeof( filetimedata ) );
-	in->front = 0;
-	in->time = 0;
-	in->time_noticed = 0;
-	CNHashInsert( htFileTimeCacher, strdup( fname ), in );
+	FileTimeNewData( fname );
 	OGTSUnlockMutex( mutFileTimeCacher );
 	return 0;
 }
@@ -889,6 +1104,15 @@ void CNOVRInternalStartCacheSystem()
 	htFileTimeCacher = CNHashGenerate( 0, 0, CNHASH_STRINGS );
 	semPendinger = OGCreateSema(); 
 	ftindexlist = CNOVRIndexedListCreate( ftremovefn );
+#ifdef CNOVR_INOTIFY
+	ftinotify = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+	if( ftinotify < 0 )
+	{
+		ovrprintf( "Warning: inotify unavailable, falling back to polling for file changes.\n" );
+	}
+	ftwatcheddirs = CNHashGenerate( 0, 0, 0, cnhash_strhf, cnhash_strcf, 0 );
+	ftwdprefixes = CNHashGenerate( 0, 0, 0, cnhash_ptrhf, cnhash_ptrcf, 0 );
+#endif
 	thdFileTimeCacher = OGCreateThread( thdfiletimechecker, 0 );
 }
 
@@ -913,7 +1137,6 @@ void CNOVRInternalStopCacheSystem()
 		cnhashelement * e = htFileTimeCacher->elements + k;
 		if( e->data )
 		{
-			double ft = OGGetFileTime( e->key );
 			filetimedata * frontelem = ((filetimedata*)e->data);
 			filetimetagged * dat = frontelem->front;
 			while( dat )
@@ -925,6 +1148,22 @@ void CNOVRInternalStopCacheSystem()
 		}
 	}
 	CNHashDestroy( htFileTimeCacher );
+	sb_free( ftdirty );
+	ftdirty = 0;
+
+#ifdef CNOVR_INOTIFY
+	if( ftinotify >= 0 ) close( ftinotify );
+	ftinotify = -1;
+	for( k = 0; k < ftwdprefixes->array_size; k++ )
+	{
+		char ** prefixes = (char**)ftwdprefixes->elements[k].data;
+		int p;
+		for( p = 0; p < sb_count( prefixes ); p++ ) free( prefixes[p] );
+		sb_free( prefixes );
+	}
+	CNHashDestroy( ftwdprefixes );
+	CNHashDestroy( ftwatcheddirs );
+#endif
 }
 
 void CNOVRFileTimeAddWatch( const char * fname, cnovr_cb_fn fn, void * tag, void * opaquev )
@@ -936,11 +1175,7 @@ void CNOVRFileTimeAddWatch( const char * fname, cnovr_cb_fn fn, void * tag, void
 	filetimedata * ftd = (filetimedata*)CNHashGetValue( htFileTimeCacher, (void*)fname );
 	if( !ftd )
 	{
-		ftd = malloc( sizeof( filetimedata ) );
-		ftd->front = 0;
-		ftd->time = 0;
-		ftd->time_noticed = 0;
-		CNHashInsert( htFileTimeCacher, strdup( fname ), ftd );
+		ftd = FileTimeNewData( fname );
 	}
 
 	//First, see if the element already exists.
@@ -1014,7 +1249,13 @@ void CNOVRFileTimeRemoveTagged( void * tag, int wait_on_pending )
 
 struct CNOVRJobQueue_t;
 
-// Warning: You can only have one consumer per queue with the way locking is currently set up.
+//cnovrQAsync is serviced by a pool of workers, one per core (less the render thread).
+//Each worker owns a deque.  Jobs tacked from a worker go onto its own deque, jobs
+//from anywhere else are dealt round-robin.  A worker with nothing of its own steals
+//the oldest job from a sibling.  The deques, the dedup hash and the tag list all
+//share jq->mut, so (fn,tag,opaquev) stays unique across the whole queue.
+#define CNOVR_MAX_JOB_WORKERS 16
+
 typedef struct CNOVRJobElement_t
 {
 	cnovr_cb_fn * fn;
@@ -1024,26 +1265,57 @@ typedef struct CNOVRJobElement_t
 	struct CNOVRJobElement_t * next;
 	struct CNOVRJobElement_t * prev;
 	CNOVRIndexedListByTag * correspondance;
+	int deque;
+	cnovrJobPriority priority;
 } CNOVRJobElement;
 
+//Each deque is split into one lane per priority class.  Higher classes are always taken first.
+typedef struct CNOVRJobDeque_t
+{
+	CNOVRJobElement * front[cnovrPriorityMAX];
+	CNOVRJobElement * back[cnovrPriorityMAX];
+} CNOVRJobDeque;
+
 typedef struct CNOVRJobQueue_t
 {
-	CNOVRJobElement * front;
-	CNOVRJobElement * back;
-	CNOVRJobElement staged;
-	bool is_staged;
+	int workers;  //0 = only serviced from CNOVRJobProcessQueueElement
+	int ndeques;
+	int nexttack;
+	CNOVRJobDeque deques[CNOVR_MAX_JOB_WORKERS];
+
+	//One staging slot per worker, plus one (the last) for whoever calls CNOVRJobProcessQueueElement.
+	CNOVRJobElement staged[CNOVR_MAX_JOB_WORKERS+1];
+	volatile bool is_staged[CNOVR_MAX_JOB_WORKERS+1];
+
 	cnhashtable * hash;
 	og_mutex_t mut;
 	og_sema_t  sem;
 	og_sema_t  pendingsem;
+	int pendingwaiters;  //Threads blocked in JQWaitOnPending.  Every finished job posts pendingsem once for each.
 
 	//Prevent any new queuing of objects if deleting a tag.
+	//Tricky: Lock order is deletingmut, then mut.  CNOVRJobCancelAllTag holds deletingmut while it waits
+	//on running jobs, and the wait needs mut.
 	og_mutex_t deletingmut;
 	void * deletingtag;
 	bool deletingnow;
 	bool quittingnow;
+
+	//For budgeted processing, see CNOVRJobProcessQueueBudgeted.
+	int depth[cnovrPriorityMAX];
+	int budgetus;
+	int jobslastpass;
+	double timelastpass;
+	double timeaverage;
 } CNOVRJobQueue;
 
+typedef struct CNOVRJobWorker_t
+{
+	CNOVRJobQueue * jq;
+	int id;
+	og_thread_t thread;
+} CNOVRJobWorker;
+
 static intptr_t JQhash( const void * key, void * opaque ) { CNOVRJobElement * he = (CNOVRJobElement*)key; return ( ((uint32_t)(he->fn-((cnovr_cb_fn*)0)) + (uint32_t)(he->tag-((void*)0)) + (uint32_t)(he->opaquev - (void*)0) )) | 1; }
 static int      JQcomp( const void * key_a, const void * key_b, void * opaque )
 {
@@ -1061,33 +1333,48 @@ static int      JQcomp( const void * key_a, const void * key_b, void * opaque )
 static CNOVRJobQueue CNOVRJEQ[cnovrQMAX];
 static CNOVRIndexedList * JQELIST;
 
-static og_thread_t jt1;
-static og_thread_t jt2;
+static CNOVRJobWorker JQWorkers[CNOVR_MAX_JOB_WORKERS+1];
+static int JQWorkerCount;
+static og_tls_t JQWorkerTLS;
+
+static int InternalGetCoreCount()
+{
+#if defined(WINDOWS) || defined( WIN32 ) || defined( WIN64 )
+	SYSTEM_INFO si;
+	GetSystemInfo( &si );
+	return si.dwNumberOfProcessors;
+#else
+	return sysconf( _SC_NPROCESSORS_ONLN );
+#endif
+}
 
 static void IndexedDestructor( void * tag, void * item, void * opaque )
 {
 	CNOVRJobElement * je = (CNOVRJobElement*)item;
 	CNOVRJobQueue * jq = (CNOVRJobQueue*)opaque;
+	CNOVRJobDeque * dq = &jq->deques[je->deque];
+	int p = je->priority;
 
 	//This function is not threadsafe.
-	if( jq->front == je )
+	if( dq->front[p] == je )
 	{
-		jq->front = je->next;
-		if( jq->front )
+		dq->front[p] = je->next;
+		if( dq->front[p] )
 		{
-			jq->front->prev = 0;
+			dq->front[p]->prev = 0;
 		}
 	}
-	if( jq->back == je )
+	if( dq->back[p] == je )
 	{
-		jq->back = je->prev;
-		if( jq->back )
+		dq->back[p] = je->prev;
+		if( dq->back[p] )
 		{
-			jq->back->next = 0;
+			dq->back[p]->next = 0;
 		}
 	}
 	if( je->prev ) je->prev->next = je->next;
 	if( je->next ) je->next->prev = je->prev;
+	jq->depth[p]--;
 
 	CNHashDelete( jq->hash, je );
 	free( je );	
@@ -1101,48 +1388,114 @@ static void BackendDeleteJob( CNOVRJobQueue * jq, CNOVRJobElement * je )
 void DEBUGDumpQueue( cnovrQueueType qt )
 {
 	CNOVRJobQueue * q = &CNOVRJEQ[qt];
-	printf( "Q: FRONT: %p   BACK: %p\n", q->front, q->back );
-	CNOVRJobElement * e = q->front;
-	while( e )
+	int d, p;
+	for( d = 0; d < q->ndeques; d++ )
+	for( p = 0; p < cnovrPriorityMAX; p++ )
 	{
-		printf( "  <<%16p %16p(%p) %16p>>\n",  e->prev, e, e->opaquev, e->next );
-		e = e->next;
+		printf( "Q%d/%d: FRONT: %p   BACK: %p\n", d, p, q->deques[d].front[p], q->deques[d].back[p] );
+		CNOVRJobElement * e = q->deques[d].front[p];
+		while( e )
+		{
+			printf( "  <<%16p %16p(%p) %16p>>\n",  e->prev, e, e->opaquev, e->next );
+			e = e->next;
+		}
 	}
 }
 
+//Must hold jq->mut.
+static int JQIsStaged( CNOVRJobQueue * jq, CNOVRJobElement * compe, void * tag )
+{
+	int i;
+	for( i = 0; i <= jq->workers; i++ )
+	{
+		if( !jq->is_staged[i] ) continue;
+		if( compe && JQcomp( compe, &jq->staged[i], 0 ) == 0 ) return 1;
+		if( !compe && jq->staged[i].tag == tag ) return 1;
+	}
+	return 0;
+}
 
-static void * CNOVRJobProcessor( void * v )
+//Must hold jq->mut.  Highest priority first; within a priority, own deque first, then steal the oldest job from a sibling.
+//A job whose twin (same fn, tag, opaquev) is still running gets left for later, so the two never overlap.
+static CNOVRJobElement * JQTakeJob( CNOVRJobQueue * jq, int deque )
 {
-	CNOVRJobQueue * jq = (CNOVRJobQueue*)v;
-	while( !jq->quittingnow )
+	int i, p;
+	for( p = 0; p < cnovrPriorityMAX; p++ )
 	{
-		OGLockSema( jq->sem );
-		OGTSLockMutex( jq->mut );
-		CNOVRJobElement * front = jq->front;
-		CNOVRJobElement * staged = &(jq->staged);
-		if( front )
+		if( !jq->depth[p] ) continue;
+		for( i = 0; i < jq->ndeques; i++ )
 		{
-			memcpy( staged, front, sizeof( jq->staged ) );
-			jq->is_staged = 1;
-			BackendDeleteJob( jq, front );
+			CNOVRJobElement * e = jq->deques[(deque+i)%jq->ndeques].front[p];
+			while( e && JQIsStaged( jq, e, 0 ) ) e = e->next;
+			if( e ) return e;
 		}
+	}
+	return 0;
+}
+
+//Pulls a job into the given staging slot and runs it.  Returns 0 if there was nothing to do.
+static int JQRunOne( CNOVRJobQueue * jq, int slot, int deque )
+{
+	OGTSLockMutex( jq->mut );
+	CNOVRJobElement * front = JQTakeJob( jq, deque );
+	CNOVRJobElement * staged = &(jq->staged[slot]);
+	if( !front )
+	{
 		OGTSUnlockMutex( jq->mut );
+		return 0;
+	}
+	memcpy( staged, front, sizeof( CNOVRJobElement ) );
+	jq->is_staged[slot] = 1;
+	BackendDeleteJob( jq, front );
+	OGTSUnlockMutex( jq->mut );
 
-		if( front )
-		{
-			if( staged->fn ) TCCInvocation( staged->tcctag, staged->fn( staged->tag, staged->opaquev ) );
+	if( staged->fn ) TCCInvocation( staged->tcctag, staged->fn( staged->tag, staged->opaquev ) );
 
-			//If you were to cancel the job, spinlock until e->staged == 0.
-			staged->tag = 0;
-			staged->tcctag = 0;
-			staged->opaquev = 0;
-			staged->fn = 0;
-			jq->is_staged = 0;
-			//In case any close-outs were pending.
-			OGTSLockMutex( jq->mut );
-			while( OGGetSema( jq->pendingsem ) == 0 ) OGUnlockSema( jq->pendingsem ); 
-			OGTSUnlockMutex( jq->mut );
-		}
+	//If you were to cancel the job, spinlock until is_staged == 0.
+	//This is probably a place worth peeking if there's a problem found with this code
+	//verify no race condition in your particular application/fitness
+	OGTSLockMutex( jq->mut );
+	//If the twin got tacked while we ran, whoever woke up for it may have had to pass on it.  Wake someone again.
+	if( jq->workers && CNHashGetValue( jq->hash, staged ) ) OGUnlockSema( jq->sem );
+	staged->tag = 0;
+	staged->tcctag = 0;
+	staged->opaquev = 0;
+	staged->fn = 0;
+	jq->is_staged[slot] = 0;
+	//In case any close-outs were pending.
+	while( jq->pendingwaiters )
+	{
+		jq->pendingwaiters--;
+		OGUnlockSema( jq->pendingsem );
+	}
+	OGTSUnlockMutex( jq->mut );
+	return 1;
+}
+
+//Wait until no consumer is running a job matching compe (or tag if compe is null).
+static void JQWaitOnPending( CNOVRJobQueue * jq, CNOVRJobElement * compe, void * tag )
+{
+	while( 1 )
+	{
+		OGTSLockMutex( jq->mut );
+		int pending = JQIsStaged( jq, compe, tag );
+		//Registered under mut, so the job can't finish between the check and the count going up.
+		if( pending ) jq->pendingwaiters++;
+		OGTSUnlockMutex( jq->mut );
+		if( !pending ) break;
+		OGLockSema( jq->pendingsem );
+	}
+}
+
+static void * CNOVRJobProcessor( void * v )
+{
+	CNOVRJobWorker * w = (CNOVRJobWorker*)v;
+	CNOVRJobQueue * jq = w->jq;
+	OGSetTLS( JQWorkerTLS, w );
+	while( !jq->quittingnow )
+	{
+		OGLockSema( jq->sem );
+		JQRunOne( jq, w->id, w->id );
 	}
 	return 0;
 }
@@ -1152,26 +1505,45 @@ void CNOVRJobInit()
 	int i;
 
 	JQELIST = CNOVRIndexedListCreate( IndexedDestructor );
+	JQWorkerTLS = OGCreateTLS();
+
+	//Leave one core for the render thread.
+	int asyncworkers = InternalGetCoreCount() - 1;
+	if( asyncworkers < 1 ) asyncworkers = 1;
+	if( asyncworkers > CNOVR_MAX_JOB_WORKERS ) asyncworkers = CNOVR_MAX_JOB_WORKERS;
 
 	for( i = 0; i < cnovrQMAX; i++ )
 	{
 		CNOVRJobQueue * jq = &CNOVRJEQ[i];
+		memset( jq, 0, sizeof( *jq ) );
 		jq->mut = OGCreateMutex();
 		jq->sem = OGCreateSema();
 		jq->pendingsem = OGCreateSema();
 		jq->deletingmut = OGCreateMutex();
-		jq->deletingtag = 0;
-		jq->deletingnow = 0;
-		jq->front = 0;
-		jq->back = 0;
-		jq->is_staged = 0;
 		jq->hash = CNHashGenerate( 0, 0, 0, JQhash, JQcomp, 0 );
-		jq->quittingnow = 0;
-		memset( &CNOVRJEQ[i].staged, 0, sizeof( CNOVRJEQ[i].staged ) );
+		switch( i )
+		{
+		case cnovrQLow: jq->workers = 1; break;
+		case cnovrQAsync: jq->workers = asyncworkers; break;
+		default: jq->workers = 0; break;
+		}
+		jq->ndeques = jq->workers?jq->workers:1;
 	}
+	CNOVRJEQ[cnovrQPrerender].budgetus = CNOVR_DEFAULT_PRERENDER_BUDGET_US;
 
-	jt1 = OGCreateThread( CNOVRJobProcessor, &CNOVRJEQ[cnovrQLow] );
-	jt2 = OGCreateThread( CNOVRJobProcessor, &CNOVRJEQ[cnovrQAsync] );
+	JQWorkerCount = 0;
+	for( i = 0; i < cnovrQMAX; i++ )
+	{
+		CNOVRJobQueue * jq = &CNOVRJEQ[i];
+		int j;
+		for( j = 0; j < jq->workers && JQWorkerCount < CNOVR_MAX_JOB_WORKERS+1; j++ )
+		{
+			CNOVRJobWorker * w = &JQWorkers[JQWorkerCount++];
+			w->jq = jq;
+			w->id = j;
+			w->thread = OGCreateThread( CNOVRJobProcessor, w );
+		}
+	}
 }
 
 void CNOVRJobStop()
@@ -1180,12 +1552,17 @@ void CNOVRJobStop()
 	for( i = 0; i < cnovrQMAX; i++ )
 	{
 		CNOVRJobQueue * jq = &CNOVRJEQ[i];
+		int j;
 		jq->quittingnow = 1;
-		OGUnlockSema( jq->sem );
+		for( j = 0; j < jq->workers; j++ )
+			OGUnlockSema( jq->sem );
 	}
 
-	OGJoinThread( jt1 );
-	OGJoinThread( jt2 );
+	for( i = 0; i < JQWorkerCount; i++ )
+	{
+		OGJoinThread( JQWorkers[i].thread );
+	}
+	JQWorkerCount = 0;
 
 	CNOVRIndexedListDestroy( JQELIST );
 
@@ -1198,41 +1575,66 @@ void CNOVRJobStop()
 		OGDeleteMutex( jq->deletingmut );
 		OGDeleteMutex( jq->mut );
 	}
+	OGDeleteTLS( JQWorkerTLS );
 }
 
 int CNOVRJobProcessQueueElement( cnovrQueueType q )
 {
 	CNOVRJobQueue * jq = &CNOVRJEQ[q];
+	return JQRunOne( jq, jq->workers, 0 );
+}
+
+int CNOVRJobProcessQueueBudgeted( cnovrQueueType q )
+{
+	CNOVRJobQueue * jq = &CNOVRJEQ[q];
+	double start = OGGetAbsoluteTime();
+	double budget = jq->budgetus / 1000000.0;
+	double now = start;
+	int ran = 0;
+
+	//Always make forward progress, even if a single job is larger than the budget.
+	do
+	{
+		if( !JQRunOne( jq, jq->workers, 0 ) ) break;
+		ran++;
+		now = OGGetAbsoluteTime();
+	} while( budget <= 0 || now - start < budget );
+
+	jq->jobslastpass = ran;
+	jq->timelastpass = now - start;
+	jq->timeaverage = jq->timeaverage * .95 + jq->timelastpass * .05;
+	return ran;
+}
+
+void CNOVRJobSetBudget( cnovrQueueType q, int budgetus )
+{
+	CNOVRJEQ[q].budgetus = budgetus;
+}
+
+void CNOVRJobGetStats( cnovrQueueType q, cnovrJobStats * stats )
+{
+	CNOVRJobQueue * jq = &CNOVRJEQ[q];
+	int p;
 	OGTSLockMutex( jq->mut );
-	CNOVRJobElement * front = jq->front;
-	if( front )
-	{
-		CNOVRJobElement * staged = &(jq->staged);
-		memcpy( staged, front, sizeof( jq->staged ) );
-		jq->is_staged = 1;
-		BackendDeleteJob( jq, front );
-		OGUnlockMutex( jq->mut );
-		if( staged->fn ) TCCInvocation( staged->tcctag, staged->fn( staged->tag, staged->opaquev ) );
-		jq->is_staged = 0;
-		staged->tag = 0;
-		staged->tcctag = 0;
-		staged->opaquev = 0;
-		staged->fn = 0;
-
-		//In case any close-outs were pending.
-		//This is probably a place worth peeking if there's a problem found with this code
-		//verify no race condition in your particular application/fitness
-		OGTSLockMutex( jq->mut );
-		while( OGGetSema( jq->pendingsem ) == 0 ) OGUnlockSema( jq->pendingsem ); 
-		OGUnlockMutex( jq->mut );
-		return 1;
+	stats->iDepthTotal = 0;
+	for( p = 0; p < cnovrPriorityMAX; p++ )
+	{
+		stats->iDepth[p] = jq->depth[p];
+		stats->iDepthTotal += jq->depth[p];
 	}
-
-	OGUnlockMutex( jq->mut );
-	return 0;
+	OGTSUnlockMutex( jq->mut );
+	stats->iBudgetus = jq->budgetus;
+	stats->iJobsLastPass = jq->jobslastpass;
+	stats->fTimeLastPassus = jq->timelastpass * 1000000.0;
+	stats->fTimeAverageus = jq->timeaverage * 1000000.0;
 }
 
 void CNOVRJobTack( cnovrQueueType q, cnovr_cb_fn fn, void * tag, void * opaquev, bool insert_even_if_pending )
+{
+	CNOVRJobTackPriority( q, fn, tag, opaquev, insert_even_if_pending, cnovrPriorityNormal );
+}
+
+void CNOVRJobTackPriority( cnovrQueueType q, cnovr_cb_fn fn, void * tag, void * opaquev, bool insert_even_if_pending, cnovrJobPriority priority )
 {
 	CNOVRJobElement * newe = malloc( sizeof( CNOVRJobElement ) );
 	newe->fn = fn;
@@ -1241,9 +1643,12 @@ void CNOVRJobTack( cnovrQueueType q, cnovr_cb_fn fn, void * tag, void * opaquev,
 	newe->opaquev = opaquev;
 	newe->next = 0;
 	newe->prev = 0;
+	newe->priority = ( priority < 0 || priority >= cnovrPriorityMAX ) ? cnovrPriorityNormal : priority;
 
 	CNOVRJobQueue * jq = &CNOVRJEQ[q];
 
+	OGTSLockMutex( jq->mut );
+
 	TCCInstance * te = TCCGetTag();
 //	printf( "TCE: %p %d\n", te, te?te->bClosing:0 );
 	if( te && te->bClosing ) goto fail;
@@ -1252,7 +1657,7 @@ void CNOVRJobTack( cnovrQueueType q, cnovr_cb_fn fn, void * tag, void * opaquev,
 	//Make sure we don't permit addition of a delete-in-progress, in case the user has chained events.
 	if( jq->deletingnow && jq->deletingtag == tag && tag != 0) goto fail;
 
-	int is_pending = JQcomp( newe, &jq->staged, 0 ) == 0;
+	int is_pending = JQIsStaged( jq, newe, 0 );
 
 	//Look for duplicates
 	if( ( is_pending && !insert_even_if_pending ) || CNHashInsert( jq->hash, newe, newe ) == 0 )
@@ -1261,25 +1666,35 @@ void CNOVRJobTack( cnovrQueueType q, cnovr_cb_fn fn, void * tag, void * opaquev,
 	}
 	else
 	{
-		if( jq->back )
+		//Keep work spawned by a worker on that worker, otherwise spread it out.
+		CNOVRJobWorker * w = (CNOVRJobWorker*)OGGetTLS( JQWorkerTLS );
+		if( w && w->jq == jq )
+			newe->deque = w->id;
+		else
+			newe->deque = ( jq->nexttack++ ) % jq->ndeques;
+
+		CNOVRJobDeque * dq = &jq->deques[newe->deque];
+		int p = newe->priority;
+		if( dq->back[p] )
 		{
-			jq->back->next = newe;
-			newe->prev = jq->back;
-			jq->back = newe;
+			dq->back[p]->next = newe;
+			newe->prev = dq->back[p];
+			dq->back[p] = newe;
 		}
 		else
 		{
-			jq->back = jq->front = newe;
+			dq->back[p] = dq->front[p] = newe;
 		}
+		jq->depth[p]++;
 		newe->correspondance = CNOVRIndexedListInsert( JQELIST, tag, newe, jq );
 		OGUnlockSema( jq->sem );
 	}
-	OGUnlockMutex( jq->mut );
+	OGTSUnlockMutex( jq->mut );
 	return;
 fail:
 	//Failed to insert.
 	free( newe );
-	OGUnlockMutex( jq->mut );
+	OGTSUnlockMutex( jq->mut );
 }
 
 void CNOVRJobCancel( cnovrQueueType q, cnovr_cb_fn fn, void * tag, void * opaquev, bool wait_on_pending )
@@ -1301,20 +1716,20 @@ void CNOVRJobCancel( cnovrQueueType q, cnovr_cb_fn fn, void * tag, void * opaque
 	OGTSUnlockMutex( jq->mut );
 
 	//Make srue we don't have any remaining pends.
-	OGUnlockSema( jq->pendingsem );
-	while( wait_on_pending && jq->is_staged && (JQcomp( &compe, &jq->staged, 0 ) == 0) )
+	if( wait_on_pending )
 	{
-		OGLockSema( jq->pendingsem );
+		JQWaitOnPending( jq, &compe, 0 );
 	}
 }
 
 void CNOVRJobCancelAllTag( void * tag, int wait_on_pending )
 {
 	int list;
+	//deletingmut before mut, see CNOVRJobQueue.
 	for( list = 0; list < cnovrQMAX; list++ )
 	{
-		OGTSLockMutex( CNOVRJEQ[list].mut );
 		OGTSLockMutex( CNOVRJEQ[list].deletingmut );
+		OGTSLockMutex( CNOVRJEQ[list].mut );
 		CNOVRJEQ[list].deletingtag = tag;
 		CNOVRJEQ[list].deletingnow = 1;
 	}
@@ -1326,35 +1741,163 @@ void CNOVRJobCancelAllTag( void * tag, int wait_on_pending )
 
 	for( list = 0; list < cnovrQMAX; list++ )
 	{
-		CNOVRJobQueue * jq = &CNOVRJEQ[list];
-		OGUnlockSema( jq->pendingsem );
-		//XXX TRICKY: this seems to sometimes fail, locked open.
-		while( wait_on_pending && jq->is_staged && jq->staged.tag == tag )
+		if( wait_on_pending )
 		{
-			OGLockSema( jq->pendingsem );
+			JQWaitOnPending( &CNOVRJEQ[list], 0, tag );
 		}
 	}
 	for( list = 0; list < cnovrQMAX; list++ )
 	{
 		CNOVRJEQ[list].deletingtag = 0;
+		CNOVRJEQ[list].deletingnow = 0;
 		OGTSUnlockMutex( CNOVRJEQ[list].deletingmut );
 	}
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
+//Run lists are dense arrays, sorted by priority then by order of addition, so they're called in
+//a deterministic order.  An item is found by its key (the base object) through bykey, and every
+//tcctag keeps a list of its keys so a module can be pulled out without scanning everything.
+//
+//Tricky: While a list is being called, items never move.  Removing only clears fn (a tombstone)
+//and adds go into pending.  Both are settled once nobody is iterating the list.
 typedef struct JobListItem_t
 {
-	cnovr_cb_fn * fn;
+	cnovr_cb_fn * fn;   //0 if removed.
+	void * key;
 	void * tcctag;
+	int priority;
+	int tccpos;         //Where this item's key is in its tcctag's key list.
 } JobListItem;
 
-static cnhashtable * ListHTs[cnovrLMAX];
-static og_mutex_t    ListMTs[cnovrLMAX];
+typedef struct JobList_t
+{
+	JobListItem * items;
+	int count;
+	int size;
+	int removed;
+	int iterating;
+	JobListItem * pending;  //stretchy buffer
+	cnhashtable * bykey;    //key -> index+1 in items
+	cnhashtable * bytcc;    //tcctag -> stretchy buffer of keys
+	og_mutex_t mut;
+} JobList;
+
+static const char * ListNames[cnovrLMAX] = { "Update", "Prerender", "Collide", "Render0", "Render1", "Render2", "Render3", "Render4", "PostRender", "PreviewRender", "CollideBatch" };
+static JobList JobLists[cnovrLMAX];
+
+static void DeleteJLTCCList( void * key, void * data, void * opaque )
+{
+	void ** keys = (void**)data;
+	sb_free( keys );
+}
+
+//All JL* functions must be called with jl->mut held.
+static JobListItem * JLGet( JobList * jl, void * key )
+{
+	intptr_t idx = (intptr_t)CNHashGetValue( jl->bykey, key );
+	return idx ? &jl->items[idx-1] : 0;
+}
+
+static void JLSetIndex( JobList * jl, int idx )
+{
+	CNHashIndex( jl->bykey, jl->items[idx].key )->data = (void*)(intptr_t)(idx+1);
+}
+
+static void JLTCCInsert( JobList * jl, JobListItem * it )
+{
+	cnhashelement * e = CNHashIndex( jl->bytcc, it->tcctag );
+	void ** keys = (void**)e->data;
+	it->tccpos = sb_count( keys );
+	sb_push( keys, it->key );
+	e->data = keys;
+}
+
+static void JLTCCRemove( JobList * jl, JobListItem * it )
+{
+	void ** keys = (void**)CNHashGetValue( jl->bytcc, it->tcctag );
+	if( !keys ) return;
+	int last = sb_count( keys ) - 1;
+	if( it->tccpos != last )
+	{
+		void * moved = keys[last];
+		JobListItem * mit = JLGet( jl, moved );
+		keys[it->tccpos] = moved;
+		if( mit ) mit->tccpos = it->tccpos;
+	}
+	stb__sbn( keys )--;
+}
+
+static void JLInsert( JobList * jl, JobListItem * nit )
+{
+	int i;
+	if( jl->count == jl->size )
+	{
+		jl->size = jl->size ? jl->size * 2 : 16;
+		jl->items = realloc( jl->items, sizeof( JobListItem ) * jl->size );
+	}
+
+	//After everything with the same or lower priority.  Usually this is the end.
+	int at = jl->count;
+	while( at > 0 && jl->items[at-1].priority > nit->priority ) at--;
+	if( at != jl->count )
+	{
+		memmove( &jl->items[at+1], &jl->items[at], sizeof( JobListItem ) * ( jl->count - at ) );
+	}
+	jl->items[at] = *nit;
+	jl->count++;
+	for( i = at; i < jl->count; i++ )
+	{
+		if( jl->items[i].fn ) JLSetIndex( jl, i );
+	}
+	JLTCCInsert( jl, &jl->items[at] );
+}
+
+static void JLRemove( JobList * jl, JobListItem * it )
+{
+	JLTCCRemove( jl, it );
+	CNHashDelete( jl->bykey, it->key );
+	it->fn = 0;
+	jl->removed++;
+}
+
+static JobListItem * JLGetPending( JobList * jl, void * key )
+{
+	int i;
+	for( i = 0; i < sb_count( jl->pending ); i++ )
+	{
+		if( jl->pending[i].fn && jl->pending[i].key == key ) return &jl->pending[i];
+	}
+	return 0;
+}
 
-void DeleteJLE( void * key, void * data, void * opaque )
+static void JLSettle( JobList * jl )
 {
-	free( data );
+	int i, j;
+	if( jl->removed )
+	{
+		for( i = 0, j = 0; i < jl->count; i++ )
+		{
+			if( !jl->items[i].fn ) continue;
+			if( i != j )
+			{
+				jl->items[j] = jl->items[i];
+				JLSetIndex( jl, j );
+			}
+			j++;
+		}
+		jl->count = j;
+		jl->removed = 0;
+	}
+	if( sb_count( jl->pending ) )
+	{
+		for( i = 0; i < sb_count( jl->pending ); i++ )
+		{
+			if( jl->pending[i].fn ) JLInsert( jl, &jl->pending[i] );
+		}
+		stb__sbn( jl->pending ) = 0;
+	}
 }
 
 void CNOVRListSystemInit()
@@ -1362,9 +1905,11 @@ void CNOVRListSystemInit()
 	int i;
 	for( i = 0; i < cnovrLMAX; i++ )
 	{
-		ListHTs[i] = CNHashGenerate( 0, 0, 0, cnhash_ptrhf, cnhash_ptrcf, DeleteJLE );
- 
-		ListMTs[i] = OGCreateMutex();
+		JobList * jl = &JobLists[i];
+		memset( jl, 0, sizeof( *jl ) );
+		jl->bykey = CNHashGenerate( 0, 0, 0, cnhash_ptrhf, cnhash_ptrcf, 0 );
+		jl->bytcc = CNHashGenerate( 0, 0, 0, cnhash_ptrhf, cnhash_ptrcf, DeleteJLTCCList );
+		jl->mut = OGCreateMutex();
 	}
 }
 
@@ -1373,54 +1918,97 @@ void CNOVRListSystemDestroy()
 	int i;
 	for( i = 0; i < cnovrLMAX; i++ )
 	{
-		OGLockMutex( ListMTs[i] );
-		CNHashDestroy( ListHTs[i] );
-		OGDeleteMutex( ListMTs[i] );
+		JobList * jl = &JobLists[i];
+		OGLockMutex( jl->mut );
+		CNHashDestroy( jl->bykey );
+		CNHashDestroy( jl->bytcc );
+		free( jl->items );
+		sb_free( jl->pending );
+		OGDeleteMutex( jl->mut );
 	}
 }
 
 int CNOVRListCall( cnovrRunList l, void * data, int delete_on_call )
 {
-	cnhashtable * t = ListHTs[l];
-	og_mutex_t  m = ListMTs[l];
-	int i;
+	JobList * jl = &JobLists[l];
+	int i, count;
 	int hit = 0;
-	OGTSLockMutex( m );
-	for( i = 0; i < t->array_size; i++ )
+
+	OGTSLockMutex( jl->mut );
+	if( !jl->iterating ) JLSettle( jl );
+	jl->iterating++;
+	count = jl->count;
+	OGTSUnlockMutex( jl->mut );
+
+	for( i = 0; i < count; i++ )
 	{
-		cnhashelement * e = &t->elements[i];
-		JobListItem * jle = (JobListItem*)e->data;
-		if( jle && jle->fn )
-		{
-			hit++;
-			OGTSUnlockMutex( m );
-			if( jle->fn ) TCCInvocation( jle->tcctag, jle->fn( e->key, data ) );
-			OGTSLockMutex( m );
-		}
+		JobListItem * it = &jl->items[i];
+		cnovr_cb_fn * fn = it->fn;
+		if( !fn ) continue;
+		void * tcctag = it->tcctag;
+		hit++;
+		double start = OGGetAbsoluteTime();
+		TCCInvocation( tcctag, fn( it->key, data ) );
+		CNOVRProfileRecord( ListNames[l], tcctag, fn, -1, start, OGGetAbsoluteTime() );
 	}
-	OGTSUnlockMutex( m );
+
+	OGTSLockMutex( jl->mut );
+	jl->iterating--;
+	if( !jl->iterating ) JLSettle( jl );
+	OGTSUnlockMutex( jl->mut );
 	return hit;
 }
 
-
 void CNOVRListAdd( cnovrRunList l, void * b, cnovr_cb_fn * fn )
+{
+	CNOVRListAddPriority( l, b, fn, 0 );
+}
+
+void CNOVRListAddPriority( cnovrRunList l, void * b, cnovr_cb_fn * fn, int priority )
 {
 	TCCInstance * te = TCCGetTag();
 	if( te && te->bClosing ) return;
-	og_mutex_t  m = ListMTs[l];
-	cnhashelement * e;
-	OGTSLockMutex( m );
-	e = CNHashIndex( ListHTs[l], b );
-	JobListItem * jli = e->data;
-	if( !jli ) jli = malloc( sizeof( JobListItem ) );
-	jli->fn = fn;
-	jli->tcctag = te;
-	if( e->data )
+	JobList * jl = &JobLists[l];
+	JobListItem nit;
+	nit.fn = fn;
+	nit.key = b;
+	nit.tcctag = te;
+	nit.priority = priority;
+	nit.tccpos = 0;
+
+	OGTSLockMutex( jl->mut );
+	JobListItem * it = JLGet( jl, b );
+	int live = !!it;
+	if( !it ) it = JLGetPending( jl, b );
+	if( it )
 	{
 		ovrprintf( "Warning overwriting element with CNOVRListAdd\n" );
+		if( it->priority == priority )
+		{
+			//Overwrite in place, this is safe even while iterating.
+			if( live && it->tcctag != te )
+			{
+				JLTCCRemove( jl, it );
+				it->tcctag = te;
+				JLTCCInsert( jl, it );
+			}
+			it->tcctag = te;
+			it->fn = fn;
+			OGTSUnlockMutex( jl->mut );
+			return;
+		}
+		//Changing priority means it has to move.
+		if( live ) JLRemove( jl, it );
+		else it->fn = 0;
+	}
+	if( jl->iterating )
+		sb_push( jl->pending, nit );
+	else
+	{
+		JLSettle( jl );
+		JLInsert( jl, &nit );
 	}
-	e->data = jli;	//Overwrite if called again.
-	OGTSUnlockMutex( m );
+	OGTSUnlockMutex( jl->mut );
 }
 
 void CNOVRListDeleteTag( void * b )
@@ -1428,37 +2016,39 @@ void CNOVRListDeleteTag( void * b )
 	int l;
 	for( l = 0; l < cnovrLMAX; l++ )
 	{
-		og_mutex_t  m = ListMTs[l];
-		OGTSLockMutex( m );
-		CNHashDelete( ListHTs[l], b );
-		OGTSUnlockMutex( m );
+		JobList * jl = &JobLists[l];
+		OGTSLockMutex( jl->mut );
+		JobListItem * it = JLGet( jl, b );
+		if( it ) JLRemove( jl, it );
+		it = JLGetPending( jl, b );
+		if( it ) it->fn = 0;
+		OGTSUnlockMutex( jl->mut );
 	}
 }
 
-//XXX TODO: FIXME: This is very slow.  Re-architect to make this part fast.
 void CNOVRListDeleteTCCTag( void * tcctag )
 {
 	int l;
 	for( l = 0; l < cnovrLMAX; l++ )
 	{
-		og_mutex_t  m = ListMTs[l];
-		OGTSLockMutex( m );
+		JobList * jl = &JobLists[l];
 		int i;
-		int len = ListHTs[l]->array_size;
-		cnhashelement * e = ListHTs[l]->elements;
-		for( i = 0; i < len; i++ )
+		OGTSLockMutex( jl->mut );
+		void ** keys = (void**)CNHashGetValue( jl->bytcc, tcctag );
+		for( i = 0; i < sb_count( keys ); i++ )
 		{
-			JobListItem * t = (JobListItem*)e->data;
-			if( t && t->tcctag == tcctag )
-			{
-				e->data = 0;
-				e->key = 0;
-				e->hashvalue = 0;
-				free( t );
-			}
-			e++;
+			JobListItem * it = JLGet( jl, keys[i] );
+			if( !it ) continue;
+			CNHashDelete( jl->bykey, keys[i] );
+			it->fn = 0;
+			jl->removed++;
+		}
+		if( keys ) CNHashDelete( jl->bytcc, tcctag );
+		for( i = 0; i < sb_count( jl->pending ); i++ )
+		{
+			if( jl->pending[i].tcctag == tcctag ) jl->pending[i].fn = 0;
 		}
-		OGTSUnlockMutex( m );
+		OGTSUnlockMutex( jl->mut );
 	}
 }
 
@@ -1,7 +1,12 @@
 #include <cnovrutil.h>
+#include <cnovr.h>
+#include <cnovrparts.h>
+#include <cnovrtexcompress.h>
 #include <os_generic.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
 
 int g;
 
@@ -13,13 +18,489 @@ void JobTest1( void * opaquev, void * opaquei )
 	g = opaquei - (void*)0;
 }
 
+//Retacks itself while still running, the copies must not overlap.
+og_mutex_t twinmut;
+int twinrunning, twinoverlap, twinruns;
+void JobTwin( void * opaquev, void * opaquei )
+{
+	OGLockMutex( twinmut );
+	if( twinrunning++ ) twinoverlap = 1;
+	int run = ++twinruns;
+	OGUnlockMutex( twinmut );
+	if( run < 5 ) CNOVRJobTack( cnovrQAsync, JobTwin, 0, 0, 1 );
+	OGUSleep( 20000 );
+	OGLockMutex( twinmut );
+	twinrunning--;
+	OGUnlockMutex( twinmut );
+}
+
+volatile int slowstarted, slowdone;
+void JobSlow( void * opaquev, void * opaquei )
+{
+	slowstarted = 1;
+	OGUSleep( 50000 );
+	slowdone = 1;
+}
+
 #define FAIL { printf( "Fail at %d\n", __LINE__ ); exit( -5 ); } 
 
-int main()
+int main( int argc, char ** argv )
 {
 	int i;
 	CNOVRJobInit();
 
+	if( 1 )
+	{
+		//Benchmark: per-vertex VBO appends, the old way (realloc every vertex) and the new way, vs. one bulk append.
+		#define BENCH_VERTS 1000000
+		float * src = malloc( sizeof( float ) * 4 * BENCH_VERTS );
+		for( i = 0; i < BENCH_VERTS * 4; i++ ) src[i] = i;
+
+		//What CNOVRVBOTackv used to do, per vertex.
+		og_mutex_t oldmut = OGCreateMutex();
+		float * old = 0;
+		double start = OGGetAbsoluteTime();
+		for( i = 0; i < BENCH_VERTS; i++ )
+		{
+			OGLockMutex( oldmut );
+			old = realloc( old, ( i + 1 ) * 4 * sizeof( float ) );
+			memcpy( old + i*4, src + i*4, 4 * sizeof( float ) );
+			OGUnlockMutex( oldmut );
+		}
+		double tackold = OGGetAbsoluteTime() - start;
+
+		cnovr_vbo * a = CNOVRCreateVBO( 4, 0, 0, 0 );
+		cnovr_vbo * b = CNOVRCreateVBO( 4, 0, 0, 0 );
+		start = OGGetAbsoluteTime();
+		for( i = 0; i < BENCH_VERTS; i++ )
+			CNOVRVBOTackv( a, 4, src + i*4 );
+		double tackv = OGGetAbsoluteTime() - start;
+		start = OGGetAbsoluteTime();
+		CNOVRVBOReserve( b, BENCH_VERTS );
+		CNOVRVBOTackN( b, BENCH_VERTS, src, 4 );
+		double tackn = OGGetAbsoluteTime() - start;
+		if( a->iVertexCount != BENCH_VERTS || b->iVertexCount != BENCH_VERTS ) FAIL;
+		if( memcmp( a->pVertices, b->pVertices, sizeof( float ) * 4 * BENCH_VERTS ) ) FAIL;
+		if( memcmp( a->pVertices, old, sizeof( float ) * 4 * BENCH_VERTS ) ) FAIL;
+		printf( "VBO append %d verts: old Tackv %.2fms, Tackv %.2fms (%.1fx), Reserve+TackN %.2fms (%.1fx)\n", BENCH_VERTS,
+			tackold*1000., tackv*1000., tackold/tackv, tackn*1000., tackold/tackn );
+		free( old );
+		OGDeleteMutex( oldmut );
+		free( src );
+
+		//Nothing uploaded these, so this doesn't need GL.
+		CNOVRVBODelete( a );
+		CNOVRVBODelete( b );
+	}
+
+	if( 1 )
+	{
+		//Batch pose math vs. the scalar versions.  Odd count so the scalar tail gets used too.
+		#define BENCH_POSES 1027
+		#define BENCH_POSE_ITERS 2000
+		static cnovr_pose pa[BENCH_POSES], pb[BENCH_POSES], pbatch[BENCH_POSES], pscalar[BENCH_POSES];
+		static cnovr_point3d pts[BENCH_POSES], ptbatch[BENCH_POSES], ptscalar[BENCH_POSES];
+		static FLT mbatch[BENCH_POSES*16], mscalar[BENCH_POSES*16];
+		static cnovr_quat qa[BENCH_POSES], qb[BENCH_POSES], qbatch[BENCH_POSES], qscalar[BENCH_POSES];
+		static FLT qt[BENCH_POSES];
+		int k, it;
+		srand( 0 );
+		for( i = 0; i < BENCH_POSES; i++ )
+		{
+			cnovr_euler_angle ea = { rand()%628/100., rand()%628/100., rand()%628/100. };
+			cnovr_euler_angle eb = { rand()%628/100., rand()%628/100., rand()%628/100. };
+			quatfromeuler( pa[i].Rot, ea );
+			quatfromeuler( pb[i].Rot, ( i % 5 ) ? eb : ea ); //Some close ones, for slerp's lerp path.
+			if( i % 7 == 0 ) quatscale( pb[i].Rot, pa[i].Rot, -1 );
+			for( k = 0; k < 3; k++ )
+			{
+				pa[i].Pos[k] = rand()%2000/100. - 10;
+				pb[i].Pos[k] = rand()%2000/100. - 10;
+				pts[i][k] = rand()%1000/100. - 5;
+			}
+			pa[i].Scale = .5 + rand()%100/100.;
+			pb[i].Scale = .5 + rand()%100/100.;
+			quatcopy( qa[i], pa[i].Rot );
+			quatcopy( qb[i], pb[i].Rot );
+			qt[i] = rand()%1000/1000.;
+		}
+
+		double tscalar[4], tbatch[4];
+		double start = OGGetAbsoluteTime();
+		for( it = 0; it < BENCH_POSE_ITERS; it++ ) for( i = 0; i < BENCH_POSES; i++ ) apply_pose_to_point( ptscalar[i], &pa[0], pts[i] );
+		tscalar[0] = OGGetAbsoluteTime() - start; start = OGGetAbsoluteTime();
+		for( it = 0; it < BENCH_POSE_ITERS; it++ ) apply_pose_to_point_n( ptbatch, &pa[0], pts, BENCH_POSES );
+		tbatch[0] = OGGetAbsoluteTime() - start; start = OGGetAbsoluteTime();
+		for( it = 0; it < BENCH_POSE_ITERS; it++ ) for( i = 0; i < BENCH_POSES; i++ ) apply_pose_to_pose( &pscalar[i], &pa[i], &pb[i] );
+		tscalar[1] = OGGetAbsoluteTime() - start; start = OGGetAbsoluteTime();
+		for( it = 0; it < BENCH_POSE_ITERS; it++ ) apply_pose_to_pose_n( pbatch, pa, pb, BENCH_POSES );
+		tbatch[1] = OGGetAbsoluteTime() - start; start = OGGetAbsoluteTime();
+		for( it = 0; it < BENCH_POSE_ITERS; it++ ) for( i = 0; i < BENCH_POSES; i++ ) pose_to_matrix44( mscalar + i*16, &pa[i] );
+		tscalar[2] = OGGetAbsoluteTime() - start; start = OGGetAbsoluteTime();
+		for( it = 0; it < BENCH_POSE_ITERS; it++ ) pose_to_matrix44_n( mbatch, pa, BENCH_POSES );
+		tbatch[2] = OGGetAbsoluteTime() - start; start = OGGetAbsoluteTime();
+		for( it = 0; it < BENCH_POSE_ITERS; it++ ) for( i = 0; i < BENCH_POSES; i++ ) quatslerp( qscalar[i], qa[i], qb[i], qt[i] );
+		tscalar[3] = OGGetAbsoluteTime() - start; start = OGGetAbsoluteTime();
+		for( it = 0; it < BENCH_POSE_ITERS; it++ ) quatslerp_n( qbatch, qa, qb, qt, BENCH_POSES );
+		tbatch[3] = OGGetAbsoluteTime() - start;
+
+		//Same operations in the same order, but the compiler may fuse or reorder things differently, so allow a little.
+		#define POSE_CLOSE( a, b ) ( fabsf( (a) - (b) ) <= 1e-5 * ( 1 + fabsf( a ) ) )
+		for( i = 0; i < BENCH_POSES; i++ )
+		{
+			for( k = 0; k < 3; k++ ) if( !POSE_CLOSE( ptbatch[i][k], ptscalar[i][k] ) ) FAIL;
+			for( k = 0; k < 4; k++ ) if( !POSE_CLOSE( pbatch[i].Rot[k], pscalar[i].Rot[k] ) ) FAIL;
+			for( k = 0; k < 3; k++ ) if( !POSE_CLOSE( pbatch[i].Pos[k], pscalar[i].Pos[k] ) ) FAIL;
+			if( !POSE_CLOSE( pbatch[i].Scale, pscalar[i].Scale ) ) FAIL;
+			for( k = 0; k < 16; k++ ) if( !POSE_CLOSE( mbatch[i*16+k], mscalar[i*16+k] ) ) FAIL;
+			for( k = 0; k < 4; k++ ) if( !POSE_CLOSE( qbatch[i][k], qscalar[i][k] ) ) FAIL;
+		}
+
+		//Slerp has to take the short way round.  Going by w, x and y alone these look close, but the full dot
+		//is negative, so qb gets flipped and halfway is (0,0,0,1), not (1,0,0,0).
+		for( i = 0; i < 5; i++ )
+		{
+			qa[i][0] = .6; qa[i][1] = 0; qa[i][2] = 0; qa[i][3] = .8;
+			qb[i][0] = .6; qb[i][1] = 0; qb[i][2] = 0; qb[i][3] = -.8;
+			qt[i] = .5;
+		}
+		quatslerp( qscalar[0], qa[0], qb[0], .5 );
+		quatslerp_n( qbatch, qa, qb, qt, 5 );
+		if( fabsf( qscalar[0][3] ) < .999 ) FAIL;
+		for( i = 0; i < 5; i++ ) if( fabsf( qbatch[i][3] ) < .999 ) FAIL;
+
+		//In place has to work too.
+		memcpy( pbatch, pa, sizeof( pa ) );
+		apply_pose_to_pose_n( pbatch, pbatch, pb, BENCH_POSES );
+		for( i = 0; i < BENCH_POSES; i++ )
+			for( k = 0; k < 4; k++ ) if( !POSE_CLOSE( pbatch[i].Rot[k], pscalar[i].Rot[k] ) ) FAIL;
+
+		printf( "Batch math, %d x %d: point %.1fx, pose %.1fx, matrix %.1fx, slerp %.1fx faster\n", BENCH_POSES, BENCH_POSE_ITERS,
+			tscalar[0]/tbatch[0], tscalar[1]/tbatch[1], tscalar[2]/tbatch[2], tscalar[3]/tbatch[3] );
+	}
+
+	if( 1 )
+	{
+		//Benchmark: collision BVH vs. brute force.  Three offset 100x100 grids, 60k triangles.
+		cnovr_model * m = CNOVRModelCreate( 0, GL_TRIANGLES );
+		cnovr_point3d size = { 1, 1, -.5 };
+		CNOVRModelAppendMesh( m, 100, 100, 0, size, 0, 0 );
+		size[0] = .5; size[2] = 0;
+		CNOVRModelAppendMesh( m, 100, 100, 0, size, 0, 0 );
+		size[0] = .25; size[1] = .25; size[2] = .5;
+		CNOVRModelAppendMesh( m, 100, 100, 0, size, 0, 0 );
+		CNOVRModelBuildBVH( m );
+
+		int x, y, checked = 0;
+		double tbvh = 0, tbrute = 0;
+		for( y = 0; y < 1000; y++ )
+		for( x = 0; x < 1000; x++ )
+		{
+			cnovr_point3d start = { -0.001, -1.001, 4 };
+			cnovr_point3d dir = { (x-500)/1000.+.25, (y-500)/1000.+.25, -1 };
+			cnovr_collide_results res, resbrute;
+			float dradius = ( x & 1 ) ? .02 : 0;
+			normalize3d( dir, dir );
+			memset( &res, 0, sizeof( res ) );
+			res.t = 1e20;
+			resbrute = res;
+			double start_time = OGGetAbsoluteTime();
+			int r = CNOVRModelCollide( m, start, dir, &res, dradius, 0 );
+			tbvh += OGGetAbsoluteTime() - start_time;
+			if( ( x % 20 ) > 1 || ( y % 20 ) ) continue;
+
+			//Hide the BVH to get the brute force answer.
+			struct cnovr_model_bvh_t * bvh = m->pBVH;
+			m->pBVH = 0;
+			m->bBVHBuilding = 1;
+			start_time = OGGetAbsoluteTime();
+			int rbrute = CNOVRModelCollide( m, start, dir, &resbrute, dradius, 0 );
+			tbrute += OGGetAbsoluteTime() - start_time;
+			m->pBVH = bvh;
+			m->bBVHBuilding = 0;
+			if( r != rbrute || memcmp( &res, &resbrute, sizeof( res ) ) ) { printf( "%d %d: %d %d %f %f\n", x, y, r, rbrute, res.t, resbrute.t ); FAIL; }
+			checked++;
+		}
+		printf( "Collide 1000x1000 rays: BVH %.0f rays/s, brute force %.0f rays/s (%d checked)\n", 1000000 / tbvh, checked / tbrute, checked );
+
+		//Same rays, a row at a time through CNOVRModelCollideMany.  Must match one at a time exactly.
+		cnovr_collide_ray * rays = malloc( sizeof( cnovr_collide_ray ) * 1000 );
+		double tmany = 0;
+		for( y = 0; y < 1000; y++ )
+		{
+			for( x = 0; x < 1000; x++ )
+			{
+				cnovr_collide_ray * ray = &rays[x];
+				memset( ray, 0, sizeof( *ray ) );
+				ray->start[0] = -0.001; ray->start[1] = -1.001; ray->start[2] = 4;
+				ray->direction[0] = (x-500)/1000.+.25; ray->direction[1] = (y-500)/1000.+.25; ray->direction[2] = -1;
+				normalize3d( ray->direction, ray->direction );
+				ray->dradius = ( x & 1 ) ? .02 : 0;
+				ray->res.t = 1e20;
+			}
+			double start_time = OGGetAbsoluteTime();
+			CNOVRModelCollideMany( m, rays, 1000 );
+			tmany += OGGetAbsoluteTime() - start_time;
+			for( x = 0; x < 1000; x += 7 )
+			{
+				cnovr_collide_ray * ray = &rays[x];
+				cnovr_collide_results res;
+				memset( &res, 0, sizeof( res ) );
+				res.t = 1e20;
+				int r = CNOVRModelCollide( m, ray->start, ray->direction, &res, ray->dradius, 0 );
+				if( r != ray->ret || memcmp( &res, &ray->res, sizeof( res ) ) ) { printf( "%d %d: %d %d %f %f\n", x, y, r, ray->ret, res.t, ray->res.t ); FAIL; }
+			}
+		}
+		free( rays );
+		printf( "CollideMany 1000x1000 rays: %.0f rays/s\n", 1000000 / tmany );
+	}
+
+	{
+		printf( "TEST 3:" );
+		//Test 3: A job and its twin (tacked with insert_even_if_pending) never run at once, even with several workers.
+		twinmut = OGCreateMutex();
+		CNOVRJobTack( cnovrQAsync, JobTwin, 0, 0, 1 );
+		for( i = 0; i < 100 && twinruns < 5; i++ ) OGUSleep( 10000 );
+		OGUSleep( 50000 );
+		if( twinruns != 5 || twinoverlap ) { printf( "Runs: %d Overlap: %d\n", twinruns, twinoverlap ); FAIL; }
+
+		//Cancelling with wait_on_pending has to hold off until the running copy is done.
+		CNOVRJobTack( cnovrQAsync, JobSlow, 0, 0, 0 );
+		for( i = 0; i < 100 && !slowstarted; i++ ) OGUSleep( 1000 );
+		CNOVRJobCancel( cnovrQAsync, JobSlow, 0, 0, 1 );
+		if( !slowstarted || !slowdone ) FAIL;
+		printf( " PASS\n" );
+	}
+
+	//Shared with the GL upload benchmark below.
+	#define BENCH_TEX 4096
+	uint8_t * benchtex = malloc( BENCH_TEX * BENCH_TEX * 4 );
+	uint8_t * benchtexbc;
+	int benchtexformat, benchtexlevels;
+	size_t benchtexsize;
+	if( 1 )
+	{
+		//Benchmark: BC1 encode of a 4k picture with mips, and how much VRAM it saves.
+		int x, y;
+		for( y = 0; y < BENCH_TEX; y++ )
+		for( x = 0; x < BENCH_TEX; x++ )
+		{
+			uint8_t * p = benchtex + ( x + y * BENCH_TEX ) * 4;
+			p[0] = x >> 4; p[1] = y >> 4; p[2] = ( x ^ y ) & 0xff; p[3] = 255;
+		}
+		double start = OGGetAbsoluteTime();
+		benchtexbc = CNOVRTexCompressRGBA( benchtex, BENCH_TEX, BENCH_TEX, CNOVR_TEXMIPS_SRGB, &benchtexformat, &benchtexlevels, &benchtexsize );
+		double encode = OGGetAbsoluteTime() - start;
+		if( benchtexformat != CNOVR_TEXCOMPRESS_BC1 || benchtexlevels != 13 ) FAIL;
+
+		//Alpha has to pick BC3, and odd sizes have to round up to whole blocks.
+		benchtex[3] = 0;
+		int fmt, levels;
+		size_t size;
+		uint8_t * small = CNOVRTexCompressRGBA( benchtex, 5, 3, CNOVR_TEXMIPS_LINEAR, &fmt, &levels, &size );
+		if( fmt != CNOVR_TEXCOMPRESS_BC3 || levels != 3 || size != 16*2 + 16 + 16 ) FAIL;
+
+		//Cache round trip, then a header that lies about its size or format has to be thrown out.
+		{
+			const char * cachesrc = "offlinetests_tex.png";
+			int cw, ch, cfmt, clevels;
+			size_t csize;
+			CNOVRTexCompressCacheSave( cachesrc, 1234, CNOVR_TEXMIPS_LINEAR, 5, 3, fmt, levels, small, size );
+			uint8_t * cached = CNOVRTexCompressCacheLoad( cachesrc, 1234, CNOVR_TEXMIPS_LINEAR, &cw, &ch, &cfmt, &clevels, &csize );
+			if( !cached || cw != 5 || ch != 3 || cfmt != fmt || clevels != levels || csize != size || memcmp( cached, small, size ) ) FAIL;
+			free( cached );
+
+			CNOVRTexCompressCacheSave( cachesrc, 1234, CNOVR_TEXMIPS_LINEAR, 5, 3, fmt, levels, small, size - 16 );
+			if( CNOVRTexCompressCacheLoad( cachesrc, 1234, CNOVR_TEXMIPS_LINEAR, &cw, &ch, &cfmt, &clevels, &csize ) ) FAIL;
+			CNOVRTexCompressCacheSave( cachesrc, 1234, CNOVR_TEXMIPS_LINEAR, 5, 3, CNOVR_TEXCOMPRESS_BC1, levels, small, size );
+			if( CNOVRTexCompressCacheLoad( cachesrc, 1234, CNOVR_TEXMIPS_LINEAR, &cw, &ch, &cfmt, &clevels, &csize ) ) FAIL;
+			CNOVRTexCompressCacheSave( cachesrc, 1234, CNOVR_TEXMIPS_LINEAR, 5, 3, 0x1234, levels, small, size );
+			if( CNOVRTexCompressCacheLoad( cachesrc, 1234, CNOVR_TEXMIPS_LINEAR, &cw, &ch, &cfmt, &clevels, &csize ) ) FAIL;
+			remove( "offlinetests_tex.png.texcache" );
+		}
+		free( small );
+		benchtex[3] = 255;
+
+		printf( "BC1 %dx%d with mips: encode %.0fms, VRAM %.1f MB -> %.1f MB\n", BENCH_TEX, BENCH_TEX, encode * 1000,
+			BENCH_TEX * BENCH_TEX * 4 * 4.0 / 3.0 / 1048576.0, benchtexsize / 1048576.0 );
+	}
+
+	if( 1 )
+	{
+		//CPU mip chains.  sRGB has to average in linear light: black + white is 188, not 128.
+		int levels, x, y, k;
+		size_t size;
+		uint8_t * bw = malloc( 2 * 2 * 4 );
+		for( k = 0; k < 16; k++ ) bw[k] = ( ( k / 4 ) & 1 ) ? 255 : 0;
+		bw = CNOVRTexMipChainRGBA( bw, 2, 2, CNOVR_TEXMIPS_SRGB, &levels, &size );
+		if( levels != 2 || size != 20 || bw[16] != 188 || bw[17] != 188 || bw[18] != 188 || bw[19] != 128 ) FAIL;
+		free( bw );
+
+		//Linear goes through SSE2 where it can, it has to match the plain box filter, odd edges too.
+		#define MIPTEST_W 70
+		#define MIPTEST_H 9
+		uint8_t * img = malloc( MIPTEST_W * MIPTEST_H * 4 );
+		for( k = 0; k < MIPTEST_W * MIPTEST_H * 4; k++ ) img[k] = rand();
+		uint8_t * ref = malloc( MIPTEST_W * MIPTEST_H * 4 );
+		memcpy( ref, img, MIPTEST_W * MIPTEST_H * 4 );
+		img = CNOVRTexMipChainRGBA( img, MIPTEST_W, MIPTEST_H, CNOVR_TEXMIPS_LINEAR, &levels, &size );
+		if( levels != 7 ) FAIL;
+		uint8_t * l1 = img + MIPTEST_W * MIPTEST_H * 4;
+		for( y = 0; y < MIPTEST_H / 2; y++ )
+		for( x = 0; x < MIPTEST_W / 2; x++ )
+		for( k = 0; k < 4; k++ )
+		{
+			int a = ref[(x*2+y*2*MIPTEST_W)*4+k] + ref[(x*2+1+y*2*MIPTEST_W)*4+k] +
+				ref[(x*2+(y*2+1)*MIPTEST_W)*4+k] + ref[(x*2+1+(y*2+1)*MIPTEST_W)*4+k];
+			if( l1[(x+y*(MIPTEST_W/2))*4+k] != ( a + 2 ) / 4 ) FAIL;
+		}
+		free( img );
+		free( ref );
+
+		double tmip[2];
+		for( k = 0; k < 2; k++ )
+		{
+			uint8_t * chain = malloc( BENCH_TEX * BENCH_TEX * 4 );
+			memcpy( chain, benchtex, BENCH_TEX * BENCH_TEX * 4 );
+			tmip[k] = OGGetAbsoluteTime();
+			chain = CNOVRTexMipChainRGBA( chain, BENCH_TEX, BENCH_TEX, k ? CNOVR_TEXMIPS_LINEAR : CNOVR_TEXMIPS_SRGB, &levels, &size );
+			tmip[k] = OGGetAbsoluteTime() - tmip[k];
+			free( chain );
+		}
+		printf( "Mip chain %dx%d: sRGB %.1fms, linear %.1fms\n", BENCH_TEX, BENCH_TEX, tmip[0]*1000, tmip[1]*1000 );
+	}
+
+	if( argc > 1 && strcmp( argv[1], "gl" ) == 0 )
+	{
+		//Everything in here needs a GL context, so it only runs with "offlinetests gl".  CNOVRInit brings
+		//the job system back up for the tests below.
+		CNOVRJobStop();
+		if( CNOVRInit( "offlinetests", 64, 64, 2 ) ) FAIL;
+
+		//Benchmark: 4x MSAA resolve of both eyes at Index's 100% render target size.
+		#define BENCH_RESOLVE_W 2016
+		#define BENCH_RESOLVE_H 2224
+		#define BENCH_RESOLVE_ITERS 200
+		cnovr_rf_buffer * eyes[2];
+		eyes[0] = CNOVRRFBufferCreate( BENCH_RESOLVE_W, BENCH_RESOLVE_H, 4 );
+		eyes[1] = CNOVRRFBufferCreate( BENCH_RESOLVE_W, BENCH_RESOLVE_H, 4 );
+		cnovr_rf_buffer * eyearray = CNOVRRFBufferCreateArray( BENCH_RESOLVE_W, BENCH_RESOLVE_H, 4, 2 );
+		if( !eyes[0] || !eyes[1] || !eyearray ) FAIL;
+
+		double tres[3];
+		int mode;
+		for( mode = 0; mode < 3; mode++ )
+		{
+			//0: blit, 1: resolve shader, 2: blit out of the eye array.
+			cnovrstate->bShaderResolve = mode == 1;
+			int j;
+			for( j = 0; j < BENCH_RESOLVE_ITERS + 10; j++ )
+			{
+				//First few are warmup, and let the resolve shader compile.
+				if( j == 10 )
+				{
+					glFinish();
+					tres[mode] = OGGetAbsoluteTime();
+				}
+				if( mode == 2 )
+				{
+					CNOVRFBufferActivateLayer( eyearray, 0 );
+					glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+					CNOVRFBufferActivateLayer( eyearray, 1 );
+					glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+					CNOVRFBufferBlitResolve( eyearray );
+				}
+				else
+				{
+					for( i = 0; i < 2; i++ )
+					{
+						CNOVRFBufferActivate( eyes[i] );
+						glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+						CNOVRFBufferBlitResolve( eyes[i] );
+					}
+				}
+				while( CNOVRJobProcessQueueElement( cnovrQPrerender ) );
+				CNOVRListCall( cnovrLPrerender, 0, 0 );
+			}
+			glFinish();
+			tres[mode] = ( OGGetAbsoluteTime() - tres[mode] ) / BENCH_RESOLVE_ITERS;
+		}
+		cnovrstate->bShaderResolve = 0;
+
+		printf( "Resolve 4x MSAA, 2x %dx%d: blit %.3fms, shader %.3fms, eye array blit %.3fms (incl. clear)\n",
+			BENCH_RESOLVE_W, BENCH_RESOLVE_H, tres[0]*1000, tres[1]*1000, tres[2]*1000 );
+		CNOVRDelete( eyes[0] );
+		CNOVRDelete( eyes[1] );
+		CNOVRDelete( eyearray );
+		while( CNOVRJobProcessQueueElement( cnovrQPrerender ) );
+
+		//Benchmark: uploading the 4k picture, RGBA8 + glGenerateMipmap vs. the precompressed BC1 chain.
+		GLuint texids[2];
+		double tup[2];
+		glGenTextures( 2, texids );
+		glFinish();
+		tup[0] = OGGetAbsoluteTime();
+		glBindTexture( GL_TEXTURE_2D, texids[0] );
+		glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA8, BENCH_TEX, BENCH_TEX, 0, GL_RGBA, GL_UNSIGNED_BYTE, benchtex );
+		glGenerateMipmapCHEW( GL_TEXTURE_2D );
+		glFinish();
+		tup[0] = OGGetAbsoluteTime() - tup[0];
+		tup[1] = OGGetAbsoluteTime();
+		glBindTexture( GL_TEXTURE_2D, texids[1] );
+		{
+			int l, lw = BENCH_TEX;
+			size_t offset = 0;
+			for( l = 0; l < benchtexlevels; l++ )
+			{
+				size_t ls = CNOVRTexCompressLevelSize( benchtexformat, lw, lw );
+				glCompressedTexImage2DCHEW( GL_TEXTURE_2D, l, benchtexformat, lw, lw, 0, ls, benchtexbc + offset );
+				offset += ls;
+				lw = ( lw > 1 ) ? lw / 2 : 1;
+			}
+		}
+		glFinish();
+		tup[1] = OGGetAbsoluteTime() - tup[1];
+		glBindTexture( GL_TEXTURE_2D, 0 );
+		glDeleteTextures( 2, texids );
+		printf( "Upload %dx%d with mips: RGBA8 %.1fms, BC1 %.1fms\n", BENCH_TEX, BENCH_TEX, tup[0]*1000, tup[1]*1000 );
+
+		//Benchmark: building a shader from source, then again from the program binary the first build cached.
+		//The timestamp makes sure the first one misses.
+		{
+			FILE * f = fopen( "offlinetests_shader.vert", "w" );
+			if( !f ) FAIL;
+			fprintf( f, "#version AUTOVER\n#include \"cnovr.glsl\"\n//%f\nin vec4 position; //#MAPATTRIB position 0\n"
+				"void main() { gl_Position = umPerspective * umView * umModel * vec4( position.xyz, 1.0 ); }\n", OGGetAbsoluteTime() );
+			fclose( f );
+			f = fopen( "offlinetests_shader.frag", "w" );
+			if( !f ) FAIL;
+			fprintf( f, "#version AUTOVER\n#include \"cnovr.glsl\"\nout vec4 colorOut;\nvoid main() { colorOut = vec4( 1.0 ); }\n" );
+			fclose( f );
+
+			double tsh[2];
+			for( mode = 0; mode < 2; mode++ )
+			{
+				double start = OGGetAbsoluteTime();
+				cnovr_shader * s = CNOVRShaderCreate( "offlinetests_shader" );
+				while( !s->nShaderID && OGGetAbsoluteTime() - start < 10 )
+				{
+					while( CNOVRJobProcessQueueElement( cnovrQPrerender ) );
+					CNOVRListCall( cnovrLPrerender, 0, 0 );
+					OGUSleep( 100 );
+				}
+				tsh[mode] = OGGetAbsoluteTime() - start;
+				if( !s->nShaderID ) FAIL;
+				CNOVRDelete( s );
+				while( CNOVRJobProcessQueueElement( cnovrQPrerender ) );
+			}
+			printf( "Shader build: from source %.1fms, from program binary %.1fms%s\n", tsh[0]*1000, tsh[1]*1000,
+				cnovrstate->bParallelShaderCompile ? " (parallel compile)" : "" );
+		}
+	}
+
+	free( benchtex );
+	free( benchtexbc );
+
 	if( 1 )
 	{
 		cnovr_model * m = CNOVRModelCreate( 0, GL_TRIANGLES );
@@ -169,6 +650,7 @@ int main()
 
 		printf( " PASS\n" );
 	}
+
 	CNOVRJobStop();
 	printf( "DONE\n" );
 	return 0;
@@ -1,4 +1,4 @@
 del main.exe
-C:\tcc\tcc.exe -v -o main.exe -lkernel32 -lgdi32 -lshlwapi -ldbghelp -luser32 -lopengl32 -Iopenvr/headers -Irawdraw -DCNFGOGL -DWINDOWS -DOSG_NOSTATIC -Iinclude -g -Icntools/cnhash -Icntools/cnrbtree -Ilib -Ilib/systemheaders -Ilib/tinycc/include  -Ilib/tinycc    src/main.c lib/stb_include_custom.c lib/stb_image.c lib/tcc_single_file.c lib/cnrbtree.c lib/tccengine_link.c lib/tcccrash_link.c lib/symbol_enumerator_link.c lib/cnhash_link.c lib/jsmn.c lib/os_generic_link.c rawdraw/CNFGWinDriver.c rawdraw/CNFGFunctions.c src/cnovr.c src/chew.c src/cnovrparts.c src/cnovrmath.c src/cnovrutil.c src/cnovrfocus.c src/cnovrindexedlist.c src/cnovropenvr.c src/cnovrtcc.c src/cnovrtccinterface.c src/cnovrcanvas.c openvr/bin/win32/openvr_api.dll C:/windows/system32/msvcrt.dll -rdynamic
+C:\tcc\tcc.exe -v -o main.exe -lkernel32 -lgdi32 -lshlwapi -ldbghelp -luser32 -lopengl32 -Iopenvr/headers -Irawdraw -DCNFGOGL -DWINDOWS -DOSG_NOSTATIC -Iinclude -g -Icntools/cnhash -Icntools/cnrbtree -Ilib -Ilib/systemheaders -Ilib/tinycc/include  -Ilib/tinycc    src/main.c lib/stb_include_custom.c lib/stb_image.c lib/tcc_single_file.c lib/cnrbtree.c lib/tccengine_link.c lib/tcccrash_link.c lib/symbol_enumerator_link.c lib/cnhash_link.c lib/jsmn.c lib/os_generic_link.c rawdraw/CNFGWinDriver.c rawdraw/CNFGFunctions.c src/cnovr.c src/chew.c src/cnovrparts.c src/cnovrmath.c src/cnovrutil.c src/cnovrfocus.c src/cnovrindexedlist.c src/cnovropenvr.c src/cnovrtcc.c src/cnovrtccinterface.c src/cnovrcanvas.c src/cnovrprofile.c src/cnovrtexcompress.c openvr/bin/win32/openvr_api.dll C:/windows/system32/msvcrt.dll -rdynamic
 
 